@@ -1,219 +1,797 @@
-// (c) Yuri N. K. 2025. All rights reserved.
-// ykasczc@gmail.com
-
-#include "DictionaryArchive.h"
-#include "Misc/Paths.h"
-#include "Misc/FileHelper.h"
-#include "LocalTTSTypes.h"
-
-#if !defined(__ORDER_LITTLE_ENDIAN__)
-#define __ORDER_LITTLE_ENDIAN__ PLATFORM_LITTLE_ENDIAN
-#endif
-
-#pragma warning( push )
-#pragma warning( disable : 4334)
-
-#if PLATFORM_WINDOWS
-#define WIN32_LEAN_AND_MEAN
-#endif
-
-#undef malloc
-#undef free
-#undef realloc
-#undef memset
-#undef memcpy
-
-#define malloc(Count)				FMemory::Malloc(Count)
-#define free(Original)				FMemory::Free(Original)
-#define realloc(Original, Count)	FMemory::Realloc(Original, Count)
-#define memset(Dest, Char, Count)	FMemory::Memset(Dest, Char, Count)
-#define memcpy(Dest, Source, Count)	FMemory::Memcpy(Dest, Source, Count)
-
-THIRD_PARTY_INCLUDES_START
-#if PLATFORM_PS4 || PLATFORM_PS5
-#define MINIZ_NO_TIME
-#endif
-#include "miniz.h"
-#include "miniz.c"
-THIRD_PARTY_INCLUDES_END
-
-#undef malloc
-#undef free
-#undef realloc
-#undef memset
-#undef memcpy
-
-#pragma warning( pop )
-
-//--------------------------------------------------------------------------------------------------------
-
-void UDictionaryArchive::Serialize(FArchive& Ar)
-{
-    Super::Serialize(Ar);
-
-    ArchivedData.SetBulkDataFlags(BULKDATA_Force_NOT_InlinePayload | BULKDATA_Size64Bit);
-    ArchivedData.Serialize(Ar, this, INDEX_NONE, false);
-}
-
-void UDictionaryArchive::BeginDestroy()
-{
-    Super::BeginDestroy();
-	
-    if (G2PData.IsValid())
-    {
-        G2PData->Empty();
-        G2PData.Reset();
-    }
-
-    // It shouldn't happen unless the app was closed in a process of unzipping
-    if (ZipPtr)
-    {
-        FMemory::Free(ZipPtr);
-        ZipPtr = nullptr;
-    }
-}
-
-bool UDictionaryArchive::InitializeFromFile(const FString& FileName /* lang_file.zip { lang_file.csv } */)
-{
-    TArray64<uint8> TempBuffer;
-
-    if (FPaths::FileExists(FileName))
-    {
-        if (FFileHelper::LoadFileToArray(TempBuffer, *FileName))
-        {
-            ImportFileName = FPaths::GetBaseFilename(FileName) + TEXT(".csv");
-            Size = TempBuffer.Num();
-
-            // Fill BulkData
-            ArchivedData.Lock(LOCK_READ_WRITE);
-            void* DataPtr = ArchivedData.Realloc(TempBuffer.Num());
-            FMemory::Memcpy(DataPtr, TempBuffer.GetData(), TempBuffer.Num());
-            ArchivedData.Unlock();
-
-            Unzip();
-
-            return true;
-        }
-    }
-    return false;
-}
-
-void UDictionaryArchive::Unzip()
-{
-    mz_zip_archive* pZip = (mz_zip_archive*)(FMemory::Memzero(FMemory::Malloc(sizeof(mz_zip_archive)), sizeof(mz_zip_archive)));
-    ZipPtr = pZip;
-
-    // Read data
-    char* DataPtr = nullptr;
-    int32 DataSize = ArchivedData.GetBulkDataSize();
-    ArchivedData.GetCopy(reinterpret_cast<void**>(&DataPtr));    
-
-    if (!mz_zip_reader_init_mem(pZip, DataPtr, DataSize, MZ_ZIP_FLAG_WRITE_ZIP64))
-    {
-        UE_LOG(LogTemp, Warning, TEXT("Couldn't load zip archive from the binary data"));
-        pZip = nullptr;
-        return;
-    }
-
-    int32 EntriesNum = mz_zip_reader_get_num_files(pZip);
-    if (EntriesNum <= 0)
-    {
-        UE_LOG(LogTemp, Warning, TEXT("Archive is empty :("));
-        FMemory::Free(ZipPtr);
-        pZip = nullptr;
-        return;
-
-    }
-
-    bool bDirectoriesThreeError = false;
-
-    ZipEntriesNum = EntriesNum;
-    FullArchiveSize = 0;
-    int32 Index = 0;
-    {
-        // Get file information
-        mz_zip_archive_file_stat EntryDesc;
-        const bool bResult = static_cast<bool>(mz_zip_reader_file_stat(pZip, (mz_uint)Index, &EntryDesc));
-        if (!bResult)
-        {
-            FMemory::Free(ZipPtr);
-            ZipPtr = nullptr;
-            return;
-        }
-
-        int32 IsDirectory = (int32)EntryDesc.m_is_directory;
-        FullArchiveSize += (int64)EntryDesc.m_comp_size;
-
-        FString FileName = ANSI_TO_TCHAR(EntryDesc.m_filename);
-
-        // Create directory
-        if (!IsDirectory)
-        {
-            UnzippedSize += (int64)EntryDesc.m_comp_size;
-
-            // Extracting to memory
-            size_t EntrySize;
-            uint8* EntryDataPtr = (uint8*)mz_zip_reader_extract_to_heap(pZip, (mz_uint)Index, &EntrySize, 0);
-
-            if (!EntryDataPtr)
-            {
-                FString EntryName = ANSI_TO_TCHAR(EntryDesc.m_filename);
-                UE_LOG(LogTemp, Warning, TEXT("Unable to extract zip entry '%s' into memory"), *EntryName);
-                FMemory::Free(ZipPtr);
-                ZipPtr = nullptr;
-                return;
-            }
-
-            FillMap((char*)EntryDataPtr, EntrySize);
-
-            FMemory::Free(EntryDataPtr);
-        }
-    }
-
-    FMemory::Free(ZipPtr);
-    FMemory::Free(DataPtr);
-    pZip = nullptr;
-}
-
-void UDictionaryArchive::FillMap(const char* Data, int64 DataSize)
-{
-    FString DataRaw = UTF8_TO_TCHAR(Data);
-
-    TArray<FString> CsvLines;
-    DataRaw.ParseIntoArrayLines(CsvLines);
-
-    if (!G2PData)
-    {
-        G2PData = MakeUnique<TMap<FString, FString>>();
-    }
-
-    G2PData->Empty();
-    int32 Counter = 0;
-    for (const auto& p : CsvLines)
-    {
-        if (p == TEXT("word;phoneme")) continue;
-        int32 ind = p.Find(TEXT(";"));
-        if (ind > 0)
-        {
-            FString Key = p.Left(ind);
-            FString Val = p.Right(p.Len() - ind - 1);
-            G2PData->Add(Key, Val);
-        }
-        else
-        {
-            UE_LOG(LogTemp, Log, TEXT("Skipping line #%d (%s)"), Counter, *p);;
-        }
-        Counter++;
-    }
-    UE_LOG(LogTemp, Log, TEXT("Phonemization dictionary: %d lines deserialized"), G2PData->Num());
-}
-
-bool UDictionaryArchive::HasBulkData() const
-{
-    return ArchivedData.GetBulkDataSize() > 0;
-}
-
-bool UDictionaryArchive::IsDictionaryReady() const
-{
-    return G2PData.IsValid() && !G2PData->IsEmpty();
-}
+// (c) Yuri N. K. 2025. All rights reserved.
+// ykasczc@gmail.com
+
+#include "DictionaryArchive.h"
+#include "Misc/Paths.h"
+#include "Misc/FileHelper.h"
+#include "LocalTTSTypes.h"
+#include "Serialization/CustomVersion.h"
+#include "HAL/PlatformTime.h"
+#include "Async/ParallelFor.h"
+#include "Async/Async.h"
+#include "UObject/ObjectSaveContext.h"
+
+#if !defined(__ORDER_LITTLE_ENDIAN__)
+#define __ORDER_LITTLE_ENDIAN__ PLATFORM_LITTLE_ENDIAN
+#endif
+
+#pragma warning( push )
+#pragma warning( disable : 4334)
+
+#if PLATFORM_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#undef malloc
+#undef free
+#undef realloc
+#undef memset
+#undef memcpy
+
+#define malloc(Count)				FMemory::Malloc(Count)
+#define free(Original)				FMemory::Free(Original)
+#define realloc(Original, Count)	FMemory::Realloc(Original, Count)
+#define memset(Dest, Char, Count)	FMemory::Memset(Dest, Char, Count)
+#define memcpy(Dest, Source, Count)	FMemory::Memcpy(Dest, Source, Count)
+
+THIRD_PARTY_INCLUDES_START
+#if PLATFORM_PS4 || PLATFORM_PS5
+#define MINIZ_NO_TIME
+#endif
+#include "miniz.h"
+#include "miniz.c"
+THIRD_PARTY_INCLUDES_END
+
+#undef malloc
+#undef free
+#undef realloc
+#undef memset
+#undef memcpy
+
+#pragma warning( pop )
+
+//--------------------------------------------------------------------------------------------------------
+
+namespace DictionaryCsv
+{
+    // Size of decompressed data parsed at once
+    constexpr int64 ChunkSize = 4 * 1024 * 1024;
+    // Min size of data parsed by one worker
+    constexpr int64 MinRangeSize = 256 * 1024;
+    // About 24 bytes per line in the dictionaries
+    constexpr int64 BytesPerLine = 24;
+
+    // Parse lines "word;phonemes" in UTF-8 data, returns number of skipped lines
+    int32 ParseLines(const char* Data, int64 DataSize, FPhonemeDictionaryBuilder& Builder)
+    {
+        int32 SkippedLines = 0;
+        int64 LineStart = 0;
+        while (LineStart < DataSize)
+        {
+            const char* LineEndPtr = (const char*)memchr(Data + LineStart, '\n', DataSize - LineStart);
+            const int64 LineEnd = LineEndPtr ? LineEndPtr - Data : DataSize;
+            int64 LineLen = LineEnd - LineStart;
+            if (LineLen > 0 && Data[LineStart + LineLen - 1] == '\r') LineLen--;
+
+            const FUtf8StringView Line((const UTF8CHAR*)(Data + LineStart), (int32)LineLen);
+            LineStart = LineEnd + 1;
+
+            if (Line.IsEmpty() || Line == UTF8TEXTVIEW("word;phoneme")) continue;
+            int32 ind = INDEX_NONE;
+            if (!Line.FindChar(UTF8CHAR(';'), ind) || ind == 0 || !Builder.Add(Line.Left(ind), Line.RightChop(ind + 1)))
+            {
+                SkippedLines++;
+            }
+        }
+        return SkippedLines;
+    }
+
+    // Split data to line ranges and parse them in parallel. Entries are appended to Builder in the original order
+    int32 ParseLinesParallel(const char* Data, int64 DataSize, FPhonemeDictionaryBuilder& Builder)
+    {
+        const int32 RangesNum = FMath::Clamp((int32)(DataSize / MinRangeSize), 1, FTaskGraphInterface::Get().GetNumWorkerThreads() + 1);
+        if (RangesNum == 1)
+        {
+            return ParseLines(Data, DataSize, Builder);
+        }
+
+        // Move range borders to the beginning of the next line
+        TArray<int64, TInlineAllocator<32>> Borders;
+        Borders.SetNumUninitialized(RangesNum + 1);
+        Borders[0] = 0;
+        Borders[RangesNum] = DataSize;
+        for (int32 i = 1; i < RangesNum; i++)
+        {
+            const int64 Position = FMath::Max(DataSize * i / RangesNum, Borders[i - 1]);
+            const char* LineEndPtr = (const char*)memchr(Data + Position, '\n', DataSize - Position);
+            Borders[i] = LineEndPtr ? LineEndPtr - Data + 1 : DataSize;
+        }
+
+        TArray<FPhonemeDictionaryBuilder> RangeBuilders;
+        TArray<int32> RangeSkippedLines;
+        RangeBuilders.SetNum(RangesNum);
+        RangeSkippedLines.SetNumZeroed(RangesNum);
+        ParallelFor(RangesNum, [&](int32 RangeIndex)
+        {
+            const int64 RangeSize = Borders[RangeIndex + 1] - Borders[RangeIndex];
+            RangeBuilders[RangeIndex].Reserve((int32)(RangeSize / BytesPerLine), RangeSize);
+            RangeSkippedLines[RangeIndex] = ParseLines(Data + Borders[RangeIndex], RangeSize, RangeBuilders[RangeIndex]);
+        });
+
+        int32 SkippedLines = 0;
+        for (int32 i = 0; i < RangesNum; i++)
+        {
+            Builder.Append(MoveTemp(RangeBuilders[i]));
+            SkippedLines += RangeSkippedLines[i];
+        }
+        return SkippedLines;
+    }
+
+    // UTF-8 BOM size at the beginning of data
+    int64 GetBomSize(const char* Data, int64 DataSize)
+    {
+        return DataSize >= 3 && FMemory::Memcmp(Data, "\xEF\xBB\xBF", 3) == 0 ? 3 : 0;
+    }
+
+    // Extract csv file from zip archive by chunks and add its lines to Builder
+    bool ExtractEntry(mz_zip_archive* pZip, const mz_zip_archive_file_stat& EntryDesc, FPhonemeDictionaryBuilder& Builder)
+    {
+        // Complete lines of each chunk are parsed while the rest is moved to the next chunk
+        mz_zip_reader_extract_iter_state* EntryIter = mz_zip_reader_extract_iter_new(pZip, EntryDesc.m_file_index, 0);
+        if (!EntryIter)
+        {
+            FString EntryName = ANSI_TO_TCHAR(EntryDesc.m_filename);
+            UE_LOG(LogTemp, Warning, TEXT("Unable to extract zip entry '%s' into memory"), *EntryName);
+            return false;
+        }
+
+        Builder.Reserve(Builder.Num() + (int32)(EntryDesc.m_uncomp_size / BytesPerLine), EntryDesc.m_uncomp_size);
+
+        TArray64<char> Chunk;
+        Chunk.SetNumUninitialized(FMath::Min<int64>(ChunkSize, EntryDesc.m_uncomp_size + 1));
+        int64 PendingSize = 0;
+        int64 ParsedSize = 0;
+        int32 SkippedLines = 0;
+        while (true)
+        {
+            const int64 ReadSize = (int64)mz_zip_reader_extract_iter_read(EntryIter, Chunk.GetData() + PendingSize, Chunk.Num() - PendingSize);
+            int64 AvailableSize = PendingSize + ReadSize;
+            int64 Start = ParsedSize == 0 ? GetBomSize(Chunk.GetData(), AvailableSize) : 0;
+
+            if (ReadSize == 0)
+            {
+                // Last line without line break
+                SkippedLines += ParseLines(Chunk.GetData() + Start, AvailableSize - Start, Builder);
+                break;
+            }
+
+            int64 ChunkEnd = AvailableSize;
+            while (ChunkEnd > Start && Chunk[ChunkEnd - 1] != '\n') ChunkEnd--;
+            if (ChunkEnd == Start)
+            {
+                // Line is longer than chunk
+                PendingSize = AvailableSize;
+                Chunk.SetNumUninitialized(Chunk.Num() * 2);
+                continue;
+            }
+
+            SkippedLines += ParseLinesParallel(Chunk.GetData() + Start, ChunkEnd - Start, Builder);
+            ParsedSize += ChunkEnd;
+            PendingSize = AvailableSize - ChunkEnd;
+            FMemory::Memmove(Chunk.GetData(), Chunk.GetData() + ChunkEnd, PendingSize);
+        }
+
+        // Read returns 0 both at the end and on error. Free checks size and CRC of the completely decompressed entry
+        const bool bReadFailed = EntryIter->status < 0;
+        if (!mz_zip_reader_extract_iter_free(EntryIter) || bReadFailed)
+        {
+            FString EntryName = ANSI_TO_TCHAR(EntryDesc.m_filename);
+            FString ErrorText = ANSI_TO_TCHAR(mz_zip_get_error_string(mz_zip_get_last_error(pZip)));
+            UE_LOG(LogTemp, Error, TEXT("Zip entry '%s' is corrupted: %s"), *EntryName, *ErrorText);
+            return false;
+        }
+
+        if (SkippedLines > 0)
+        {
+            UE_LOG(LogTemp, Log, TEXT("Phonemization dictionary: %d lines skipped"), SkippedLines);
+        }
+        return true;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------------
+
+struct FDictionaryArchiveVersion
+{
+    enum Type
+    {
+        BeforeCustomVersionWasAdded = 0,
+        // Dictionary table is compiled at import and saved as second bulk data
+        CompiledTable,
+        // Phonemes in compiled table are stored as NFD-normalized code points
+        NormalizedPhonemes,
+
+        VersionPlusOne,
+        LatestVersion = VersionPlusOne - 1
+    };
+
+    static const FGuid GUID;
+};
+
+const FGuid FDictionaryArchiveVersion::GUID(0x6A1F3C52, 0x94B04E1D, 0xA2C7E813, 0x5D09B4F6);
+FCustomVersionRegistration GRegisterDictionaryArchiveVersion(FDictionaryArchiveVersion::GUID, FDictionaryArchiveVersion::LatestVersion, TEXT("LocalTTSDictionaryArchive"));
+
+void UDictionaryArchive::Serialize(FArchive& Ar)
+{
+    Super::Serialize(Ar);
+    Ar.UsingCustomVersion(FDictionaryArchiveVersion::GUID);
+
+    ArchivedData.SetBulkDataFlags(BULKDATA_Force_NOT_InlinePayload | BULKDATA_Size64Bit);
+    ArchivedData.Serialize(Ar, this, INDEX_NONE, false);
+
+    if (Ar.CustomVer(FDictionaryArchiveVersion::GUID) >= FDictionaryArchiveVersion::CompiledTable)
+    {
+        // Compiled table is cooked to a separate aligned payload and mapped on load on platforms supporting it,
+        // otherwise shards are read on first lookup
+        CompiledData.SetBulkDataFlags(BULKDATA_Force_NOT_InlinePayload | BULKDATA_Size64Bit | BULKDATA_MemoryMappedPayload);
+        CompiledData.Serialize(Ar, this, INDEX_NONE, /* bAttemptFileMapping */ Ar.IsLoading());
+
+        if (Ar.IsLoading() && Ar.CustomVer(FDictionaryArchiveVersion::GUID) < FDictionaryArchiveVersion::NormalizedPhonemes)
+        {
+            // Outdated table format: the dictionary will be compiled again from ZIP archive
+            CompiledData.RemoveBulkData();
+            CompiledShardOffsets.Empty();
+            CompiledSize = 0;
+        }
+    }
+}
+
+#if WITH_EDITOR
+void UDictionaryArchive::PreSave(FObjectPreSaveContext SaveContext)
+{
+    Super::PreSave(SaveContext);
+
+    // Assets without compiled table (old or outdated format) are saved and cooked with it, so ZIP archive isn't parsed in runtime
+    if (ArchivedData.GetBulkDataSize() == 0 || HasCompiledTable())
+    {
+        return;
+    }
+
+    EDictionaryState ExpectedState = EDictionaryState::NotReady;
+    if (DictionaryState.compare_exchange_strong(ExpectedState, EDictionaryState::Building))
+    {
+        // Build the table only to save it
+        UnzipArchive();
+        StoreCompiledTable(UnzippedData, GetBuiltShardOffsets(), GetBuiltWordsNum());
+        ReleaseData();
+        DictionaryState.store(EDictionaryState::NotReady, std::memory_order_release);
+    }
+    else if (ExpectedState == EDictionaryState::Ready && !UnzippedData.IsEmpty())
+    {
+        // Already built from ZIP archive
+        StoreCompiledTable(UnzippedData, GetBuiltShardOffsets(), GetBuiltWordsNum());
+    }
+    else if (ExpectedState == EDictionaryState::Building)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Phonemization dictionary %s is being prepared, its compiled table will be stored when it's ready"), *GetName());
+    }
+
+    if (!HasCompiledTable() && ExpectedState != EDictionaryState::Building)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Phonemization dictionary %s is saved without compiled table"), *GetName());
+    }
+}
+#endif
+
+void UDictionaryArchive::BeginDestroy()
+{
+    Super::BeginDestroy();
+
+    // Background task can still use the data, it will be released in IsReadyForFinishDestroy
+    if (GetDictionaryState() != EDictionaryState::Building)
+    {
+        ReleaseData();
+    }
+}
+
+bool UDictionaryArchive::IsReadyForFinishDestroy()
+{
+    // Wait for the background task
+    if (GetDictionaryState() == EDictionaryState::Building)
+    {
+        return false;
+    }
+    ReleaseData();
+    return Super::IsReadyForFinishDestroy();
+}
+
+void UDictionaryArchive::ReleaseData()
+{
+    Shards.Empty();
+    UnzippedData.Empty();
+    MappedData = nullptr;
+    if (bCompiledDataLocked)
+    {
+        CompiledData.Unlock();
+        bCompiledDataLocked = false;
+    }
+
+    // It shouldn't happen unless the app was closed in a process of unzipping
+    if (ZipPtr)
+    {
+        FMemory::Free(ZipPtr);
+        ZipPtr = nullptr;
+    }
+}
+
+bool UDictionaryArchive::InitializeFromFile(const FString& FileName /* lang_file.zip { lang_file.csv } */)
+{
+    TArray64<uint8> TempBuffer;
+
+    if (FPaths::FileExists(FileName))
+    {
+        if (FFileHelper::LoadFileToArray(TempBuffer, *FileName))
+        {
+            ImportFileName = FPaths::GetBaseFilename(FileName) + TEXT(".csv");
+            Size = TempBuffer.Num();
+
+            // Fill BulkData
+            ArchivedData.Lock(LOCK_READ_WRITE);
+            void* DataPtr = ArchivedData.Realloc(TempBuffer.Num());
+            FMemory::Memcpy(DataPtr, TempBuffer.GetData(), TempBuffer.Num());
+            ArchivedData.Unlock();
+
+            // Build dictionary table and save it with the asset, so it can be used without unzipping
+            ReleaseData();
+            DictionaryState.store(EDictionaryState::Building);
+            UnzipArchive();
+            StoreCompiledTable(UnzippedData, GetBuiltShardOffsets(), GetBuiltWordsNum());
+            const bool bResult = IsValidTable();
+            DictionaryState.store(bResult ? EDictionaryState::Ready : EDictionaryState::Failed, std::memory_order_release);
+
+            return bResult;
+        }
+    }
+    return false;
+}
+
+void UDictionaryArchive::Unzip()
+{
+    EDictionaryState ExpectedState = EDictionaryState::NotReady;
+    if (DictionaryState.compare_exchange_strong(ExpectedState, EDictionaryState::Building))
+    {
+        PrepareTable();
+    }
+}
+
+void UDictionaryArchive::PrepareAsync()
+{
+    EDictionaryState ExpectedState = EDictionaryState::NotReady;
+    if (DictionaryState.compare_exchange_strong(ExpectedState, EDictionaryState::Building))
+    {
+        // The asset isn't destroyed until the state is changed (see IsReadyForFinishDestroy),
+        // so it's resolved even if it became unreachable in the meantime
+        AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [WeakThis = TWeakObjectPtr<UDictionaryArchive>(this)]()
+        {
+            if (UDictionaryArchive* Dictionary = WeakThis.GetEvenIfUnreachable())
+            {
+                Dictionary->PrepareTable();
+            }
+        });
+    }
+}
+
+bool UDictionaryArchive::ReleaseTable()
+{
+    const EDictionaryState State = GetDictionaryState();
+    if (State == EDictionaryState::Building)
+    {
+        return false;
+    }
+    ReleaseData();
+    DictionaryState.store(EDictionaryState::NotReady, std::memory_order_release);
+    return true;
+}
+
+void UDictionaryArchive::PrepareTable()
+{
+    const double StartTime = FPlatformTime::Seconds();
+    if (!HasCompiledTable() || !LoadCompiledTable())
+    {
+        UnzipArchive();
+#if WITH_EDITOR
+        // Old asset: compile the table to save it next time. Bulk data and properties are changed on game thread,
+        // where the asset can be serialized, so the built table is copied for it
+        if (IsValidTable())
+        {
+            auto Store = [WeakThis = TWeakObjectPtr<UDictionaryArchive>(this), Data = TArray64<uint8>(UnzippedData), Offsets = GetBuiltShardOffsets(), BuiltWordsNum = GetBuiltWordsNum()]()
+            {
+                UDictionaryArchive* Dictionary = WeakThis.Get();
+                if (Dictionary && !Dictionary->HasCompiledTable())
+                {
+                    // Marks the package dirty
+                    Dictionary->Modify();
+                    Dictionary->StoreCompiledTable(Data, Offsets, BuiltWordsNum);
+                }
+            };
+            if (IsInGameThread())
+            {
+                Store();
+            }
+            else
+            {
+                AsyncTask(ENamedThreads::GameThread, MoveTemp(Store));
+            }
+        }
+#endif
+    }
+
+    const bool bResult = IsValidTable();
+    UE_LOG(LogTemp, Log, TEXT("Phonemization dictionary %s: %s in %.2f ms"), *GetName(), bResult ? TEXT("ready") : TEXT("failed"), (FPlatformTime::Seconds() - StartTime) * 1000.0);
+    DictionaryState.store(bResult ? EDictionaryState::Ready : EDictionaryState::Failed, std::memory_order_release);
+}
+
+bool UDictionaryArchive::LoadCompiledTable()
+{
+    const int64 DataSize = CompiledData.GetBulkDataSize();
+
+    // Old assets contain single table
+    TArray<int64> Offsets = CompiledShardOffsets;
+    if (Offsets.Num() < 2)
+    {
+        Offsets = { 0, DataSize };
+    }
+    const int32 ShardsNum = Offsets.Num() - 1;
+    if (!FMath::IsPowerOfTwo(ShardsNum) || Offsets.Last() != DataSize)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Phonemization dictionary %s: invalid shards of compiled table"), *GetName());
+        return false;
+    }
+
+    if (CompiledData.IsDataMemoryMapped())
+    {
+        // Use mapped memory directly, it's unlocked when the asset is destroyed
+        MappedData = (const uint8*)CompiledData.LockReadOnly();
+        bCompiledDataLocked = true;
+    }
+
+    // Shards are loaded on first lookup
+    Shards.SetNum(ShardsNum);
+    for (int32 i = 0; i < ShardsNum; i++)
+    {
+        Shards[i] = MakeUnique<FDictionaryShard>();
+        Shards[i]->Offset = Offsets[i];
+        Shards[i]->Size = Offsets[i + 1] - Offsets[i];
+    }
+
+    UE_LOG(LogTemp, Log, TEXT("Phonemization dictionary: compiled table with %d words in %d shards"), WordsNum, ShardsNum);
+    return true;
+}
+
+bool UDictionaryArchive::LoadShard(FDictionaryShard& Shard) const
+{
+    FScopeLock Lock(&Shard.LoadLock);
+    if (Shard.bLoaded.load(std::memory_order_acquire))
+    {
+        return Shard.Table.IsValid();
+    }
+
+    if (MappedData)
+    {
+        Shard.Table.InitializeView(MappedData + Shard.Offset, Shard.Size);
+    }
+    else if (CompiledData.IsBulkDataLoaded())
+    {
+        // Editor or inline data: copy range of the shard
+        TArray64<uint8> ShardData;
+        ShardData.SetNumUninitialized(Shard.Size);
+        {
+            FScopeLock DataLock(&CompiledDataLock);
+            const uint8* Data = (const uint8*)CompiledData.LockReadOnly();
+            FMemory::Memcpy(ShardData.GetData(), Data + Shard.Offset, Shard.Size);
+            CompiledData.Unlock();
+        }
+        Shard.Table.Initialize(MoveTemp(ShardData));
+    }
+    else
+    {
+        // Read only range of the shard from disk
+        TUniquePtr<IBulkDataIORequest> Request(CompiledData.CreateStreamingRequest(Shard.Offset, Shard.Size, AIOP_High, nullptr, nullptr));
+        if (Request.IsValid() && Request->WaitCompletion() && !Request->WasCancelled())
+        {
+            Shard.Table.InitializeFromRawMemory(Request->GetReadResults(), Shard.Size);
+        }
+    }
+
+    if (!Shard.Table.IsValid())
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Phonemization dictionary %s: failed to load shard at %lld"), *GetName(), Shard.Offset);
+    }
+    // Don't try to load invalid shard again
+    Shard.bLoaded.store(true, std::memory_order_release);
+    return Shard.Table.IsValid();
+}
+
+bool UDictionaryArchive::Find(FStringView Word, TConstArrayView<UTF32CHAR>& OutPhonemes) const
+{
+    if (Shards.IsEmpty())
+    {
+        return false;
+    }
+
+    UTF8CHAR Key[FPhonemeDictionaryTable::MaxKeyBytes];
+    const int32 KeyLen = FPhonemeDictionaryTable::FoldWord(Word, Key);
+    if (KeyLen <= 0)
+    {
+        return false;
+    }
+
+    const uint32 Hash = FPhonemeDictionaryTable::HashKey(Key, KeyLen);
+    FDictionaryShard* Shard = GetShard(Hash);
+    if (!Shard->bLoaded.load(std::memory_order_acquire) && !LoadShard(*Shard))
+    {
+        return false;
+    }
+    return Shard->Table.FindFolded(Key, KeyLen, Hash, OutPhonemes);
+}
+
+void UDictionaryArchive::PrefetchWords(TConstArrayView<FString> Words) const
+{
+    if (Shards.Num() < 2)
+    {
+        return;
+    }
+
+    TArray<FDictionaryShard*, TInlineAllocator<32>> ShardsToLoad;
+    for (const FString& Word : Words)
+    {
+        UTF8CHAR Key[FPhonemeDictionaryTable::MaxKeyBytes];
+        const int32 KeyLen = FPhonemeDictionaryTable::FoldWord(Word, Key);
+        if (KeyLen > 0)
+        {
+            FDictionaryShard* Shard = GetShard(FPhonemeDictionaryTable::HashKey(Key, KeyLen));
+            if (!Shard->bLoaded.load(std::memory_order_acquire))
+            {
+                ShardsToLoad.AddUnique(Shard);
+            }
+        }
+    }
+
+    if (ShardsToLoad.Num() > 1)
+    {
+        ParallelFor(ShardsToLoad.Num(), [this, &ShardsToLoad](int32 Index)
+        {
+            LoadShard(*ShardsToLoad[Index]);
+        });
+    }
+    else if (ShardsToLoad.Num() == 1)
+    {
+        LoadShard(*ShardsToLoad[0]);
+    }
+}
+
+void UDictionaryArchive::LoadAllShards() const
+{
+    ParallelFor(Shards.Num(), [this](int32 Index)
+    {
+        if (!Shards[Index]->bLoaded.load(std::memory_order_acquire))
+        {
+            LoadShard(*Shards[Index]);
+        }
+    });
+}
+
+int32 UDictionaryArchive::GetLoadedShardsNum() const
+{
+    int32 Num = 0;
+    for (const auto& Shard : Shards)
+    {
+        if (Shard->bLoaded.load(std::memory_order_acquire)) Num++;
+    }
+    return Num;
+}
+
+const FPhonemeDictionaryTable* UDictionaryArchive::GetShardTable(int32 ShardIndex) const
+{
+    if (!Shards.IsValidIndex(ShardIndex))
+    {
+        return nullptr;
+    }
+    FDictionaryShard& Shard = *Shards[ShardIndex];
+    if (!Shard.bLoaded.load(std::memory_order_acquire) && !LoadShard(Shard))
+    {
+        return nullptr;
+    }
+    return Shard.Table.IsValid() ? &Shard.Table : nullptr;
+}
+
+int64 UDictionaryArchive::GetResidentSize() const
+{
+    int64 ResidentSize = UnzippedData.GetAllocatedSize();
+    for (const auto& Shard : Shards)
+    {
+        if (Shard->bLoaded.load(std::memory_order_acquire))
+        {
+            ResidentSize += Shard->Table.GetAllocatedSize();
+        }
+    }
+    return ResidentSize;
+}
+
+void UDictionaryArchive::StoreCompiledTable(const TArray64<uint8>& Data, const TArray<int64>& ShardOffsets, int32 InWordsNum)
+{
+    if (Data.IsEmpty())
+    {
+        return;
+    }
+
+    CompiledSize = Data.Num();
+    CompiledData.Lock(LOCK_READ_WRITE);
+    void* DataPtr = CompiledData.Realloc(CompiledSize);
+    FMemory::Memcpy(DataPtr, Data.GetData(), CompiledSize);
+    CompiledData.Unlock();
+
+    CompiledShardOffsets = ShardOffsets;
+    WordsNum = InWordsNum;
+}
+
+TArray<int64> UDictionaryArchive::GetBuiltShardOffsets() const
+{
+    TArray<int64> Offsets;
+    Offsets.SetNumUninitialized(Shards.Num() + 1);
+    for (int32 i = 0; i < Shards.Num(); i++)
+    {
+        Offsets[i] = Shards[i]->Offset;
+    }
+    Offsets[Shards.Num()] = UnzippedData.Num();
+    return Offsets;
+}
+
+int32 UDictionaryArchive::GetBuiltWordsNum() const
+{
+    int32 Num = 0;
+    for (const auto& Shard : Shards)
+    {
+        Num += Shard->Table.Num();
+    }
+    return Num;
+}
+
+void UDictionaryArchive::UnzipArchive()
+{
+    mz_zip_archive* pZip = (mz_zip_archive*)(FMemory::Memzero(FMemory::Malloc(sizeof(mz_zip_archive)), sizeof(mz_zip_archive)));
+    ZipPtr = pZip;
+
+    // Read data
+    char* DataPtr = nullptr;
+    int32 DataSize = ArchivedData.GetBulkDataSize();
+    ArchivedData.GetCopy(reinterpret_cast<void**>(&DataPtr));    
+
+    if (!mz_zip_reader_init_mem(pZip, DataPtr, DataSize, MZ_ZIP_FLAG_WRITE_ZIP64))
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Couldn't load zip archive from the binary data"));
+        FMemory::Free(ZipPtr);
+        FMemory::Free(DataPtr);
+        ZipPtr = nullptr;
+        pZip = nullptr;
+        return;
+    }
+
+    int32 EntriesNum = mz_zip_reader_get_num_files(pZip);
+    if (EntriesNum <= 0)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Archive is empty :("));
+        mz_zip_reader_end(pZip);
+        FMemory::Free(ZipPtr);
+        FMemory::Free(DataPtr);
+        ZipPtr = nullptr;
+        pZip = nullptr;
+        return;
+    }
+
+    ZipEntriesNum = EntriesNum;
+    FullArchiveSize = 0;
+    UnzippedSize = 0;
+
+    // Dictionary can be split to several csv files, all of them are merged into one dictionary
+    FPhonemeDictionaryBuilder Builder;
+    bool bExtracted = true;
+    for (int32 Index = 0; Index < EntriesNum; Index++)
+    {
+        // Get file information
+        mz_zip_archive_file_stat EntryDesc;
+        if (!mz_zip_reader_file_stat(pZip, (mz_uint)Index, &EntryDesc))
+        {
+            continue;
+        }
+
+        FullArchiveSize += (int64)EntryDesc.m_comp_size;
+        if (EntryDesc.m_is_directory)
+        {
+            continue;
+        }
+        if (!DictionaryCsv::ExtractEntry(pZip, EntryDesc, Builder))
+        {
+            // Don't build the table from truncated data
+            bExtracted = false;
+            break;
+        }
+        UnzippedSize += (int64)EntryDesc.m_uncomp_size;
+    }
+
+    if (bExtracted)
+    {
+        BuildTable(Builder);
+    }
+    else
+    {
+        UE_LOG(LogTemp, Error, TEXT("Phonemization dictionary %s: failed to extract zip archive"), *GetName());
+        Shards.Empty();
+        UnzippedData.Empty();
+    }
+
+    mz_zip_reader_end(pZip);
+    FMemory::Free(ZipPtr);
+    FMemory::Free(DataPtr);
+    ZipPtr = nullptr;
+    pZip = nullptr;
+}
+
+void UDictionaryArchive::FillMap(const char* Data, int64 DataSize)
+{
+    FPhonemeDictionaryBuilder Builder;
+    Builder.Reserve((int32)(DataSize / DictionaryCsv::BytesPerLine), DataSize);
+
+    const int64 BomSize = DictionaryCsv::GetBomSize(Data, DataSize);
+    const int32 SkippedLines = DictionaryCsv::ParseLinesParallel(Data + BomSize, DataSize - BomSize, Builder);
+    if (SkippedLines > 0)
+    {
+        UE_LOG(LogTemp, Log, TEXT("Phonemization dictionary: %d lines skipped"), SkippedLines);
+    }
+    BuildTable(Builder);
+}
+
+void UDictionaryArchive::BuildTable(const FPhonemeDictionaryBuilder& Builder)
+{
+    Shards.Empty();
+    UnzippedData.Empty();
+    if (Builder.Num() == 0)
+    {
+        return;
+    }
+
+    TArray<int64> Offsets;
+    Builder.BuildShards(Builder.GetRecommendedShardsNum(), UnzippedData, Offsets);
+
+    // All shards are in memory already
+    Shards.SetNum(Offsets.Num() - 1);
+    for (int32 i = 0; i < Shards.Num(); i++)
+    {
+        Shards[i] = MakeUnique<FDictionaryShard>();
+        Shards[i]->Offset = Offsets[i];
+        Shards[i]->Size = Offsets[i + 1] - Offsets[i];
+        Shards[i]->Table.InitializeView(UnzippedData.GetData() + Offsets[i], Shards[i]->Size);
+        Shards[i]->bLoaded.store(true, std::memory_order_release);
+    }
+    UE_LOG(LogTemp, Log, TEXT("Phonemization dictionary: %d lines deserialized in %d shards (%lld bytes)"), GetBuiltWordsNum(), Shards.Num(), UnzippedData.GetAllocatedSize());
+}
+
+bool UDictionaryArchive::HasBulkData() const
+{
+    return ArchivedData.GetBulkDataSize() > 0 || HasCompiledTable();
+}
+
+bool UDictionaryArchive::HasCompiledTable() const
+{
+    return CompiledData.GetBulkDataSize() > 0;
+}
+
+bool UDictionaryArchive::IsDictionaryReady() const
+{
+    return GetDictionaryState() == EDictionaryState::Ready;
+}
+
+bool UDictionaryArchive::IsValidTable() const
+{
+    return Shards.Num() > 0;
+}
@@ -1,462 +1,694 @@
-﻿// (c) Yuri N. K. 2025. All rights reserved.
-// ykasczc@gmail.com
-
-#include "LocalTTSFunctionLibrary.h"
-#include "LocalTTSTypes.h"
-#include "Internationalization/Regex.h"
-#include "LocalTTSSubsystem.h"
-#include "Subsystems/EngineSubsystem.h"
-#include "TTSModelData_Base.h"
-#include "Misc/FileHelper.h"
-#include "GenericPlatform/GenericPlatformFile.h"
-#include "HAL/PlatformFileManager.h"
-#include "Misc/Paths.h"
-#include "Engine/Engine.h"
-
-#include "Modules/ModuleManager.h"
-#include "LocalTTSModule.h"
-#include <string>
-
-#include "NNE.h"
-#include "NNEModelData.h"
-#include "NNERuntime.h"
-#include "NNERuntimeCPU.h"
-
-struct WaveHeader
-{
-	char ChunkID[4];
-	unsigned int ChunkSize;
-	char Format[4];
-	char SubChunk1ID[4];
-	unsigned int SubChunk1Size;
-	unsigned short int AudioFormat;
-	unsigned short int NumChannels;
-	unsigned int SampleRate;
-	unsigned int ByteRate;
-	unsigned short int BlockAlign;
-	unsigned short int BitsPerSample;
-	char SubChunk2ID[4];
-	unsigned int SubChunk2Size; // PCM data size in bytes
-};
-
-void ULocalTTSFunctionLibrary::SaveAudioDataToFile(const TArray<uint8>& RawPCMData, int32 NumChannels, int32 SampleRate, FString FileName)
-{
-	const int32 WaveHeaderSize = sizeof(WaveHeader);
-	TArray<uint8> FileData;
-	FileData.SetNumUninitialized(WaveHeaderSize + RawPCMData.Num());
-
-	// Saving audio from editor asset, need to decompress it first
-	UE_LOG(LogTemp, Log, TEXT("Saving %s file using uncompressed data (size = %d)"), *FPaths::GetCleanFilename(FileName), RawPCMData.Num());
-
-	//float Duration = ((RawFileData.Num() / 2) / (SampleRate * SampleRate));
-
-	WaveHeader h;
-	FMemory::Memcpy(h.ChunkID, "RIFF", 4);
-	h.ChunkSize = 36 + RawPCMData.Num();
-	FMemory::Memcpy(h.Format, "WAVE", 4);
-	FMemory::Memcpy(h.SubChunk1ID, "fmt ", 4);
-	h.SubChunk1Size = 16;
-	h.AudioFormat = 1;
-	h.NumChannels = NumChannels;
-	h.SampleRate = SampleRate;
-	h.BitsPerSample = 16;
-	h.BlockAlign = h.NumChannels;
-	h.ByteRate = h.SampleRate * h.NumChannels;
-
-	FMemory::Memcpy(h.SubChunk2ID, "data", 4);
-	h.SubChunk2Size = RawPCMData.Num();
-
-	FMemory::Memcpy(FileData.GetData(), &h, sizeof(h));
-	FMemory::Memcpy(FileData.GetData() + sizeof(h), RawPCMData.GetData(), RawPCMData.Num());
-
-	FFileHelper::SaveArrayToFile(FileData, *FileName);
-}
-
-void ULocalTTSFunctionLibrary::SaveAudioData32ToFile(const Audio::FAlignedFloatBuffer& RawPCMData, int32 NumChannels, int32 SampleRate, FString FileName)
-{
-	const int32 WaveHeaderSize = sizeof(WaveHeader);
-	TArray<uint8> FileData;
-	FileData.SetNumUninitialized(WaveHeaderSize + RawPCMData.Num() * sizeof(float));
-
-	// Saving audio from editor asset, need to decompress it first
-	UE_LOG(LogTemp, Log, TEXT("Saving %s file using uncompressed data (size = %d), sample rate = %d"), *FPaths::GetCleanFilename(FileName), RawPCMData.Num(), SampleRate);
-	const int32 NumSamples = RawPCMData.Num();
-	const int32 BitsPerSample = 32;
-
-	WaveHeader h;
-	FMemory::Memcpy(h.ChunkID, "RIFF", 4);
-	h.ChunkSize = 36 + NumSamples * NumChannels * BitsPerSample / 8;
-	FMemory::Memcpy(h.Format, "WAVE", 4);
-	FMemory::Memcpy(h.SubChunk1ID, "fmt ", 4);
-	h.SubChunk1Size = 16;
-	h.AudioFormat = 3;
-	h.NumChannels = NumChannels;
-	h.SampleRate = SampleRate;
-	h.ByteRate = SampleRate * NumChannels * BitsPerSample / 8;
-	h.BlockAlign = NumChannels * BitsPerSample / 8;
-	h.BitsPerSample = BitsPerSample;
-
-	FMemory::Memcpy(h.SubChunk2ID, "data", 4);
-	h.SubChunk2Size = NumSamples * NumChannels * BitsPerSample / 8;
-	FMemory::Memcpy(FileData.GetData(), &h, sizeof(h));
-	FMemory::Memcpy(FileData.GetData() + sizeof(h), RawPCMData.GetData(), RawPCMData.Num() * sizeof(float));
-
-	FFileHelper::SaveArrayToFile(FileData, *FileName);
-}
-
-int32 ULocalTTSFunctionLibrary::GetModelSpeakerByName(const FNNMInstanceId& ModelID, const FString& SpeakerName)
-{
-	ULocalTTSSubsystem* LocalTTS = GEngine->GetEngineSubsystem<ULocalTTSSubsystem>();
-	if (LocalTTS->IsVoiceModelValid(ModelID))
-	{
-		const auto& Speakers = LocalTTS->GetVoiceModel(ModelID)->VoiceDesc->Speakers;
-		if (const int32* Id = Speakers.Find(SpeakerName))
-		{
-			return *Id;
-		}
-	}
-
-	return INDEX_NONE;
-}
-
-bool ULocalTTSFunctionLibrary::IsTtsModelLoaded(const FNNMInstanceId& ModelID)
-{
-	ULocalTTSSubsystem* LocalTTS = GEngine->GetEngineSubsystem<ULocalTTSSubsystem>();
-	return LocalTTS->IsVoiceModelValid(ModelID);
-}
-
-UTTSModelData_Base* ULocalTTSFunctionLibrary::GetTtsModelDataAsset(const FNNMInstanceId& ModelID)
-{
-	ULocalTTSSubsystem* LocalTTS = GEngine->GetEngineSubsystem<ULocalTTSSubsystem>();
-	return LocalTTS->GetModelDataAsset(ModelID);
-}
-
-bool ULocalTTSFunctionLibrary::ReleaseTtsModel(const FNNMInstanceId& ModelID)
-{
-	ULocalTTSSubsystem* LocalTTS = GEngine->GetEngineSubsystem<ULocalTTSSubsystem>();
-	return LocalTTS->ReleaseModel(ModelID);
-}
-
-void ULocalTTSFunctionLibrary::Util_PhonemizeDictionaries()
-{
-	TMap<FString, FString> FileToLanguage = {
-		{ TEXT("ar.csv"), TEXT("ar_JO") },
-		{ TEXT("de.csv"), TEXT("de") },
-		{ TEXT("en_UK.csv"), TEXT("en") },
-		{ TEXT("en_US.csv"), TEXT("en-us") },
-		{ TEXT("es_ES.csv"), TEXT("es") },
-		{ TEXT("es_MX.csv"), TEXT("es-la") },		
-		//{ TEXT("fa.csv"), TEXT("fa_IR") },
-		{ TEXT("fi.csv"), TEXT("fi") },
-		{ TEXT("fr_FR.csv"), TEXT("fr") },
-		{ TEXT("is.csv"), TEXT("is") },
-		//{ TEXT("ma.csv"), TEXT("ml_IN") },
-		{ TEXT("nl.dic"), TEXT("nl") },
-		{ TEXT("vi_N.csv"), TEXT("vi") },
-		{ TEXT("zh_hant.csv"), TEXT("zh") },
-		{ TEXT("hungarian.dic"), TEXT("hu") },
-		{ TEXT("italian.dic"), TEXT("it") },
-		{ TEXT("polish.dic"), TEXT("pl") },
-		{ TEXT("pt_br.dic"), TEXT("pt") },
-		{ TEXT("pt_pt.dic"), TEXT("pt-pt") },
-		{ TEXT("turkish.dic"), TEXT("tr") },
-		{ TEXT("russian.txt"), TEXT("ru") },		
-	};
-
-	auto ModuleTts = FModuleManager::GetModulePtr<FLocalTTSModule>(TEXT("LocalTTS"));
-	int Terminator = 0;
-	const FRegexPattern Pattern(TEXT("\\([^()]*\\)"));
-
-	const FString DictPath = TEXT("C:/Users/Yura/source/repos/G2PTrain/G2PTrain/csv");
-	const FString EndChar = TEXT("/");
-	for (const auto& FileInfo : FileToLanguage)
-	{
-		FString VoiceCode = FileInfo.Value;
-		bool bPreExisting = false;
-
-		UE_LOG(LogTemp, Log, TEXT("Set Language: %s"), *VoiceCode);
-		int32 Result = ModuleTts->func_espeak_SetVoiceByName(TCHAR_TO_ANSI(*VoiceCode));
-		if (Result != 0)
-		{
-			UE_LOG(LogTemp, Log, TEXT("Error. Unsupported Voice"));
-			bPreExisting = true;
-		}
-
-		TArray<FString> CsvData, ResultData;
-		FFileHelper::LoadFileToStringArray(CsvData, *(DictPath / FileInfo.Key));
-
-		bool bFormatIPA = FileInfo.Key.EndsWith(TEXT(".csv"));
-		bool bFormatRu = FileInfo.Key.EndsWith(TEXT(".txt"));
-		bool bFormatDict = FileInfo.Key.EndsWith(TEXT(".dic"));
-
-		int32 Counter = 0;
-		for (auto& Line : CsvData)
-		{
-			Line.ToLowerInline();
-			FString Word;
-			if (bPreExisting)
-			{
-				int32 SepIndex = Line.Find(TEXT(","));
-				if (SepIndex <= 0) continue;
-				Word = Line.Left(SepIndex);
-				FString Phonemes = Line.Right(Line.Len() - SepIndex - 1);
-				Phonemes.TrimStartAndEndInline();
-				if (Phonemes.StartsWith(TEXT("\"")) || Phonemes.Contains(TEXT(";")) || Phonemes.Contains(TEXT(","))) //"/aːðana/, /aːðanna/, /aːðin/"
-				{
-					Phonemes.MidInline(1);
-					if (Phonemes.StartsWith(TEXT("/")))
-					{
-						Phonemes.MidInline(1);
-					}
-					SepIndex = Line.Find(TEXT("/"));
-					Phonemes = Phonemes.Left(SepIndex);
-				}
-				else
-				{
-					Phonemes.ReplaceInline(TEXT("/"), TEXT(""));
-				}
-
-				Line = Word + TEXT(";") + Phonemes;
-
-				if (Counter == 0)
-				{
-					UE_LOG(LogTemp, Log, TEXT("espeak_TextToPhonemesWithTerminator %s"), *Line);
-				}
-				Counter = (Counter + 1) % 100;
-
-				continue;
-			}
-			else if (bFormatIPA)
-			{
-				int32 SepIndex = Line.Find(TEXT(","));
-				if (SepIndex <= 0) continue;
-				Word = Line.Left(SepIndex);
-			}
-			else if (bFormatRu)
-			{
-				Word = Line;
-			}
-			else if (bFormatDict)
-			{
-				int32 SepIndex = Line.Find(EndChar);
-				if (SepIndex <= 0) continue;
-				Word = Line.Left(SepIndex);
-			}
-
-			// phonemize
-			std::string stword = TCHAR_TO_UTF8(*Word);
-			const char* InputTextPointer = stword.c_str();
-			std::string clausePhonemes(ModuleTts->func_espeak_TextToPhonemesWithTerminator((const void**)&InputTextPointer, /*textmode*/ espeakCHARS_AUTO, /*phonememode = IPA*/ 0x02, &Terminator));
-
-			// save
-			FString Phonemes = UTF8_TO_TCHAR(clausePhonemes.c_str());
-			// cleanup
-			FRegexMatcher Matcher(Pattern, Phonemes);
-			while (Matcher.FindNext())
-			{
-				int32 Start = Matcher.GetMatchBeginning();
-				int32 End = Matcher.GetMatchEnding();
-				Phonemes.RemoveAt(Start, End - Start);
-				Matcher = FRegexMatcher(Pattern, Phonemes);
-			}
-
-			Line = Word + TEXT(";") + Phonemes;
-
-
-		}
-
-		FString FinalFileName = DictPath / TEXT("espoken") / FileInfo.Key.Left(FileInfo.Key.Len() - 3) + TEXT("csv");
-		FFileHelper::SaveStringArrayToFile(CsvData, *FinalFileName);
-	}
-}
-
-void ULocalTTSFunctionLibrary::Util_PhonemizeDictionariesToTrainG2P()
-{
-	TMap<FString, FString> EspeakToActual = {
-		{TEXT("ar"), TEXT("ara")}, {TEXT("ca"), TEXT("cat")}, {TEXT("cs"), TEXT("cze")}, {TEXT("cy"), TEXT("wel-nw")}, {TEXT("da"), TEXT("dan")}, {TEXT("de"), TEXT("ger")}, {TEXT("el"), TEXT("gre")}, {TEXT("en-gb-x-rp"), TEXT("eng-uk")}, {TEXT("en-us"), TEXT("eng-us")}, {TEXT("es"), TEXT("spa")}, {TEXT("es-419"), TEXT("spa-me")}, {TEXT("fa"), TEXT("fas")}, {TEXT("fi"), TEXT("fin")}, {TEXT("fr"), TEXT("fra")}, {TEXT("fr-fr"), TEXT("fra")}, {TEXT("hu"), TEXT("hun")}, {TEXT("is"), TEXT("ice")}, {TEXT("it"), TEXT("ita")}, {TEXT("ka"), TEXT("geo")}, {TEXT("kk"), TEXT("kaz")}, {TEXT("lb"), TEXT("ltz")}, {TEXT("nl"), TEXT("dut")}, {TEXT("nb"), TEXT("nob")}, {TEXT("pl"), TEXT("pol")}, {TEXT("pt-br"), TEXT("por-bz")}, {TEXT("pt"), TEXT("por-po")}, {TEXT("ro"), TEXT("ron")}, {TEXT("ru"), TEXT("rus")}, {TEXT("sk"), TEXT("slo")}, {TEXT("sl"), TEXT("slv")}, {TEXT("sr"), TEXT("srp")}, {TEXT("sv"), TEXT("swe")}, {TEXT("sw"), TEXT("swa")}, {TEXT("tr"), TEXT("tur")}, {TEXT("uk"), TEXT("ukr")}, {TEXT("vi"), TEXT("vie-n")}, {TEXT("cmn"), TEXT("zho-s")}, {TEXT("zh"), TEXT("zho-s")}, {TEXT("j"), TEXT("jpn")}, {TEXT("ja"), TEXT("jpn")}, {TEXT("hi"), TEXT("hin")}
-	};
-
-	auto ModuleTts = FModuleManager::GetModulePtr<FLocalTTSModule>(TEXT("LocalTTS"));
-	int Terminator = 0;
-
-	// remove language codes
-	const FRegexPattern Pattern(TEXT("\\([^()]*\\)"));
-
-	// train dataset
-	//const FString SrcPath = TEXT("C:/Users/Yura/source/repos/CharsiuG2P/data/train");
-	// dev dataset
-	//const FString SrcPath = TEXT("C:/Users/Yura/source/repos/CharsiuG2P/data/dev");
-	// test dataset
-	const FString SrcPath = TEXT("C:/Users/Yura/source/repos/CharsiuG2P/data/test");
-	for (const auto& Lang : EspeakToActual)
-	{
-		int32 Result = ModuleTts->func_espeak_SetVoiceByName(TCHAR_TO_ANSI(*Lang.Key));
-		if (Result != 0)
-		{
-			UE_LOG(LogTemp, Log, TEXT("Error. Unsupported Voice"));
-			continue;
-		}
-
-		// LOAD
-		TArray<FString> FileData;
-		FString FileName = SrcPath / Lang.Value + TEXT(".tsv");
-		FString DestFileName = SrcPath / TEXT("espoken") / Lang.Value + TEXT(".tsv");
-		FFileHelper::LoadFileToStringArray(FileData, *FileName);
-
-		IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
-		IFileHandle* FileHandle = PlatformFile.OpenWrite(*DestFileName);
-
-		// GENERATE NEW PHONEMES USING ESPEAK-NG
-		for (auto& Line : FileData)
-		{
-			int32 SepIndex = Line.Find(TEXT("\t"));
-			if (SepIndex <= 0) continue;
-			Line.LeftInline(SepIndex);
-			Line.ToLowerInline();
-
-			// phonemize using espeak-ng
-			std::string WordUtf8 = TCHAR_TO_UTF8(*Line);
-			const char* InputTextPointer = WordUtf8.c_str();
-			std::string WordPhonemes(ModuleTts->func_espeak_TextToPhonemesWithTerminator((const void**)&InputTextPointer, /*textmode*/ espeakCHARS_AUTO, /*phonememode = IPA*/ 0x02, &Terminator));
-			FString Phonemes = UTF8_TO_TCHAR(WordPhonemes.c_str());
-			// cleanup
-			FString tmp = Phonemes;
-			FRegexMatcher Matcher(Pattern, Phonemes);
-			while (Matcher.FindNext())
-			{
-				int32 Start = Matcher.GetMatchBeginning();
-				int32 End = Matcher.GetMatchEnding();
-				Phonemes.RemoveAt(Start, End - Start);
-				Matcher = FRegexMatcher(Pattern, Phonemes);
-			}
-
-			// save
-			Line.Append(TEXT("\t") + Phonemes);
-
-			FString linetemp = Line + TEXT("\r\n");
-			std::string strutf8(TCHAR_TO_UTF8(*linetemp));
-			FileHandle->Write((const uint8*)strutf8.c_str(), strutf8.size());
-		}
-
-		// SAVE TO NEW FILE
-		delete FileHandle;
-		//FFileHelper::SaveStringArrayToFile(FileData, *DestFileName);
-	}
-}
-
-bool ULocalTTSFunctionLibrary::LoadNNM(FNNEModelTTS& ModelData, class UNNEModelData* ModelAsset, int32 OutputDataSize, FString Header)
-{
-	bool bResult = false;
-
-	FString NneRuntimeName = TEXT("NNERuntimeORTCpu");
-	TWeakInterfacePtr<INNERuntimeCPU> Runtime = UE::NNE::GetRuntime<INNERuntimeCPU>(NneRuntimeName);
-	if (!Runtime.IsValid())
-	{
-		UE_LOG(LogTemp, Error, TEXT("%s: Can't find NNE runtime (NNERuntimeORTCpu)"), *Header);
-		return false;
-	}
-
-	// Load model
-	TSharedPtr<UE::NNE::IModelCPU> Model = Runtime->CreateModelCPU(ModelAsset);
-	if (!Model.IsValid())
-	{
-		UE_LOG(LogTemp, Error, TEXT("%s: Couldn't load runtime TTS model"), *Header);
-		return false;
-	}
-
-	// Create instance
-	ModelData.ModelInstance = Model->CreateModelInstanceCPU();
-	if (!ModelData.ModelInstance.IsValid())
-	{
-		return false;
-	}
-
-	// Initialize model instance
-	TConstArrayView<UE::NNE::FTensorDesc> InputTensorDescs = ModelData.ModelInstance->GetInputTensorDescs();
-
-	int32 Index = 0;
-	for (const auto& InShape : InputTensorDescs)
-	{
-		ModelData.InputTensorShapes.Add(UE::NNE::FTensorShape::MakeFromSymbolic(InShape.GetShape()));
-		const int32 Volume = FMath::Max(1, (int32)ModelData.InputTensorShapes.Last().Volume());
-
-		ModelData.InputMap.AddDefaulted();
-		ModelData.InputMap[Index].Format = InShape.GetDataType();
-		FString DataTypeStr = StaticEnum<ENNETensorDataType>()->GetNameByValue((int32)InShape.GetDataType()).ToString();
-
-#if WITH_EDITOR
-		FString ShapeDesc = LocalTtsUtils::PrintArray(InShape.GetShape().GetData());
-		UE_LOG(LogTemp, Log, TEXT("%s: InputTensorShapes[%d] has shape (%s) and type %s"), *Header, Index, *ShapeDesc, *DataTypeStr);
-#endif
-
-		if (InShape.GetDataType() == ENNETensorDataType::Float)
-		{
-			ModelData.InputDataFloat.AddDefaulted();
-			ModelData.InputDataFloat.Last().SetNumUninitialized(Volume);
-			ModelData.InputMap[Index].ArrayIndex = ModelData.InputDataFloat.Num() - 1;
-		}
-		else //if (InShape.GetDataType() == ENNETensorDataType::Int64)
-		{
-			ModelData.InputDataInt64.AddDefaulted();
-			ModelData.InputDataInt64.Last().SetNumUninitialized(Volume);
-			ModelData.InputMap[Index].ArrayIndex = ModelData.InputDataInt64.Num() - 1;
-		}
-
-		Index++;
-	}
-
-	TConstArrayView<UE::NNE::FTensorDesc> OutputTensorDescs = ModelData.ModelInstance->GetOutputTensorDescs();
-	TArray<UE::NNE::FTensorShape> OutputTensorShapes;
-	Index = 0;
-	int32 OutputSize = 1;
-	for (const auto& OutShape : OutputTensorDescs)
-	{
-		OutputTensorShapes.Add(UE::NNE::FTensorShape::MakeFromSymbolic(OutShape.GetShape()));
-		FString DataTypeStr = StaticEnum<ENNETensorDataType>()->GetNameByValue((int32)OutShape.GetDataType()).ToString();
-
-		for (const auto& Dim : OutputTensorShapes.Last().GetData())
-		{
-			if (Dim > 0) OutputSize *= Dim;
-		}
-#if WITH_EDITOR
-		FString ShapeDesc = LocalTtsUtils::PrintArray(OutShape.GetShape().GetData());
-		UE_LOG(LogTemp, Log, TEXT("%s: OutputTensorDescs[%d] has shape (%s and total size %d) and type %s"), *Header, Index, *ShapeDesc, OutputSize, *DataTypeStr);
-#endif
-		Index++;
-	}
-	if (OutputTensorShapes.IsEmpty())
-	{
-		UE_LOG(LogTemp, Error, TEXT("Incorrect NNE Model format!"));
-		return false;
-	}
-	ModelData.OutputData.SetNumZeroed(OutputDataSize * OutputSize);
-
-	// Initialize input-output tensors and arrays
-
-	ModelData.InputBindings.SetNumZeroed(ModelData.InputMap.Num());
-	Index = 0;
-	for (const auto& Input : ModelData.InputMap)
-	{
-		if (Input.Format == ENNETensorDataType::Float)
-		{
-			ModelData.InputBindings[Index].Data = ModelData.InputDataFloat[Input.ArrayIndex].GetData();
-			ModelData.InputBindings[Index].SizeInBytes = ModelData.InputDataFloat[Input.ArrayIndex].Num() * sizeof(float);
-		}
-		else
-		{
-			ModelData.InputBindings[Index].Data = ModelData.InputDataInt64[Input.ArrayIndex].GetData();
-			ModelData.InputBindings[Index].SizeInBytes = ModelData.InputDataInt64[Input.ArrayIndex].Num() * sizeof(int64);
-		}
-		Index++;
-	}
-
-	ModelData.OutputBindings.SetNumZeroed(1);
-	ModelData.OutputBindings[0].Data = ModelData.OutputData.GetData();
-	ModelData.OutputBindings[0].SizeInBytes = ModelData.OutputData.Num() * sizeof(float);
-
-	bResult = ModelData.InputMap.Num() > 0 && ModelData.OutputData.Num() > 0;
-	ModelData.bLoaded = bResult;
-	UE_LOG(LogTemp, Log, TEXT("%s: model loading complete. Input num = %d | Output num = %d"), *Header, ModelData.InputMap.Num(), ModelData.OutputData.Num());
-	
-	return bResult;
+﻿// (c) Yuri N. K. 2025. All rights reserved.
+// ykasczc@gmail.com
+
+#include "LocalTTSFunctionLibrary.h"
+#include "LocalTTSTypes.h"
+#include "Internationalization/Regex.h"
+#include "LocalTTSSubsystem.h"
+#include "Subsystems/EngineSubsystem.h"
+#include "TTSModelData_Base.h"
+#include "Misc/FileHelper.h"
+#include "GenericPlatform/GenericPlatformFile.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/Paths.h"
+#include "Engine/Engine.h"
+#include "HAL/PlatformTime.h"
+#include "Phonemizer.h"
+#include "DictionaryArchive.h"
+
+#include "Modules/ModuleManager.h"
+#include "LocalTTSModule.h"
+#include <string>
+
+#include "NNE.h"
+#include "NNEModelData.h"
+#include "NNERuntime.h"
+#include "NNERuntimeCPU.h"
+
+struct WaveHeader
+{
+	char ChunkID[4];
+	unsigned int ChunkSize;
+	char Format[4];
+	char SubChunk1ID[4];
+	unsigned int SubChunk1Size;
+	unsigned short int AudioFormat;
+	unsigned short int NumChannels;
+	unsigned int SampleRate;
+	unsigned int ByteRate;
+	unsigned short int BlockAlign;
+	unsigned short int BitsPerSample;
+	char SubChunk2ID[4];
+	unsigned int SubChunk2Size; // PCM data size in bytes
+};
+
+void ULocalTTSFunctionLibrary::SaveAudioDataToFile(const TArray<uint8>& RawPCMData, int32 NumChannels, int32 SampleRate, FString FileName)
+{
+	const int32 WaveHeaderSize = sizeof(WaveHeader);
+	TArray<uint8> FileData;
+	FileData.SetNumUninitialized(WaveHeaderSize + RawPCMData.Num());
+
+	// Saving audio from editor asset, need to decompress it first
+	UE_LOG(LogTemp, Log, TEXT("Saving %s file using uncompressed data (size = %d)"), *FPaths::GetCleanFilename(FileName), RawPCMData.Num());
+
+	//float Duration = ((RawFileData.Num() / 2) / (SampleRate * SampleRate));
+
+	WaveHeader h;
+	FMemory::Memcpy(h.ChunkID, "RIFF", 4);
+	h.ChunkSize = 36 + RawPCMData.Num();
+	FMemory::Memcpy(h.Format, "WAVE", 4);
+	FMemory::Memcpy(h.SubChunk1ID, "fmt ", 4);
+	h.SubChunk1Size = 16;
+	h.AudioFormat = 1;
+	h.NumChannels = NumChannels;
+	h.SampleRate = SampleRate;
+	h.BitsPerSample = 16;
+	h.BlockAlign = h.NumChannels * h.BitsPerSample / 8;
+	h.ByteRate = h.SampleRate * h.BlockAlign;
+
+	FMemory::Memcpy(h.SubChunk2ID, "data", 4);
+	h.SubChunk2Size = RawPCMData.Num();
+
+	FMemory::Memcpy(FileData.GetData(), &h, sizeof(h));
+	FMemory::Memcpy(FileData.GetData() + sizeof(h), RawPCMData.GetData(), RawPCMData.Num());
+
+	FFileHelper::SaveArrayToFile(FileData, *FileName);
+}
+
+void ULocalTTSFunctionLibrary::SaveAudioData32ToFile(const Audio::FAlignedFloatBuffer& RawPCMData, int32 NumChannels, int32 SampleRate, FString FileName)
+{
+	const int32 WaveHeaderSize = sizeof(WaveHeader);
+	TArray<uint8> FileData;
+	FileData.SetNumUninitialized(WaveHeaderSize + RawPCMData.Num() * sizeof(float));
+
+	// Saving audio from editor asset, need to decompress it first
+	UE_LOG(LogTemp, Log, TEXT("Saving %s file using uncompressed data (size = %d), sample rate = %d"), *FPaths::GetCleanFilename(FileName), RawPCMData.Num(), SampleRate);
+	const int32 NumSamples = RawPCMData.Num();
+	const int32 BitsPerSample = 32;
+
+	WaveHeader h;
+	FMemory::Memcpy(h.ChunkID, "RIFF", 4);
+	h.ChunkSize = 36 + NumSamples * NumChannels * BitsPerSample / 8;
+	FMemory::Memcpy(h.Format, "WAVE", 4);
+	FMemory::Memcpy(h.SubChunk1ID, "fmt ", 4);
+	h.SubChunk1Size = 16;
+	h.AudioFormat = 3;
+	h.NumChannels = NumChannels;
+	h.SampleRate = SampleRate;
+	h.ByteRate = SampleRate * NumChannels * BitsPerSample / 8;
+	h.BlockAlign = NumChannels * BitsPerSample / 8;
+	h.BitsPerSample = BitsPerSample;
+
+	FMemory::Memcpy(h.SubChunk2ID, "data", 4);
+	h.SubChunk2Size = NumSamples * NumChannels * BitsPerSample / 8;
+	FMemory::Memcpy(FileData.GetData(), &h, sizeof(h));
+	FMemory::Memcpy(FileData.GetData() + sizeof(h), RawPCMData.GetData(), RawPCMData.Num() * sizeof(float));
+
+	FFileHelper::SaveArrayToFile(FileData, *FileName);
+}
+
+int32 ULocalTTSFunctionLibrary::GetModelSpeakerByName(const FNNMInstanceId& ModelID, const FString& SpeakerName)
+{
+	ULocalTTSSubsystem* LocalTTS = GEngine->GetEngineSubsystem<ULocalTTSSubsystem>();
+	if (LocalTTS->IsVoiceModelValid(ModelID))
+	{
+		const auto& Speakers = LocalTTS->GetVoiceModel(ModelID)->VoiceDesc->Speakers;
+		if (const int32* Id = Speakers.Find(SpeakerName))
+		{
+			return *Id;
+		}
+	}
+
+	return INDEX_NONE;
+}
+
+bool ULocalTTSFunctionLibrary::IsTtsModelLoaded(const FNNMInstanceId& ModelID)
+{
+	ULocalTTSSubsystem* LocalTTS = GEngine->GetEngineSubsystem<ULocalTTSSubsystem>();
+	return LocalTTS->IsVoiceModelValid(ModelID);
+}
+
+UTTSModelData_Base* ULocalTTSFunctionLibrary::GetTtsModelDataAsset(const FNNMInstanceId& ModelID)
+{
+	ULocalTTSSubsystem* LocalTTS = GEngine->GetEngineSubsystem<ULocalTTSSubsystem>();
+	return LocalTTS->GetModelDataAsset(ModelID);
+}
+
+bool ULocalTTSFunctionLibrary::ReleaseTtsModel(const FNNMInstanceId& ModelID)
+{
+	ULocalTTSSubsystem* LocalTTS = GEngine->GetEngineSubsystem<ULocalTTSSubsystem>();
+	return LocalTTS->ReleaseModel(ModelID);
+}
+
+void ULocalTTSFunctionLibrary::Util_PhonemizeDictionaries()
+{
+	TMap<FString, FString> FileToLanguage = {
+		{ TEXT("ar.csv"), TEXT("ar_JO") },
+		{ TEXT("de.csv"), TEXT("de") },
+		{ TEXT("en_UK.csv"), TEXT("en") },
+		{ TEXT("en_US.csv"), TEXT("en-us") },
+		{ TEXT("es_ES.csv"), TEXT("es") },
+		{ TEXT("es_MX.csv"), TEXT("es-la") },		
+		//{ TEXT("fa.csv"), TEXT("fa_IR") },
+		{ TEXT("fi.csv"), TEXT("fi") },
+		{ TEXT("fr_FR.csv"), TEXT("fr") },
+		{ TEXT("is.csv"), TEXT("is") },
+		//{ TEXT("ma.csv"), TEXT("ml_IN") },
+		{ TEXT("nl.dic"), TEXT("nl") },
+		{ TEXT("vi_N.csv"), TEXT("vi") },
+		{ TEXT("zh_hant.csv"), TEXT("zh") },
+		{ TEXT("hungarian.dic"), TEXT("hu") },
+		{ TEXT("italian.dic"), TEXT("it") },
+		{ TEXT("polish.dic"), TEXT("pl") },
+		{ TEXT("pt_br.dic"), TEXT("pt") },
+		{ TEXT("pt_pt.dic"), TEXT("pt-pt") },
+		{ TEXT("turkish.dic"), TEXT("tr") },
+		{ TEXT("russian.txt"), TEXT("ru") },		
+	};
+
+	auto ModuleTts = FModuleManager::GetModulePtr<FLocalTTSModule>(TEXT("LocalTTS"));
+	int Terminator = 0;
+	const FRegexPattern Pattern(TEXT("\\([^()]*\\)"));
+
+	const FString DictPath = TEXT("C:/Users/Yura/source/repos/G2PTrain/G2PTrain/csv");
+	const FString EndChar = TEXT("/");
+	for (const auto& FileInfo : FileToLanguage)
+	{
+		FString VoiceCode = FileInfo.Value;
+		bool bPreExisting = false;
+
+		UE_LOG(LogTemp, Log, TEXT("Set Language: %s"), *VoiceCode);
+		int32 Result = ModuleTts->func_espeak_SetVoiceByName(TCHAR_TO_ANSI(*VoiceCode));
+		if (Result != 0)
+		{
+			UE_LOG(LogTemp, Log, TEXT("Error. Unsupported Voice"));
+			bPreExisting = true;
+		}
+
+		TArray<FString> CsvData, ResultData;
+		FFileHelper::LoadFileToStringArray(CsvData, *(DictPath / FileInfo.Key));
+
+		bool bFormatIPA = FileInfo.Key.EndsWith(TEXT(".csv"));
+		bool bFormatRu = FileInfo.Key.EndsWith(TEXT(".txt"));
+		bool bFormatDict = FileInfo.Key.EndsWith(TEXT(".dic"));
+
+		int32 Counter = 0;
+		for (auto& Line : CsvData)
+		{
+			Line.ToLowerInline();
+			FString Word;
+			if (bPreExisting)
+			{
+				int32 SepIndex = Line.Find(TEXT(","));
+				if (SepIndex <= 0) continue;
+				Word = Line.Left(SepIndex);
+				FString Phonemes = Line.Right(Line.Len() - SepIndex - 1);
+				Phonemes.TrimStartAndEndInline();
+				if (Phonemes.StartsWith(TEXT("\"")) || Phonemes.Contains(TEXT(";")) || Phonemes.Contains(TEXT(","))) //"/aːðana/, /aːðanna/, /aːðin/"
+				{
+					Phonemes.MidInline(1);
+					if (Phonemes.StartsWith(TEXT("/")))
+					{
+						Phonemes.MidInline(1);
+					}
+					SepIndex = Line.Find(TEXT("/"));
+					Phonemes = Phonemes.Left(SepIndex);
+				}
+				else
+				{
+					Phonemes.ReplaceInline(TEXT("/"), TEXT(""));
+				}
+
+				Line = Word + TEXT(";") + Phonemes;
+
+				if (Counter == 0)
+				{
+					UE_LOG(LogTemp, Log, TEXT("espeak_TextToPhonemesWithTerminator %s"), *Line);
+				}
+				Counter = (Counter + 1) % 100;
+
+				continue;
+			}
+			else if (bFormatIPA)
+			{
+				int32 SepIndex = Line.Find(TEXT(","));
+				if (SepIndex <= 0) continue;
+				Word = Line.Left(SepIndex);
+			}
+			else if (bFormatRu)
+			{
+				Word = Line;
+			}
+			else if (bFormatDict)
+			{
+				int32 SepIndex = Line.Find(EndChar);
+				if (SepIndex <= 0) continue;
+				Word = Line.Left(SepIndex);
+			}
+
+			// phonemize
+			std::string stword = TCHAR_TO_UTF8(*Word);
+			const char* InputTextPointer = stword.c_str();
+			std::string clausePhonemes(ModuleTts->func_espeak_TextToPhonemesWithTerminator((const void**)&InputTextPointer, /*textmode*/ espeakCHARS_AUTO, /*phonememode = IPA*/ 0x02, &Terminator));
+
+			// save
+			FString Phonemes = UTF8_TO_TCHAR(clausePhonemes.c_str());
+			// cleanup
+			FRegexMatcher Matcher(Pattern, Phonemes);
+			while (Matcher.FindNext())
+			{
+				int32 Start = Matcher.GetMatchBeginning();
+				int32 End = Matcher.GetMatchEnding();
+				Phonemes.RemoveAt(Start, End - Start);
+				Matcher = FRegexMatcher(Pattern, Phonemes);
+			}
+
+			Line = Word + TEXT(";") + Phonemes;
+
+
+		}
+
+		FString FinalFileName = DictPath / TEXT("espoken") / FileInfo.Key.Left(FileInfo.Key.Len() - 3) + TEXT("csv");
+		FFileHelper::SaveStringArrayToFile(CsvData, *FinalFileName);
+	}
+}
+
+void ULocalTTSFunctionLibrary::Util_PhonemizeDictionariesToTrainG2P()
+{
+	TMap<FString, FString> EspeakToActual = {
+		{TEXT("ar"), TEXT("ara")}, {TEXT("ca"), TEXT("cat")}, {TEXT("cs"), TEXT("cze")}, {TEXT("cy"), TEXT("wel-nw")}, {TEXT("da"), TEXT("dan")}, {TEXT("de"), TEXT("ger")}, {TEXT("el"), TEXT("gre")}, {TEXT("en-gb-x-rp"), TEXT("eng-uk")}, {TEXT("en-us"), TEXT("eng-us")}, {TEXT("es"), TEXT("spa")}, {TEXT("es-419"), TEXT("spa-me")}, {TEXT("fa"), TEXT("fas")}, {TEXT("fi"), TEXT("fin")}, {TEXT("fr"), TEXT("fra")}, {TEXT("fr-fr"), TEXT("fra")}, {TEXT("hu"), TEXT("hun")}, {TEXT("is"), TEXT("ice")}, {TEXT("it"), TEXT("ita")}, {TEXT("ka"), TEXT("geo")}, {TEXT("kk"), TEXT("kaz")}, {TEXT("lb"), TEXT("ltz")}, {TEXT("nl"), TEXT("dut")}, {TEXT("nb"), TEXT("nob")}, {TEXT("pl"), TEXT("pol")}, {TEXT("pt-br"), TEXT("por-bz")}, {TEXT("pt"), TEXT("por-po")}, {TEXT("ro"), TEXT("ron")}, {TEXT("ru"), TEXT("rus")}, {TEXT("sk"), TEXT("slo")}, {TEXT("sl"), TEXT("slv")}, {TEXT("sr"), TEXT("srp")}, {TEXT("sv"), TEXT("swe")}, {TEXT("sw"), TEXT("swa")}, {TEXT("tr"), TEXT("tur")}, {TEXT("uk"), TEXT("ukr")}, {TEXT("vi"), TEXT("vie-n")}, {TEXT("cmn"), TEXT("zho-s")}, {TEXT("zh"), TEXT("zho-s")}, {TEXT("j"), TEXT("jpn")}, {TEXT("ja"), TEXT("jpn")}, {TEXT("hi"), TEXT("hin")}
+	};
+
+	auto ModuleTts = FModuleManager::GetModulePtr<FLocalTTSModule>(TEXT("LocalTTS"));
+	int Terminator = 0;
+
+	// remove language codes
+	const FRegexPattern Pattern(TEXT("\\([^()]*\\)"));
+
+	// train dataset
+	//const FString SrcPath = TEXT("C:/Users/Yura/source/repos/CharsiuG2P/data/train");
+	// dev dataset
+	//const FString SrcPath = TEXT("C:/Users/Yura/source/repos/CharsiuG2P/data/dev");
+	// test dataset
+	const FString SrcPath = TEXT("C:/Users/Yura/source/repos/CharsiuG2P/data/test");
+	for (const auto& Lang : EspeakToActual)
+	{
+		int32 Result = ModuleTts->func_espeak_SetVoiceByName(TCHAR_TO_ANSI(*Lang.Key));
+		if (Result != 0)
+		{
+			UE_LOG(LogTemp, Log, TEXT("Error. Unsupported Voice"));
+			continue;
+		}
+
+		// LOAD
+		TArray<FString> FileData;
+		FString FileName = SrcPath / Lang.Value + TEXT(".tsv");
+		FString DestFileName = SrcPath / TEXT("espoken") / Lang.Value + TEXT(".tsv");
+		FFileHelper::LoadFileToStringArray(FileData, *FileName);
+
+		IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+		IFileHandle* FileHandle = PlatformFile.OpenWrite(*DestFileName);
+
+		// GENERATE NEW PHONEMES USING ESPEAK-NG
+		for (auto& Line : FileData)
+		{
+			int32 SepIndex = Line.Find(TEXT("\t"));
+			if (SepIndex <= 0) continue;
+			Line.LeftInline(SepIndex);
+			Line.ToLowerInline();
+
+			// phonemize using espeak-ng
+			std::string WordUtf8 = TCHAR_TO_UTF8(*Line);
+			const char* InputTextPointer = WordUtf8.c_str();
+			std::string WordPhonemes(ModuleTts->func_espeak_TextToPhonemesWithTerminator((const void**)&InputTextPointer, /*textmode*/ espeakCHARS_AUTO, /*phonememode = IPA*/ 0x02, &Terminator));
+			FString Phonemes = UTF8_TO_TCHAR(WordPhonemes.c_str());
+			// cleanup
+			FString tmp = Phonemes;
+			FRegexMatcher Matcher(Pattern, Phonemes);
+			while (Matcher.FindNext())
+			{
+				int32 Start = Matcher.GetMatchBeginning();
+				int32 End = Matcher.GetMatchEnding();
+				Phonemes.RemoveAt(Start, End - Start);
+				Matcher = FRegexMatcher(Pattern, Phonemes);
+			}
+
+			// save
+			Line.Append(TEXT("\t") + Phonemes);
+
+			FString linetemp = Line + TEXT("\r\n");
+			std::string strutf8(TCHAR_TO_UTF8(*linetemp));
+			FileHandle->Write((const uint8*)strutf8.c_str(), strutf8.size());
+		}
+
+		// SAVE TO NEW FILE
+		delete FileHandle;
+		//FFileHelper::SaveStringArrayToFile(FileData, *DestFileName);
+	}
+}
+
+void ULocalTTSFunctionLibrary::Util_BenchmarkG2PDecoding(const TArray<FString>& Words, const FString& EspeakLanguageCode, int32 Iterations)
+{
+	ULocalTTSSubsystem* LocalTTS = GEngine->GetEngineSubsystem<ULocalTTSSubsystem>();
+	UPhonemizer* Phonemizer = LocalTTS->GetPhonemizer();
+	if (!IsValid(Phonemizer) || Words.IsEmpty())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Util_BenchmarkG2PDecoding: phonemizer isn't initialized or words list is empty"));
+		return;
+	}
+	FString LanguageCode;
+	if (!Phonemizer->GetLanguageCodeFromEspeak(EspeakLanguageCode, false, LanguageCode))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Util_BenchmarkG2PDecoding: unsupported language %s"), *EspeakLanguageCode);
+		return;
+	}
+	Iterations = FMath::Max(1, Iterations);
+
+	// Words are lowercased in the synthesis path
+	TArray<FString> Batch;
+	for (const auto& Word : Words)
+	{
+		Batch.Add(Word.ToLower());
+	}
+
+	auto RunBatches = [Phonemizer, &Batch, &LanguageCode, Iterations](bool bCachedDecoder, TArray<FString>& OutPhonemes) -> double
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		for (int32 i = 0; i < Iterations; i++)
+		{
+			Phonemizer->PhonemizeWordsG2P(Batch, LanguageCode, OutPhonemes, bCachedDecoder);
+		}
+		return (FPlatformTime::Seconds() - StartTime) * 1000.0 / (double)Iterations;
+	};
+
+	TArray<FString> FullResult, CachedResult;
+	const double FullMs = RunBatches(false, FullResult);
+	UE_LOG(LogTemp, Log, TEXT("Util_BenchmarkG2PDecoding: full-sequence decoder: %.2f ms per batch of %d words"), FullMs, Batch.Num());
+
+	if (!Phonemizer->HasCachedDecoder())
+	{
+		UE_LOG(LogTemp, Log, TEXT("Util_BenchmarkG2PDecoding: decoder with past key values isn't loaded"));
+		return;
+	}
+
+	const double CachedMs = RunBatches(true, CachedResult);
+	int32 Mismatches = FullResult.Num() == CachedResult.Num() ? 0 : Batch.Num();
+	for (int32 i = 0; i < FullResult.Num() && i < CachedResult.Num(); i++)
+	{
+		if (FullResult[i] != CachedResult[i])
+		{
+			Mismatches++;
+		}
+	}
+	UE_LOG(LogTemp, Log, TEXT("Util_BenchmarkG2PDecoding: cached decoder: %.2f ms per batch (x%.2f), %d words differ"), CachedMs, FullMs / FMath::Max(CachedMs, 0.001), Mismatches);
+}
+
+void ULocalTTSFunctionLibrary::Util_BenchmarkDictionary(UDictionaryArchive* Dictionary, int32 LookupsNum)
+{
+	if (!IsValid(Dictionary))
+	{
+		return;
+	}
+	if (!Dictionary->IsDictionaryReady() && Dictionary->HasBulkData())
+	{
+		Dictionary->Unzip();
+	}
+	if (!Dictionary->IsDictionaryReady())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Util_BenchmarkDictionary: dictionary isn't ready"));
+		return;
+	}
+
+	// Load all shards
+	double StartTime = FPlatformTime::Seconds();
+	Dictionary->LoadAllShards();
+	const double LoadMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+	TArray<TPair<FUtf8StringView, TConstArrayView<UTF32CHAR>>> Entries;
+	for (int32 ShardIndex = 0; ShardIndex < Dictionary->GetShardsNum(); ShardIndex++)
+	{
+		if (const FPhonemeDictionaryTable* Table = Dictionary->GetShardTable(ShardIndex))
+		{
+			for (int32 i = 0; i < Table->Num(); i++)
+			{
+				FUtf8StringView Word;
+				TConstArrayView<UTF32CHAR> Phonemes;
+				Table->GetEntry(i, Word, Phonemes);
+				Entries.Emplace(Word, Phonemes);
+			}
+		}
+	}
+	if (Entries.IsEmpty())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Util_BenchmarkDictionary: dictionary is empty"));
+		return;
+	}
+	LookupsNum = FMath::Max(1, LookupsNum);
+
+	// Build TMap the same way it was done before
+	StartTime = FPlatformTime::Seconds();
+	TMap<FString, FString> Map;
+	int64 MapSize = 0;
+	for (const auto& [Word, Phonemes] : Entries)
+	{
+		const FString& Value = Map.Add(FString(Word.Len(), Word.GetData()), FPhonemeDictionaryTable::PhonemesToString(Phonemes));
+		MapSize += Value.GetAllocatedSize();
+	}
+	for (const auto& Pair : Map)
+	{
+		MapSize += Pair.Key.GetAllocatedSize();
+	}
+	MapSize += Map.GetAllocatedSize();
+	const double MapBuildMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+	// Mix of existing (different case) and missing words
+	TArray<FString> Queries;
+	Queries.Reserve(LookupsNum);
+	for (int32 i = 0; i < LookupsNum; i++)
+	{
+		const FUtf8StringView Word = Entries[(int32)(((int64)i * 7919) % Entries.Num())].Key;
+		FString Query(Word.Len(), Word.GetData());
+		Queries.Add(i % 4 == 3 ? Query + TEXT("x") : Query.ToUpper());
+	}
+
+	int32 MapFound = 0;
+	StartTime = FPlatformTime::Seconds();
+	for (const FString& Query : Queries)
+	{
+		if (Map.Find(Query.ToLower())) MapFound++;
+	}
+	const double MapLookupMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+	int32 TableFound = 0;
+	StartTime = FPlatformTime::Seconds();
+	for (const FString& Query : Queries)
+	{
+		TConstArrayView<UTF32CHAR> Phonemes;
+		if (Dictionary->Find(Query, Phonemes)) TableFound++;
+	}
+	const double TableLookupMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+	UE_LOG(LogTemp, Log, TEXT("Util_BenchmarkDictionary: %s, %d words, %d shards loaded in %.1f ms"), *Dictionary->GetName(), Entries.Num(), Dictionary->GetShardsNum(), LoadMs);
+	UE_LOG(LogTemp, Log, TEXT("Util_BenchmarkDictionary: TMap: %.2f MB, built in %.1f ms, %d lookups in %.2f ms (%d found)"), (double)MapSize / 1048576.0, MapBuildMs, LookupsNum, MapLookupMs, MapFound);
+	UE_LOG(LogTemp, Log, TEXT("Util_BenchmarkDictionary: Table: %.2f MB, %d lookups in %.2f ms (%d found)"), (double)Dictionary->GetResidentSize() / 1048576.0, LookupsNum, TableLookupMs, TableFound);
+}
+
+void ULocalTTSFunctionLibrary::Util_BenchmarkPostProcessing(int32 SamplesNum, int32 Iterations)
+{
+	SamplesNum = FMath::Max(16, SamplesNum);
+	Iterations = FMath::Max(1, Iterations);
+
+	// Speech-like test signal
+	Audio::FAlignedFloatBuffer PCMData32;
+	PCMData32.SetNumUninitialized(SamplesNum);
+	FRandomStream Random(1234);
+	for (int32 i = 0; i < SamplesNum; i++)
+	{
+		PCMData32[i] = 0.3f * FMath::Sin((float)i * 0.05f) * FMath::Sin((float)i * 0.0007f) + Random.FRandRange(-0.05f, 0.05f);
+	}
+
+	TArray<int16> ScalarData, VectorData;
+	ScalarData.SetNumUninitialized(SamplesNum);
+	VectorData.SetNumUninitialized(SamplesNum);
+
+	// Scalar loops as they were used in PostProcessNND
+	double StartTime = FPlatformTime::Seconds();
+	for (int32 Iteration = 0; Iteration < Iterations; Iteration++)
+	{
+		float MaxAudioValue = 0.01f;
+		for (const auto& Sample : PCMData32)
+		{
+			MaxAudioValue = FMath::Max(MaxAudioValue, FMath::Abs(Sample));
+		}
+		const float AudioScale = 32767.0f / MaxAudioValue;
+		for (int32 i = 0; i < SamplesNum; i++)
+		{
+			ScalarData[i] = (int16)FMath::TruncToInt(PCMData32[i] * AudioScale);
+		}
+	}
+	const double ScalarMs = (FPlatformTime::Seconds() - StartTime) * 1000.0 / Iterations;
+
+	StartTime = FPlatformTime::Seconds();
+	for (int32 Iteration = 0; Iteration < Iterations; Iteration++)
+	{
+		LocalTtsMath::NormalizeToInt16(PCMData32.GetData(), SamplesNum, 0.01f, VectorData.GetData());
+	}
+	const double VectorMs = (FPlatformTime::Seconds() - StartTime) * 1000.0 / Iterations;
+
+	int32 MaxDiff = 0;
+	for (int32 i = 0; i < SamplesNum; i++)
+	{
+		MaxDiff = FMath::Max(MaxDiff, FMath::Abs((int32)ScalarData[i] - (int32)VectorData[i]));
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("Util_BenchmarkPostProcessing: %d samples, scalar: %.3f ms, vectorized: %.3f ms (x%.1f), max difference: %d"),
+		SamplesNum, ScalarMs, VectorMs, ScalarMs / FMath::Max(VectorMs, 0.0001), MaxDiff);
+}
+
+bool ULocalTTSFunctionLibrary::LoadNNM(FNNEModelTTS& ModelData, class UNNEModelData* ModelAsset, int32 OutputDataSize, FString Header)
+{
+	FString NneRuntimeName = TEXT("NNERuntimeORTCpu");
+	TWeakInterfacePtr<INNERuntimeCPU> Runtime = UE::NNE::GetRuntime<INNERuntimeCPU>(NneRuntimeName);
+	if (!Runtime.IsValid())
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s: Can't find NNE runtime (NNERuntimeORTCpu)"), *Header);
+		return false;
+	}
+
+	// Load model
+	TSharedPtr<UE::NNE::IModelCPU> Model = Runtime->CreateModelCPU(ModelAsset);
+	if (!Model.IsValid())
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s: Couldn't load runtime TTS model"), *Header);
+		return false;
+	}
+
+	ModelData.Model = Model;
+	return CreateNNMInstance(ModelData, OutputDataSize, Header);
+}
+
+bool ULocalTTSFunctionLibrary::CloneNNM(FNNEModelTTS& ModelData, const FNNEModelTTS& SourceModelData, int32 OutputDataSize, FString Header)
+{
+	if (!SourceModelData.Model.IsValid())
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s: Source model isn't loaded"), *Header);
+		return false;
+	}
+
+	ModelData.Model = SourceModelData.Model;
+	return CreateNNMInstance(ModelData, OutputDataSize, Header);
+}
+
+bool ULocalTTSFunctionLibrary::CreateNNMInstance(FNNEModelTTS& ModelData, int32 OutputDataSize, FString Header)
+{
+	bool bResult = false;
+
+	// Create instance
+	ModelData.ModelInstance = ModelData.Model->CreateModelInstanceCPU();
+	if (!ModelData.ModelInstance.IsValid())
+	{
+		return false;
+	}
+
+	// Initialize model instance
+	TConstArrayView<UE::NNE::FTensorDesc> InputTensorDescs = ModelData.ModelInstance->GetInputTensorDescs();
+
+	int32 Index = 0;
+	for (const auto& InShape : InputTensorDescs)
+	{
+		ModelData.InputTensorShapes.Add(UE::NNE::FTensorShape::MakeFromSymbolic(InShape.GetShape()));
+		const int32 Volume = FMath::Max(1, (int32)ModelData.InputTensorShapes.Last().Volume());
+
+		ModelData.InputMap.AddDefaulted();
+		ModelData.InputMap[Index].Format = InShape.GetDataType();
+		FString DataTypeStr = StaticEnum<ENNETensorDataType>()->GetNameByValue((int32)InShape.GetDataType()).ToString();
+
+#if WITH_EDITOR
+		FString ShapeDesc = LocalTtsUtils::PrintArray(InShape.GetShape().GetData());
+		UE_LOG(LogTemp, Log, TEXT("%s: InputTensorShapes[%d] has shape (%s) and type %s"), *Header, Index, *ShapeDesc, *DataTypeStr);
+#endif
+
+		if (InShape.GetDataType() == ENNETensorDataType::Float)
+		{
+			ModelData.InputDataFloat.AddDefaulted();
+			ModelData.InputDataFloat.Last().SetNumUninitialized(Volume);
+			ModelData.InputMap[Index].ArrayIndex = ModelData.InputDataFloat.Num() - 1;
+		}
+		else //if (InShape.GetDataType() == ENNETensorDataType::Int64)
+		{
+			ModelData.InputDataInt64.AddDefaulted();
+			ModelData.InputDataInt64.Last().SetNumUninitialized(Volume);
+			ModelData.InputMap[Index].ArrayIndex = ModelData.InputDataInt64.Num() - 1;
+		}
+
+		Index++;
+	}
+
+	TConstArrayView<UE::NNE::FTensorDesc> OutputTensorDescs = ModelData.ModelInstance->GetOutputTensorDescs();
+	TArray<UE::NNE::FTensorShape> OutputTensorShapes;
+	Index = 0;
+	// Size of the main output (0). Extra outputs get their own buffers below
+	int32 OutputSize = 1;
+	for (const auto& OutShape : OutputTensorDescs)
+	{
+		OutputTensorShapes.Add(UE::NNE::FTensorShape::MakeFromSymbolic(OutShape.GetShape()));
+		FString DataTypeStr = StaticEnum<ENNETensorDataType>()->GetNameByValue((int32)OutShape.GetDataType()).ToString();
+
+		int64 Volume = 1;
+		for (const auto& Dim : OutputTensorShapes.Last().GetData())
+		{
+			if (Dim > 0) Volume *= Dim;
+		}
+		if (Index == 0)
+		{
+			OutputSize = (int32)FMath::Min<int64>(Volume, MAX_int32 / FMath::Max(1, OutputDataSize));
+		}
+#if WITH_EDITOR
+		FString ShapeDesc = LocalTtsUtils::PrintArray(OutShape.GetShape().GetData());
+		UE_LOG(LogTemp, Log, TEXT("%s: OutputTensorDescs[%d] has shape (%s and total size %lld) and type %s"), *Header, Index, *ShapeDesc, Volume, *DataTypeStr);
+#endif
+		Index++;
+	}
+	if (OutputTensorShapes.IsEmpty())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Incorrect NNE Model format!"));
+		return false;
+	}
+	ModelData.OutputData.SetNumZeroed(OutputDataSize * OutputSize);
+
+	// Initialize input-output tensors and arrays
+
+	ModelData.InputBindings.SetNumZeroed(ModelData.InputMap.Num());
+	Index = 0;
+	for (const auto& Input : ModelData.InputMap)
+	{
+		if (Input.Format == ENNETensorDataType::Float)
+		{
+			ModelData.InputBindings[Index].Data = ModelData.InputDataFloat[Input.ArrayIndex].GetData();
+			ModelData.InputBindings[Index].SizeInBytes = ModelData.InputDataFloat[Input.ArrayIndex].Num() * sizeof(float);
+		}
+		else
+		{
+			ModelData.InputBindings[Index].Data = ModelData.InputDataInt64[Input.ArrayIndex].GetData();
+			ModelData.InputBindings[Index].SizeInBytes = ModelData.InputDataInt64[Input.ArrayIndex].Num() * sizeof(int64);
+		}
+		Index++;
+	}
+
+	// NNE expects bindings for all outputs, extra outputs are resized by the caller before RunSync
+	ModelData.OutputBindings.SetNumZeroed(OutputTensorShapes.Num());
+	ModelData.OutputBindings[0].Data = ModelData.OutputData.GetData();
+	ModelData.OutputBindings[0].SizeInBytes = ModelData.OutputData.Num() * sizeof(float);
+
+	ModelData.ExtraOutputData.SetNum(OutputTensorShapes.Num() - 1);
+	for (int32 ExtraIndex = 1; ExtraIndex < OutputTensorShapes.Num(); ExtraIndex++)
+	{
+		ModelData.PrepareExtraOutputBuffer(ExtraIndex, FMath::Max(1, (int32)OutputTensorShapes[ExtraIndex].Volume()));
+	}
+
+	bResult = ModelData.InputMap.Num() > 0 && ModelData.OutputData.Num() > 0;
+	ModelData.bLoaded = bResult;
+	UE_LOG(LogTemp, Log, TEXT("%s: model loading complete. Input num = %d | Output num = %d"), *Header, ModelData.InputMap.Num(), ModelData.OutputData.Num());
+	
+	return bResult;
 }
\ No newline at end of file
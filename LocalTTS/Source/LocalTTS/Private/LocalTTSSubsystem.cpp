@@ -1,589 +1,1044 @@
-﻿// (c) Yuri N. K. 2025. All rights reserved.
-// ykasczc@gmail.com
-
-#include "LocalTTSSubsystem.h"
-#include "LocalTTSModule.h"
-#include "HAL/CriticalSection.h"
-#include "Containers/StringConv.h"
-#include "Interfaces/IPluginManager.h"
-#include "Engine/AssetManager.h"
-#include "Engine/Engine.h"
-#include "Misc/Paths.h"
-#include "Misc/FileHelper.h"
-#include "HAL/FileManager.h"
-#include "Async/Async.h"
-#include "LocalTTSTypes.h"
-#include "TTSModelData_Base.h"
-#include "LocalTTSFunctionLibrary.h"
-#include "DSP/AlignedBuffer.h"
-#include "AudioResampler.h"
-#include "TTSSoundWaveRuntime.h"
-#include "LocalTTSSettings.h"
-#include "Containers/Ticker.h"
-#include "Modules/ModuleManager.h"
-#include "LocalTTSModule.h"
-#include "Phonemizer.h"
-
-#include "NNE.h"
-#include "NNEModelData.h"
-#include "NNERuntime.h"
-#include "NNERuntimeCPU.h"
-
-//#include <espeak-ng/speak_lib.h>
-
-FCriticalSection ULocalTTSSubsystem::OnnxLoadMutex;
-
-/*
-#if WITH_EDITOR
-template<typename ElemType>
-FString LocalTtsUtils::PrintArray(const TArray<ElemType>& InData)
-{
-	FString s;
-	for (const auto& d : InData)
-	{
-		if (!s.IsEmpty())
-		{
-			s.Append(TEXT(", "));
-		}
-
-		if (typeid(d) == typeid(float))
-		{
-			s.Append(FString::SanitizeFloat(d));
-		}
-		else
-		{
-			s.Append(FString::FromInt(d));
-		}
-	}
-
-	return s;
-}
-
-template<typename ElemType>
-FString LocalTtsUtils::PrintArray(const TArrayView<ElemType>& InData)
-{
-	FString s;
-	for (const auto& d : InData)
-	{
-		if (!s.IsEmpty())
-		{
-			s.Append(TEXT(", "));
-		}
-
-		if (typeid(d) == typeid(float))
-		{
-			s.Append(FString::SanitizeFloat(d));
-		}
-		else
-		{
-			s.Append(FString::FromInt(d));
-		}
-	}
-
-	return s;
-}
-#endif
-*/
-
-void ULocalTTSSubsystem::Initialize(FSubsystemCollectionBase& Collection)
-{
-    Super::Initialize(Collection);
-
-	const UTtsSettings* Settings = UTtsSettings::Get();
-	if (Settings->bAutoInitializeOnStartup)
-	{
-		//TickDelegateHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &ULocalTTSSubsystem::StartupDelayedInitialize_Internal), 0.5f);
-		StartupDelayedInitialize_Internal(0.f);
-	}
-}
-
-void ULocalTTSSubsystem::Deinitialize()
-{
-    Super::Deinitialize();
-	Cleanup();
-}
-
-void ULocalTTSSubsystem::InitializePhonemizer()
-{
-	StartupDelayedInitialize_Internal(0.f);
-}
-
-void ULocalTTSSubsystem::LoadModelTTS(TSoftObjectPtr<UNNEModelData> TTSModelReferene, TSoftObjectPtr<UTTSModelData_Base> TokenizerReferene, const FLocalTTSStatusResponse& OnLoadingComplete)
-{
-	if (bIsLoading)
-	{
-		OnLoadingComplete.ExecuteIfBound(INDEX_NONE, false);
-		return;
-	}
-
-	if (TTSModelReferene.IsNull())
-	{
-		UE_LOG(LogTemp, Error, TEXT("Model Reference is not set, please assign it in the editor"));
-		OnLoadingComplete.ExecuteIfBound(INDEX_NONE, false);
-		return;
-	}
-	else
-	{
-		if (TokenizerReferene.IsNull())
-		{
-			UE_LOG(LogTemp, Error, TEXT("Tokenizer/Model data is invalid"));
-
-			OnLoadingComplete.ExecuteIfBound(INDEX_NONE, false);
-			return;
-		}
-		
-		FString ModelAssetName = TTSModelReferene.GetAssetName();
-		for (const auto& ExistingModel : VoiceModels)
-		{
-			if (ExistingModel.Value.ModelAssetName == ModelAssetName && ExistingModel.Value.bLoaded)
-			{
-				// already loaded
-				UE_LOG(LogTemp, Log, TEXT("Model is already loaded"));
-
-				OnLoadingComplete.ExecuteIfBound(ExistingModel.Key, true);
-				return;
-			}
-		}
-
-		bIsLoading = true;
-		OnLastLoadCallback = OnLoadingComplete;
-		LastAddedModelTag = INDEX_NONE;
-
-		FNNMInstanceId NewId = VoiceModels.Num();
-		VoiceModels.Add(NewId.Id);
-		VoiceModels[NewId.Id].ModelAssetName = ModelAssetName;
-		VoiceModels[NewId.Id].VoiceDesc = TokenizerReferene.LoadSynchronous();
-
-		const auto Delegate = FStreamableDelegate::CreateLambda([ModelReferene = TTSModelReferene, ModelId = NewId.Id, this]()
-		{
-			if (!ModelReferene.IsValid())
-			{
-				LastAddedModelTag = ModelId;
-				UE_LOG(LogTemp, Log, TEXT("Couldn't load TTS model from soft pointer %s"), *ModelReferene.GetLongPackageName());
-				OnModelLoadingComplete_Internal(false);
-				return;
-			}
-			const FName ModelName = *ModelReferene.GetAssetName();
-
-			AsyncTask(ENamedThreads::AnyThread, [this, ModelReferene, ModelId]() mutable
-			{
-				OnnxLoadMutex.TryLock();
-				LastAddedModelTag = ModelId;
-
-				auto& ModelData = VoiceModels[ModelId];
-				UNNEModelData* ModelAsset = ModelReferene.Get();
-				bool bResult = ULocalTTSFunctionLibrary::LoadNNM(ModelData, ModelAsset, OutputDataBufferSize, TEXT("TTSModel"));
-
-				AsyncTask(ENamedThreads::GameThread, [this, bResult]()
-				{
-					OnnxLoadMutex.Unlock();
-					OnModelLoadingComplete_Internal(bResult);
-				});
-			});
-		});
-
-		if (UAssetManager::IsInitialized())
-		{
-			UAssetManager::GetStreamableManager().RequestAsyncLoad(TTSModelReferene.ToSoftObjectPath(), Delegate);
-		}
-	}
-}
-
-void ULocalTTSSubsystem::DoTextToSpeech(const FNNMInstanceId& VoiceModelId, const FString& Text, const FTTSGenerateSettings& Settings, const FLocalTTSSynthesisResponse& OnResult)
-{
-	if (RequestsQueue.IsEmpty() && !bIsWorking)
-	{
-		ActiveRequest.VoiceModelId = VoiceModelId;
-		ActiveRequest.Text = Text;
-		ActiveRequest.Settings = Settings;
-		ActiveRequest.Callback = OnResult;
-		Inference();
-	}
-	else
-	{
-		FSynthesisQueue r;
-		r.VoiceModelId = VoiceModelId;
-		r.Text = Text;
-		r.Settings = Settings;
-		r.Callback = OnResult;
-		RequestsQueue.Enqueue(r);
-	}
-}
-
-int32 ULocalTTSSubsystem::PredictOutputBufferSize(int32 TokensNum, const FNNEModelTTS& Model) const
-{
-	int32 val = 
-		(int32)(
-			(float)(TokensNum * (int32)900 * (Model.VoiceDesc->SampleRate / (int32)22050)) *
-			(Model.VoiceDesc->BaseSynthesisSpeedMultiplier * Model.VoiceDesc->Speed)
-			);
-
-	const int32 minval = OutputDataBufferSize * 2;
-	return val > minval ? val : minval;
-}
-
-void ULocalTTSSubsystem::Inference()
-{
-	if (!VoiceModels.Contains(ActiveRequest.VoiceModelId.Id))
-	{
-		UE_LOG(LogTemp, Warning, TEXT("Invalid ModelTag. Model not found."));
-		OnGenerationComplete_Internal(false);
-		return;
-	}
-	if (ActiveRequest.Text.IsEmpty())
-	{
-		UE_LOG(LogTemp, Warning, TEXT("Text is empty. Skipping."));
-		OnGenerationComplete_Internal(false);
-		return;
-	}
-
-	bIsWorking = true;
-
-	// Current voice vodel
-	auto& VModel = VoiceModels[ActiveRequest.VoiceModelId.Id];
-	SynthResult.Reset(ActiveRequest.VoiceModelId);
-	SynthResult.SampleRate = VModel.VoiceDesc->SampleRate;
-
-	AsyncTask(ENamedThreads::AnyThread, [this]() mutable
-	{
-		// Current voice vodel
-		auto& VModel = VoiceModels[SynthResult.ModelTag.Id];
-			
-		// Convert text to arrays of phonemes separated by sentences
-		FString PhonemizedText;
-		if (!VModel.VoiceDesc->PhonemizeText(ActiveRequest.Text, PhonemizedText, ActiveRequest.Settings.SpeakerId, SynthResult.PhonemePhrases))
-		{
-			UE_LOG(LogTemp, Warning, TEXT("Failed to phonemize text: %s"), *ActiveRequest.Text);
-			OnGenerationComplete_Internal(false);
-			return;
-		}
-
-		// Prepare memory for 32bit PCM buffer
-		int32 TotalPhonemeCount = 0;
-		for (const auto& PhonemesInPhrase : SynthResult.PhonemePhrases)
-		{
-			TotalPhonemeCount += PhonemesInPhrase.Num();
-		}
-		UE_LOG(LogTemp, Log, TEXT("Phonemized Text: [%s] (%d symbols in total)"), *PhonemizedText, TotalPhonemeCount);
-		
-		int32 SentenceSilenceSamples = (int32)(VModel.VoiceDesc->SentenceSilenceSeconds * (float)VModel.VoiceDesc->SampleRate /* * channel num */);
-		SynthResult.PCMData32.Reserve(PredictOutputBufferSize(TotalPhonemeCount, VModel));
-
-		int32 SentenceIndex = -1;
-		for (const auto& PhonemesInPhrase : SynthResult.PhonemePhrases)
-		{
-			TArray<Piper::PhonemeId> Tokens;
-			TMap<Piper::PhonemeUtf8, int32> MissedPhonemes;
-			SentenceIndex++;
-
-			// 1. Tokenize sentence
-			if (!VModel.VoiceDesc->Tokenize(PhonemesInPhrase, Tokens, MissedPhonemes,
-				/* bFirst */ SentenceIndex == 0,
-				/* bLast */  SentenceIndex == SynthResult.PhonemePhrases.Num() - 1)
-				)
-			{
-				UE_LOG(LogTemp, Warning, TEXT("Failed to tokenize phonemes."));
-				OnGenerationComplete_Internal(false);
-				return;
-			}
-			if (Tokens.IsEmpty())
-			{
-				UE_LOG(LogTemp, Log, TEXT("Failed to tokenize"));
-				continue;
-			}
-			if (MissedPhonemes.Num() > 0)
-			{
-				UE_LOG(LogTemp, Warning, TEXT("Couldn't tokenize %d phonemes! Result will be inaccurate."), MissedPhonemes.Num());
-			}
-
-#if WITH_EDITOR
-			FString TokensStr = LocalTtsUtils::PrintArray(Tokens);
-			UE_LOG(LogTemp, Log, TEXT("Tokenized data: %s (%d total)"), *TokensStr, Tokens.Num());
-#endif
-
-			// 2. Set NN inputs
-			FTTSGenerateRequestContext PrepareContext;
-			PrepareContext.SpeakerId = ActiveRequest.Settings.SpeakerId;
-			PrepareContext.Tokens = &Tokens;
-			if (!VModel.VoiceDesc->SetNNEInputParams(VModel, PrepareContext))
-			{
-				UE_LOG(LogTemp, Warning, TEXT("Unable to prepare NNM inputs."));
-				OnGenerationComplete_Internal(false);
-				return;
-			}
-
-			// 3. Prepare NN output buffer
-			// usually we get about 600 samples per token for 22,050 Hz, but need some reserve for safety
-			int32 ExpectedOutputSize = PredictOutputBufferSize(Tokens.Num(), VModel);
-			if (VModel.OutputData.Num() < ExpectedOutputSize)
-			{
-				VModel.OutputData.SetNumUninitialized(ExpectedOutputSize);
-				UE_LOG(LogTemp, Log, TEXT("Expanding output buffer to %d float samples"), ExpectedOutputSize);
-			}
-			VModel.OutputBindings[0].Data = VModel.OutputData.GetData();
-			VModel.OutputBindings[0].SizeInBytes = VModel.OutputData.Num() * sizeof(float);
-
-			// 4. Interfere current phrase (sentence)
-			TArray<float> TTSOutputs;
-			TArray<uint32> TTSOutputsShape;
-			if (!VModel.RunNNE(TTSOutputs, TTSOutputsShape, false)) // no need to copy to TTSOutputs
-			{
-				UE_LOG(LogTemp, Warning, TEXT("Failed to run NNE."));
-				OnGenerationComplete_Internal(false);
-				return;
-			}
-
-			// 5. Read output
-			int32 GeneratedSamplesNum = VModel.ModelInstance->GetOutputTensorShapes().GetData()->Volume();
-
-			// Push output into PCMData32 buffer
-			if (GeneratedSamplesNum == 0)
-			{
-				UE_LOG(LogTemp, Warning, TEXT("Nothing was generated for sentence %d of %d"), SentenceIndex + 1, SynthResult.PhonemePhrases.Num());
-			}
-			else if (GeneratedSamplesNum > VModel.OutputData.Num())
-			{
-				UE_LOG(LogTemp, Error, TEXT("NNE output buffer was too small (%d vs %d). Data is corrupted."), VModel.OutputData.Num(), GeneratedSamplesNum);
-				OnGenerationComplete_Internal(false);
-				return;
-			}
-			else if (GeneratedSamplesNum > 0)
-			{
-				SynthResult.AudioSeconds += (float)GeneratedSamplesNum / (float)VModel.VoiceDesc->SampleRate;
-				UE_LOG(LogTemp, Log, TEXT("Total generated audio size: %f seconds"), SynthResult.AudioSeconds);
-				int32 StartOffset = SynthResult.PCMData32.Num() * (int32)sizeof(float);
-				SynthResult.PCMData32.AddUninitialized(GeneratedSamplesNum);
-				FMemory::Memcpy((uint8*)SynthResult.PCMData32.GetData() + StartOffset, (const uint8*)VModel.OutputData.GetData(), GeneratedSamplesNum * (int32)sizeof(float));
-
-				// Add pause at the end of each sentence
-				if (SentenceSilenceSamples > 0 && SentenceIndex < SynthResult.PhonemePhrases.Num() - 1)
-				{
-					UE_LOG(LogTemp, Log, TEXT("Addign silence samples (%d) for %f seconds"), SentenceSilenceSamples, VModel.VoiceDesc->SentenceSilenceSeconds);
-					SynthResult.AudioSeconds += VModel.VoiceDesc->SentenceSilenceSeconds;
-					SynthResult.PCMData32.AddZeroed(SentenceSilenceSamples);
-				}
-			}
-		}
-
-		// Set to target sample rate
-		const UTtsSettings* Settings = UTtsSettings::Get();
-		if (Settings->bResampleSynthesizedAudio && Settings->TargetSampleRate != VModel.VoiceDesc->SampleRate)
-		{
-			Audio::FAlignedFloatBuffer ResampledPCMData;
-
-			const Audio::FResamplingParameters ResampleParameters =
-			{
-				Audio::EResamplingMethod::Linear,
-				1,
-				static_cast<float>(VModel.VoiceDesc->SampleRate),
-				static_cast<float>(Settings->TargetSampleRate),
-				SynthResult.PCMData32
-			};
-
-			ResampledPCMData.AddUninitialized(Audio::GetOutputBufferSize(ResampleParameters));
-			Audio::FResamplerResults ResampleResults;
-			ResampleResults.OutBuffer = &ResampledPCMData;
-
-			if (Audio::Resample(ResampleParameters, ResampleResults))
-			{
-				SynthResult.PCMData32 = MoveTemp(ResampledPCMData);
-				SynthResult.SampleRate = Settings->TargetSampleRate;
-			}	
-		}
-
-		// Custom postprocessing if needed (for piper: normalize volume)
-		VModel.VoiceDesc->PostProcessNND(SynthResult);
-
-		// Resample 32bit to 16bit if it didn't happen during post-processing
-		if (SynthResult.PCMData16.IsEmpty())
-		{
-			int32 SamplesNum = SynthResult.PCMData32.Num();
-			SynthResult.PCMData16.SetNumUninitialized(SamplesNum * 2);
-
-			int16* pcm16 = (int16*)SynthResult.PCMData16.GetData();
-			for (int32 i = 0; i < SamplesNum; i++)
-			{
-				pcm16[i] = (int16)FMath::TruncToInt(SynthResult.PCMData32[i] * 32768.0f);
-			}
-		}
-
-		AsyncTask(ENamedThreads::GameThread, [this]()
-		{
-			OnGenerationComplete_Internal(true);
-		});
-	});
-}
-
-const FNNEModelTTS* ULocalTTSSubsystem::GetVoiceModel(const FNNMInstanceId& ModelID) const
-{
-	return VoiceModels.Find(ModelID.Id);
-}
-
-bool ULocalTTSSubsystem::IsVoiceModelValid(const FNNMInstanceId& ModelID) const
-{
-	return VoiceModels.Contains(ModelID.Id) && VoiceModels[ModelID.Id].bLoaded;
-}
-
-UTTSModelData_Base* ULocalTTSSubsystem::GetModelDataAsset(const FNNMInstanceId& ModelID) const
-{
-	const FNNEModelTTS* Model = VoiceModels.Find(ModelID.Id);
-	return Model ? Model->VoiceDesc : nullptr;
-}
-
-bool ULocalTTSSubsystem::ReleaseModel(const FNNMInstanceId& ModelTag)
-{
-	if (IsVoiceModelValid(ModelTag))
-	{
-		VoiceModels[ModelTag.Id].ModelInstance.Reset();
-		VoiceModels.Remove(ModelTag.Id);
-		return true;
-	}
-	return false;
-}
-
-bool ULocalTTSSubsystem::StartupDelayedInitialize_Internal(float DeltaTime)
-{
-	if (TickDelegateHandle.IsValid())
-	{
-		FTSTicker::GetCoreTicker().RemoveTicker(TickDelegateHandle);
-	}
-
-#if ESPEAK_NG
-	FString ContentPath = FLocalTTSModule::GetContentPath() / TEXT("NonUFS/espeak-ng-data");
-	UE_LOG(LogTemp, Log, TEXT("eSpeak data path: %s"), *ContentPath);
-	if (PlatformFileUtils::DirectoryExists(ContentPath))
-	{
-		auto ModuleTts = FModuleManager::GetModulePtr<FLocalTTSModule>(TEXT("LocalTTS"));
-		if (!ModuleTts->IsLoaded())
-		{
-			UE_LOG(LogTemp, Log, TEXT("eSpeak status: unexpected error."));
-			return false;
-		}
-
-#if PLATFORM_ANDROID
-		ContentPath = PlatformFileUtils::GetPlatformPath(ContentPath);
-#endif
-
-		int32 EspeakResult = ModuleTts->func_espeak_Initialize(AUDIO_OUTPUT_SYNCHRONOUS, 0, TCHAR_TO_ANSI(*ContentPath), 0);
-		UE_LOG(LogTemp, Log, TEXT("eSpeak initialization status: %d"), EspeakResult);
-		bEspeakStatus = EspeakResult > 0;
-	}
-	else
-	{
-		UE_LOG(LogTemp, Log, TEXT("eSpeak status: can't find content"));
-		bEspeakStatus = false;
-	}
-
-#else
-	const UTtsSettings* Settings = UTtsSettings::Get();
-	if (!Settings->PhonemizerInfo.IsNull())
-	{
-		Phonemizer = Settings->PhonemizerInfo.LoadSynchronous();
-		if (IsValid(Phonemizer))
-		{
-			Phonemizer->SyncLoadModel(Settings->PhonemizerEncoder, Settings->PhonemizerDecoder);
-			bEspeakStatus = true;
-		}
-	}
-#endif
-
-	return bEspeakStatus;
-}
-
-void ULocalTTSSubsystem::OnModelLoadingComplete_Internal(bool bResult)
-{
-	if (IsInGameThread())
-	{
-		bIsLoading = false;
-		OnnxLoadMutex.Unlock();
-		OnLastLoadCallback.ExecuteIfBound(LastAddedModelTag, bResult);
-		
-		// Try to load dictionary beforehand
-		if (IsValid(Phonemizer))
-		{
-			if (VoiceModels.Contains(LastAddedModelTag.Id))
-			{
-				UTTSModelData_Base* ModelData = VoiceModels[LastAddedModelTag.Id].VoiceDesc;
-				if (IsValid(ModelData) && ModelData->PhonemizationType == ETTSPhonemeType::PT_Dictionary)
-				{
-					Phonemizer->PrepareDictionary(ModelData->GetEspeakCode(0));
-				}
-			}
-		}
-	}
-	else
-	{
-		AsyncTask(ENamedThreads::GameThread, [this, bResult]()
-		{
-			bIsLoading = false;
-			OnnxLoadMutex.Unlock();
-			OnLastLoadCallback.ExecuteIfBound(LastAddedModelTag, bResult);
-		});
-	}
-}
-
-void ULocalTTSSubsystem::OnGenerationComplete_Internal(bool bResult)
-{
-	if (bResult)
-	{
-		auto& VModel = VoiceModels[SynthResult.ModelTag.Id];
-
-		const UTtsSettings* Settings = UTtsSettings::Get();
-		if (Settings->bSaveCachedWav)
-		{
-			FString Path = FPaths::ProjectDir() / TEXT("Saved") / TEXT("CacheTTS");
-			if (!FPaths::DirectoryExists(Path))
-			{
-				IFileManager::Get().MakeDirectory(*Path);
-			}
-			FString StrDate = FDateTime::Now().ToFormattedString(TEXT("%Y-%m-%d-%H-%M-%S"));
-			FString FileName = Path / TEXT("tts-") + StrDate + TEXT(".wav");
-			ULocalTTSFunctionLibrary::SaveAudioDataToFile(SynthResult.PCMData16, 1, SynthResult.SampleRate, FileName);
-		}
-
-		UTTSSoundWaveRuntime* VoiceSoundWave = NewObject<UTTSSoundWaveRuntime>();
-		if (IsValid(VoiceSoundWave))
-		{
-			VoiceSoundWave->bProcedural = true;
-			VoiceSoundWave->bLooping = false;
-			VoiceSoundWave->SetSampleRate(SynthResult.SampleRate);
-			VoiceSoundWave->NumChannels = 1;
-			VoiceSoundWave->InitializeAudio(SynthResult.PCMData16.GetData(), SynthResult.PCMData16.Num());
-			ActiveRequest.Callback.ExecuteIfBound(VoiceSoundWave);
-		}
-		OnGenerationResult.Broadcast(SynthResult.ModelTag, VoiceSoundWave);
-
-		VModel.OutputData.Empty();
-		SynthResult.PCMData16.Empty();
-		SynthResult.PCMData32.Empty();
-	}
-	else
-	{
-		ActiveRequest.Callback.ExecuteIfBound(nullptr);
-	}
-
-	bIsWorking = false;
-	if (!RequestsQueue.IsEmpty())
-	{
-		RequestsQueue.Dequeue(ActiveRequest);
-		Inference();
-	}
-}
-
-void ULocalTTSSubsystem::Cleanup()
-{
-	if (bEspeakStatus)
-	{
-		auto ModuleTts = FModuleManager::GetModulePtr<FLocalTTSModule>(TEXT("LocalTTS"));
-		if (ModuleTts->IsLoaded())
-		{
-			ModuleTts->func_espeak_Terminate();
-		}
-	}
-
-	for (auto& Model : VoiceModels)
-	{
-		Model.Value.ModelInstance.Reset();
-	}
-	VoiceModels.Empty();
-}
+﻿// (c) Yuri N. K. 2025. All rights reserved.
+// ykasczc@gmail.com
+
+#include "LocalTTSSubsystem.h"
+#include "LocalTTSModule.h"
+#include "HAL/CriticalSection.h"
+#include "Containers/StringConv.h"
+#include "Interfaces/IPluginManager.h"
+#include "Engine/AssetManager.h"
+#include "Engine/Engine.h"
+#include "Misc/Paths.h"
+#include "Misc/FileHelper.h"
+#include "HAL/FileManager.h"
+#include "Async/Async.h"
+#include "Async/ParallelFor.h"
+#include "LocalTTSTypes.h"
+#include "TTSModelData_Base.h"
+#include "LocalTTSFunctionLibrary.h"
+#include "DSP/AlignedBuffer.h"
+#include "PolyphaseResampler.h"
+#include "StreamingNormalizer.h"
+#include "TTSSoundWaveRuntime.h"
+#include "TTSSoundWaveStreaming.h"
+#include "LocalTTSSettings.h"
+#include "Containers/Ticker.h"
+#include "Modules/ModuleManager.h"
+#include "LocalTTSModule.h"
+#include "Phonemizer.h"
+#include "PhonemeLexicon.h"
+
+#include "NNE.h"
+#include "NNEModelData.h"
+#include "NNERuntime.h"
+#include "NNERuntimeCPU.h"
+
+//#include <espeak-ng/speak_lib.h>
+
+FCriticalSection ULocalTTSSubsystem::OnnxLoadMutex;
+
+/*
+#if WITH_EDITOR
+template<typename ElemType>
+FString LocalTtsUtils::PrintArray(const TArray<ElemType>& InData)
+{
+	FString s;
+	for (const auto& d : InData)
+	{
+		if (!s.IsEmpty())
+		{
+			s.Append(TEXT(", "));
+		}
+
+		if (typeid(d) == typeid(float))
+		{
+			s.Append(FString::SanitizeFloat(d));
+		}
+		else
+		{
+			s.Append(FString::FromInt(d));
+		}
+	}
+
+	return s;
+}
+
+template<typename ElemType>
+FString LocalTtsUtils::PrintArray(const TArrayView<ElemType>& InData)
+{
+	FString s;
+	for (const auto& d : InData)
+	{
+		if (!s.IsEmpty())
+		{
+			s.Append(TEXT(", "));
+		}
+
+		if (typeid(d) == typeid(float))
+		{
+			s.Append(FString::SanitizeFloat(d));
+		}
+		else
+		{
+			s.Append(FString::FromInt(d));
+		}
+	}
+
+	return s;
+}
+#endif
+*/
+
+void ULocalTTSSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+    Super::Initialize(Collection);
+
+	const UTtsSettings* Settings = UTtsSettings::Get();
+	if (Settings->bAutoInitializeOnStartup)
+	{
+		//TickDelegateHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &ULocalTTSSubsystem::StartupDelayedInitialize_Internal), 0.5f);
+		StartupDelayedInitialize_Internal(0.f);
+	}
+}
+
+void ULocalTTSSubsystem::Deinitialize()
+{
+    Super::Deinitialize();
+	Cleanup();
+}
+
+void ULocalTTSSubsystem::InitializePhonemizer()
+{
+	StartupDelayedInitialize_Internal(0.f);
+}
+
+void ULocalTTSSubsystem::LoadModelTTS(TSoftObjectPtr<UNNEModelData> TTSModelReferene, TSoftObjectPtr<UTTSModelData_Base> TokenizerReferene, const FLocalTTSStatusResponse& OnLoadingComplete)
+{
+	if (bIsLoading)
+	{
+		OnLoadingComplete.ExecuteIfBound(INDEX_NONE, false);
+		return;
+	}
+
+	if (TTSModelReferene.IsNull())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Model Reference is not set, please assign it in the editor"));
+		OnLoadingComplete.ExecuteIfBound(INDEX_NONE, false);
+		return;
+	}
+	else
+	{
+		if (TokenizerReferene.IsNull())
+		{
+			UE_LOG(LogTemp, Error, TEXT("Tokenizer/Model data is invalid"));
+
+			OnLoadingComplete.ExecuteIfBound(INDEX_NONE, false);
+			return;
+		}
+		
+		FString ModelAssetName = TTSModelReferene.GetAssetName();
+		for (const auto& ExistingModel : VoiceModels)
+		{
+			if (ExistingModel.Value.ModelAssetName == ModelAssetName && ExistingModel.Value.bLoaded)
+			{
+				// already loaded
+				UE_LOG(LogTemp, Log, TEXT("Model is already loaded"));
+
+				OnLoadingComplete.ExecuteIfBound(ExistingModel.Key, true);
+				return;
+			}
+		}
+
+		bIsLoading = true;
+		OnLastLoadCallback = OnLoadingComplete;
+		LastAddedModelTag = INDEX_NONE;
+
+		FNNMInstanceId NewId = VoiceModels.Num();
+		VoiceModels.Add(NewId.Id);
+		VoiceModels[NewId.Id].ModelAssetName = ModelAssetName;
+		VoiceModels[NewId.Id].VoiceDesc = TokenizerReferene.LoadSynchronous();
+
+		const auto Delegate = FStreamableDelegate::CreateLambda([ModelReferene = TTSModelReferene, ModelId = NewId.Id, this]()
+		{
+			if (!ModelReferene.IsValid())
+			{
+				LastAddedModelTag = ModelId;
+				UE_LOG(LogTemp, Log, TEXT("Couldn't load TTS model from soft pointer %s"), *ModelReferene.GetLongPackageName());
+				OnModelLoadingComplete_Internal(false);
+				return;
+			}
+			const FName ModelName = *ModelReferene.GetAssetName();
+
+			AsyncTask(ENamedThreads::AnyThread, [this, ModelReferene, ModelId]() mutable
+			{
+				OnnxLoadMutex.TryLock();
+				LastAddedModelTag = ModelId;
+
+				auto& ModelData = VoiceModels[ModelId];
+				UNNEModelData* ModelAsset = ModelReferene.Get();
+				bool bResult = ULocalTTSFunctionLibrary::LoadNNM(ModelData, ModelAsset, OutputDataBufferSize, TEXT("TTSModel"));
+
+				AsyncTask(ENamedThreads::GameThread, [this, bResult]()
+				{
+					OnnxLoadMutex.Unlock();
+					OnModelLoadingComplete_Internal(bResult);
+				});
+			});
+		});
+
+		if (UAssetManager::IsInitialized())
+		{
+			UAssetManager::GetStreamableManager().RequestAsyncLoad(TTSModelReferene.ToSoftObjectPath(), Delegate);
+		}
+	}
+}
+
+void ULocalTTSSubsystem::DoTextToSpeech(const FNNMInstanceId& VoiceModelId, const FString& Text, const FTTSGenerateSettings& Settings, const FLocalTTSSynthesisResponse& OnResult)
+{
+	// Requests are processed when phonemizer is ready
+	if (RequestsQueue.IsEmpty() && !bIsWorking && !bPhonemizerInitializing)
+	{
+		ActiveRequest.VoiceModelId = VoiceModelId;
+		ActiveRequest.Text = Text;
+		ActiveRequest.Settings = Settings;
+		ActiveRequest.Callback = OnResult;
+		Inference();
+	}
+	else
+	{
+		FSynthesisQueue r;
+		r.VoiceModelId = VoiceModelId;
+		r.Text = Text;
+		r.Settings = Settings;
+		r.Callback = OnResult;
+		RequestsQueue.Enqueue(r);
+	}
+}
+
+int32 ULocalTTSSubsystem::PredictOutputBufferSize(int32 TokensNum, const FNNEModelTTS& Model) const
+{
+	int32 val = 
+		(int32)(
+			(float)(TokensNum * (int32)900 * (Model.VoiceDesc->SampleRate / (int32)22050)) *
+			(Model.VoiceDesc->BaseSynthesisSpeedMultiplier * Model.VoiceDesc->Speed)
+			);
+
+	const int32 minval = OutputDataBufferSize * 2;
+	return val > minval ? val : minval;
+}
+
+void ULocalTTSSubsystem::Inference()
+{
+	// Wave of the previous request isn't needed anymore
+	StreamingSoundWave = nullptr;
+	bStreamingSoundWaveDelivered = false;
+
+	if (!VoiceModels.Contains(ActiveRequest.VoiceModelId.Id))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Invalid ModelTag. Model not found."));
+		OnGenerationComplete_Internal(false);
+		return;
+	}
+	if (ActiveRequest.Text.IsEmpty())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Text is empty. Skipping."));
+		OnGenerationComplete_Internal(false);
+		return;
+	}
+
+	bIsWorking = true;
+
+	// Current voice vodel
+	auto& VModel = VoiceModels[ActiveRequest.VoiceModelId.Id];
+	SynthResult.Reset(ActiveRequest.VoiceModelId);
+	SynthResult.SampleRate = VModel.VoiceDesc->SampleRate;
+
+	// Streamed sound wave is initialized by synthesis thread and passed to callback before audio is ready
+	StreamingSoundWave = UTtsSettings::Get()->bStreamingPlayback ? NewObject<UTTSSoundWaveStreaming>() : nullptr;
+
+	// Worker gets the wave with the task, StreamingSoundWave is only changed on the game thread
+	AsyncTask(ENamedThreads::AnyThread, [this, StreamingWave = StreamingSoundWave.Get()]() mutable
+	{
+		// Current voice vodel
+		auto& VModel = VoiceModels[SynthResult.ModelTag.Id];
+			
+		// Convert text to arrays of phonemes separated by sentences
+		FString PhonemizedText;
+		if (!VModel.VoiceDesc->PhonemizeText(ActiveRequest.Text, PhonemizedText, ActiveRequest.Settings.SpeakerId, SynthResult.PhonemePhrases))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Failed to phonemize text: %s"), *ActiveRequest.Text);
+			CompleteGenerationOnGameThread_Internal(false);
+			return;
+		}
+
+		// Prepare memory for 32bit PCM buffer
+		int32 TotalPhonemeCount = SynthResult.PhonemePhrases.Phonemes.Num();
+		UE_LOG(LogTemp, Log, TEXT("Phonemized Text: [%s] (%d symbols in total)"), *PhonemizedText, TotalPhonemeCount);
+		
+		int32 SentenceSilenceSamples = (int32)(VModel.VoiceDesc->SentenceSilenceSeconds * (float)VModel.VoiceDesc->SampleRate /* * channel num */);
+		const int32 PhrasesNum = SynthResult.PhonemePhrases.Num();
+		const UTtsSettings* Settings = UTtsSettings::Get();
+		const int32 InstancesNum = VModel.VoiceDesc->SupportsParallelBatches() ? FMath::Min(Settings->ParallelBatchInstances, PhrasesNum) : 1;
+
+		// Set to target sample rate: phrases are resampled as soon as they're added
+		TUniquePtr<FPolyphaseResampler> Resampler;
+		if (Settings->bResampleSynthesizedAudio && !Settings->bNativeRatePlayback && Settings->TargetSampleRate != VModel.VoiceDesc->SampleRate)
+		{
+			if (TSharedPtr<const FPolyphaseFilterBank> FilterBank = GetResamplerFilterBank(VModel.VoiceDesc->SampleRate, Settings->TargetSampleRate))
+			{
+				Resampler = MakeUnique<FPolyphaseResampler>(FilterBank);
+				SynthResult.SampleRate = Settings->TargetSampleRate;
+			}
+		}
+		const int32 ExpectedSamplesNum = PredictOutputBufferSize(TotalPhonemeCount, VModel);
+		const int32 ExpectedOutputNum = Resampler.IsValid() ? (int32)Resampler->GetOutputNum(ExpectedSamplesNum) : ExpectedSamplesNum;
+		SynthResult.PCMData32.Reserve(ExpectedOutputNum);
+
+		// Start playback of streamed sound wave, audio is appended to it as soon as it's normalized
+		int32 StreamedSamplesNum = 0;
+		if (StreamingWave)
+		{
+			// Ring buffer for two phrases of average size, the wave grows it if synthesis gets ahead of playback
+			StreamingWave->InitializeStream(SynthResult.SampleRate, 2 * ExpectedOutputNum / FMath::Max(1, PhrasesNum));
+			// Callback is called once with this wave. StreamingSoundWave keeps it alive until completion, which is queued after this task
+			bStreamingSoundWaveDelivered = true;
+			AsyncTask(ENamedThreads::GameThread, [WeakThis = TWeakObjectPtr<ULocalTTSSubsystem>(this), WeakWave = TWeakObjectPtr<UTTSSoundWaveStreaming>(StreamingWave), Callback = ActiveRequest.Callback, ModelTag = SynthResult.ModelTag]()
+			{
+				UTTSSoundWaveStreaming* Wave = WeakWave.Get();
+				Callback.ExecuteIfBound(Wave);
+				if (ULocalTTSSubsystem* This = WeakThis.Get())
+				{
+					This->OnGenerationResult.Broadcast(ModelTag, Wave);
+				}
+			});
+		}
+
+		// Normalize phrases as they're added instead of peak normalization in PostProcessNND (always needed for streamed audio)
+		TUniquePtr<FStreamingNormalizer> Normalizer;
+		const float NormalizationMinPeak = VModel.VoiceDesc->GetNormalizationMinPeak();
+		if ((Settings->bStreamingNormalization || StreamingWave != nullptr) && NormalizationMinPeak > 0.f)
+		{
+			Normalizer = MakeUnique<FStreamingNormalizer>(SynthResult.SampleRate, 0.05f, 4.f, NormalizationMinPeak);
+		}
+		// Resampled audio waiting for normalizer
+		Audio::FAlignedFloatBuffer StagedPCMData;
+		Audio::FAlignedFloatBuffer& PhraseOutput = Normalizer.IsValid() ? StagedPCMData : SynthResult.PCMData32;
+
+		// Push new output to the streamed sound wave (it queues everything, synthesis doesn't wait for playback)
+		auto StreamNewAudio = [this, StreamingWave, &StreamedSamplesNum]()
+		{
+			if (StreamingWave && StreamedSamplesNum < SynthResult.PCMData32.Num())
+			{
+				StreamingWave->AppendAudio(SynthResult.PCMData32.GetData() + StreamedSamplesNum, SynthResult.PCMData32.Num() - StreamedSamplesNum);
+				StreamedSamplesNum = SynthResult.PCMData32.Num();
+			}
+		};
+
+		auto AppendPhrase = [this, &Resampler, &Normalizer, &StagedPCMData, &PhraseOutput, &StreamNewAudio, SentenceSilenceSamples, PhrasesNum](int32 SentenceIndex, TConstArrayView<float> PhrasePCMData)
+		{
+			// Silent (fully trimmed) phrase still gets its pause
+			if (!PhrasePCMData.IsEmpty())
+			{
+				if (Resampler.IsValid())
+				{
+					Resampler->Process(PhrasePCMData.GetData(), PhrasePCMData.Num(), PhraseOutput);
+				}
+				else
+				{
+					PhraseOutput.Append(PhrasePCMData);
+				}
+			}
+
+			// Add pause at the end of each sentence
+			if (SentenceSilenceSamples > 0 && SentenceIndex < PhrasesNum - 1)
+			{
+				if (Resampler.IsValid())
+				{
+					Resampler->ProcessSilence(SentenceSilenceSamples, PhraseOutput);
+				}
+				else
+				{
+					PhraseOutput.AddZeroed(SentenceSilenceSamples);
+				}
+			}
+
+			if (Normalizer.IsValid())
+			{
+				Normalizer->Process(StagedPCMData.GetData(), StagedPCMData.Num(), SynthResult.PCMData32);
+				StagedPCMData.Reset();
+			}
+			StreamNewAudio();
+		};
+
+		if (InstancesNum <= 1)
+		{
+			Audio::FAlignedFloatBuffer PhrasePCMData;
+			int32 PhraseStart = 0;
+			for (int32 SentenceIndex = 0; SentenceIndex < PhrasesNum; SentenceIndex++)
+			{
+				if (!SynthesizePhrase_Internal(VModel, SentenceIndex, PhrasePCMData, PhraseStart))
+				{
+					CompleteGenerationOnGameThread_Internal(false);
+					return;
+				}
+				AppendPhrase(SentenceIndex, MakeArrayView(PhrasePCMData).RightChop(PhraseStart));
+			}
+		}
+		else
+		{
+			// Batches don't depend on each other: synthesize them on several model instances.
+			// Each phrase is appended as soon as it and all previous phrases are ready, so streaming starts with the first phrase
+			TArray<FNNEModelTTS*> Instances;
+			GetModelInstances_Internal(SynthResult.ModelTag.Id, InstancesNum, Instances);
+
+			TArray<Audio::FAlignedFloatBuffer> PhrasesPCMData;
+			PhrasesPCMData.SetNum(PhrasesNum);
+			TArray<int32> PhrasesStart;
+			PhrasesStart.SetNumZeroed(PhrasesNum);
+			TArray<bool> PhrasesReady;
+			PhrasesReady.SetNumZeroed(PhrasesNum);
+			int32 NextAppendedPhrase = 0;
+			FCriticalSection AppendLock;
+			std::atomic<int32> NextPhrase = 0;
+			std::atomic<bool> bFailed = false;
+
+			ParallelFor(Instances.Num(), [this, &Instances, &PhrasesPCMData, &PhrasesStart, &PhrasesReady, &NextAppendedPhrase, &AppendLock, &AppendPhrase, &NextPhrase, &bFailed, PhrasesNum](int32 InstanceIndex)
+			{
+				int32 PhraseIndex;
+				while (!bFailed.load() && (PhraseIndex = NextPhrase.fetch_add(1)) < PhrasesNum)
+				{
+					if (!SynthesizePhrase_Internal(*Instances[InstanceIndex], PhraseIndex, PhrasesPCMData[PhraseIndex], PhrasesStart[PhraseIndex]))
+					{
+						bFailed.store(true);
+						break;
+					}
+
+					FScopeLock Lock(&AppendLock);
+					PhrasesReady[PhraseIndex] = true;
+					while (!bFailed.load() && NextAppendedPhrase < PhrasesNum && PhrasesReady[NextAppendedPhrase])
+					{
+						AppendPhrase(NextAppendedPhrase, MakeArrayView(PhrasesPCMData[NextAppendedPhrase]).RightChop(PhrasesStart[NextAppendedPhrase]));
+						PhrasesPCMData[NextAppendedPhrase].Empty();
+						NextAppendedPhrase++;
+					}
+				}
+			});
+
+			if (bFailed.load())
+			{
+				CompleteGenerationOnGameThread_Internal(false);
+				return;
+			}
+			UE_LOG(LogTemp, Log, TEXT("Synthesized %d batches using %d model instances"), PhrasesNum, Instances.Num());
+		}
+
+		if (Resampler.IsValid())
+		{
+			Resampler->Flush(PhraseOutput);
+		}
+		if (Normalizer.IsValid())
+		{
+			Normalizer->Process(StagedPCMData.GetData(), StagedPCMData.Num(), SynthResult.PCMData32);
+			Normalizer->Flush(SynthResult.PCMData32);
+		}
+		if (StreamingWave)
+		{
+			StreamNewAudio();
+			StreamingWave->FinishStream();
+		}
+		SynthResult.AudioSeconds = (float)SynthResult.PCMData32.Num() / (float)SynthResult.SampleRate;
+		UE_LOG(LogTemp, Log, TEXT("Total generated audio size: %f seconds"), SynthResult.AudioSeconds);
+
+		// Float audio is passed to the sound wave as is, 16 bit data is created later if needed
+		const bool bFloatOutput = Settings->bFloatPlayback || StreamingWave != nullptr;
+		if (Normalizer.IsValid())
+		{
+			// Already normalized to [-1, 1]
+			if (!bFloatOutput)
+			{
+				SynthResult.PCMData16.SetNumUninitialized(SynthResult.PCMData32.Num() * 2);
+				LocalTtsMath::FloatToInt16(SynthResult.PCMData32.GetData(), SynthResult.PCMData32.Num(), 32767.0f, (int16*)SynthResult.PCMData16.GetData());
+			}
+		}
+		else if (bFloatOutput)
+		{
+			// Same peak normalization as PostProcessNND, but without conversion
+			if (NormalizationMinPeak > 0.f)
+			{
+				LocalTtsMath::NormalizeInPlace(SynthResult.PCMData32.GetData(), SynthResult.PCMData32.Num(), NormalizationMinPeak);
+			}
+		}
+		else
+		{
+			// Custom postprocessing if needed (for piper: normalize volume)
+			VModel.VoiceDesc->PostProcessNND(SynthResult);
+		}
+
+		// Resample 32bit to 16bit if it didn't happen during post-processing
+		if (!bFloatOutput && SynthResult.PCMData16.IsEmpty())
+		{
+			int32 SamplesNum = SynthResult.PCMData32.Num();
+			SynthResult.PCMData16.SetNumUninitialized(SamplesNum * 2);
+			LocalTtsMath::FloatToInt16(SynthResult.PCMData32.GetData(), SamplesNum, 32768.0f, (int16*)SynthResult.PCMData16.GetData());
+		}
+
+		CompleteGenerationOnGameThread_Internal(true);
+	});
+}
+
+void ULocalTTSSubsystem::CompleteGenerationOnGameThread_Internal(bool bResult)
+{
+	// Game thread tasks run in order, so the streamed wave is always delivered before completion
+	AsyncTask(ENamedThreads::GameThread, [WeakThis = TWeakObjectPtr<ULocalTTSSubsystem>(this), bResult]()
+	{
+		if (ULocalTTSSubsystem* This = WeakThis.Get())
+		{
+			This->OnGenerationComplete_Internal(bResult);
+		}
+	});
+}
+
+bool ULocalTTSSubsystem::SynthesizePhrase_Internal(FNNEModelTTS& Model, int32 PhraseIndex, Audio::FAlignedFloatBuffer& OutPCMData, int32& OutStart)
+{
+	OutPCMData.Reset();
+	OutStart = 0;
+
+	const TConstArrayView<Piper::PhonemeUtf8> PhonemesInPhrase = SynthResult.PhonemePhrases[PhraseIndex];
+	TArray<Piper::PhonemeId> Tokens;
+	TMap<Piper::PhonemeUtf8, int32> MissedPhonemes;
+
+	// 1. Tokenize sentence
+	if (!Model.VoiceDesc->Tokenize(PhonemesInPhrase, Tokens, MissedPhonemes,
+		/* bFirst */ PhraseIndex == 0,
+		/* bLast */  PhraseIndex == SynthResult.PhonemePhrases.Num() - 1)
+		)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Failed to tokenize phonemes."));
+		return false;
+	}
+	if (Tokens.IsEmpty())
+	{
+		UE_LOG(LogTemp, Log, TEXT("Failed to tokenize"));
+		return true;
+	}
+	if (MissedPhonemes.Num() > 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Couldn't tokenize %d phonemes! Result will be inaccurate."), MissedPhonemes.Num());
+	}
+
+#if WITH_EDITOR
+	FString TokensStr = LocalTtsUtils::PrintArray(Tokens);
+	UE_LOG(LogTemp, Log, TEXT("Tokenized data: %s (%d total)"), *TokensStr, Tokens.Num());
+#endif
+
+	// 2. Set NN inputs
+	FTTSGenerateRequestContext PrepareContext;
+	PrepareContext.SpeakerId = ActiveRequest.Settings.SpeakerId;
+	PrepareContext.Tokens = &Tokens;
+	if (!Model.VoiceDesc->SetNNEInputParams(Model, PrepareContext))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Unable to prepare NNM inputs."));
+		return false;
+	}
+
+	// 3. Prepare NN output buffer
+	// usually we get about 600 samples per token for 22,050 Hz, but need some reserve for safety
+	int32 ExpectedOutputSize = PredictOutputBufferSize(Tokens.Num(), Model);
+	if (Model.OutputData.Num() < ExpectedOutputSize)
+	{
+		Model.OutputData.SetNumUninitialized(ExpectedOutputSize);
+		UE_LOG(LogTemp, Log, TEXT("Expanding output buffer to %d float samples"), ExpectedOutputSize);
+	}
+	Model.OutputBindings[0].Data = Model.OutputData.GetData();
+	Model.OutputBindings[0].SizeInBytes = Model.OutputData.Num() * sizeof(float);
+
+	// 4. Interfere current phrase (sentence)
+	TArray<float> TTSOutputs;
+	TArray<uint32> TTSOutputsShape;
+	if (!Model.RunNNE(TTSOutputs, TTSOutputsShape, false)) // no need to copy to TTSOutputs
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Failed to run NNE."));
+		return false;
+	}
+
+	// 5. Read output
+	int32 GeneratedSamplesNum = Model.ModelInstance->GetOutputTensorShapes().GetData()->Volume();
+
+	// Push output into PCM buffer
+	if (GeneratedSamplesNum == 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Nothing was generated for sentence %d of %d"), PhraseIndex + 1, SynthResult.PhonemePhrases.Num());
+	}
+	else if (GeneratedSamplesNum > Model.OutputData.Num())
+	{
+		UE_LOG(LogTemp, Error, TEXT("NNE output buffer was too small (%d vs %d). Data is corrupted."), Model.OutputData.Num(), GeneratedSamplesNum);
+		return false;
+	}
+	else if (GeneratedSamplesNum > 0)
+	{
+		// Find peak while copying, then cut silence at the edges of the phrase (only edge frames are read again)
+		OutPCMData.SetNumUninitialized(GeneratedSamplesNum);
+		const float Peak = LocalTtsMath::CopyAbsMax(Model.OutputData.GetData(), GeneratedSamplesNum, OutPCMData.GetData());
+		int32 End;
+		Model.VoiceDesc->GetTrimmedRange(OutPCMData.GetData(), GeneratedSamplesNum, Peak, OutStart, End);
+		OutPCMData.SetNum(End, EAllowShrinking::No);
+		OutStart = FMath::Min(OutStart, End);
+	}
+
+	return true;
+}
+
+void ULocalTTSSubsystem::GetModelInstances_Internal(int32 ModelId, int32 InstancesNum, TArray<FNNEModelTTS*>& OutInstances)
+{
+	FNNEModelTTS& MainInstance = VoiceModels[ModelId];
+	OutInstances.Add(&MainInstance);
+
+	FScopeLock Lock(&VoiceModelPoolsLock);
+	TArray<TUniquePtr<FNNEModelTTS>>& Pool = VoiceModelPools.FindOrAdd(ModelId);
+	while (Pool.Num() < InstancesNum - 1)
+	{
+		// Instances share the loaded model
+		TUniquePtr<FNNEModelTTS> NewInstance = MakeUnique<FNNEModelTTS>();
+		NewInstance->ModelAssetName = MainInstance.ModelAssetName;
+		NewInstance->VoiceDesc = MainInstance.VoiceDesc;
+		if (!ULocalTTSFunctionLibrary::CloneNNM(*NewInstance, MainInstance, OutputDataBufferSize, TEXT("TTSModel")))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Failed to create additional instance of TTS model %s"), *MainInstance.ModelAssetName);
+			break;
+		}
+		Pool.Add(MoveTemp(NewInstance));
+	}
+
+	for (int32 i = 0; i < Pool.Num() && OutInstances.Num() < InstancesNum; i++)
+	{
+		OutInstances.Add(Pool[i].Get());
+	}
+}
+
+TSharedPtr<const FPolyphaseFilterBank> ULocalTTSSubsystem::GetResamplerFilterBank(int32 InRate, int32 OutRate)
+{
+	FScopeLock Lock(&ResamplerFilterBanksLock);
+	const TPair<int32, int32> Key(InRate, OutRate);
+	if (const TSharedPtr<const FPolyphaseFilterBank>* ExistingBank = ResamplerFilterBanks.Find(Key))
+	{
+		return *ExistingBank;
+	}
+
+	TSharedPtr<const FPolyphaseFilterBank> NewBank = FPolyphaseFilterBank::Create(InRate, OutRate);
+	if (NewBank.IsValid())
+	{
+		ResamplerFilterBanks.Add(Key, NewBank);
+	}
+	return NewBank;
+}
+
+bool ULocalTTSSubsystem::ResamplePCMData16_Internal(const TArray<uint8>& InPCMData, int32 InRate, int32 OutRate, TArray<uint8>& OutPCMData)
+{
+	TSharedPtr<const FPolyphaseFilterBank> FilterBank = GetResamplerFilterBank(InRate, OutRate);
+	if (!FilterBank.IsValid())
+	{
+		return false;
+	}
+
+	const int16* Samples = (const int16*)InPCMData.GetData();
+	const int32 SamplesNum = InPCMData.Num() / 2;
+	Audio::FAlignedFloatBuffer PCMData32;
+	PCMData32.SetNumUninitialized(SamplesNum);
+	for (int32 i = 0; i < SamplesNum; i++)
+	{
+		PCMData32[i] = (float)Samples[i];
+	}
+
+	FPolyphaseResampler Resampler(FilterBank);
+	Audio::FAlignedFloatBuffer ResampledPCMData32;
+	ResampledPCMData32.Reserve((int32)Resampler.GetOutputNum(SamplesNum));
+	Resampler.Process(PCMData32.GetData(), SamplesNum, ResampledPCMData32);
+	Resampler.Flush(ResampledPCMData32);
+
+	OutPCMData.SetNumUninitialized(ResampledPCMData32.Num() * 2);
+	LocalTtsMath::FloatToInt16(ResampledPCMData32.GetData(), ResampledPCMData32.Num(), 1.f, (int16*)OutPCMData.GetData());
+	return true;
+}
+
+const FNNEModelTTS* ULocalTTSSubsystem::GetVoiceModel(const FNNMInstanceId& ModelID) const
+{
+	return VoiceModels.Find(ModelID.Id);
+}
+
+bool ULocalTTSSubsystem::IsVoiceModelValid(const FNNMInstanceId& ModelID) const
+{
+	return VoiceModels.Contains(ModelID.Id) && VoiceModels[ModelID.Id].bLoaded;
+}
+
+UTTSModelData_Base* ULocalTTSSubsystem::GetModelDataAsset(const FNNMInstanceId& ModelID) const
+{
+	const FNNEModelTTS* Model = VoiceModels.Find(ModelID.Id);
+	return Model ? Model->VoiceDesc : nullptr;
+}
+
+bool ULocalTTSSubsystem::ReleaseModel(const FNNMInstanceId& ModelTag)
+{
+	if (IsVoiceModelValid(ModelTag))
+	{
+		// Dictionary can be released if other voices don't use it
+		UTTSModelData_Base* ModelData = VoiceModels[ModelTag.Id].VoiceDesc;
+		if (IsValid(Phonemizer) && IsValid(ModelData) && ModelData->PhonemizationType == ETTSPhonemeType::PT_Dictionary)
+		{
+			Phonemizer->RemoveDictionaryUser(ModelData->GetEspeakCode(0), ModelTag.Id);
+		}
+
+		{
+			FScopeLock Lock(&VoiceModelPoolsLock);
+			VoiceModelPools.Remove(ModelTag.Id);
+		}
+		VoiceModels[ModelTag.Id].ModelInstance.Reset();
+		VoiceModels[ModelTag.Id].Model.Reset();
+		VoiceModels.Remove(ModelTag.Id);
+		return true;
+	}
+	return false;
+}
+
+bool ULocalTTSSubsystem::StartupDelayedInitialize_Internal(float DeltaTime)
+{
+	if (TickDelegateHandle.IsValid())
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(TickDelegateHandle);
+	}
+
+#if ESPEAK_NG
+	FString ContentPath = FLocalTTSModule::GetContentPath() / TEXT("NonUFS/espeak-ng-data");
+	UE_LOG(LogTemp, Log, TEXT("eSpeak data path: %s"), *ContentPath);
+	if (PlatformFileUtils::DirectoryExists(ContentPath))
+	{
+		auto ModuleTts = FModuleManager::GetModulePtr<FLocalTTSModule>(TEXT("LocalTTS"));
+		if (!ModuleTts->IsLoaded())
+		{
+			UE_LOG(LogTemp, Log, TEXT("eSpeak status: unexpected error."));
+			return false;
+		}
+
+#if PLATFORM_ANDROID
+		ContentPath = PlatformFileUtils::GetPlatformPath(ContentPath);
+#endif
+
+		int32 EspeakResult = ModuleTts->func_espeak_Initialize(AUDIO_OUTPUT_SYNCHRONOUS, 0, TCHAR_TO_ANSI(*ContentPath), 0);
+		UE_LOG(LogTemp, Log, TEXT("eSpeak initialization status: %d"), EspeakResult);
+		bEspeakStatus = EspeakResult > 0;
+	}
+	else
+	{
+		UE_LOG(LogTemp, Log, TEXT("eSpeak status: can't find content"));
+		bEspeakStatus = false;
+	}
+
+#else
+	if (bPhonemizerInitializing)
+	{
+		return true;
+	}
+
+	const UTtsSettings* Settings = UTtsSettings::Get();
+	if (Settings->PhonemizerInfo.IsNull())
+	{
+		return false;
+	}
+	if (Settings->PhonemizerEncoder.IsNull() || Settings->PhonemizerDecoder.IsNull())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UPhonemizer. Model Reference is not set, please assign it in the editor"));
+		return false;
+	}
+
+	bPhonemizerInitializing = true;
+	PhonemizerReadyPromise = MakeUnique<TPromise<bool>>();
+	PhonemizerReadyFuture = PhonemizerReadyPromise->GetFuture().Share();
+
+	// Load phonemizer and G2P models in background, NNE instances are created when everything is loaded
+	TArray<FSoftObjectPath> AssetPaths = { Settings->PhonemizerInfo.ToSoftObjectPath(), Settings->PhonemizerEncoder.ToSoftObjectPath(), Settings->PhonemizerDecoder.ToSoftObjectPath() };
+	if (!Settings->PhonemizerDecoderWithPast.IsNull())
+	{
+		AssetPaths.Add(Settings->PhonemizerDecoderWithPast.ToSoftObjectPath());
+	}
+	for (const auto& Lexicon : Settings->Lexicons)
+	{
+		if (!Lexicon.IsNull())
+		{
+			AssetPaths.Add(Lexicon.ToSoftObjectPath());
+		}
+	}
+
+	PendingPhonemizerAssets.Reset();
+	PendingPhonemizerAssetsNum = AssetPaths.Num();
+	for (const FSoftObjectPath& AssetPath : AssetPaths)
+	{
+		AssetPath.LoadAsync(FLoadSoftObjectPathAsyncDelegate::CreateUObject(this, &ULocalTTSSubsystem::OnPhonemizerAssetLoaded_Internal));
+	}
+
+	return true;
+#endif
+
+	return bEspeakStatus;
+}
+
+bool ULocalTTSSubsystem::IsPhonemizerReady() const
+{
+	return bEspeakStatus && !bPhonemizerInitializing;
+}
+
+void ULocalTTSSubsystem::OnPhonemizerAssetLoaded_Internal(const FSoftObjectPath& AssetPath, UObject* LoadedAsset)
+{
+	if (IsValid(LoadedAsset))
+	{
+		PendingPhonemizerAssets.Add(LoadedAsset);
+	}
+	else
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Couldn't load phonemizer asset %s"), *AssetPath.ToString());
+	}
+
+	PendingPhonemizerAssetsNum--;
+	if (PendingPhonemizerAssetsNum > 0)
+	{
+		return;
+	}
+
+	const UTtsSettings* Settings = UTtsSettings::Get();
+	UPhonemizer* NewPhonemizer = Settings->PhonemizerInfo.Get();
+	UNNEModelData* EncoderAsset = Settings->PhonemizerEncoder.Get();
+	UNNEModelData* DecoderAsset = Settings->PhonemizerDecoder.Get();
+	UNNEModelData* DecoderWithPastAsset = Settings->PhonemizerDecoderWithPast.Get();
+	if (!IsValid(NewPhonemizer) || !IsValid(EncoderAsset) || !IsValid(DecoderAsset))
+	{
+		OnPhonemizerInitialized_Internal(false);
+		return;
+	}
+
+	// Create NNE instances: the phonemizer isn't used until it's published on the game thread
+	AsyncTask(ENamedThreads::AnyThread, [this, NewPhonemizer, EncoderAsset, DecoderAsset, DecoderWithPastAsset]()
+	{
+		const bool bResult = NewPhonemizer->InitializeModels(EncoderAsset, DecoderAsset);
+		if (bResult && DecoderWithPastAsset)
+		{
+			NewPhonemizer->InitializeCachedDecoder(DecoderWithPastAsset);
+		}
+
+		AsyncTask(ENamedThreads::GameThread, [this, NewPhonemizer, bResult]()
+		{
+			if (bResult)
+			{
+				Phonemizer = NewPhonemizer;
+			}
+			OnPhonemizerInitialized_Internal(bResult);
+		});
+	});
+}
+
+void ULocalTTSSubsystem::OnPhonemizerInitialized_Internal(bool bResult)
+{
+	UE_LOG(LogTemp, Log, TEXT("Phonemizer initialization status: %d"), bResult);
+
+	bEspeakStatus = bResult;
+	bPhonemizerInitializing = false;
+	PendingPhonemizerAssets.Empty();
+	if (PhonemizerReadyPromise.IsValid())
+	{
+		PhonemizerReadyPromise->SetValue(bResult);
+		PhonemizerReadyPromise.Reset();
+	}
+
+	// Load dictionaries for the models which were loaded before phonemizer
+	if (IsValid(Phonemizer))
+	{
+		for (const auto& Lexicon : UTtsSettings::Get()->Lexicons)
+		{
+			Phonemizer->AddLexicon(Lexicon.Get());
+		}
+
+		for (const auto& Model : VoiceModels)
+		{
+			UTTSModelData_Base* ModelData = Model.Value.VoiceDesc;
+			if (IsValid(ModelData) && ModelData->PhonemizationType == ETTSPhonemeType::PT_Dictionary)
+			{
+				Phonemizer->AddDictionaryUser(ModelData->GetEspeakCode(0), Model.Key);
+			}
+		}
+
+		if (!DictionariesTickHandle.IsValid())
+		{
+			DictionariesTickHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &ULocalTTSSubsystem::UpdateDictionaries_Internal), 1.f);
+		}
+	}
+
+	// Process requests queued during initialization
+	if (!bIsWorking && !RequestsQueue.IsEmpty())
+	{
+		RequestsQueue.Dequeue(ActiveRequest);
+		Inference();
+	}
+}
+
+bool ULocalTTSSubsystem::UpdateDictionaries_Internal(float DeltaTime)
+{
+	if (IsValid(Phonemizer))
+	{
+		Phonemizer->UpdateDictionaries();
+	}
+	return true;
+}
+
+void ULocalTTSSubsystem::OnModelLoadingComplete_Internal(bool bResult)
+{
+	if (IsInGameThread())
+	{
+		bIsLoading = false;
+		OnnxLoadMutex.Unlock();
+		OnLastLoadCallback.ExecuteIfBound(LastAddedModelTag, bResult);
+		
+		// Try to load dictionary beforehand
+		if (IsValid(Phonemizer))
+		{
+			if (VoiceModels.Contains(LastAddedModelTag.Id))
+			{
+				UTTSModelData_Base* ModelData = VoiceModels[LastAddedModelTag.Id].VoiceDesc;
+				if (IsValid(ModelData) && ModelData->PhonemizationType == ETTSPhonemeType::PT_Dictionary)
+				{
+					Phonemizer->AddDictionaryUser(ModelData->GetEspeakCode(0), LastAddedModelTag.Id);
+				}
+			}
+		}
+	}
+	else
+	{
+		AsyncTask(ENamedThreads::GameThread, [this, bResult]()
+		{
+			bIsLoading = false;
+			OnnxLoadMutex.Unlock();
+			OnLastLoadCallback.ExecuteIfBound(LastAddedModelTag, bResult);
+		});
+	}
+}
+
+void ULocalTTSSubsystem::OnGenerationComplete_Internal(bool bResult)
+{
+	if (bResult)
+	{
+		auto& VModel = VoiceModels[SynthResult.ModelTag.Id];
+
+		const UTtsSettings* Settings = UTtsSettings::Get();
+		const bool bFloatOutput = SynthResult.PCMData16.IsEmpty() && !SynthResult.PCMData32.IsEmpty();
+		if (Settings->bSaveCachedWav)
+		{
+			if (bFloatOutput)
+			{
+				SynthResult.PCMData16.SetNumUninitialized(SynthResult.PCMData32.Num() * 2);
+				LocalTtsMath::FloatToInt16(SynthResult.PCMData32.GetData(), SynthResult.PCMData32.Num(), 32767.0f, (int16*)SynthResult.PCMData16.GetData());
+			}
+
+			FString Path = FPaths::ProjectDir() / TEXT("Saved") / TEXT("CacheTTS");
+			if (!FPaths::DirectoryExists(Path))
+			{
+				IFileManager::Get().MakeDirectory(*Path);
+			}
+			FString StrDate = FDateTime::Now().ToFormattedString(TEXT("%Y-%m-%d-%H-%M-%S"));
+			FString FileName = Path / TEXT("tts-") + StrDate + TEXT(".wav");
+
+			// Saved files use TargetSampleRate even if audio is played at the native rate
+			TArray<uint8> ResampledPCMData;
+			if (Settings->bResampleSynthesizedAudio && SynthResult.SampleRate != Settings->TargetSampleRate
+				&& ResamplePCMData16_Internal(SynthResult.PCMData16, SynthResult.SampleRate, Settings->TargetSampleRate, ResampledPCMData))
+			{
+				ULocalTTSFunctionLibrary::SaveAudioDataToFile(ResampledPCMData, 1, Settings->TargetSampleRate, FileName);
+			}
+			else
+			{
+				ULocalTTSFunctionLibrary::SaveAudioDataToFile(SynthResult.PCMData16, 1, SynthResult.SampleRate, FileName);
+			}
+		}
+
+		if (StreamingSoundWave)
+		{
+			// Already passed to callback when synthesis started
+			StreamingSoundWave = nullptr;
+		}
+		else
+		{
+			UTTSSoundWaveRuntime* VoiceSoundWave = NewObject<UTTSSoundWaveRuntime>();
+			if (IsValid(VoiceSoundWave))
+			{
+				VoiceSoundWave->bProcedural = true;
+				VoiceSoundWave->bLooping = false;
+				VoiceSoundWave->SetSampleRate(SynthResult.SampleRate);
+				VoiceSoundWave->NumChannels = 1;
+				if (bFloatOutput)
+				{
+					VoiceSoundWave->InitializeAudioFloat(MoveTemp(SynthResult.PCMData32));
+				}
+				else
+				{
+					VoiceSoundWave->InitializeAudio(SynthResult.PCMData16.GetData(), SynthResult.PCMData16.Num());
+				}
+				ActiveRequest.Callback.ExecuteIfBound(VoiceSoundWave);
+			}
+			OnGenerationResult.Broadcast(SynthResult.ModelTag, VoiceSoundWave);
+		}
+
+		VModel.OutputData.Empty();
+		SynthResult.PCMData16.Empty();
+		SynthResult.PCMData32.Empty();
+	}
+	else
+	{
+		// Streamed sound wave which was already passed to the callback just stops after the audio synthesized so far
+		if (StreamingSoundWave)
+		{
+			StreamingSoundWave->FinishStream();
+			StreamingSoundWave = nullptr;
+		}
+		if (!bStreamingSoundWaveDelivered)
+		{
+			ActiveRequest.Callback.ExecuteIfBound(nullptr);
+		}
+	}
+
+	bIsWorking = false;
+	if (!RequestsQueue.IsEmpty())
+	{
+		RequestsQueue.Dequeue(ActiveRequest);
+		Inference();
+	}
+}
+
+void ULocalTTSSubsystem::Cleanup()
+{
+	if (DictionariesTickHandle.IsValid())
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(DictionariesTickHandle);
+		DictionariesTickHandle.Reset();
+	}
+
+	if (PhonemizerReadyPromise.IsValid())
+	{
+		PhonemizerReadyPromise->SetValue(false);
+		PhonemizerReadyPromise.Reset();
+	}
+
+	if (bEspeakStatus)
+	{
+		auto ModuleTts = FModuleManager::GetModulePtr<FLocalTTSModule>(TEXT("LocalTTS"));
+		if (ModuleTts->IsLoaded())
+		{
+			ModuleTts->func_espeak_Terminate();
+		}
+	}
+
+	{
+		FScopeLock Lock(&VoiceModelPoolsLock);
+		VoiceModelPools.Empty();
+	}
+	for (auto& Model : VoiceModels)
+	{
+		Model.Value.ModelInstance.Reset();
+		Model.Value.Model.Reset();
+	}
+	VoiceModels.Empty();
+}
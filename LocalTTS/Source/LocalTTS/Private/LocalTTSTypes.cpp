@@ -1,171 +1,407 @@
-﻿// (c) Yuri N. K. 2025. All rights reserved.
-// ykasczc@gmail.com
-
-#include "LocalTTSTypes.h"
-#include "TTSModelData_Base.h"
-#include "LocalTTSSubsystem.h"
-#include "NNERuntimeCPU.h"
-#include "Misc/Paths.h"
-
-#if PLATFORM_ANDROID
-#include <filesystem>
-#include "GenericPlatform/GenericPlatformFile.h"
-#include "HAL/PlatformProcess.h"
-#include "Android/AndroidPlatformFile.h"
-#include "Misc/App.h"
-#endif
-
-TArray<int64>& FNNEModelTTS::GetInParamIntUnsafe(const int32 Index)
-{
-    return InputDataInt64[InputMap[Index].ArrayIndex];
-}
-
-TArray<float>& FNNEModelTTS::GetInParamFloatUnsafe(const int32 Index)
-{
-    return InputDataFloat[InputMap[Index].ArrayIndex];
-}
-
-bool FNNEModelTTS::CheckInParam(const int32 Index, ENNETensorDataType Type) const
-{
-    return InputMap.IsValidIndex(Index) && InputMap[Index].Format == Type;
-}
-
-void FNNEModelTTS::PrepareOutputBuffer(int32 Size)
-{
-	OutputData.SetNumUninitialized(Size);
-	OutputBindings.SetNumZeroed(1);
-	OutputBindings[0].Data = OutputData.GetData();
-	OutputBindings[0].SizeInBytes = Size * sizeof(float);
-}
-
-bool FNNEModelTTS::PrepareInputFloat(int32 Index, const TArray<float>& Data, const TArrayView<const uint32>& Shape)
-{
-	if (!CheckInParam(Index, ENNETensorDataType::Float))
-	{
-		return false;
-	}
-
-	// input
-	TArray<float>& Inputs = GetInParamFloatUnsafe(Index);
-
-	Inputs.SetNumUninitialized(Data.Num());
-	FMemory::Memcpy(Inputs.GetData(), Data.GetData(), Data.Num() * (int32)sizeof(float));
-	InputBindings[Index].SizeInBytes = (uint64)Inputs.Num() * sizeof(float);
-	InputBindings[Index].Data = Inputs.GetData();
-
-	InputTensorShapes[Index] = UE::NNE::FTensorShape::Make(Shape);
-
-	return true;
-}
-
-bool FNNEModelTTS::PrepareInputInt64(int32 Index, const TArray<int64>& Data, const TArrayView<const uint32>& Shape)
-{
-	if (!CheckInParam(Index, ENNETensorDataType::Int64))
-	{
-		return false;
-	}
-
-	// input
-	TArray<int64>& Inputs = GetInParamIntUnsafe(Index);
-
-	Inputs.SetNumUninitialized(Data.Num());
-	FMemory::Memcpy(Inputs.GetData(), Data.GetData(), Data.Num() * (int32)sizeof(int64));
-	InputBindings[Index].SizeInBytes = (uint64)Inputs.Num() * sizeof(int64);
-	InputBindings[Index].Data = Inputs.GetData();
-
-	InputTensorShapes[Index] = UE::NNE::FTensorShape::Make(Shape);
-
-	return true;
-}
-
-bool FNNEModelTTS::RunNNE(TArray<float>& OutData, TArray<uint32>& OutDataShape, bool bReturnData)
-{
-	// Ensure we applied input tensor shapes
-	ModelInstance->SetInputTensorShapes(InputTensorShapes);
-
-	if (InputBindings.Num() != InputTensorShapes.Num())
-	{
-		UE_LOG(LogTemp, Warning, TEXT("Invalid NNE input setup: input tensors num (%d) doesn't match input tensor shapes (%d)"), InputBindings.Num(), InputTensorShapes.Num());
-		return false;
-	}
-
-	// run
-	UE::NNE::IModelInstanceRunSync::ERunSyncStatus RunStatus = ModelInstance->RunSync(InputBindings, OutputBindings);
-	if (RunStatus == UE::NNE::IModelInstanceRunSync::ERunSyncStatus::Fail)
-	{
-		return false;
-	}
-
-	// get output data
-	const auto EncoderOutputsShape = ModelInstance->GetOutputTensorShapes().GetData();
-	int32 GeneratedSamplesNum = EncoderOutputsShape->Volume();
-	if (GeneratedSamplesNum > OutputData.Num())
-	{
-#if WITH_EDITOR
-		FString OutShape = LocalTtsUtils::PrintArray(EncoderOutputsShape->GetData());
-		UE_LOG(LogTemp, Error, TEXT("RunNNE: output buffer size (%d) is smaller then NNM output volume %d, shape (%s). Data is corrupted."), OutputData.Num(), GeneratedSamplesNum, *OutShape);
-#endif
-		return false;
-	}
-
-	if (bReturnData)
-	{
-		OutData.SetNumUninitialized(GeneratedSamplesNum);
-		FMemory::Memcpy(OutData.GetData(), OutputData.GetData(), GeneratedSamplesNum * (int32)sizeof(float));
-	}
-	OutDataShape = EncoderOutputsShape->GetData();
-
-	return true;
-}
-
-void PlatformFileUtils::NormalizePath(FString& Path)
-{
-	Path.ReplaceInline(TEXT("\\"), TEXT("/"), ESearchCase::CaseSensitive);
-	Path.ReplaceInline(TEXT("//"), TEXT("/"), ESearchCase::CaseSensitive);
-	Path.ReplaceInline(TEXT("/./"), TEXT("/"), ESearchCase::CaseSensitive);
-}
-
-FString PlatformFileUtils::GetPlatformPath(FString Path)
-{
-	NormalizePath(Path);
-
-#if PLATFORM_ANDROID
-	auto& PlatformFile = IAndroidPlatformFile::GetPlatformPhysical();
-
-	while (Path.StartsWith(TEXT("../"), ESearchCase::CaseSensitive))
-	{
-		Path.RightChopInline(3, EAllowShrinking::No);
-	}
-	Path.ReplaceInline(FPlatformProcess::BaseDir(), TEXT(""));
-	if (Path.Equals(TEXT(".."), ESearchCase::CaseSensitive))
-	{
-		Path = TEXT("");
-	}
-
-	FString BasePath = PlatformFile.ConvertToAbsolutePathForExternalAppForRead(TEXT("../"));
-	// Avoid duplication
-	if (!Path.StartsWith(BasePath))
-	{
-		Path = BasePath / Path;
-	}
-
-	NormalizePath(Path);
-	return Path;
-#else
-	return FPaths::ConvertRelativePathToFull(Path);
-#endif
-}
-
-bool PlatformFileUtils::DirectoryExists(const FString& Dir)
-{
-#if PLATFORM_ANDROID
-	FString d = PlatformFileUtils::GetPlatformPath(Dir);
-	if (d.EndsWith(TEXT("/")))
-	{
-		d.LeftChopInline(1);
-	}
-	return std::filesystem::exists(TCHAR_TO_ANSI(*d));
-#else
-	return FPaths::DirectoryExists(Dir);
-#endif
+﻿// (c) Yuri N. K. 2025. All rights reserved.
+// ykasczc@gmail.com
+
+#include "LocalTTSTypes.h"
+#include "TTSModelData_Base.h"
+#include "LocalTTSSubsystem.h"
+#include "NNERuntimeCPU.h"
+#include "Misc/Paths.h"
+
+#if PLATFORM_ANDROID
+#include <filesystem>
+#include "GenericPlatform/GenericPlatformFile.h"
+#include "HAL/PlatformProcess.h"
+#include "Android/AndroidPlatformFile.h"
+#include "Misc/App.h"
+#endif
+
+TArray<int64>& FNNEModelTTS::GetInParamIntUnsafe(const int32 Index)
+{
+    return InputDataInt64[InputMap[Index].ArrayIndex];
+}
+
+TArray<float>& FNNEModelTTS::GetInParamFloatUnsafe(const int32 Index)
+{
+    return InputDataFloat[InputMap[Index].ArrayIndex];
+}
+
+bool FNNEModelTTS::CheckInParam(const int32 Index, ENNETensorDataType Type) const
+{
+    return InputMap.IsValidIndex(Index) && InputMap[Index].Format == Type;
+}
+
+void FNNEModelTTS::PrepareOutputBuffer(int32 Size)
+{
+	OutputData.SetNumUninitialized(Size);
+	if (OutputBindings.IsEmpty())
+	{
+		OutputBindings.SetNumZeroed(1);
+	}
+	OutputBindings[0].Data = OutputData.GetData();
+	OutputBindings[0].SizeInBytes = Size * sizeof(float);
+}
+
+void FNNEModelTTS::PrepareExtraOutputBuffer(int32 OutputIndex, int32 Size)
+{
+	check(OutputIndex > 0 && ExtraOutputData.IsValidIndex(OutputIndex - 1));
+
+	TArray<float>& Outputs = ExtraOutputData[OutputIndex - 1];
+	Outputs.SetNumUninitialized(Size, EAllowShrinking::No);
+	OutputBindings[OutputIndex].Data = Outputs.GetData();
+	OutputBindings[OutputIndex].SizeInBytes = (uint64)Size * sizeof(float);
+}
+
+bool FNNEModelTTS::PrepareInputFloat(int32 Index, const TArray<float>& Data, const TArrayView<const uint32>& Shape)
+{
+	return PrepareInputFloat(Index, Data.GetData(), Data.Num(), Shape);
+}
+
+bool FNNEModelTTS::PrepareInputFloat(int32 Index, const float* Data, int32 Num, const TArrayView<const uint32>& Shape)
+{
+	if (!CheckInParam(Index, ENNETensorDataType::Float))
+	{
+		return false;
+	}
+
+	// input
+	TArray<float>& Inputs = GetInParamFloatUnsafe(Index);
+
+	Inputs.SetNumUninitialized(Num);
+	FMemory::Memcpy(Inputs.GetData(), Data, Num * (int32)sizeof(float));
+	InputBindings[Index].SizeInBytes = (uint64)Inputs.Num() * sizeof(float);
+	InputBindings[Index].Data = Inputs.GetData();
+
+	InputTensorShapes[Index] = UE::NNE::FTensorShape::Make(Shape);
+
+	return true;
+}
+
+bool FNNEModelTTS::PrepareInputInt64(int32 Index, const TArray<int64>& Data, const TArrayView<const uint32>& Shape)
+{
+	if (!CheckInParam(Index, ENNETensorDataType::Int64))
+	{
+		return false;
+	}
+
+	// input
+	TArray<int64>& Inputs = GetInParamIntUnsafe(Index);
+
+	Inputs.SetNumUninitialized(Data.Num());
+	FMemory::Memcpy(Inputs.GetData(), Data.GetData(), Data.Num() * (int32)sizeof(int64));
+	InputBindings[Index].SizeInBytes = (uint64)Inputs.Num() * sizeof(int64);
+	InputBindings[Index].Data = Inputs.GetData();
+
+	InputTensorShapes[Index] = UE::NNE::FTensorShape::Make(Shape);
+
+	return true;
+}
+
+bool FNNEModelTTS::BindInputFloat(int32 Index, float* Data, int64 Num, const TArrayView<const uint32>& Shape)
+{
+	if (!CheckInParam(Index, ENNETensorDataType::Float))
+	{
+		return false;
+	}
+
+	InputBindings[Index].SizeInBytes = (uint64)Num * sizeof(float);
+	InputBindings[Index].Data = Data;
+	InputTensorShapes[Index] = UE::NNE::FTensorShape::Make(Shape);
+
+	return true;
+}
+
+bool FNNEModelTTS::BindInputInt64(int32 Index, int64* Data, int64 Num, const TArrayView<const uint32>& Shape)
+{
+	if (!CheckInParam(Index, ENNETensorDataType::Int64))
+	{
+		return false;
+	}
+
+	InputBindings[Index].SizeInBytes = (uint64)Num * sizeof(int64);
+	InputBindings[Index].Data = Data;
+	InputTensorShapes[Index] = UE::NNE::FTensorShape::Make(Shape);
+
+	return true;
+}
+
+bool FNNEModelTTS::RunNNE(TArray<float>& OutData, TArray<uint32>& OutDataShape, bool bReturnData)
+{
+	// Ensure we applied input tensor shapes
+	ModelInstance->SetInputTensorShapes(InputTensorShapes);
+
+	if (InputBindings.Num() != InputTensorShapes.Num())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Invalid NNE input setup: input tensors num (%d) doesn't match input tensor shapes (%d)"), InputBindings.Num(), InputTensorShapes.Num());
+		return false;
+	}
+
+	// run
+	UE::NNE::IModelInstanceRunSync::ERunSyncStatus RunStatus = ModelInstance->RunSync(InputBindings, OutputBindings);
+	if (RunStatus == UE::NNE::IModelInstanceRunSync::ERunSyncStatus::Fail)
+	{
+		return false;
+	}
+
+	// get output data
+	const auto EncoderOutputsShape = ModelInstance->GetOutputTensorShapes().GetData();
+	int32 GeneratedSamplesNum = EncoderOutputsShape->Volume();
+	if (GeneratedSamplesNum > OutputData.Num())
+	{
+#if WITH_EDITOR
+		FString OutShape = LocalTtsUtils::PrintArray(EncoderOutputsShape->GetData());
+		UE_LOG(LogTemp, Error, TEXT("RunNNE: output buffer size (%d) is smaller then NNM output volume %d, shape (%s). Data is corrupted."), OutputData.Num(), GeneratedSamplesNum, *OutShape);
+#endif
+		return false;
+	}
+
+	if (bReturnData)
+	{
+		OutData.SetNumUninitialized(GeneratedSamplesNum);
+		FMemory::Memcpy(OutData.GetData(), OutputData.GetData(), GeneratedSamplesNum * (int32)sizeof(float));
+	}
+	OutDataShape = EncoderOutputsShape->GetData();
+
+	return true;
+}
+
+int32 LocalTtsMath::ArgMax(const float* Data, int32 Num)
+{
+	if (Num <= 0)
+	{
+		return INDEX_NONE;
+	}
+
+	// Max value: 4 floats per iteration
+	int32 i = 0;
+	float MaxVal = Data[0];
+	if (Num >= 8)
+	{
+		VectorRegister4Float VMax = VectorLoad(Data);
+		for (i = 4; i + 4 <= Num; i += 4)
+		{
+			VMax = VectorMax(VMax, VectorLoad(Data + i));
+		}
+
+		alignas(16) float Lanes[4];
+		VectorStoreAligned(VMax, Lanes);
+		MaxVal = FMath::Max(FMath::Max(Lanes[0], Lanes[1]), FMath::Max(Lanes[2], Lanes[3]));
+	}
+	for (; i < Num; i++)
+	{
+		MaxVal = FMath::Max(MaxVal, Data[i]);
+	}
+
+	// First index of max value
+	const VectorRegister4Float VMaxVal = VectorSetFloat1(MaxVal);
+	for (i = 0; i + 4 <= Num; i += 4)
+	{
+		const int32 Mask = VectorMaskBits(VectorCompareEQ(VectorLoad(Data + i), VMaxVal));
+		if (Mask != 0)
+		{
+			return i + (int32)FMath::CountTrailingZeros((uint32)Mask);
+		}
+	}
+	for (; i < Num; i++)
+	{
+		if (Data[i] == MaxVal)
+		{
+			return i;
+		}
+	}
+
+	return 0;
+}
+
+float LocalTtsMath::AbsMax(const float* Data, int32 Num)
+{
+	int32 i = 0;
+	float MaxVal = 0.f;
+	if (Num >= 8)
+	{
+		// Two accumulators to hide latency of VectorMax
+		VectorRegister4Float VMax0 = VectorZeroFloat();
+		VectorRegister4Float VMax1 = VectorZeroFloat();
+		for (; i + 8 <= Num; i += 8)
+		{
+			VMax0 = VectorMax(VMax0, VectorAbs(VectorLoad(Data + i)));
+			VMax1 = VectorMax(VMax1, VectorAbs(VectorLoad(Data + i + 4)));
+		}
+
+		alignas(16) float Lanes[4];
+		VectorStoreAligned(VectorMax(VMax0, VMax1), Lanes);
+		MaxVal = FMath::Max(FMath::Max(Lanes[0], Lanes[1]), FMath::Max(Lanes[2], Lanes[3]));
+	}
+	for (; i < Num; i++)
+	{
+		MaxVal = FMath::Max(MaxVal, FMath::Abs(Data[i]));
+	}
+
+	return MaxVal;
+}
+
+float LocalTtsMath::CopyAbsMax(const float* Data, int32 Num, float* Out)
+{
+	int32 i = 0;
+	float MaxVal = 0.f;
+	if (Num >= 8)
+	{
+		VectorRegister4Float VMax0 = VectorZeroFloat();
+		VectorRegister4Float VMax1 = VectorZeroFloat();
+		for (; i + 8 <= Num; i += 8)
+		{
+			const VectorRegister4Float V0 = VectorLoad(Data + i);
+			const VectorRegister4Float V1 = VectorLoad(Data + i + 4);
+			VectorStore(V0, Out + i);
+			VectorStore(V1, Out + i + 4);
+			VMax0 = VectorMax(VMax0, VectorAbs(V0));
+			VMax1 = VectorMax(VMax1, VectorAbs(V1));
+		}
+
+		alignas(16) float Lanes[4];
+		VectorStoreAligned(VectorMax(VMax0, VMax1), Lanes);
+		MaxVal = FMath::Max(FMath::Max(Lanes[0], Lanes[1]), FMath::Max(Lanes[2], Lanes[3]));
+	}
+	for (; i < Num; i++)
+	{
+		Out[i] = Data[i];
+		MaxVal = FMath::Max(MaxVal, FMath::Abs(Data[i]));
+	}
+
+	return MaxVal;
+}
+
+float LocalTtsMath::SumOfSquares(const float* Data, int32 Num)
+{
+	int32 i = 0;
+	float Sum = 0.f;
+	if (Num >= 8)
+	{
+		VectorRegister4Float VSum0 = VectorZeroFloat();
+		VectorRegister4Float VSum1 = VectorZeroFloat();
+		for (; i + 8 <= Num; i += 8)
+		{
+			const VectorRegister4Float V0 = VectorLoad(Data + i);
+			const VectorRegister4Float V1 = VectorLoad(Data + i + 4);
+			VSum0 = VectorMultiplyAdd(V0, V0, VSum0);
+			VSum1 = VectorMultiplyAdd(V1, V1, VSum1);
+		}
+
+		alignas(16) float Lanes[4];
+		VectorStoreAligned(VectorAdd(VSum0, VSum1), Lanes);
+		Sum = (Lanes[0] + Lanes[1]) + (Lanes[2] + Lanes[3]);
+	}
+	for (; i < Num; i++)
+	{
+		Sum += Data[i] * Data[i];
+	}
+
+	return Sum;
+}
+
+void LocalTtsMath::FloatToInt16(const float* Data, int32 Num, float Scale, int16* Out)
+{
+	int32 i = 0;
+
+	// 8 samples per iteration: scale, clamp, truncate and pack with saturation
+	const VectorRegister4Float VScale = VectorSetFloat1(Scale);
+	const VectorRegister4Float VMin = VectorSetFloat1(-32768.f);
+	const VectorRegister4Float VMax = VectorSetFloat1(32767.f);
+	for (; i + 8 <= Num; i += 8)
+	{
+		const VectorRegister4Float V0 = VectorMin(VectorMax(VectorMultiply(VectorLoad(Data + i), VScale), VMin), VMax);
+		const VectorRegister4Float V1 = VectorMin(VectorMax(VectorMultiply(VectorLoad(Data + i + 4), VScale), VMin), VMax);
+		const VectorRegister4Int I0 = VectorFloatToInt(V0);
+		const VectorRegister4Int I1 = VectorFloatToInt(V1);
+#if PLATFORM_ENABLE_VECTORINTRINSICS_NEON
+		vst1q_s16(Out + i, vcombine_s16(vqmovn_s32(I0), vqmovn_s32(I1)));
+#elif PLATFORM_ENABLE_VECTORINTRINSICS
+		_mm_storeu_si128((__m128i*)(Out + i), _mm_packs_epi32(I0, I1));
+#else
+		alignas(16) int32 Lanes[8];
+		VectorIntStoreAligned(I0, Lanes);
+		VectorIntStoreAligned(I1, Lanes + 4);
+		for (int32 Lane = 0; Lane < 8; Lane++)
+		{
+			Out[i + Lane] = (int16)Lanes[Lane];
+		}
+#endif
+	}
+	for (; i < Num; i++)
+	{
+		Out[i] = (int16)FMath::TruncToInt(FMath::Clamp(Data[i] * Scale, -32768.f, 32767.f));
+	}
+}
+
+void LocalTtsMath::NormalizeToInt16(const float* Data, int32 Num, float MinPeak, int16* Out)
+{
+	const float Peak = FMath::Max(MinPeak, AbsMax(Data, Num));
+	FloatToInt16(Data, Num, 32767.f / Peak, Out);
+}
+
+void LocalTtsMath::NormalizeInPlace(float* Data, int32 Num, float MinPeak)
+{
+	const float Scale = 1.f / FMath::Max(MinPeak, AbsMax(Data, Num));
+	const VectorRegister4Float VScale = VectorSetFloat1(Scale);
+
+	int32 i = 0;
+	for (; i + 4 <= Num; i += 4)
+	{
+		VectorStore(VectorMultiply(VectorLoad(Data + i), VScale), Data + i);
+	}
+	for (; i < Num; i++)
+	{
+		Data[i] *= Scale;
+	}
+}
+
+void PlatformFileUtils::NormalizePath(FString& Path)
+{
+	Path.ReplaceInline(TEXT("\\"), TEXT("/"), ESearchCase::CaseSensitive);
+	Path.ReplaceInline(TEXT("//"), TEXT("/"), ESearchCase::CaseSensitive);
+	Path.ReplaceInline(TEXT("/./"), TEXT("/"), ESearchCase::CaseSensitive);
+}
+
+FString PlatformFileUtils::GetPlatformPath(FString Path)
+{
+	NormalizePath(Path);
+
+#if PLATFORM_ANDROID
+	auto& PlatformFile = IAndroidPlatformFile::GetPlatformPhysical();
+
+	while (Path.StartsWith(TEXT("../"), ESearchCase::CaseSensitive))
+	{
+		Path.RightChopInline(3, EAllowShrinking::No);
+	}
+	Path.ReplaceInline(FPlatformProcess::BaseDir(), TEXT(""));
+	if (Path.Equals(TEXT(".."), ESearchCase::CaseSensitive))
+	{
+		Path = TEXT("");
+	}
+
+	FString BasePath = PlatformFile.ConvertToAbsolutePathForExternalAppForRead(TEXT("../"));
+	// Avoid duplication
+	if (!Path.StartsWith(BasePath))
+	{
+		Path = BasePath / Path;
+	}
+
+	NormalizePath(Path);
+	return Path;
+#else
+	return FPaths::ConvertRelativePathToFull(Path);
+#endif
+}
+
+bool PlatformFileUtils::DirectoryExists(const FString& Dir)
+{
+#if PLATFORM_ANDROID
+	FString d = PlatformFileUtils::GetPlatformPath(Dir);
+	if (d.EndsWith(TEXT("/")))
+	{
+		d.LeftChopInline(1);
+	}
+	return std::filesystem::exists(TCHAR_TO_ANSI(*d));
+#else
+	return FPaths::DirectoryExists(Dir);
+#endif
 }
\ No newline at end of file
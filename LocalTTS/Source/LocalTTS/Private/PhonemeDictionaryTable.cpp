@@ -0,0 +1,442 @@
+// (c) Yuri N. K. 2025. All rights reserved.
+// ykasczc@gmail.com
+
+#include "PhonemeDictionaryTable.h"
+#include "Async/ParallelFor.h"
+#include "uni_algo.h"
+#include <string>
+
+namespace PhonemeDictionary
+{
+	// Lowercase single code point (same as FString::ToLower for BMP)
+	FORCEINLINE uint32 FoldCodepoint(uint32 Codepoint)
+	{
+		return Codepoint <= 0xFFFF ? (uint32)FChar::ToLower((TCHAR)Codepoint) : Codepoint;
+	}
+
+	// Append code point to UTF-8 buffer, returns false if it doesn't fit
+	FORCEINLINE bool AppendUtf8(uint32 Codepoint, UTF8CHAR* Out, int32& Len)
+	{
+		if (Codepoint < 0x80)
+		{
+			if (Len + 1 > FPhonemeDictionaryTable::MaxKeyBytes) return false;
+			Out[Len++] = (UTF8CHAR)Codepoint;
+		}
+		else if (Codepoint < 0x800)
+		{
+			if (Len + 2 > FPhonemeDictionaryTable::MaxKeyBytes) return false;
+			Out[Len++] = (UTF8CHAR)(0xC0 | (Codepoint >> 6));
+			Out[Len++] = (UTF8CHAR)(0x80 | (Codepoint & 0x3F));
+		}
+		else if (Codepoint < 0x10000)
+		{
+			if (Len + 3 > FPhonemeDictionaryTable::MaxKeyBytes) return false;
+			Out[Len++] = (UTF8CHAR)(0xE0 | (Codepoint >> 12));
+			Out[Len++] = (UTF8CHAR)(0x80 | ((Codepoint >> 6) & 0x3F));
+			Out[Len++] = (UTF8CHAR)(0x80 | (Codepoint & 0x3F));
+		}
+		else
+		{
+			if (Len + 4 > FPhonemeDictionaryTable::MaxKeyBytes) return false;
+			Out[Len++] = (UTF8CHAR)(0xF0 | (Codepoint >> 18));
+			Out[Len++] = (UTF8CHAR)(0x80 | ((Codepoint >> 12) & 0x3F));
+			Out[Len++] = (UTF8CHAR)(0x80 | ((Codepoint >> 6) & 0x3F));
+			Out[Len++] = (UTF8CHAR)(0x80 | (Codepoint & 0x3F));
+		}
+		return true;
+	}
+
+	// Decode next code point from UTF-8 string, invalid bytes are returned as is
+	FORCEINLINE uint32 DecodeUtf8(const UTF8CHAR* Data, int32 Len, int32& Index)
+	{
+		const uint8 Lead = (uint8)Data[Index++];
+		int32 Extra = Lead >= 0xF0 ? 3 : Lead >= 0xE0 ? 2 : Lead >= 0xC0 ? 1 : 0;
+		if (Index + Extra > Len)
+		{
+			return Lead;
+		}
+		uint32 Codepoint = Extra == 0 ? Lead : Lead & (0x3F >> Extra);
+		while (Extra-- > 0)
+		{
+			Codepoint = (Codepoint << 6) | ((uint8)Data[Index++] & 0x3F);
+		}
+		return Codepoint;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------
+
+bool FPhonemeDictionaryTable::Initialize(TArray64<uint8>&& InData)
+{
+	Reset();
+	if (!SetData(InData.GetData(), InData.Num()))
+	{
+		return false;
+	}
+	// Moving TArray keeps the same allocation
+	Data = MoveTemp(InData);
+	return true;
+}
+
+bool FPhonemeDictionaryTable::InitializeFromRawMemory(void* InData, int64 InSize)
+{
+	Reset();
+	if (!SetData((const uint8*)InData, InSize))
+	{
+		FMemory::Free(InData);
+		return false;
+	}
+	RawMemory = InData;
+	return true;
+}
+
+bool FPhonemeDictionaryTable::InitializeView(const uint8* InData, int64 InSize)
+{
+	Reset();
+	return SetData(InData, InSize);
+}
+
+bool FPhonemeDictionaryTable::SetData(const uint8* InData, int64 InSize)
+{
+	if (!InData || InSize < (int64)sizeof(FHeader))
+	{
+		return false;
+	}
+
+	const FHeader* NewHeader = reinterpret_cast<const FHeader*>(InData);
+	const int64 ExpectedSize = (int64)sizeof(FHeader) + (int64)NewHeader->SlotsNum * sizeof(uint32) + (int64)NewHeader->EntriesNum * sizeof(FEntry) + (int64)NewHeader->PoolSize;
+	// Shards of the sharded dictionary are padded to 8 bytes
+	if (NewHeader->Magic != Magic || NewHeader->Version != Version || !FMath::IsPowerOfTwo(NewHeader->SlotsNum) || ExpectedSize > InSize || InSize - ExpectedSize >= 8)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Phonemization dictionary: invalid table data"));
+		return false;
+	}
+
+	DataSize = InSize;
+	Header = NewHeader;
+	Slots = reinterpret_cast<const uint32*>(InData + sizeof(FHeader));
+	Entries = reinterpret_cast<const FEntry*>(Slots + Header->SlotsNum);
+	Pool = reinterpret_cast<const uint8*>(Entries + Header->EntriesNum);
+	return true;
+}
+
+void FPhonemeDictionaryTable::Reset()
+{
+	Data.Empty();
+	if (RawMemory)
+	{
+		FMemory::Free(RawMemory);
+		RawMemory = nullptr;
+	}
+	DataSize = 0;
+	Header = nullptr;
+	Slots = nullptr;
+	Entries = nullptr;
+	Pool = nullptr;
+}
+
+bool FPhonemeDictionaryTable::Find(FStringView Word, TConstArrayView<UTF32CHAR>& OutPhonemes) const
+{
+	if (!Header)
+	{
+		return false;
+	}
+
+	UTF8CHAR Key[MaxKeyBytes];
+	const int32 KeyLen = FoldWord(Word, Key);
+	return KeyLen > 0 && FindFolded(Key, KeyLen, HashKey(Key, KeyLen), OutPhonemes);
+}
+
+bool FPhonemeDictionaryTable::FindFolded(const UTF8CHAR* Key, int32 KeyLen, uint32 Hash, TConstArrayView<UTF32CHAR>& OutPhonemes) const
+{
+	if (!Header)
+	{
+		return false;
+	}
+
+	const uint32 Mask = Header->SlotsNum - 1;
+	for (uint32 SlotIndex = Hash & Mask; Slots[SlotIndex] != 0; SlotIndex = (SlotIndex + 1) & Mask)
+	{
+		const FEntry& Entry = Entries[Slots[SlotIndex] - 1];
+		if (Entry.Hash == Hash && Entry.KeyLen == KeyLen && FMemory::Memcmp(Pool + Entry.GetKeyOffset(), Key, KeyLen) == 0)
+		{
+			OutPhonemes = TConstArrayView<UTF32CHAR>(reinterpret_cast<const UTF32CHAR*>(Pool + Entry.Offset), Entry.ValueLen);
+			return true;
+		}
+	}
+	return false;
+}
+
+void FPhonemeDictionaryTable::GetEntry(int32 Index, FUtf8StringView& OutWord, TConstArrayView<UTF32CHAR>& OutPhonemes) const
+{
+	check(Index >= 0 && Index < Num());
+	const FEntry& Entry = Entries[Index];
+	OutPhonemes = TConstArrayView<UTF32CHAR>(reinterpret_cast<const UTF32CHAR*>(Pool + Entry.Offset), Entry.ValueLen);
+	OutWord = FUtf8StringView(reinterpret_cast<const UTF8CHAR*>(Pool + Entry.GetKeyOffset()), Entry.KeyLen);
+}
+
+FString FPhonemeDictionaryTable::PhonemesToString(TConstArrayView<UTF32CHAR> Phonemes)
+{
+	FString Result;
+	Result.Reserve(Phonemes.Num());
+	for (const UTF32CHAR Codepoint : Phonemes)
+	{
+		// UTF-16 surrogate pair
+		if (sizeof(TCHAR) == 2 && Codepoint >= 0x10000)
+		{
+			Result.AppendChar((TCHAR)(0xD800 + ((Codepoint - 0x10000) >> 10)));
+			Result.AppendChar((TCHAR)(0xDC00 + ((Codepoint - 0x10000) & 0x3FF)));
+		}
+		else
+		{
+			Result.AppendChar((TCHAR)Codepoint);
+		}
+	}
+	return Result;
+}
+
+int32 FPhonemeDictionaryTable::FoldWord(FStringView Word, UTF8CHAR (&OutKey)[MaxKeyBytes])
+{
+	int32 Len = 0;
+	for (int32 i = 0; i < Word.Len(); i++)
+	{
+		uint32 Codepoint = (uint32)Word[i];
+		// UTF-16 surrogate pair
+		if (sizeof(TCHAR) == 2 && Codepoint >= 0xD800 && Codepoint < 0xDC00 && i + 1 < Word.Len())
+		{
+			const uint32 Low = (uint32)Word[i + 1];
+			if (Low >= 0xDC00 && Low < 0xE000)
+			{
+				Codepoint = 0x10000 + ((Codepoint - 0xD800) << 10) + (Low - 0xDC00);
+				i++;
+			}
+		}
+		if (!PhonemeDictionary::AppendUtf8(PhonemeDictionary::FoldCodepoint(Codepoint), OutKey, Len))
+		{
+			return INDEX_NONE;
+		}
+	}
+	return Len;
+}
+
+int32 FPhonemeDictionaryTable::FoldWord(FUtf8StringView Word, UTF8CHAR (&OutKey)[MaxKeyBytes])
+{
+	int32 Len = 0;
+	int32 Index = 0;
+	while (Index < Word.Len())
+	{
+		const uint32 Codepoint = PhonemeDictionary::DecodeUtf8(Word.GetData(), Word.Len(), Index);
+		if (!PhonemeDictionary::AppendUtf8(PhonemeDictionary::FoldCodepoint(Codepoint), OutKey, Len))
+		{
+			return INDEX_NONE;
+		}
+	}
+	return Len;
+}
+
+uint32 FPhonemeDictionaryTable::HashKey(const UTF8CHAR* Key, int32 Len)
+{
+	uint32 Hash = 2166136261u;
+	for (int32 i = 0; i < Len; i++)
+	{
+		Hash = (Hash ^ (uint8)Key[i]) * 16777619u;
+	}
+	return Hash;
+}
+
+//--------------------------------------------------------------------------------------------------------
+
+bool FPhonemeDictionaryBuilder::Add(FUtf8StringView Word, FUtf8StringView Phonemes)
+{
+	UTF8CHAR Key[FPhonemeDictionaryTable::MaxKeyBytes];
+	const int32 KeyLen = FPhonemeDictionaryTable::FoldWord(Word, Key);
+	if (KeyLen <= 0)
+	{
+		return false;
+	}
+
+	// Normalize once here instead of each time the word is synthesized
+	const std::u32string Value = una::utf8to32u(una::norm::to_nfd_utf8(std::string_view((const char*)Phonemes.GetData(), Phonemes.Len())));
+	const int64 ValueSize = (int64)Value.size() * sizeof(UTF32CHAR);
+	const int64 EntrySize = Align(ValueSize + KeyLen, sizeof(UTF32CHAR));
+	if (Value.size() > MAX_uint16 || Pool.Num() + EntrySize > MAX_uint32)
+	{
+		return false;
+	}
+
+	FPhonemeDictionaryTable::FEntry& Entry = Entries.AddDefaulted_GetRef();
+	Entry.Hash = FPhonemeDictionaryTable::HashKey(Key, KeyLen);
+	Entry.Offset = (uint32)Pool.Num();
+	Entry.KeyLen = (uint16)KeyLen;
+	Entry.ValueLen = (uint16)Value.size();
+	Pool.AddZeroed(EntrySize);
+	FMemory::Memcpy(&Pool[Entry.Offset], Value.data(), ValueSize);
+	FMemory::Memcpy(&Pool[Entry.GetKeyOffset()], Key, KeyLen);
+	return true;
+}
+
+bool FPhonemeDictionaryBuilder::Add(FStringView Word, FStringView Phonemes)
+{
+	const FTCHARToUTF8 WordUtf8(Word.GetData(), Word.Len());
+	const FTCHARToUTF8 PhonemesUtf8(Phonemes.GetData(), Phonemes.Len());
+	return Add(FUtf8StringView((const UTF8CHAR*)WordUtf8.Get(), WordUtf8.Length()), FUtf8StringView((const UTF8CHAR*)PhonemesUtf8.Get(), PhonemesUtf8.Length()));
+}
+
+void FPhonemeDictionaryBuilder::Append(FPhonemeDictionaryBuilder&& Other)
+{
+	if (Entries.IsEmpty())
+	{
+		Entries = MoveTemp(Other.Entries);
+		Pool = MoveTemp(Other.Pool);
+		return;
+	}
+
+	const uint32 PoolOffset = (uint32)Pool.Num();
+	Entries.Reserve(Entries.Num() + Other.Entries.Num());
+	for (FPhonemeDictionaryTable::FEntry Entry : Other.Entries)
+	{
+		Entry.Offset += PoolOffset;
+		Entries.Add(Entry);
+	}
+	Pool.Append(Other.Pool);
+
+	Other.Entries.Empty();
+	Other.Pool.Empty();
+}
+
+void FPhonemeDictionaryBuilder::Reserve(int32 EntriesNum, int64 PoolSize)
+{
+	Entries.Reserve(EntriesNum);
+	Pool.Reserve(PoolSize);
+}
+
+bool FPhonemeDictionaryBuilder::Build(TArray64<uint8>& OutData) const
+{
+	TArray<int32> EntryIndices;
+	EntryIndices.SetNumUninitialized(Entries.Num());
+	for (int32 i = 0; i < Entries.Num(); i++)
+	{
+		EntryIndices[i] = i;
+	}
+	return BuildSubset(EntryIndices, OutData);
+}
+
+int32 FPhonemeDictionaryBuilder::GetRecommendedShardsNum() const
+{
+	const int64 TableSize = Pool.Num() + (int64)Entries.Num() * (sizeof(FPhonemeDictionaryTable::FEntry) + 2 * sizeof(uint32));
+	const int32 ShardsNum = (int32)FMath::Clamp<int64>(TableSize / TargetShardSize, 1, MaxShardsNum);
+	return (int32)FMath::RoundUpToPowerOfTwo((uint32)ShardsNum);
+}
+
+bool FPhonemeDictionaryBuilder::BuildShards(int32 ShardsNum, TArray64<uint8>& OutData, TArray<int64>& OutShardOffsets) const
+{
+	if (!FMath::IsPowerOfTwo(ShardsNum))
+	{
+		return false;
+	}
+
+	// Duplicated words have the same hash, so they are in the same shard and keep their order
+	TArray<TArray<int32>> ShardEntries;
+	ShardEntries.SetNum(ShardsNum);
+	for (int32 i = 0; i < Entries.Num(); i++)
+	{
+		ShardEntries[FPhonemeDictionaryTable::GetShardIndex(Entries[i].Hash, ShardsNum)].Add(i);
+	}
+
+	TArray<TArray64<uint8>> ShardsData;
+	ShardsData.SetNum(ShardsNum);
+	ParallelFor(ShardsNum, [&](int32 ShardIndex)
+	{
+		BuildSubset(ShardEntries[ShardIndex], ShardsData[ShardIndex]);
+	});
+
+	OutShardOffsets.SetNumUninitialized(ShardsNum + 1);
+	int64 Offset = 0;
+	for (int32 i = 0; i < ShardsNum; i++)
+	{
+		OutShardOffsets[i] = Offset;
+		Offset += Align(ShardsData[i].Num(), 8);
+	}
+	OutShardOffsets[ShardsNum] = Offset;
+
+	OutData.SetNumZeroed(Offset);
+	for (int32 i = 0; i < ShardsNum; i++)
+	{
+		FMemory::Memcpy(OutData.GetData() + OutShardOffsets[i], ShardsData[i].GetData(), ShardsData[i].Num());
+	}
+	return true;
+}
+
+bool FPhonemeDictionaryBuilder::BuildSubset(TConstArrayView<int32> EntryIndices, TArray64<uint8>& OutData) const
+{
+	using FEntry = FPhonemeDictionaryTable::FEntry;
+
+	// Load factor <= 0.5
+	const uint32 SlotsNum = FMath::RoundUpToPowerOfTwo(FMath::Max(16u, (uint32)EntryIndices.Num() * 2));
+	const uint32 Mask = SlotsNum - 1;
+
+	// Fill slots with indices in Entries, duplicated words are replaced
+	TArray<uint32> SourceSlots;
+	SourceSlots.SetNumZeroed(SlotsNum);
+	for (const int32 i : EntryIndices)
+	{
+		const FEntry& Entry = Entries[i];
+		uint32 SlotIndex = Entry.Hash & Mask;
+		for (; SourceSlots[SlotIndex] != 0; SlotIndex = (SlotIndex + 1) & Mask)
+		{
+			const FEntry& Other = Entries[SourceSlots[SlotIndex] - 1];
+			if (Other.Hash == Entry.Hash && Other.KeyLen == Entry.KeyLen && FMemory::Memcmp(&Pool[Other.GetKeyOffset()], &Pool[Entry.GetKeyOffset()], Entry.KeyLen) == 0)
+			{
+				break;
+			}
+		}
+		SourceSlots[SlotIndex] = i + 1;
+	}
+
+	// Count unique entries
+	uint32 EntriesNum = 0;
+	uint64 PoolSize = 0;
+	for (const uint32 Source : SourceSlots)
+	{
+		if (Source != 0)
+		{
+			EntriesNum++;
+			PoolSize += Entries[Source - 1].GetSize();
+		}
+	}
+
+	// Write table: entries and pool are stored in the order of slots
+	OutData.SetNumUninitialized(sizeof(FPhonemeDictionaryTable::FHeader) + (int64)SlotsNum * sizeof(uint32) + (int64)EntriesNum * sizeof(FEntry) + PoolSize);
+	FPhonemeDictionaryTable::FHeader* Header = reinterpret_cast<FPhonemeDictionaryTable::FHeader*>(OutData.GetData());
+	Header->Magic = FPhonemeDictionaryTable::Magic;
+	Header->Version = FPhonemeDictionaryTable::Version;
+	Header->EntriesNum = EntriesNum;
+	Header->SlotsNum = SlotsNum;
+	Header->PoolSize = PoolSize;
+
+	uint32* Slots = reinterpret_cast<uint32*>(OutData.GetData() + sizeof(FPhonemeDictionaryTable::FHeader));
+	FEntry* OutEntries = reinterpret_cast<FEntry*>(Slots + SlotsNum);
+	uint8* OutPool = reinterpret_cast<uint8*>(OutEntries + EntriesNum);
+
+	uint32 EntryIndex = 0;
+	uint32 PoolOffset = 0;
+	for (uint32 SlotIndex = 0; SlotIndex < SlotsNum; SlotIndex++)
+	{
+		const uint32 Source = SourceSlots[SlotIndex];
+		if (Source == 0)
+		{
+			Slots[SlotIndex] = 0;
+			continue;
+		}
+
+		FEntry Entry = Entries[Source - 1];
+		const int32 EntrySize = Entry.GetSize();
+		FMemory::Memcpy(OutPool + PoolOffset, &Pool[Entry.Offset], EntrySize);
+		Entry.Offset = PoolOffset;
+		OutEntries[EntryIndex] = Entry;
+		Slots[SlotIndex] = ++EntryIndex;
+		PoolOffset += EntrySize;
+	}
+
+	return true;
+}
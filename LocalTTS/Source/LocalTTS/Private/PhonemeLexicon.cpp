@@ -0,0 +1,56 @@
+// (c) Yuri N. K. 2025. All rights reserved.
+// ykasczc@gmail.com
+
+#include "PhonemeLexicon.h"
+#include "Misc/ScopeLock.h"
+
+void UPhonemeLexicon::PostLoad()
+{
+	Super::PostLoad();
+	RebuildTable();
+}
+
+#if WITH_EDITOR
+void UPhonemeLexicon::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	// Hot-reload: next phonemization uses new words
+	if (PropertyChangedEvent.GetMemberPropertyName() == GET_MEMBER_NAME_CHECKED(UPhonemeLexicon, Words))
+	{
+		RebuildTable();
+	}
+}
+#endif
+
+void UPhonemeLexicon::RebuildTable()
+{
+	FPhonemeDictionaryBuilder Builder;
+	for (const auto& Word : Words)
+	{
+		if (Word.Key.IsEmpty() || Word.Value.IsEmpty()) continue;
+
+		if (!Builder.Add(FStringView(Word.Key), FStringView(Word.Value)))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Lexicon %s: can't add word \"%s\""), *GetName(), *Word.Key);
+		}
+	}
+
+	TSharedPtr<FPhonemeDictionaryTable> NewTable;
+	if (Builder.Num() > 0)
+	{
+		TArray64<uint8> TableData;
+		Builder.Build(TableData);
+		NewTable = MakeShared<FPhonemeDictionaryTable>();
+		NewTable->Initialize(MoveTemp(TableData));
+	}
+
+	FScopeLock Lock(&TableLock);
+	Table = NewTable;
+}
+
+TSharedPtr<const FPhonemeDictionaryTable> UPhonemeLexicon::GetTable() const
+{
+	FScopeLock Lock(&TableLock);
+	return Table;
+}
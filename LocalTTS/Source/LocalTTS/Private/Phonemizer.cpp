@@ -1,454 +1,1241 @@
-﻿// (c) Yuri N. K. 2025. All rights reserved.
-// ykasczc@gmail.com
-
-#include "Phonemizer.h"
-#include "LocalTTSFunctionLibrary.h"
-#include "LocalTTSTypes.h"
-#include "Modules/ModuleManager.h"
-#include "LocalTTSModule.h"
-#include "Engine/AssetManager.h"
-#include "Dom/JsonValue.h"
-#include "Dom/JsonObject.h"
-#include "LocalTTSSubsystem.h"
-#include "Serialization/JsonReader.h"
-#include "Serialization/JsonSerializer.h"
-#include "DictionaryArchive.h"
-#include "Async/Async.h"
-
-#include "NNE.h"
-#include "NNEModelData.h"
-#include "NNERuntime.h"
-#include "NNERuntimeCPU.h"
-#include <string>
-
-// convert three-dimensional array address to one-dim
-#define _ADDR3(a, b, c, shape) a*shape[1]*shape[2] + b*shape[2] + c
-
-namespace LocalTtsUtils
-{
-	FString PrintShape(const TArray<uint32>& Shape)
-	{
-		FString s;
-		for (const auto& d : Shape)
-		{
-			if (!s.IsEmpty()) s.Append(TEXT(", "));
-			s.Append(FString::FromInt(d));
-		}
-		return s;
-	}
-}
-
-void UPhonemizer::BeginDestroy()
-{
-	Super::BeginDestroy();
-}
-
-void UPhonemizer::SyncLoadModel(TSoftObjectPtr<UNNEModelData> EncoderPtr, TSoftObjectPtr<UNNEModelData> DecoderPtr)
-{
-	if (EncoderPtr.IsNull() || DecoderPtr.IsNull())
-	{
-		UE_LOG(LogTemp, Warning, TEXT("UPhonemizer. Model Reference is not set, please assign it in the editor"));
-		return;
-	}
-
-	/*
-	AsyncTask(ENamedThreads::AnyThread, [this, EncoderPtr, DecoderPtr]() mutable
-	{
-	});
-	*/
-	UNNEModelData* EncoderModelAsset = EncoderPtr.LoadSynchronous();
-	UNNEModelData* DecoderModelAsset = DecoderPtr.LoadSynchronous();
-
-	if (IsValid(EncoderModelAsset) && IsValid(DecoderModelAsset))
-	{
-		// We'll override output buffer size every time before RunSync
-		ULocalTTSFunctionLibrary::LoadNNM(Encoder, EncoderModelAsset, 1024, TEXT("G2PEncoder"));
-		ULocalTTSFunctionLibrary::LoadNNM(Decoder, DecoderModelAsset, 1024, TEXT("G2PDecoder"));
-	}
-}
-
-void UPhonemizer::SetLanguageCodeFormatRaw(const FString& InLanguageCode)
-{
-	LanguageCode = InLanguageCode.TrimStartAndEnd();
-}
-
-// Convert eSpeak language code to g2p model language code
-bool UPhonemizer::SetLanguageCodeFormatEspeak(const FString& InLanguageCode, bool bUseDicrionary)
-{
-	if (const FString* RawCode = EspeakToActual.Find(InLanguageCode))
-	{
-		const FString CodeNNM = *RawCode;
-		UE_LOG(LogTemp, Log, TEXT("SetLanguageCodeFormatEspeak code: %s"), *CodeNNM);
-		if (bUseDicrionary)
-		{
-			FName DictKey = *CodeNNM;
-			if (Dictionaries.Contains(DictKey) && !Dictionaries[DictKey].IsNull())
-			{
-				UDictionaryArchive* Dict = Dictionaries[DictKey].IsValid()
-					? Dictionaries[DictKey].Get()
-					: Dictionaries[DictKey].LoadSynchronous();
-
-				if (!Dict->IsDictionaryReady() && Dict->HasBulkData())
-				{
-					Dict->Unzip();
-				}
-			}
-		}
-		SetLanguageCodeFormatRaw(CodeNNM);
-		return true;
-	}
-	return false;
-}
-
-
-void UPhonemizer::PrepareDictionary(const FString& EspeakLanguageCode)
-{
-	if (const FString* RawCode = EspeakToActual.Find(EspeakLanguageCode))
-	{
-		const FName DictKey = **RawCode;
-		
-		if (Dictionaries.Contains(DictKey)
-			&& !Dictionaries[DictKey].IsNull()
-			&& !Dictionaries[DictKey].IsValid())
-		{
-			UE_LOG(LogTemp, Log, TEXT("Prepare dictionary asset: %s"), *DictKey.ToString());
-			Dictionaries[DictKey].ToSoftObjectPath().LoadAsync(OnDictionaryLoaded);
-		}
-	}
-}
-
-void UPhonemizer::LoadDictionaryFromArchive(const FString& FileName, const FString& InLanguageCode)
-{
-	if (!Dictionaries.Contains(*InLanguageCode))
-	{
-		TSoftObjectPtr<UDictionaryArchive> ptr(FSoftObjectPath(TEXT("/LocalTTS/G2P/Dict/" + InLanguageCode + TEXT(".") + InLanguageCode)));
-		Dictionaries.Add(*InLanguageCode, ptr);
-	}
-	UDictionaryArchive* arch = Dictionaries[*InLanguageCode].LoadSynchronous();
-	if (arch)
-	{
-		arch->InitializeFromFile(FileName);
-	}
-}
-
-FString UPhonemizer::GetLanguage() const
-{
-	return LanguageCode;
-}
-
-// At first, try to get phonemes from dictionary if it exists and unzipped
-// For all non-phonemized words run NNE G2P model
-void UPhonemizer::SyncPhonemizeText(const FString& Text, FString& PhonemizedText, TArray<FString>& OutWords, bool bCharactersAsWords)
-{
-	const int32 MaxLen = 50;
-	const int32 TokenEOS = 1;
-	const int32 TokenPad = 0;
-	const int32 CharCodeOffset = 3;
-
-	// Wrap language code as tag
-	FString PreparedLangCode = LanguageCode;
-	if (PreparedLangCode.Left(1) != TEXT("<"))
-	{
-		PreparedLangCode = TEXT("<") + PreparedLangCode;
-	}
-	if (PreparedLangCode.Right(1) != TEXT(":"))
-	{
-		if (PreparedLangCode.Right(1) != TEXT(">"))
-		{
-			PreparedLangCode.Append(TEXT(">:"));
-		}
-		else
-		{
-			PreparedLangCode.Append(TEXT(":"));
-		}
-	}
-
-	TMap<int32, FString> WordTerminators;
-
-	// Cleanup words
-	FString PreparedText = Text;
-	TSet<FString> Terminators = { TEXT("."), TEXT(","), TEXT("?"), TEXT("!") };
-	TSet<FString> TxtRepl = { TEXT("/"), TEXT("\\"), TEXT("("), TEXT(")"), TEXT(":"), TEXT(";"), TEXT("\""), TEXT("_"), TEXT("\r"), TEXT("\n"), TEXT("？"), TEXT("。"), TEXT("«"), TEXT("»"), TEXT("\t"), TEXT("¿") };
-	for (const auto& v : TxtRepl) PreparedText.ReplaceInline(*v, TEXT(" "));
-	PreparedText.ReplaceInline(TEXT("  "), TEXT(" "));
-	PreparedText.ReplaceInline(TEXT("  "), TEXT(" "));
-
-	if (bCharactersAsWords)
-	{
-		FString TempText;
-		for (int32 i = 0; i < PreparedText.Len(); i++)
-		{
-			const auto chr = PreparedText.Mid(i, 1);
-			TempText.Append(chr);
-			if (i < PreparedText.Len() - 1 && !TxtRepl.Contains(chr)) TempText.Append(TEXT(" "));
-		}
-		TempText.ReplaceInline(TEXT("  "), TEXT(" "));
-		PreparedText = TempText;
-	}
-
-	// Split words into array
-	TArray<FString> Words;
-	PreparedText.ParseIntoArray(Words, TEXT(" "));
-	for (int32 i = 0; i < Words.Num(); i++)
-	{
-		auto& w = Words[i];
-		for (const auto& t : Terminators)
-		{
-			if (w.Contains(t))
-			{
-				WordTerminators.Add(i, t);
-				w.ReplaceInline(*t, TEXT(""));
-			}
-		}
-	}
-
-	// Try to find words in the dictionary
-	TArray<FString> WordsPhonemized;
-	WordsPhonemized.SetNum(Words.Num());
-
-	// Can use phonemization dictionary?
-	if (const auto DictPtr = Dictionaries.Find(*LanguageCode))
-	{
-		if (DictPtr && !DictPtr->IsNull() && DictPtr->IsValid())
-		{
-			UDictionaryArchive* dict = DictPtr->Get();
-			if (dict->IsDictionaryReady())
-			{
-				int32 WordsPhonemizedCounter = 0;
-				for (int32 i = 0; i < Words.Num(); i++)
-				{
-					const FString& Word = Words[i];
-					if (const FString* ph = dict->Find(Word.ToLower()))
-					{
-						WordsPhonemized[i] = *ph;
-						WordsPhonemizedCounter++;
-						Words[i] = TEXT("");
-					}
-					else WordsPhonemized[i] = TEXT("");
-				}
-
-				// only generate unphonemized words
-				Words.Remove(TEXT(""));
-
-				if (Words.IsEmpty())
-				{
-					UE_LOG(LogTemp, Log, TEXT("SyncPhonemizeText: done using dictionary."));
-					for (int32 i = 0; i < WordsPhonemized.Num(); i++)
-					{
-						auto& w = WordsPhonemized[i];
-						if (const FString* term = WordTerminators.Find(i)) w.Append(*term);
-						PhonemizedText.Append(w + TEXT(" "));
-					}
-					PhonemizedText.TrimEndInline();
-					OutWords = WordsPhonemized;
-					return;
-				}
-				UE_LOG(LogTemp, Log, TEXT("SyncPhonemizeText: %d of %d words were phonemized using dictionary. Using NNM for %d."), WordsPhonemizedCounter, WordsPhonemized.Num(), Words.Num());
-			}
-		}
-	}
-
-	// Pad input_ids and fill attention_mask
-	const int32 BatchNum = Words.Num();
-	//FFileHelper::BufferToString()
-	int32 MaxWordLength = 0;
-	for (auto& W : Words)
-	{
-		W = PreparedLangCode + TEXT(" ") + W;
-
-		std::string s = TCHAR_TO_UTF8(*W);
-		MaxWordLength = FMath::Max(MaxWordLength, (int32)s.size());
-	}
-	TArray<int64> TokenizedWords, AttentionMask;
-	TokenizedWords.SetNumZeroed(MaxWordLength * BatchNum);
-	AttentionMask.Init(1, MaxWordLength * BatchNum);
-	for (int32 i = 0; i < BatchNum; i++)
-	{
-		std::string s = TCHAR_TO_UTF8(*Words[i]);
-		for (int32 n = 0; n < MaxWordLength; n++)
-		{
-			if (n < (int32)s.size())
-			{
-				TokenizedWords[i * MaxWordLength + n] = (uint64)(uint8)s[n] + CharCodeOffset;
-				AttentionMask[i * MaxWordLength + n] = 1;
-			}
-			else
-			{
-				AttentionMask[i * MaxWordLength + n] = 0;
-			}
-		}
-
-		FString s1;
-		for (int32 n = 0; n < MaxWordLength; n++)
-		{
-			if (n > 0) s1.Append(TEXT(", "));
-			s1.Append(FString::FromInt(TokenizedWords[i * MaxWordLength + n]));
-		}
-	}
-
-	// Encoder Inputs
-	Encoder.PrepareInputInt64(0, TokenizedWords, { (uint32)BatchNum, (uint32)MaxWordLength });
-	Encoder.PrepareInputInt64(1, AttentionMask,  { (uint32)BatchNum, (uint32)MaxWordLength });
-	// Encoder Outputs
-	Encoder.PrepareOutputBuffer(BatchNum * MaxWordLength * 1024);
-	// Run
-	TArray<float> EncoderOutputs;
-	TArray<uint32> EncoderOutputsShape;
-	if (!Encoder.RunNNE(EncoderOutputs, EncoderOutputsShape))
-	{
-		UE_LOG(LogTemp, Log, TEXT("G2P Encoder failed"));
-		return;
-	}
-
-	FString enshapetmp = LocalTtsUtils::PrintShape(EncoderOutputsShape);
-
-	TArray<TArray<int64>> DecoderInputIds; // Shape = (words_num, decoder_seq_len = 1..2..3...)	
-	DecoderInputIds.SetNum(BatchNum); // init with pad tokens; will remove later
-	for (auto& W : DecoderInputIds) W.Init(TokenPad, 1);
-
-	TArray<int64> DecoderInputIds_Data;
-	DecoderInputIds_Data.SetNumZeroed(BatchNum); // We know Pad == 0
-
-	TArray<bool> FinishedStatus;
-	FinishedStatus.SetNumZeroed(BatchNum);
-
-	for (int32 Step = 0; Step < MaxLen; Step++)
-	{
-		// Decoder Inputs		
-		Decoder.PrepareInputInt64(0, AttentionMask,			{ (uint32)BatchNum, (uint32)MaxWordLength });	// encoder_attention_mask	(10, 15)
-		Decoder.PrepareInputInt64(1, DecoderInputIds_Data,	{ (uint32)BatchNum, (uint32)Step + 1 });		// input_ids				(10, 1...)
-		Decoder.PrepareInputFloat(2, EncoderOutputs,		EncoderOutputsShape);							// encoder_hidden_states	(10, 15, 256)
-		// Decoder Outputs
-		Decoder.PrepareOutputBuffer(BatchNum * 1024 * (Step + 1));
-		// Run
-		TArray<float> Logits;
-		TArray<uint32> LogitsShape; // (0: batch_size, 1: decoder_seq_len, 2: vocab_size)
-		if (!Decoder.RunNNE(Logits, LogitsShape))
-		{
-			UE_LOG(LogTemp, Log, TEXT("G2P Decoder failed"));
-			return;
-		}
-
-		// Read generated tokens in the current step: extract logits for the latest data in sequence and do ArgMax
-		TArray<int32> NextTokens;
-		NextTokens.SetNumZeroed(LogitsShape[0]); // Batch size
-		int32 LastInSeqIndex = (int32)LogitsShape[1] - 1;
-		int32 FinishedCounter = 0;
-		
-		for (int32 WordId = 0; WordId < NextTokens.Num(); WordId++)
-		{
-			// Perform ArgMax for the latest in seq_len
-			float MaxVal = Logits[_ADDR3(WordId, LastInSeqIndex, 0, LogitsShape)];
-			for (int32 TokenId = 1; TokenId < (int32)LogitsShape[2]; TokenId++)
-			{
-				const float& TestVal = Logits[_ADDR3(WordId, LastInSeqIndex, TokenId, LogitsShape)];
-				if (TestVal > MaxVal)
-				{
-					MaxVal = TestVal;
-					NextTokens[WordId] = TokenId;
-				}
-			}
-
-			// Check status for each word
-			if (FinishedStatus[WordId])
-			{
-				NextTokens[WordId] = TokenPad;
-			}
-			else
-			{
-				if (NextTokens[WordId] == TokenEOS)
-				{
-					FinishedStatus[WordId] = true;
-				}
-			}
-
-			if (FinishedStatus[WordId]) FinishedCounter++;
-		}
-
-		// Everything is generated
-		if (FinishedCounter == BatchNum)
-		{
-			break;
-		}
-		
-		// Update DecoderInputIds
-		for (int32 WordId = 0; WordId < NextTokens.Num(); WordId++)
-		{
-			DecoderInputIds[WordId].Add(NextTokens[WordId]);
-		}
-
-		// Update data
-		const int32 SequenceLength = (int32)LogitsShape[1] + 1;
-		DecoderInputIds_Data.SetNumUninitialized(BatchNum * SequenceLength);
-		for (int32 WordId = 0; WordId < NextTokens.Num(); WordId++)
-		{
-			FMemory::Memcpy(&DecoderInputIds_Data[WordId * SequenceLength], DecoderInputIds[WordId].GetData(), DecoderInputIds[WordId].Num() * sizeof(int64));
-		}
-	}
-
-	// Set to next word which wasn't phonemized
-	int32 InsertIndexNext = INDEX_NONE;
-	while (++InsertIndexNext < WordsPhonemized.Num() && !WordsPhonemized[InsertIndexNext].IsEmpty());
-
-	for (const auto& WordTokens : DecoderInputIds)
-	{
-		// 0, 206, 139
-		int32 Index = 0;
-		char buffer[128];
-		FString Desc;
-
-		for (int32 CharIndex = 0; CharIndex < WordTokens.Num(); CharIndex++)
-		{
-			const auto& byte = WordTokens[CharIndex];
-
-			if (!Desc.IsEmpty()) Desc.Append(TEXT(", "));
-			Desc.Append(FString::FromInt(byte));
-
-			if (byte >= CharCodeOffset)
-			{
-				buffer[Index] = byte - CharCodeOffset;
-				Index++;
-			}
-		}
-		buffer[Index] = 0;
-		WordsPhonemized[InsertIndexNext] = UTF8_TO_TCHAR(buffer);
-		// next InsertIndexNext
-		while (++InsertIndexNext < WordsPhonemized.Num() && !WordsPhonemized[InsertIndexNext].IsEmpty());		
-	}
-
-	for (const auto& wt : WordTerminators)
-	{
-		WordsPhonemized[wt.Key].Append(wt.Value);
-	}
-
-	OutWords = WordsPhonemized;
-	
-	// set resulted text
-	PhonemizedText.Empty();
-	for (const auto& w : WordsPhonemized)
-	{
-		PhonemizedText.Append(w + TEXT(" "));
-	}
-	PhonemizedText.TrimEndInline();
-}
-
-void UPhonemizer::ArgMax(const float* In, int32 Shape0, int32 Shape1, TArray<int64>& Out) const
-{
-	Out.SetNumUninitialized(Shape0);
-
-	for (int32 lineIndex = 0; lineIndex < Shape0; lineIndex++)
-	{
-		int32 usefulIndex = INDEX_NONE;
-		float MaxVal = 0.f;
-		for (int32 argIndex = 0; argIndex < Shape1; argIndex++)
-		{
-			const float val = In[lineIndex * argIndex + argIndex];
-			if (argIndex == 0 || MaxVal < val)
-			{
-				MaxVal = val; usefulIndex = argIndex;
-			}
-		}
-
-		Out[lineIndex] = (int64)usefulIndex;
-	}
-}
+﻿// (c) Yuri N. K. 2025. All rights reserved.
+// ykasczc@gmail.com
+
+#include "Phonemizer.h"
+#include "LocalTTSFunctionLibrary.h"
+#include "LocalTTSTypes.h"
+#include "Modules/ModuleManager.h"
+#include "LocalTTSModule.h"
+#include "Engine/AssetManager.h"
+#include "Dom/JsonValue.h"
+#include "Dom/JsonObject.h"
+#include "LocalTTSSubsystem.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "DictionaryArchive.h"
+#include "PhonemeLexicon.h"
+#include "LocalTTSSettings.h"
+#include "Async/Async.h"
+#include "Misc/ScopeExit.h"
+#include "Misc/ScopeRWLock.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "HAL/FileManager.h"
+
+#include "NNE.h"
+#include "NNEModelData.h"
+#include "NNERuntime.h"
+#include "NNERuntimeCPU.h"
+#include <string>
+
+namespace G2PDecoding
+{
+	// Max length of generated word in bytes
+	const int32 MaxLen = 50;
+	const int32 TokenEOS = 1;
+	const int32 TokenPad = 0;
+	const int32 CharCodeOffset = 3;
+	// Vocabulary size reserved in output buffers
+	const int32 VocabBufferSize = 1024;
+	// Index of the first past key/value input in the decoder with past
+	const int32 PastInputOffset = 3;
+	// Max number of words in one G2P batch
+	const int32 MaxBatchSize = 32;
+	// Max difference of word length (in bytes) in one G2P batch
+	const uint32 BucketLengthSpan = 4;
+
+	// Remove finished rows from row-major buffer in place. KeptRows are sorted indices of the rows to keep
+	template<typename T>
+	void CompactRows(T* Data, int64 RowSize, const TArray<int32>& KeptRows)
+	{
+		for (int32 NewIndex = 0; NewIndex < KeptRows.Num(); NewIndex++)
+		{
+			if (KeptRows[NewIndex] != NewIndex)
+			{
+				FMemory::Memmove(Data + NewIndex * RowSize, Data + KeptRows[NewIndex] * RowSize, RowSize * sizeof(T));
+			}
+		}
+	}
+}
+
+namespace LocalTtsUtils
+{
+	FString PrintShape(const TArray<uint32>& Shape)
+	{
+		FString s;
+		for (const auto& d : Shape)
+		{
+			if (!s.IsEmpty()) s.Append(TEXT(", "));
+			s.Append(FString::FromInt(d));
+		}
+		return s;
+	}
+}
+
+void UPhonemizer::BeginDestroy()
+{
+	Super::BeginDestroy();
+
+	{
+		FScopeLock Lock(&SessionsLock);
+		FreeSessions.Empty();
+		Sessions.Empty();
+	}
+	for (FEvent** Event : { &SessionReleasedEvent, &SessionsIdleEvent, &RebuildFinishedEvent })
+	{
+		if (*Event)
+		{
+			FPlatformProcess::ReturnSynchEventToPool(*Event);
+			*Event = nullptr;
+		}
+	}
+}
+
+void UPhonemizer::SyncLoadModel(TSoftObjectPtr<UNNEModelData> EncoderPtr, TSoftObjectPtr<UNNEModelData> DecoderPtr)
+{
+	if (EncoderPtr.IsNull() || DecoderPtr.IsNull())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UPhonemizer. Model Reference is not set, please assign it in the editor"));
+		return;
+	}
+
+	UNNEModelData* EncoderModelAsset = EncoderPtr.LoadSynchronous();
+	UNNEModelData* DecoderModelAsset = DecoderPtr.LoadSynchronous();
+	InitializeModels(EncoderModelAsset, DecoderModelAsset);
+}
+
+bool UPhonemizer::InitializeModels(UNNEModelData* EncoderModelAsset, UNNEModelData* DecoderModelAsset)
+{
+	if (!IsValid(EncoderModelAsset) || !IsValid(DecoderModelAsset))
+	{
+		return false;
+	}
+
+	// Sessions can be used by other threads, so wait for them before destroying
+	LockSessionsForRebuild();
+	ON_SCOPE_EXIT { UnlockSessionsAfterRebuild(); };
+	FreeSessions.Empty();
+	Sessions.Empty();
+	DecoderPastShapes.Empty();
+
+	// First session loads models from assets, others share them and only create new instances
+	const int32 NewSessionsNum = FMath::Max(1, MaxConcurrentSessions);
+	for (int32 i = 0; i < NewSessionsNum; i++)
+	{
+		TUniquePtr<FG2PSession> Session = MakeUnique<FG2PSession>();
+		// We'll override output buffer size every time before RunSync
+		const bool bLoaded = i == 0
+			? ULocalTTSFunctionLibrary::LoadNNM(Session->Encoder, EncoderModelAsset, 1024, TEXT("G2PEncoder"))
+				&& ULocalTTSFunctionLibrary::LoadNNM(Session->Decoder, DecoderModelAsset, 1024, TEXT("G2PDecoder"))
+			: ULocalTTSFunctionLibrary::CloneNNM(Session->Encoder, Sessions[0]->Encoder, 1024, TEXT("G2PEncoder"))
+				&& ULocalTTSFunctionLibrary::CloneNNM(Session->Decoder, Sessions[0]->Decoder, 1024, TEXT("G2PDecoder"));
+
+		if (!bLoaded)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("UPhonemizer: couldn't create G2P session %d"), i);
+			break;
+		}
+		Sessions.Add(MoveTemp(Session));
+	}
+
+	for (const auto& Session : Sessions)
+	{
+		FreeSessions.Add(Session.Get());
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("UPhonemizer: %d G2P sessions are ready"), Sessions.Num());
+	return Sessions.Num() > 0;
+}
+
+bool UPhonemizer::SyncLoadCachedDecoder(TSoftObjectPtr<UNNEModelData> DecoderWithPastPtr)
+{
+	if (DecoderWithPastPtr.IsNull())
+	{
+		LockSessionsForRebuild();
+		DecoderPastShapes.Empty();
+		UnlockSessionsAfterRebuild();
+		return false;
+	}
+
+	return InitializeCachedDecoder(DecoderWithPastPtr.LoadSynchronous());
+}
+
+bool UPhonemizer::InitializeCachedDecoder(UNNEModelData* DecoderModelAsset)
+{
+	using namespace G2PDecoding;
+
+	LockSessionsForRebuild();
+	ON_SCOPE_EXIT { UnlockSessionsAfterRebuild(); };
+	DecoderPastShapes.Empty();
+	bCachedDecoderFailed = false;
+
+	if (Sessions.IsEmpty())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UPhonemizer: G2P model should be loaded before decoder with past key values"));
+		return false;
+	}
+
+	FNNEModelTTS& DecoderWithPast = Sessions[0]->DecoderWithPast;
+	if (!IsValid(DecoderModelAsset) || !ULocalTTSFunctionLibrary::LoadNNM(DecoderWithPast, DecoderModelAsset, 1024, TEXT("G2PDecoderWithPast")))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UPhonemizer: couldn't load G2P decoder with past key values"));
+		return false;
+	}
+
+	// Validate inputs/outputs: every past input should have matching present output
+	TConstArrayView<UE::NNE::FTensorDesc> InputDescs = DecoderWithPast.ModelInstance->GetInputTensorDescs();
+	TConstArrayView<UE::NNE::FTensorDesc> OutputDescs = DecoderWithPast.ModelInstance->GetOutputTensorDescs();
+	const int32 PastNum = InputDescs.Num() - PastInputOffset;
+	if (PastNum <= 0 || OutputDescs.Num() != PastNum + 1)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UPhonemizer: G2P decoder with past has unexpected inputs (%d) or outputs (%d)"), InputDescs.Num(), OutputDescs.Num());
+		DecoderWithPast.bLoaded = false;
+		return false;
+	}
+
+	for (int32 i = 0; i < PastNum; i++)
+	{
+		const UE::NNE::FTensorDesc& Desc = InputDescs[PastInputOffset + i];
+		TConstArrayView<int32> Dims = Desc.GetShape().GetData();
+		// (batch, heads, past_seq, head_size)
+		if (Desc.GetDataType() != ENNETensorDataType::Float || Dims.Num() != 4 || Dims[1] <= 0 || Dims[3] <= 0)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("UPhonemizer: G2P decoder input %d isn't a past key/value tensor"), PastInputOffset + i);
+			DecoderPastShapes.Empty();
+			DecoderWithPast.bLoaded = false;
+			return false;
+		}
+		DecoderPastShapes.Add(FIntPoint(Dims[1], Dims[3]));
+	}
+
+	for (int32 i = 1; i < Sessions.Num(); i++)
+	{
+		if (!ULocalTTSFunctionLibrary::CloneNNM(Sessions[i]->DecoderWithPast, DecoderWithPast, 1024, TEXT("G2PDecoderWithPast")))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("UPhonemizer: couldn't create G2P decoder with past key values for session %d"), i);
+			DecoderPastShapes.Empty();
+			return false;
+		}
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("UPhonemizer: G2P decoder with past is loaded (%d past key/value tensors)"), PastNum);
+	return true;
+}
+
+bool UPhonemizer::HasCachedDecoder() const
+{
+	FScopeLock Lock(&SessionsLock);
+	return DecoderPastShapes.Num() > 0 && !bCachedDecoderFailed;
+}
+
+FG2PSession* UPhonemizer::AcquireSession()
+{
+	while (true)
+	{
+		// Events are created by the first rebuild, sessions don't exist before it
+		FEvent* WaitEvent;
+		{
+			FScopeLock Lock(&SessionsLock);
+			if (bSessionsRebuilding)
+			{
+				// Models are being replaced
+				WaitEvent = RebuildFinishedEvent;
+			}
+			else if (Sessions.IsEmpty())
+			{
+				return nullptr;
+			}
+			else if (FreeSessions.Num() > 0)
+			{
+				FG2PSession* Session = FreeSessions.Pop(EAllowShrinking::No);
+				SessionsIdleEvent->Reset();
+				// Auto-reset event wakes one waiter: pass it on if there are more free sessions
+				if (FreeSessions.Num() > 0)
+				{
+					SessionReleasedEvent->Trigger();
+				}
+				return Session;
+			}
+			else
+			{
+				// All sessions are busy, wait for the next one
+				WaitEvent = SessionReleasedEvent;
+			}
+		}
+		WaitEvent->Wait();
+	}
+}
+
+void UPhonemizer::LockSessionsForRebuild()
+{
+	SessionsLock.Lock();
+	if (!SessionReleasedEvent)
+	{
+		SessionReleasedEvent = FPlatformProcess::GetSynchEventFromPool(false);
+		SessionsIdleEvent = FPlatformProcess::GetSynchEventFromPool(true);
+		RebuildFinishedEvent = FPlatformProcess::GetSynchEventFromPool(true);
+		SessionsIdleEvent->Trigger();
+		RebuildFinishedEvent->Trigger();
+	}
+
+	// Block new sessions and wait until sessions in use are released
+	while (true)
+	{
+		bSessionsRebuilding = true;
+		RebuildFinishedEvent->Reset();
+		if (FreeSessions.Num() == Sessions.Num())
+		{
+			// Keep the lock until UnlockSessionsAfterRebuild
+			return;
+		}
+		SessionsLock.Unlock();
+		SessionsIdleEvent->Wait();
+		SessionsLock.Lock();
+	}
+}
+
+void UPhonemizer::UnlockSessionsAfterRebuild()
+{
+	bSessionsRebuilding = false;
+	SessionsIdleEvent->Trigger();
+	RebuildFinishedEvent->Trigger();
+	SessionsLock.Unlock();
+	SessionReleasedEvent->Trigger();
+}
+
+void UPhonemizer::ReleaseSession(FG2PSession* Session)
+{
+	{
+		FScopeLock Lock(&SessionsLock);
+		FreeSessions.Push(Session);
+		if (FreeSessions.Num() == Sessions.Num())
+		{
+			SessionsIdleEvent->Trigger();
+		}
+	}
+	SessionReleasedEvent->Trigger();
+}
+
+void UPhonemizer::SetLanguageCodeFormatRaw(const FString& InLanguageCode)
+{
+	LanguageCode = InLanguageCode.TrimStartAndEnd();
+}
+
+bool UPhonemizer::SetLanguageCodeFormatEspeak(const FString& InLanguageCode, bool bUseDicrionary)
+{
+	FString CodeNNM;
+	if (GetLanguageCodeFromEspeak(InLanguageCode, bUseDicrionary, CodeNNM))
+	{
+		SetLanguageCodeFormatRaw(CodeNNM);
+		return true;
+	}
+	return false;
+}
+
+// Convert eSpeak language code to g2p model language code
+bool UPhonemizer::GetLanguageCodeFromEspeak(const FString& EspeakLanguageCode, bool bUseDictionary, FString& OutLanguageCode)
+{
+	if (const FString* RawCode = EspeakToActual.Find(EspeakLanguageCode))
+	{
+		const FString CodeNNM = *RawCode;
+		UE_LOG(LogTemp, Log, TEXT("GetLanguageCodeFromEspeak code: %s"), *CodeNNM);
+		if (bUseDictionary)
+		{
+			// Can be called from several synthesis threads: never load or unzip here,
+			// SyncPhonemizeText uses G2P model until the dictionary is ready
+			bool bRequested;
+			{
+				FScopeLock Lock(&DictionaryLock);
+				bRequested = RequestedDictionaries.Contains(FName(*CodeNNM));
+			}
+			if (!bRequested)
+			{
+				if (IsInGameThread())
+				{
+					PrepareDictionary(EspeakLanguageCode);
+				}
+				else
+				{
+					AsyncTask(ENamedThreads::GameThread, [WeakThis = TWeakObjectPtr<UPhonemizer>(this), EspeakLanguageCode]()
+					{
+						if (WeakThis.IsValid())
+						{
+							WeakThis->PrepareDictionary(EspeakLanguageCode);
+						}
+					});
+				}
+			}
+		}
+		OutLanguageCode = CodeNNM;
+		return true;
+	}
+	return false;
+}
+
+
+void UPhonemizer::PrepareDictionary(const FString& EspeakLanguageCode)
+{
+	check(IsInGameThread());
+
+	if (const FString* RawCode = EspeakToActual.Find(EspeakLanguageCode))
+	{
+		const FName DictKey = **RawCode;
+		
+		if (Dictionaries.Contains(DictKey) && !Dictionaries[DictKey].IsNull())
+		{
+			{
+				FScopeLock Lock(&DictionaryLock);
+				RequestedDictionaries.Add(DictKey);
+			}
+
+			if (UDictionaryArchive* Dict = Dictionaries[DictKey].Get())
+			{
+				OnDictionaryAssetLoaded(Dictionaries[DictKey].ToSoftObjectPath(), Dict, DictKey);
+			}
+			else
+			{
+				UE_LOG(LogTemp, Log, TEXT("Prepare dictionary asset: %s"), *DictKey.ToString());
+				Dictionaries[DictKey].ToSoftObjectPath().LoadAsync(
+					FLoadSoftObjectPathAsyncDelegate::CreateUObject(this, &UPhonemizer::OnDictionaryAssetLoaded, DictKey));
+			}
+		}
+	}
+}
+
+void UPhonemizer::OnDictionaryAssetLoaded(const FSoftObjectPath& AssetPath, UObject* LoadedAsset, FName DictKey)
+{
+	UDictionaryArchive* Dict = Cast<UDictionaryArchive>(LoadedAsset);
+	if (!Dict)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Failed to load dictionary asset: %s"), *AssetPath.ToString());
+		return;
+	}
+
+	// Keep asset loaded and build the table in background thread
+	{
+		FScopeLock Lock(&DictionaryLock);
+		LoadedDictionaries.Add(DictKey, Dict);
+		DictionaryUsage.FindOrAdd(DictKey).LastUsedTime = FPlatformTime::Seconds();
+	}
+	if (Dict->HasBulkData())
+	{
+		Dict->PrepareAsync();
+	}
+}
+
+void UPhonemizer::AddDictionaryUser(const FString& EspeakLanguageCode, int32 VoiceId)
+{
+	const FString* RawCode = EspeakToActual.Find(EspeakLanguageCode);
+	// Languages without dictionary asset don't have users
+	if (RawCode && Dictionaries.Contains(**RawCode) && !Dictionaries[**RawCode].IsNull())
+	{
+		{
+			FScopeLock Lock(&DictionaryLock);
+			FDictionaryUsage& Usage = DictionaryUsage.FindOrAdd(FName(**RawCode));
+			Usage.Voices.Add(VoiceId);
+			Usage.LastUsedTime = FPlatformTime::Seconds();
+		}
+		PrepareDictionary(EspeakLanguageCode);
+	}
+}
+
+void UPhonemizer::RemoveDictionaryUser(const FString& EspeakLanguageCode, int32 VoiceId)
+{
+	if (const FString* RawCode = EspeakToActual.Find(EspeakLanguageCode))
+	{
+		FScopeLock Lock(&DictionaryLock);
+		if (FDictionaryUsage* Usage = DictionaryUsage.Find(FName(**RawCode)))
+		{
+			Usage->Voices.Remove(VoiceId);
+			Usage->LastUsedTime = FPlatformTime::Seconds();
+		}
+	}
+}
+
+UDictionaryArchive* UPhonemizer::FindResidentDictionary(FName DictKey)
+{
+	FScopeLock Lock(&DictionaryLock);
+	const TObjectPtr<UDictionaryArchive>* Dict = LoadedDictionaries.Find(DictKey);
+	if (!Dict)
+	{
+		return nullptr;
+	}
+	if (FDictionaryUsage* Usage = DictionaryUsage.Find(DictKey))
+	{
+		Usage->LastUsedTime = FPlatformTime::Seconds();
+	}
+	return *Dict;
+}
+
+void UPhonemizer::UpdateDictionaries()
+{
+	check(IsInGameThread());
+
+	const double Now = FPlatformTime::Seconds();
+	const int64 MemoryBudget = (int64)DictionaryMemoryBudgetMB * 1024 * 1024;
+
+	// Unused dictionaries which can be released: oldest first
+	TArray<TPair<double, FName>> Candidates;
+	int64 ResidentSize = 0;
+	{
+		FScopeLock Lock(&DictionaryLock);
+		for (const auto& Dict : LoadedDictionaries)
+		{
+			const EDictionaryState State = Dict.Value->GetDictionaryState();
+			if (State == EDictionaryState::Building || State == EDictionaryState::NotReady)
+			{
+				continue;
+			}
+			ResidentSize += Dict.Value->GetResidentSize();
+
+			const FDictionaryUsage* Usage = DictionaryUsage.Find(Dict.Key);
+			if (!Usage || Usage->Voices.IsEmpty())
+			{
+				Candidates.Emplace(Usage ? Usage->LastUsedTime : 0.0, Dict.Key);
+			}
+		}
+	}
+	if (Candidates.IsEmpty())
+	{
+		return;
+	}
+	Candidates.Sort([](const TPair<double, FName>& A, const TPair<double, FName>& B) { return A.Key < B.Key; });
+
+	// Dictionary can be used by synthesis threads now, try again on next update
+	if (!DictionaryResidencyLock.TryWriteLock())
+	{
+		return;
+	}
+	for (const auto& Candidate : Candidates)
+	{
+		const bool bExpired = DictionaryUnloadDelay > 0.f && Now - Candidate.Key > DictionaryUnloadDelay;
+		const bool bOverBudget = MemoryBudget > 0 && ResidentSize > MemoryBudget;
+		if (bExpired || bOverBudget)
+		{
+			ResidentSize -= LoadedDictionaries[Candidate.Value]->GetResidentSize();
+			UnloadDictionary(Candidate.Value);
+		}
+	}
+	DictionaryResidencyLock.WriteUnlock();
+}
+
+void UPhonemizer::UnloadDictionary(FName DictKey)
+{
+	FScopeLock Lock(&DictionaryLock);
+	if (const TObjectPtr<UDictionaryArchive>* Dict = LoadedDictionaries.Find(DictKey))
+	{
+		UE_LOG(LogTemp, Log, TEXT("Release phonemization dictionary %s (%lld bytes)"), *DictKey.ToString(), (*Dict)->GetResidentSize());
+		(*Dict)->ReleaseTable();
+		LoadedDictionaries.Remove(DictKey);
+		RequestedDictionaries.Remove(DictKey);
+	}
+}
+
+void UPhonemizer::AddLexicon(UPhonemeLexicon* Lexicon)
+{
+	if (IsValid(Lexicon))
+	{
+		FScopeLock Lock(&DictionaryLock);
+		Lexicons.AddUnique(Lexicon);
+	}
+}
+
+void UPhonemizer::RemoveLexicon(UPhonemeLexicon* Lexicon)
+{
+	FScopeLock Lock(&DictionaryLock);
+	Lexicons.Remove(Lexicon);
+}
+
+FString UPhonemizer::GetG2PWordsFilePath(FName InLanguageCode)
+{
+	return FPaths::ProjectSavedDir() / TEXT("LocalTTS") / FString::Printf(TEXT("G2P_%s.csv"), *InLanguageCode.ToString());
+}
+
+void UPhonemizer::FG2PWordsCache::BuildTable()
+{
+	// Table is replaced, so other threads can still use the old one
+	TArray64<uint8> TableData;
+	Builder.Build(TableData);
+	TSharedPtr<FPhonemeDictionaryTable> NewTable = MakeShared<FPhonemeDictionaryTable>();
+	NewTable->Initialize(MoveTemp(TableData));
+	Table = NewTable;
+	PendingWordsNum = 0;
+	LastBuildTime = FPlatformTime::Seconds();
+}
+
+TSharedPtr<const FPhonemeDictionaryTable> UPhonemizer::GetG2PWordsTable(FName InLanguageCode)
+{
+	FScopeLock Lock(&G2PWordsLock);
+	if (FG2PWordsCache* Cache = G2PWordsCaches.Find(InLanguageCode))
+	{
+		// New words are phonemized by G2P model until the next rebuild
+		constexpr int32 RebuildWordsNum = 64;
+		constexpr double RebuildInterval = 10.0;
+		if (Cache->PendingWordsNum >= RebuildWordsNum || (Cache->PendingWordsNum > 0 && FPlatformTime::Seconds() - Cache->LastBuildTime > RebuildInterval))
+		{
+			Cache->BuildTable();
+		}
+		return Cache->Table;
+	}
+
+	FG2PWordsCache& Cache = G2PWordsCaches.Add(InLanguageCode);
+	TArray<FString> Lines;
+	if (FFileHelper::LoadFileToStringArray(Lines, *GetG2PWordsFilePath(InLanguageCode)))
+	{
+		for (const FString& Line : Lines)
+		{
+			int32 ind = INDEX_NONE;
+			if (Line.FindChar(TEXT(';'), ind) && ind > 0)
+			{
+				Cache.Builder.Add(FStringView(Line).Left(ind), FStringView(Line).RightChop(ind + 1));
+			}
+		}
+		if (Cache.Builder.Num() > 0)
+		{
+			Cache.BuildTable();
+		}
+		UE_LOG(LogTemp, Log, TEXT("Loaded %d saved G2P words for %s"), Cache.Builder.Num(), *InLanguageCode.ToString());
+	}
+	return Cache.Table;
+}
+
+void UPhonemizer::SaveG2PWords(FName InLanguageCode, const TArray<FString>& Words, const TArray<FString>& Phonemes)
+{
+	FScopeLock Lock(&G2PWordsLock);
+	FG2PWordsCache& Cache = G2PWordsCaches.FindOrAdd(InLanguageCode);
+
+	FString NewLines;
+	for (int32 i = 0; i < FMath::Min(Words.Num(), Phonemes.Num()); i++)
+	{
+		if (!Words[i].IsEmpty() && !Phonemes[i].IsEmpty() && Cache.Builder.Add(FStringView(Words[i]), FStringView(Phonemes[i])))
+		{
+			NewLines.Append(Words[i]).AppendChar(TEXT(';')).Append(Phonemes[i]).AppendChar(TEXT('\n'));
+			Cache.PendingWordsNum++;
+		}
+	}
+	if (NewLines.IsEmpty())
+	{
+		return;
+	}
+
+	// Table is rebuilt by GetG2PWordsTable
+	FFileHelper::SaveStringToFile(NewLines, *GetG2PWordsFilePath(InLanguageCode), FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM, &IFileManager::Get(), FILEWRITE_Append);
+}
+
+TMap<FName, int64> UPhonemizer::GetDictionariesResidentSize() const
+{
+	TMap<FName, int64> Sizes;
+	FScopeLock Lock(&DictionaryLock);
+	for (const auto& Dict : LoadedDictionaries)
+	{
+		Sizes.Add(Dict.Key, Dict.Value->GetResidentSize());
+	}
+	return Sizes;
+}
+
+void UPhonemizer::LoadDictionaryFromArchive(const FString& FileName, const FString& InLanguageCode)
+{
+	if (!Dictionaries.Contains(*InLanguageCode))
+	{
+		TSoftObjectPtr<UDictionaryArchive> ptr(FSoftObjectPath(TEXT("/LocalTTS/G2P/Dict/" + InLanguageCode + TEXT(".") + InLanguageCode)));
+		Dictionaries.Add(*InLanguageCode, ptr);
+	}
+	UDictionaryArchive* arch = Dictionaries[*InLanguageCode].LoadSynchronous();
+	if (arch && !arch->InitializeFromFile(FileName))
+	{
+		UE_LOG(LogTemp, Error, TEXT("UPhonemizer: couldn't import dictionary %s from %s"), *InLanguageCode, *FileName);
+	}
+}
+
+FString UPhonemizer::GetLanguage() const
+{
+	return LanguageCode;
+}
+
+FString UPhonemizer::GetLanguageTag(const FString& InLanguageCode)
+{
+	// Wrap language code as tag
+	FString PreparedLangCode = InLanguageCode.TrimStartAndEnd();
+	if (PreparedLangCode.Left(1) != TEXT("<"))
+	{
+		PreparedLangCode = TEXT("<") + PreparedLangCode;
+	}
+	if (PreparedLangCode.Right(1) != TEXT(":"))
+	{
+		if (PreparedLangCode.Right(1) != TEXT(">"))
+		{
+			PreparedLangCode.Append(TEXT(">:"));
+		}
+		else
+		{
+			PreparedLangCode.Append(TEXT(":"));
+		}
+	}
+	return PreparedLangCode;
+}
+
+// At first, try to get phonemes from dictionary if it exists and unzipped
+// For all non-phonemized words run NNE G2P model
+void UPhonemizer::SyncPhonemizeText(const FString& Text, FString& PhonemizedText, TArray<FString>& OutWords, bool bCharactersAsWords)
+{
+	SyncPhonemizeTextToCodepoints(Text, LanguageCode, PhonemizedText, OutWords, nullptr, bCharactersAsWords);
+}
+
+void UPhonemizer::SyncPhonemizeTextToCodepoints(const FString& Text, const FString& InLanguageCode, FString& PhonemizedText, TArray<FString>& OutWords, TArray<TArray<Piper::PhonemeUtf8>>* OutDictionaryPhonemes, bool bCharactersAsWords)
+{
+	TMap<int32, FString> WordTerminators;
+
+	// Cleanup words
+	FString PreparedText = Text;
+	TSet<FString> Terminators = { TEXT("."), TEXT(","), TEXT("?"), TEXT("!") };
+	TSet<FString> TxtRepl = { TEXT("/"), TEXT("\\"), TEXT("("), TEXT(")"), TEXT(":"), TEXT(";"), TEXT("\""), TEXT("_"), TEXT("\r"), TEXT("\n"), TEXT("？"), TEXT("。"), TEXT("«"), TEXT("»"), TEXT("\t"), TEXT("¿") };
+	for (const auto& v : TxtRepl) PreparedText.ReplaceInline(*v, TEXT(" "));
+	PreparedText.ReplaceInline(TEXT("  "), TEXT(" "));
+	PreparedText.ReplaceInline(TEXT("  "), TEXT(" "));
+
+	if (bCharactersAsWords)
+	{
+		FString TempText;
+		for (int32 i = 0; i < PreparedText.Len(); i++)
+		{
+			const auto chr = PreparedText.Mid(i, 1);
+			TempText.Append(chr);
+			if (i < PreparedText.Len() - 1 && !TxtRepl.Contains(chr)) TempText.Append(TEXT(" "));
+		}
+		TempText.ReplaceInline(TEXT("  "), TEXT(" "));
+		PreparedText = TempText;
+	}
+
+	// Split words into array
+	TArray<FString> Words;
+	PreparedText.ParseIntoArray(Words, TEXT(" "));
+	for (int32 i = 0; i < Words.Num(); i++)
+	{
+		auto& w = Words[i];
+		for (const auto& t : Terminators)
+		{
+			if (w.Contains(t))
+			{
+				WordTerminators.Add(i, t);
+				w.ReplaceInline(*t, TEXT(""));
+			}
+		}
+	}
+
+	// Try to find words in lexicons, saved G2P words and the dictionary
+	TArray<FString> WordsPhonemized;
+	WordsPhonemized.SetNum(Words.Num());
+	if (OutDictionaryPhonemes)
+	{
+		OutDictionaryPhonemes->Reset();
+		OutDictionaryPhonemes->SetNum(Words.Num());
+	}
+
+	const FName LanguageKey = FName(*InLanguageCode);
+	int32 WordsPhonemizedCounter = 0;
+	bool bLookupDone = false;
+	auto FindWords = [&](TFunctionRef<bool(FStringView, TConstArrayView<UTF32CHAR>&)> FindPhonemes)
+	{
+		bLookupDone = true;
+		for (int32 i = 0; i < Words.Num(); i++)
+		{
+			if (!WordsPhonemized[i].IsEmpty()) continue;
+
+			TConstArrayView<UTF32CHAR> ph;
+			if (FindPhonemes(Words[i], ph))
+			{
+				WordsPhonemized[i] = FPhonemeDictionaryTable::PhonemesToString(ph);
+				if (OutDictionaryPhonemes)
+				{
+					// Already normalized
+					(*OutDictionaryPhonemes)[i] = TArray<Piper::PhonemeUtf8>(ph.GetData(), ph.Num());
+				}
+				WordsPhonemizedCounter++;
+			}
+		}
+	};
+
+	// Project lexicons
+	TArray<TSharedPtr<const FPhonemeDictionaryTable>, TInlineAllocator<4>> LexiconTables;
+	{
+		FScopeLock Lock(&DictionaryLock);
+		for (const auto& Lexicon : Lexicons)
+		{
+			if (Lexicon->IsUsedForLanguage(LanguageKey))
+			{
+				if (TSharedPtr<const FPhonemeDictionaryTable> Table = Lexicon->GetTable())
+				{
+					LexiconTables.Add(Table);
+				}
+			}
+		}
+	}
+	for (const auto& Table : LexiconTables)
+	{
+		FindWords([&Table](FStringView Word, TConstArrayView<UTF32CHAR>& OutPhonemes) { return Table->Find(Word, OutPhonemes); });
+	}
+
+	// Can use phonemization dictionary? Dictionaries aren't unloaded while they are used here
+	// Otherwise check if the language has dictionary which isn't available right now (loading, building or released for a while)
+	bool bDictionaryPending = false;
+	{
+		FReadScopeLock ResidencyLock(DictionaryResidencyLock);
+		UDictionaryArchive* dict = FindResidentDictionary(LanguageKey);
+		if (dict && dict->IsDictionaryReady())
+		{
+			// Load missing shards of the dictionary at once
+			dict->PrefetchWords(Words);
+			FindWords([dict](FStringView Word, TConstArrayView<UTF32CHAR>& OutPhonemes) { return dict->Find(Word, OutPhonemes); });
+		}
+		else if (dict)
+		{
+			bDictionaryPending = dict->GetDictionaryState() != EDictionaryState::Failed;
+		}
+		else
+		{
+			FScopeLock Lock(&DictionaryLock);
+			const FDictionaryUsage* Usage = DictionaryUsage.Find(LanguageKey);
+			bDictionaryPending = RequestedDictionaries.Contains(LanguageKey) || (Usage && Usage->Voices.Num() > 0);
+		}
+	}
+
+	// Words phonemized by G2P model before (checked after dictionary, so they never shadow its words)
+	const bool bSaveG2PWords = UTtsSettings::Get()->bSaveG2PWords;
+	if (bSaveG2PWords)
+	{
+		if (TSharedPtr<const FPhonemeDictionaryTable> Table = GetG2PWordsTable(LanguageKey))
+		{
+			FindWords([&Table](FStringView Word, TConstArrayView<UTF32CHAR>& OutPhonemes) { return Table->Find(Word, OutPhonemes); });
+		}
+	}
+
+	if (bLookupDone)
+	{
+		// only generate unphonemized words
+		for (int32 i = 0; i < Words.Num(); i++)
+		{
+			if (!WordsPhonemized[i].IsEmpty()) Words[i].Empty();
+		}
+		Words.Remove(TEXT(""));
+
+		if (Words.IsEmpty())
+		{
+			UE_LOG(LogTemp, Log, TEXT("SyncPhonemizeText: done using dictionary."));
+			for (int32 i = 0; i < WordsPhonemized.Num(); i++)
+			{
+				auto& w = WordsPhonemized[i];
+				if (const FString* term = WordTerminators.Find(i)) w.Append(*term);
+				PhonemizedText.Append(w + TEXT(" "));
+			}
+			PhonemizedText.TrimEndInline();
+			OutWords = WordsPhonemized;
+			return;
+		}
+		UE_LOG(LogTemp, Log, TEXT("SyncPhonemizeText: %d of %d words were phonemized using dictionary. Using NNM for %d."), WordsPhonemizedCounter, WordsPhonemized.Num(), Words.Num());
+	}
+
+	// Run G2P model for the words which weren't found in the dictionary
+	TArray<FString> WordsG2P;
+	if (!PhonemizeWordsG2P(Words, InLanguageCode, WordsG2P, bUseCachedDecoder))
+	{
+		return;
+	}
+	// Only save words which are really missing in the dictionary (not just because it's being built or released).
+	// Languages without dictionary (or voices not using it) always save them
+	if (bSaveG2PWords && !bDictionaryPending)
+	{
+		SaveG2PWords(LanguageKey, Words, WordsG2P);
+	}
+
+	// Set to next word which wasn't phonemized
+	int32 InsertIndexNext = INDEX_NONE;
+	while (++InsertIndexNext < WordsPhonemized.Num() && !WordsPhonemized[InsertIndexNext].IsEmpty());
+
+	for (const auto& WordPhonemes : WordsG2P)
+	{
+		WordsPhonemized[InsertIndexNext] = WordPhonemes;
+		// next InsertIndexNext
+		while (++InsertIndexNext < WordsPhonemized.Num() && !WordsPhonemized[InsertIndexNext].IsEmpty());
+	}
+
+	for (const auto& wt : WordTerminators)
+	{
+		WordsPhonemized[wt.Key].Append(wt.Value);
+	}
+
+	OutWords = WordsPhonemized;
+	
+	// set resulted text
+	PhonemizedText.Empty();
+	for (const auto& w : WordsPhonemized)
+	{
+		PhonemizedText.Append(w + TEXT(" "));
+	}
+	PhonemizedText.TrimEndInline();
+}
+
+bool UPhonemizer::PhonemizeWordsG2P(const TArray<FString>& Words, TArray<FString>& OutPhonemes, bool bAllowCachedDecoder)
+{
+	return PhonemizeWordsG2P(Words, LanguageCode, OutPhonemes, bAllowCachedDecoder);
+}
+
+bool UPhonemizer::PhonemizeWordsG2P(const TArray<FString>& Words, const FString& InLanguageCode, TArray<FString>& OutPhonemes, bool bAllowCachedDecoder)
+{
+	using namespace G2PDecoding;
+
+	OutPhonemes.Reset();
+	if (Words.IsEmpty())
+	{
+		return true;
+	}
+
+	// Exclusive access to encoder/decoder instances until phonemization is finished
+	FG2PSession* Session = AcquireSession();
+	if (!Session)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UPhonemizer: G2P model isn't loaded"));
+		return false;
+	}
+	ON_SCOPE_EXIT
+	{
+		ReleaseSession(Session);
+	};
+
+	const FString LanguageTag = GetLanguageTag(InLanguageCode);
+	TArray<std::string> WordsUtf8;
+	WordsUtf8.Reserve(Words.Num());
+	for (const auto& W : Words)
+	{
+		WordsUtf8.Add(std::string(TCHAR_TO_UTF8(*(LanguageTag + TEXT(" ") + W))));
+	}
+
+	// Sort words by length and split them to buckets of similar length to minimize padding
+	TArray<int32> SortedWords;
+	SortedWords.SetNumUninitialized(Words.Num());
+	for (int32 i = 0; i < SortedWords.Num(); i++) SortedWords[i] = i;
+	SortedWords.StableSort([&WordsUtf8](int32 A, int32 B) { return WordsUtf8[A].size() < WordsUtf8[B].size(); });
+
+	OutPhonemes.SetNum(Words.Num());
+	TArray<int32> Bucket;
+	TArray<TArray<int64>> BucketTokens;
+	for (int32 SortedIndex = 0; SortedIndex < SortedWords.Num(); SortedIndex++)
+	{
+		Bucket.Add(SortedWords[SortedIndex]);
+
+		const bool bLastWord = SortedIndex == SortedWords.Num() - 1;
+		const bool bBucketIsFull = Bucket.Num() == MaxBatchSize
+			|| (!bLastWord && WordsUtf8[SortedWords[SortedIndex + 1]].size() > WordsUtf8[Bucket[0]].size() + BucketLengthSpan);
+		if (!bLastWord && !bBucketIsFull)
+		{
+			continue;
+		}
+
+		if (!PhonemizeBucketG2P(*Session, WordsUtf8, Bucket, bAllowCachedDecoder, BucketTokens))
+		{
+			UE_LOG(LogTemp, Log, TEXT("G2P Decoder failed"));
+			OutPhonemes.Reset();
+			return false;
+		}
+
+		// Convert generated bytes to strings
+		for (int32 WordId = 0; WordId < Bucket.Num(); WordId++)
+		{
+			int32 Index = 0;
+			char buffer[MaxLen + 1];
+
+			for (const auto& byte : BucketTokens[WordId])
+			{
+				if (byte >= CharCodeOffset && Index < MaxLen)
+				{
+					buffer[Index] = byte - CharCodeOffset;
+					Index++;
+				}
+			}
+			buffer[Index] = 0;
+			OutPhonemes[Bucket[WordId]] = UTF8_TO_TCHAR(buffer);
+		}
+		Bucket.Reset();
+	}
+
+	return true;
+}
+
+bool UPhonemizer::PhonemizeBucketG2P(FG2PSession& Session, const TArray<std::string>& WordsUtf8, const TArray<int32>& Bucket, bool bAllowCachedDecoder, TArray<TArray<int64>>& OutTokens)
+{
+	using namespace G2PDecoding;
+
+	// Pad input_ids and fill attention_mask
+	const int32 BatchNum = Bucket.Num();
+	int32 MaxWordLength = 0;
+	for (const int32 WordIndex : Bucket)
+	{
+		MaxWordLength = FMath::Max(MaxWordLength, (int32)WordsUtf8[WordIndex].size());
+	}
+
+	TArray<int64> TokenizedWords, AttentionMask;
+	TokenizedWords.SetNumZeroed(MaxWordLength * BatchNum);
+	AttentionMask.SetNumUninitialized(MaxWordLength * BatchNum);
+	for (int32 i = 0; i < BatchNum; i++)
+	{
+		const std::string& s = WordsUtf8[Bucket[i]];
+		for (int32 n = 0; n < MaxWordLength; n++)
+		{
+			if (n < (int32)s.size())
+			{
+				TokenizedWords[i * MaxWordLength + n] = (uint64)(uint8)s[n] + CharCodeOffset;
+				AttentionMask[i * MaxWordLength + n] = 1;
+			}
+			else
+			{
+				AttentionMask[i * MaxWordLength + n] = 0;
+			}
+		}
+	}
+
+	// Decoders compact finished rows of the attention mask and hidden states in place, so keep the original mask to retry
+	TArray<int64> DecoderAttentionMask = AttentionMask;
+	for (int32 Attempt = 0; Attempt < 2; Attempt++)
+	{
+		// Encoder Inputs
+		Session.Encoder.BindInputInt64(0, TokenizedWords.GetData(), TokenizedWords.Num(), { (uint32)BatchNum, (uint32)MaxWordLength });
+		Session.Encoder.BindInputInt64(1, AttentionMask.GetData(), AttentionMask.Num(), { (uint32)BatchNum, (uint32)MaxWordLength });
+		// Encoder Outputs
+		Session.Encoder.PrepareOutputBuffer(BatchNum * MaxWordLength * 1024);
+		// Run, hidden states stay in the encoder's output buffer and are used by decoder directly
+		TArray<float> EncoderOutputsUnused;
+		TArray<uint32> EncoderOutputsShape;
+		if (!Session.Encoder.RunNNE(EncoderOutputsUnused, EncoderOutputsShape, false))
+		{
+			UE_LOG(LogTemp, Log, TEXT("G2P Encoder failed"));
+			return false;
+		}
+
+		if (Attempt == 0 && bAllowCachedDecoder && HasCachedDecoder())
+		{
+			if (DecodeIncremental(Session, BatchNum, MaxWordLength, DecoderAttentionMask, Session.Encoder.OutputData.GetData(), EncoderOutputsShape, OutTokens))
+			{
+				return true;
+			}
+
+			// Retry with the full-sequence decoder
+			UE_LOG(LogTemp, Warning, TEXT("G2P decoder with past key values failed. Switching to full-sequence decoder."));
+			bCachedDecoderFailed = true;
+			DecoderAttentionMask = AttentionMask;
+			continue;
+		}
+
+		return DecodeFullSequence(Session, BatchNum, MaxWordLength, DecoderAttentionMask, Session.Encoder.OutputData.GetData(), EncoderOutputsShape, OutTokens);
+	}
+
+	return false;
+}
+
+bool UPhonemizer::DecodeFullSequence(FG2PSession& Session, int32 BatchNum, int32 SeqLen, TArray<int64>& AttentionMask, float* EncoderOutputs, TArray<uint32> EncoderOutputsShape, TArray<TArray<int64>>& OutTokens)
+{
+	using namespace G2PDecoding;
+
+	OutTokens.SetNum(BatchNum); // init with pad tokens; will remove later
+	for (auto& W : OutTokens) W.Init(TokenPad, 1);
+
+	// Words which are still generated: index in the batch to index in OutTokens
+	TArray<int32> ActiveRows, KeptRows;
+	ActiveRows.SetNumUninitialized(BatchNum);
+	for (int32 i = 0; i < BatchNum; i++) ActiveRows[i] = i;
+	TArray<int64> NextTokens;
+	NextTokens.SetNumUninitialized(BatchNum);
+
+	TArray<int64> DecoderInputIds_Data;
+	DecoderInputIds_Data.Reserve(BatchNum * MaxLen);
+
+	// Constant inputs are bound once and only rebound when the batch shrinks
+	const int32 HiddenSize = (int32)EncoderOutputsShape[2];
+	Session.Decoder.BindInputInt64(0, AttentionMask.GetData(), AttentionMask.Num(), { (uint32)BatchNum, (uint32)SeqLen });	// encoder_attention_mask	(10, 15)
+	Session.Decoder.BindInputFloat(2, EncoderOutputs, (int64)BatchNum * SeqLen * HiddenSize, EncoderOutputsShape);				// encoder_hidden_states	(10, 15, 256)
+	// Output buffer is enough for the longest sequence
+	Session.Decoder.PrepareOutputBuffer(BatchNum * VocabBufferSize * MaxLen);
+
+	for (int32 Step = 0; Step < MaxLen; Step++)
+	{
+		const int32 ActiveNum = ActiveRows.Num();
+		const int32 SequenceLength = Step + 1;
+
+		// Decoder Inputs
+		DecoderInputIds_Data.SetNumUninitialized(ActiveNum * SequenceLength, EAllowShrinking::No);
+		for (int32 Row = 0; Row < ActiveNum; Row++)
+		{
+			FMemory::Memcpy(&DecoderInputIds_Data[Row * SequenceLength], OutTokens[ActiveRows[Row]].GetData(), SequenceLength * sizeof(int64));
+		}
+		Session.Decoder.BindInputInt64(1, DecoderInputIds_Data.GetData(), DecoderInputIds_Data.Num(), { (uint32)ActiveNum, (uint32)SequenceLength });	// input_ids	(10, 1...)
+
+		// Run
+		TArray<float> LogitsUnused;
+		TArray<uint32> LogitsShape; // (0: batch_size, 1: decoder_seq_len, 2: vocab_size)
+		if (!Session.Decoder.RunNNE(LogitsUnused, LogitsShape, false))
+		{
+			return false;
+		}
+
+		// Read generated tokens in the current step: extract logits for the latest data in sequence and do ArgMax
+		const int32 VocabSize = (int32)LogitsShape[2];
+		SelectNextTokens(Session.Decoder.OutputData.GetData() + (SequenceLength - 1) * VocabSize, SequenceLength * VocabSize, VocabSize, ActiveNum, NextTokens);
+
+		// Update DecoderInputIds, drop finished words
+		KeptRows.Reset();
+		for (int32 Row = 0; Row < ActiveNum; Row++)
+		{
+			if (NextTokens[Row] != TokenEOS)
+			{
+				OutTokens[ActiveRows[Row]].Add(NextTokens[Row]);
+				KeptRows.Add(Row);
+			}
+		}
+
+		// Everything is generated
+		if (KeptRows.IsEmpty())
+		{
+			break;
+		}
+
+		if (KeptRows.Num() < ActiveNum)
+		{
+			CompactRows(ActiveRows.GetData(), 1, KeptRows);
+			CompactRows(AttentionMask.GetData(), SeqLen, KeptRows);
+			CompactRows(EncoderOutputs, SeqLen * HiddenSize, KeptRows);
+			ActiveRows.SetNum(KeptRows.Num(), EAllowShrinking::No);
+			EncoderOutputsShape[0] = (uint32)KeptRows.Num();
+
+			Session.Decoder.BindInputInt64(0, AttentionMask.GetData(), KeptRows.Num() * SeqLen, { (uint32)KeptRows.Num(), (uint32)SeqLen });
+			Session.Decoder.BindInputFloat(2, EncoderOutputs, (int64)KeptRows.Num() * SeqLen * HiddenSize, EncoderOutputsShape);
+		}
+	}
+
+	return true;
+}
+
+/*
+* Decoder with past key values:
+* inputs:  0 - encoder_attention_mask (batch, seq), 1 - input_ids (batch, 1), 2 - encoder_hidden_states (batch, seq, hidden),
+*          3... - past self-attention keys/values (batch, heads, past_seq, head_size)
+* outputs: 0 - logits (batch, 1, vocab), 1... - present keys/values (batch, heads, past_seq + 1, head_size) in the same order as past inputs
+*/
+bool UPhonemizer::DecodeIncremental(FG2PSession& Session, int32 BatchNum, int32 SeqLen, TArray<int64>& AttentionMask, float* EncoderOutputs, TArray<uint32> EncoderOutputsShape, TArray<TArray<int64>>& OutTokens)
+{
+	using namespace G2PDecoding;
+
+	const int32 PastNum = DecoderPastShapes.Num();
+
+	// Cache is empty before the first step, reserve memory for all steps
+	for (int32 i = 0; i < PastNum; i++)
+	{
+		const int32 MaxCacheSize = BatchNum * DecoderPastShapes[i].X * MaxLen * DecoderPastShapes[i].Y;
+		Session.DecoderWithPast.GetInParamFloatUnsafe(PastInputOffset + i).Reset(MaxCacheSize);
+		Session.DecoderWithPast.ExtraOutputData[i].Reset(MaxCacheSize);
+	}
+
+	OutTokens.SetNum(BatchNum);
+	for (auto& W : OutTokens) W.Init(TokenPad, 1);
+
+	// Words which are still generated: index in the batch to index in OutTokens
+	TArray<int32> ActiveRows, KeptRows;
+	ActiveRows.SetNumUninitialized(BatchNum);
+	for (int32 i = 0; i < BatchNum; i++) ActiveRows[i] = i;
+
+	TArray<int64> InputIds;
+	InputIds.Init(TokenPad, BatchNum);
+	TArray<int64> NextTokens;
+	NextTokens.SetNumUninitialized(BatchNum);
+
+	// Constant inputs are bound once and only rebound when the batch shrinks
+	const int32 HiddenSize = (int32)EncoderOutputsShape[2];
+	Session.DecoderWithPast.BindInputInt64(0, AttentionMask.GetData(), AttentionMask.Num(), { (uint32)BatchNum, (uint32)SeqLen });
+	Session.DecoderWithPast.BindInputInt64(1, InputIds.GetData(), InputIds.Num(), { (uint32)BatchNum, 1 });
+	Session.DecoderWithPast.BindInputFloat(2, EncoderOutputs, (int64)BatchNum * SeqLen * HiddenSize, EncoderOutputsShape);
+	// Decoder Outputs: logits for one position
+	Session.DecoderWithPast.PrepareOutputBuffer(BatchNum * VocabBufferSize);
+
+	for (int32 Step = 0; Step < MaxLen; Step++)
+	{
+		const int32 ActiveNum = ActiveRows.Num();
+
+		// Decoder Inputs: past is the previous step's present, bind it without copying
+		for (int32 i = 0; i < PastNum; i++)
+		{
+			const uint32 Heads = (uint32)DecoderPastShapes[i].X;
+			const uint32 HeadSize = (uint32)DecoderPastShapes[i].Y;
+			const int32 InputIndex = PastInputOffset + i;
+
+			TArray<float>& Past = Session.DecoderWithPast.GetInParamFloatUnsafe(InputIndex);
+			Session.DecoderWithPast.InputBindings[InputIndex].Data = Past.GetData();
+			Session.DecoderWithPast.InputBindings[InputIndex].SizeInBytes = (uint64)Past.Num() * sizeof(float);
+			Session.DecoderWithPast.InputTensorShapes[InputIndex] = UE::NNE::FTensorShape::Make({ (uint32)ActiveNum, Heads, (uint32)Step, HeadSize });
+
+			Session.DecoderWithPast.PrepareExtraOutputBuffer(i + 1, ActiveNum * Heads * (Step + 1) * HeadSize);
+		}
+
+		// Run
+		TArray<float> LogitsUnused;
+		TArray<uint32> LogitsShape; // (0: batch_size, 1: 1, 2: vocab_size)
+		if (!Session.DecoderWithPast.RunNNE(LogitsUnused, LogitsShape, false))
+		{
+			return false;
+		}
+
+		const int32 VocabSize = (int32)LogitsShape[2];
+		SelectNextTokens(Session.DecoderWithPast.OutputData.GetData(), (int32)LogitsShape[1] * VocabSize, VocabSize, ActiveNum, NextTokens);
+
+		// Update generated words, drop finished words
+		KeptRows.Reset();
+		for (int32 Row = 0; Row < ActiveNum; Row++)
+		{
+			if (NextTokens[Row] != TokenEOS)
+			{
+				OutTokens[ActiveRows[Row]].Add(NextTokens[Row]);
+				InputIds[KeptRows.Num()] = NextTokens[Row];
+				KeptRows.Add(Row);
+			}
+		}
+
+		// Everything is generated
+		if (KeptRows.IsEmpty())
+		{
+			break;
+		}
+
+		// Present becomes past for the next step
+		for (int32 i = 0; i < PastNum; i++)
+		{
+			TArray<float>& Past = Session.DecoderWithPast.GetInParamFloatUnsafe(PastInputOffset + i);
+			Swap(Past, Session.DecoderWithPast.ExtraOutputData[i]);
+
+			if (KeptRows.Num() < ActiveNum)
+			{
+				const int32 RowSize = DecoderPastShapes[i].X * (Step + 1) * DecoderPastShapes[i].Y;
+				CompactRows(Past.GetData(), RowSize, KeptRows);
+				Past.SetNum(KeptRows.Num() * RowSize, EAllowShrinking::No);
+			}
+		}
+
+		if (KeptRows.Num() < ActiveNum)
+		{
+			CompactRows(ActiveRows.GetData(), 1, KeptRows);
+			CompactRows(AttentionMask.GetData(), SeqLen, KeptRows);
+			CompactRows(EncoderOutputs, SeqLen * HiddenSize, KeptRows);
+			ActiveRows.SetNum(KeptRows.Num(), EAllowShrinking::No);
+			EncoderOutputsShape[0] = (uint32)KeptRows.Num();
+
+			Session.DecoderWithPast.BindInputInt64(0, AttentionMask.GetData(), KeptRows.Num() * SeqLen, { (uint32)KeptRows.Num(), (uint32)SeqLen });
+			Session.DecoderWithPast.BindInputInt64(1, InputIds.GetData(), KeptRows.Num(), { (uint32)KeptRows.Num(), 1 });
+			Session.DecoderWithPast.BindInputFloat(2, EncoderOutputs, (int64)KeptRows.Num() * SeqLen * HiddenSize, EncoderOutputsShape);
+		}
+	}
+
+	return true;
+}
+
+void UPhonemizer::SelectNextTokens(const float* Logits, int32 RowStride, int32 VocabSize, int32 RowsNum, TArray<int64>& OutNextTokens) const
+{
+	for (int32 Row = 0; Row < RowsNum; Row++)
+	{
+		OutNextTokens[Row] = LocalTtsMath::ArgMax(Logits + (int64)Row * RowStride, VocabSize);
+	}
+}
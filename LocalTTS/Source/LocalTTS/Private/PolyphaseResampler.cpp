@@ -0,0 +1,152 @@
+// (c) Yuri N. K. 2025. All rights reserved.
+// ykasczc@gmail.com
+
+#include "PolyphaseResampler.h"
+
+TSharedPtr<const FPolyphaseFilterBank> FPolyphaseFilterBank::Create(int32 InRate, int32 OutRate, int32 TapsNum)
+{
+	if (InRate <= 0 || OutRate <= 0)
+	{
+		return nullptr;
+	}
+
+	const int32 Gcd = (int32)FMath::GreatestCommonDivisor(InRate, OutRate);
+	const int32 Up = OutRate / Gcd;
+	const int32 Down = InRate / Gcd;
+	if (Up > MaxPhasesNum)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FPolyphaseFilterBank: can't resample %d Hz to %d Hz, ratio is too complex"), InRate, OutRate);
+		return nullptr;
+	}
+
+	TSharedPtr<FPolyphaseFilterBank> Bank = MakeShared<FPolyphaseFilterBank>();
+	Bank->InRate = InRate;
+	Bank->OutRate = OutRate;
+	Bank->Up = Up;
+	Bank->Down = Down;
+	Bank->TapsNum = FMath::Max(4, Align(TapsNum, 4));
+	Bank->Coefficients.SetNumUninitialized(Up * Bank->TapsNum);
+
+	// Cutoff relative to input Nyquist frequency, with small transition band below the lowest Nyquist
+	const int32 HalfTaps = Bank->TapsNum / 2;
+	const double Cutoff = FMath::Min(1.0, (double)OutRate / (double)InRate) * 0.94;
+
+	for (int32 Phase = 0; Phase < Up; Phase++)
+	{
+		float* Taps = Bank->Coefficients.GetData() + (int64)Phase * Bank->TapsNum;
+		double Sum = 0.0;
+		for (int32 i = 0; i < Bank->TapsNum; i++)
+		{
+			// Distance (in input samples) between output sample and input sample multiplied by Taps[i]
+			const double X = (double)(i - Bank->TapsNum + 1 + HalfTaps) - (double)Phase / (double)Up;
+			const double SincArg = UE_DOUBLE_PI * Cutoff * X;
+			const double Sinc = FMath::Abs(SincArg) < 1e-9 ? 1.0 : FMath::Sin(SincArg) / SincArg;
+
+			// Blackman window
+			const double U = FMath::Clamp(X / (double)(HalfTaps + 1), -1.0, 1.0);
+			const double Window = 0.42 + 0.5 * FMath::Cos(UE_DOUBLE_PI * U) + 0.08 * FMath::Cos(2.0 * UE_DOUBLE_PI * U);
+
+			Taps[i] = (float)(Cutoff * Sinc * Window);
+			Sum += Taps[i];
+		}
+
+		// Unity gain for each phase
+		const float Norm = Sum != 0.0 ? (float)(1.0 / Sum) : 1.f;
+		for (int32 i = 0; i < Bank->TapsNum; i++)
+		{
+			Taps[i] *= Norm;
+		}
+	}
+
+	return Bank;
+}
+
+FPolyphaseResampler::FPolyphaseResampler(TSharedPtr<const FPolyphaseFilterBank> InFilterBank)
+	: FilterBank(InFilterBank)
+{
+	check(FilterBank.IsValid());
+	Reset();
+}
+
+void FPolyphaseResampler::Reset()
+{
+	// Zeros before the first sample
+	History.SetNumZeroed(FilterBank->TapsNum);
+	HistoryStart = -FilterBank->TapsNum;
+	InputNum = 0;
+	OutputIndex = 0;
+}
+
+void FPolyphaseResampler::Process(const float* Data, int32 Num, Audio::FAlignedFloatBuffer& OutData)
+{
+	History.Append(Data, Num);
+	InputNum += Num;
+
+	// Output sample needs TapsNum / 2 input samples after it
+	ProduceOutput(InputNum - FilterBank->TapsNum / 2, MAX_int64, OutData);
+}
+
+void FPolyphaseResampler::ProcessSilence(int32 Num, Audio::FAlignedFloatBuffer& OutData)
+{
+	History.AddZeroed(Num);
+	InputNum += Num;
+
+	ProduceOutput(InputNum - FilterBank->TapsNum / 2, MAX_int64, OutData);
+}
+
+void FPolyphaseResampler::Flush(Audio::FAlignedFloatBuffer& OutData)
+{
+	// Zeros after the last sample
+	History.AddZeroed(FilterBank->TapsNum / 2);
+	ProduceOutput(InputNum, GetOutputNum(InputNum), OutData);
+}
+
+void FPolyphaseResampler::ProduceOutput(int64 InputEnd, int64 OutputEnd, Audio::FAlignedFloatBuffer& OutData)
+{
+	const int32 Up = FilterBank->Up;
+	const int32 Down = FilterBank->Down;
+	const int32 TapsNum = FilterBank->TapsNum;
+	const int32 HalfTaps = TapsNum / 2;
+
+	// Number of output samples which can be computed now
+	int64 LastOutput = InputEnd > 0 ? ((InputEnd - 1) * Up) / Down : -1;
+	LastOutput = FMath::Min(LastOutput, OutputEnd - 1);
+	if (LastOutput < OutputIndex)
+	{
+		return;
+	}
+
+	const int32 StartNum = OutData.Num();
+	OutData.AddUninitialized((int32)(LastOutput - OutputIndex + 1));
+	float* Dest = OutData.GetData() + StartNum;
+
+	for (; OutputIndex <= LastOutput; OutputIndex++)
+	{
+		const int64 Position = OutputIndex * Down;
+		const int64 Base = Position / Up;
+		const int32 Phase = (int32)(Position - Base * Up);
+
+		const float* Taps = FilterBank->GetPhase(Phase);
+		const float* Input = History.GetData() + (Base + HalfTaps - TapsNum + 1 - HistoryStart);
+
+		// Dot product, 4 taps per iteration
+		VectorRegister4Float VSum = VectorZeroFloat();
+		for (int32 i = 0; i < TapsNum; i += 4)
+		{
+			VSum = VectorMultiplyAdd(VectorLoad(Input + i), VectorLoad(Taps + i), VSum);
+		}
+		alignas(16) float Lanes[4];
+		VectorStoreAligned(VSum, Lanes);
+		*Dest++ = (Lanes[0] + Lanes[1]) + (Lanes[2] + Lanes[3]);
+	}
+
+	// Drop input which isn't needed anymore
+	const int64 NextBase = (OutputIndex * Down) / Up;
+	const int64 KeepFrom = NextBase + HalfTaps - TapsNum + 1;
+	const int32 DropNum = (int32)FMath::Clamp(KeepFrom - HistoryStart, (int64)0, (int64)History.Num());
+	if (DropNum > 0)
+	{
+		History.RemoveAt(0, DropNum, EAllowShrinking::No);
+		HistoryStart += DropNum;
+	}
+}
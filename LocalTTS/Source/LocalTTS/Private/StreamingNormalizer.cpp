@@ -0,0 +1,117 @@
+// (c) Yuri N. K. 2025. All rights reserved.
+// ykasczc@gmail.com
+
+#include "StreamingNormalizer.h"
+#include "LocalTTSTypes.h"
+
+FStreamingNormalizer::FStreamingNormalizer(int32 SampleRate, float LookAheadSeconds, float ReleaseSeconds, float InMinPeak)
+{
+	const float BlockSeconds = (float)BlockSize / (float)FMath::Max(1, SampleRate);
+	LookAheadBlocks = FMath::Max(1, FMath::CeilToInt32(LookAheadSeconds / BlockSeconds));
+	ReleaseStep = ReleaseSeconds > 0.f ? FMath::Pow(2.f, BlockSeconds / ReleaseSeconds) : 1.f;
+	MinPeak = FMath::Max(InMinPeak, UE_SMALL_NUMBER);
+}
+
+void FStreamingNormalizer::Process(const float* Data, int32 Num, Audio::FAlignedFloatBuffer& OutData)
+{
+	if (Num <= 0)
+	{
+		return;
+	}
+	Pending.Append(Data, Num);
+
+	// Peaks of new complete blocks
+	const int32 CompleteBlocksNum = Pending.Num() / BlockSize;
+	for (int32 Block = BlockPeaks.Num(); Block < CompleteBlocksNum; Block++)
+	{
+		BlockPeaks.Add(LocalTtsMath::AbsMax(Pending.GetData() + Block * BlockSize, BlockSize));
+	}
+
+	// Gain at the end of block depends on LookAheadBlocks blocks after it
+	const int32 ReadyBlocksNum = CompleteBlocksNum - LookAheadBlocks - 1;
+	if (ReadyBlocksNum > 0)
+	{
+		ProduceOutput(ReadyBlocksNum, OutData);
+	}
+}
+
+void FStreamingNormalizer::Flush(Audio::FAlignedFloatBuffer& OutData)
+{
+	if (Pending.Num() > BlockPeaks.Num() * BlockSize)
+	{
+		const int32 Start = BlockPeaks.Num() * BlockSize;
+		BlockPeaks.Add(LocalTtsMath::AbsMax(Pending.GetData() + Start, Pending.Num() - Start));
+	}
+	ProduceOutput(BlockPeaks.Num(), OutData);
+	Reset();
+}
+
+void FStreamingNormalizer::Reset()
+{
+	Pending.Reset();
+	BlockPeaks.Reset();
+	LastPeak = 0.f;
+	Gain = -1.f;
+}
+
+float FStreamingNormalizer::GetPeak(int32 Block) const
+{
+	if (Block < 0)
+	{
+		return LastPeak;
+	}
+	return BlockPeaks.IsValidIndex(Block) ? BlockPeaks[Block] : 0.f;
+}
+
+float FStreamingNormalizer::GetRequiredGain(int32 Block) const
+{
+	return 1.f / FMath::Max(MinPeak, FMath::Max(GetPeak(Block - 1), GetPeak(Block)));
+}
+
+void FStreamingNormalizer::ProduceOutput(int32 BlocksNum, Audio::FAlignedFloatBuffer& OutData)
+{
+	if (BlocksNum <= 0)
+	{
+		return;
+	}
+
+	if (Gain < 0.f)
+	{
+		// Start of stream: use look-ahead window as is
+		Gain = GetRequiredGain(0);
+		for (int32 j = 1; j <= LookAheadBlocks; j++)
+		{
+			Gain = FMath::Min(Gain, GetRequiredGain(j));
+		}
+	}
+
+	const int32 OutStart = OutData.Num();
+	const int32 SamplesNum = FMath::Min(BlocksNum * BlockSize, Pending.Num());
+	OutData.AddUninitialized(SamplesNum);
+	float* Out = OutData.GetData() + OutStart;
+
+	for (int32 Block = 0; Block < BlocksNum; Block++)
+	{
+		// Gain at the next block boundary: release slowly, but reach required gain of every block in the window in time.
+		// Both boundary gains of the block don't exceed its own required gain, so linear ramp between them doesn't clip
+		float NextGain = Gain * ReleaseStep;
+		for (int32 j = 0; j <= LookAheadBlocks; j++)
+		{
+			NextGain = FMath::Min(NextGain, Gain + (GetRequiredGain(Block + 1 + j) - Gain) / (float)(j + 1));
+		}
+
+		const int32 Start = Block * BlockSize;
+		const int32 Num = FMath::Min(BlockSize, SamplesNum - Start);
+		const float Step = (NextGain - Gain) / (float)BlockSize;
+		const float* In = Pending.GetData() + Start;
+		for (int32 i = 0; i < Num; i++)
+		{
+			Out[Start + i] = In[i] * (Gain + Step * (float)i);
+		}
+		Gain = NextGain;
+	}
+
+	LastPeak = BlockPeaks[BlocksNum - 1];
+	Pending.RemoveAt(0, SamplesNum, EAllowShrinking::No);
+	BlockPeaks.RemoveAt(0, BlocksNum, EAllowShrinking::No);
+}
@@ -1,287 +1,535 @@
-// (c) Yuri N. K. 2025. All rights reserved.
-// ykasczc@gmail.com
-
-#include "TTSModelData_Base.h"
-#include "Modules/ModuleManager.h"
-#include "LocalTTSModule.h"
-#include "LocalTTSSubsystem.h"
-#include "Phonemizer.h"
-#include "Engine/Engine.h"
-//#include "espeak-ng/speak_lib.h"
-#include "uni_algo.h"
-
-#include <string>
-#include <vector>
-
-#define CLAUSE_INTONATION_FULL_STOP 0x00000000
-#define CLAUSE_INTONATION_COMMA 0x00001000
-#define CLAUSE_INTONATION_QUESTION 0x00002000
-#define CLAUSE_INTONATION_EXCLAMATION 0x00003000
-
-#define CLAUSE_TYPE_CLAUSE 0x00040000
-#define CLAUSE_TYPE_SENTENCE 0x00080000
-
-#define CLAUSE_PERIOD (40 | CLAUSE_INTONATION_FULL_STOP | CLAUSE_TYPE_SENTENCE)
-#define CLAUSE_COMMA (20 | CLAUSE_INTONATION_COMMA | CLAUSE_TYPE_CLAUSE)
-#define CLAUSE_QUESTION (40 | CLAUSE_INTONATION_QUESTION | CLAUSE_TYPE_SENTENCE)
-#define CLAUSE_EXCLAMATION                                                     \
-  (45 | CLAUSE_INTONATION_EXCLAMATION | CLAUSE_TYPE_SENTENCE)
-#define CLAUSE_COLON (30 | CLAUSE_INTONATION_FULL_STOP | CLAUSE_TYPE_CLAUSE)
-#define CLAUSE_SEMICOLON (30 | CLAUSE_INTONATION_COMMA | CLAUSE_TYPE_CLAUSE)
-
-/*
-* The idea is to use differet tokenizer assets inherited from UTTSTokenizerBase for different TTS systems,
-* But right now the only supported TTS is piper (https://github.com/rhasspy/piper).
-* Another possible local TTS which can be added in a future is KokoroTTS (https://huggingface.co/hexgrad/Kokoro-82M).
-* While it provides better quality of the audio, currenly it support 8 languages, and piper supports 36 languages.
-*/
-
-UTTSModelData_Base::UTTSModelData_Base()
-{
-#if ESPEAK_NG
-    PhonemizationType = ETTSPhonemeType::PT_eSpeak;
-#else
-    PhonemizationType = ETTSPhonemeType::PT_Dictionary;
-#endif
-}
-
-bool UTTSModelData_Base::PhonemizeText(const FString& InText, FString& OutText, int32 SpeakerId, TArray<TArray<Piper::PhonemeUtf8>>& Phonemes, bool bCastCharactersAsWords)
-{
-    auto ModuleTts = FModuleManager::GetModulePtr<FLocalTTSModule>(TEXT("LocalTTS"));
-    if (!ModuleTts->IsLoaded()) return false;
-
-    ULocalTTSSubsystem* LocalTTS = GEngine->GetEngineSubsystem<ULocalTTSSubsystem>();
-    UPhonemizer* Phonemizer = LocalTTS->GetPhonemizer();
-
-    FString VoiceCode = GetEspeakCode(SpeakerId);
-    int32 Result;
-    if (PhonemizationType == ETTSPhonemeType::PT_eSpeak)
-    {
-        Result = ModuleTts->func_espeak_SetVoiceByName(TCHAR_TO_ANSI(*VoiceCode));
-    }
-    else //if (PhonemizationType == ETTSPhonemeType::PT_NNM)
-    {
-        Result = Phonemizer->SetLanguageCodeFormatEspeak(VoiceCode, PhonemizationType == ETTSPhonemeType::PT_Dictionary) ? 0 : 1;
-    }
-    if (Result != 0)
-    {
-        UE_LOG(LogTemp, Warning, TEXT("Failed to set phonemizer voice: \"%s\" (default is %s)"), *VoiceCode, *ESpeakVoiceCode);
-        return false;
-    }
-
-    // Modified by eSpeak
-    std::string textCopy(TCHAR_TO_UTF8(*InText));
-
-    TArray<Piper::PhonemeUtf8>* SentencePhonemes = nullptr;
-    // eSpeak
-    const char* InputTextPointer = textCopy.c_str();
-    int Terminator = 0;
-    // non-eSpeak
-    TArray<FString> WordsPhonemizedWithTerminators;
-    TSet<FString> Terminators = { TEXT("."), TEXT(","), TEXT("?"), TEXT("!") };
-    int32 InputWordIndex = 0;
-    FString TerminatorChar;
-    if (PhonemizationType != ETTSPhonemeType::PT_eSpeak)
-    {
-        Phonemizer->SyncPhonemizeText(InText.ToLower(), OutText, WordsPhonemizedWithTerminators, bCastCharactersAsWords);
-    }
-
-    while (InputTextPointer != NULL)
-    {
-        std::string clausePhonemes;
-        if (PhonemizationType == ETTSPhonemeType::PT_eSpeak)
-        {
-            // Modified espeak-ng API to get access to clause terminator
-            std::string clausePhonemesRaw(ModuleTts->func_espeak_TextToPhonemesWithTerminator((const void**)&InputTextPointer, espeakCHARS_AUTO, 0x02, &Terminator));
-            clausePhonemes = clausePhonemesRaw;
-#if PLATFORM_ANDROID
-            char chrTerminator[2] = { '0', '0' };
-            clausePhonemes.append(chrTerminator);
-#endif
-            OutText.Append(UTF8_TO_TCHAR(clausePhonemes.c_str()));
-        }
-        else //if (PhonemizationType == ETTSPhonemeType::PT_NNM)
-        {
-            FString NextWord = WordsPhonemizedWithTerminators[InputWordIndex].TrimEnd();
-            TerminatorChar = TEXT(" ");
-            for (const auto& t : Terminators)
-            {
-                if (NextWord.EndsWith(t))
-                {
-                    TerminatorChar = t; break;
-                }
-            }
-            if (NextWord.EndsWith(TerminatorChar))
-            {
-                NextWord.LeftChopInline(1);
-            }
-            std::string clausePhonemesRaw(TCHAR_TO_UTF8(*NextWord));
-            clausePhonemes = clausePhonemesRaw;
-
-            if (++InputWordIndex == WordsPhonemizedWithTerminators.Num())
-            {
-                InputTextPointer = NULL;
-            }
-        }
-
-        auto PhonemesNorm = una::norm::to_nfd_utf8(clausePhonemes);
-        auto PhonemesRange = una::ranges::utf8_view{ PhonemesNorm };
-
-        if (!SentencePhonemes)
-        {
-            // Start new sentence
-            Phonemes.AddDefaulted();
-            SentencePhonemes = &Phonemes[Phonemes.Num() - 1];
-        }
-
-        std::vector<Piper::PhonemeUtf8> MappedSentPhonemes;
-        MappedSentPhonemes.insert(MappedSentPhonemes.end(), PhonemesRange.begin(), PhonemesRange.end());
-
-        auto phonemeIter = MappedSentPhonemes.begin();
-        auto phonemeEnd = MappedSentPhonemes.end();
-
-        // Filter out (lang) switch (flags).
-        // These surround words from languages other than the current voice.
-        bool inLanguageFlag = false;
-
-        while (phonemeIter != phonemeEnd)
-        {
-            if (inLanguageFlag)
-            {
-                if (*phonemeIter == U')')
-                {
-                    // End of (lang) switch
-                    inLanguageFlag = false;
-                }
-            }
-            else if (*phonemeIter == U'(')
-            {
-                // Start of (lang) switch
-                inLanguageFlag = true;
-            }
-            else
-            {
-                SentencePhonemes->Add(*phonemeIter);
-            }
-
-            phonemeIter++;
-        }
-
-        // Add appropriate punctuation depending on terminator type
-        if (PhonemizationType == ETTSPhonemeType::PT_eSpeak)
-        {
-            int punctuation = Terminator & 0x000FFFFF;
-            if (punctuation == CLAUSE_PERIOD)
-            {
-                SentencePhonemes->Add(P_Period);
-            }
-            else if (punctuation == CLAUSE_QUESTION)
-            {
-                SentencePhonemes->Add(P_Question);
-            }
-            else if (punctuation == CLAUSE_EXCLAMATION)
-            {
-                SentencePhonemes->Add(P_Exclamation);
-            }
-            else if (punctuation == CLAUSE_COMMA)
-            {
-                SentencePhonemes->Add(P_Comma);
-                SentencePhonemes->Add(P_Space);
-            }
-            else if (punctuation == CLAUSE_COLON)
-            {
-                SentencePhonemes->Add(P_Colon);
-                SentencePhonemes->Add(P_Space);
-            }
-            else if (punctuation == CLAUSE_SEMICOLON)
-            {
-                SentencePhonemes->Add(P_Semicolon);
-                SentencePhonemes->Add(P_Space);
-            }
-
-            if ((Terminator & CLAUSE_TYPE_SENTENCE) == CLAUSE_TYPE_SENTENCE)
-            {
-                // End of sentence
-                SentencePhonemes = nullptr;
-            }
-        }
-        else // Dictionary, NNE
-        {
-            if (TerminatorChar == TEXT("."))
-            {
-                SentencePhonemes->Add(P_Period);
-            }
-            else if (TerminatorChar == TEXT("?"))
-            {
-                SentencePhonemes->Add(P_Question);
-            }
-            else if (TerminatorChar == TEXT("!"))
-            {
-                SentencePhonemes->Add(P_Exclamation);
-            }
-            else if (TerminatorChar == TEXT(","))
-            {
-                SentencePhonemes->Add(P_Comma);
-                SentencePhonemes->Add(P_Space);
-            }
-            else if (TerminatorChar == TEXT(" "))
-            {
-                SentencePhonemes->Add(P_Space);
-            }
-
-            if (TerminatorChar != TEXT(",") && TerminatorChar != TEXT(" "))
-            {
-                if (!SentencePhonemes->IsEmpty())
-                {
-                    // End of sentence
-                    SentencePhonemes = nullptr;
-                }
-            }
-        }
-    } // while inputTextPointer != NULL
-
-    return true;
-}
-
-FString UTTSModelData_Base::GetEspeakCode(int32 SpeakerId) const
-{
-    return ESpeakVoiceCode;
-}
-
-bool UTTSModelData_Base::Tokenize(const TArray<Piper::PhonemeUtf8>& Phonemes, TArray<Piper::PhonemeId>& OutTokens, TMap<Piper::PhonemeUtf8, int32>& OutMissedPhonemes, bool bFirst, bool bLast)
-{
-    return false;
-}
-
-bool UTTSModelData_Base::SetNNEInputParams(FNNEModelTTS& NNModel, const FTTSGenerateRequestContext& Context) const
-{
-    return false;
-}
-
-void UTTSModelData_Base::EnsurePhonemesMap()
-{
-    if (PhonemeIdMap.Num() < TokenToId.Num())
-    {
-        PhonemeIdMap.Empty();
-        for (const auto& Binding : TokenToId)
-        {
-            FString strchar = Binding.Key;
-            if (strchar.Len() == 0) continue;
-
-            std::string s = TCHAR_TO_UTF8(*strchar);
-
-            auto PhonemesNorm = una::norm::to_nfd_utf8(s);
-            auto PhonemesRange = una::ranges::utf8_view{ PhonemesNorm };
-
-            Piper::PhonemeUtf8 Phoneme = *PhonemesRange.begin();
-            TArray<Piper::PhonemeId> Ids;
-            Ids.SetNum(Binding.Value.Tokens.Num());
-            for (int32 i = 0; i < Ids.Num(); i++)
-            {
-                Ids[i] = (Piper::PhonemeId)Binding.Value.Tokens[i];
-            }
-
-            PhonemeIdMap.Add(Phoneme, Ids);
-        }
-    }
-}
+// (c) Yuri N. K. 2025. All rights reserved.
+// ykasczc@gmail.com
+
+#include "TTSModelData_Base.h"
+#include "Modules/ModuleManager.h"
+#include "LocalTTSModule.h"
+#include "LocalTTSSubsystem.h"
+#include "Phonemizer.h"
+#include "Engine/Engine.h"
+#include "Misc/ScopeExit.h"
+//#include "espeak-ng/speak_lib.h"
+#include "uni_algo.h"
+
+#include <string>
+#include <vector>
+
+#define CLAUSE_INTONATION_FULL_STOP 0x00000000
+#define CLAUSE_INTONATION_COMMA 0x00001000
+#define CLAUSE_INTONATION_QUESTION 0x00002000
+#define CLAUSE_INTONATION_EXCLAMATION 0x00003000
+
+#define CLAUSE_TYPE_CLAUSE 0x00040000
+#define CLAUSE_TYPE_SENTENCE 0x00080000
+
+#define CLAUSE_PERIOD (40 | CLAUSE_INTONATION_FULL_STOP | CLAUSE_TYPE_SENTENCE)
+#define CLAUSE_COMMA (20 | CLAUSE_INTONATION_COMMA | CLAUSE_TYPE_CLAUSE)
+#define CLAUSE_QUESTION (40 | CLAUSE_INTONATION_QUESTION | CLAUSE_TYPE_SENTENCE)
+#define CLAUSE_EXCLAMATION                                                     \
+  (45 | CLAUSE_INTONATION_EXCLAMATION | CLAUSE_TYPE_SENTENCE)
+#define CLAUSE_COLON (30 | CLAUSE_INTONATION_FULL_STOP | CLAUSE_TYPE_CLAUSE)
+#define CLAUSE_SEMICOLON (30 | CLAUSE_INTONATION_COMMA | CLAUSE_TYPE_CLAUSE)
+
+/*
+* The idea is to use differet tokenizer assets inherited from UTTSTokenizerBase for different TTS systems,
+* But right now the only supported TTS is piper (https://github.com/rhasspy/piper).
+* Another possible local TTS which can be added in a future is KokoroTTS (https://huggingface.co/hexgrad/Kokoro-82M).
+* While it provides better quality of the audio, currenly it support 8 languages, and piper supports 36 languages.
+*/
+
+UTTSModelData_Base::UTTSModelData_Base()
+{
+#if ESPEAK_NG
+    PhonemizationType = ETTSPhonemeType::PT_eSpeak;
+#else
+    PhonemizationType = ETTSPhonemeType::PT_Dictionary;
+#endif
+}
+
+void FPhonemeTokenTable::Build(const TMap<FString, FTokensArrayWrapper>& TokenToId)
+{
+    Reset();
+    Dense.SetNumZeroed(DenseRange);
+    Spans.Reserve(TokenToId.Num());
+
+    for (const auto& Binding : TokenToId)
+    {
+        if (Binding.Key.Len() == 0) continue;
+
+        std::string s = TCHAR_TO_UTF8(*Binding.Key);
+        auto PhonemesNorm = una::norm::to_nfd_utf8(s);
+        auto PhonemesRange = una::ranges::utf8_view{ PhonemesNorm };
+        if (PhonemesRange.begin() == PhonemesRange.end()) continue;
+
+        const Piper::PhonemeUtf8 Phoneme = *PhonemesRange.begin();
+        if (Spans.Num() >= MAX_uint16 - 1)
+        {
+            UE_LOG(LogTemp, Warning, TEXT("FPhonemeTokenTable: vocabulary is too large, skipping the rest of tokens"));
+            break;
+        }
+
+        // If several keys are normalized to the same code point, the last binding replaces previous ones (as TMap::Add does)
+        int32 SpanIndex = INDEX_NONE;
+        if ((uint32)Phoneme < DenseRange)
+        {
+            SpanIndex = (int32)Dense[(int32)Phoneme] - 1;
+            if (SpanIndex == INDEX_NONE)
+            {
+                SpanIndex = Spans.AddDefaulted();
+                Dense[(int32)Phoneme] = (uint16)(SpanIndex + 1);
+            }
+        }
+        else if (const int32* ExistingIndex = Fallback.Find(Phoneme))
+        {
+            SpanIndex = *ExistingIndex;
+        }
+        else
+        {
+            SpanIndex = Spans.AddDefaulted();
+            Fallback.Add(Phoneme, SpanIndex);
+        }
+
+        FSpan& Span = Spans[SpanIndex];
+        Span.Offset = Ids.Num();
+        Span.Num = Binding.Value.Tokens.Num();
+        for (const int32 Token : Binding.Value.Tokens)
+        {
+            Ids.Add((Piper::PhonemeId)Token);
+        }
+        MaxIdsNum = FMath::Max(MaxIdsNum, Span.Num);
+    }
+}
+
+void FPhonemeTokenTable::Reset()
+{
+    Dense.Empty();
+    Fallback.Empty();
+    Spans.Empty();
+    Ids.Empty();
+    MaxIdsNum = 0;
+}
+
+namespace TokenizerImpl
+{
+    FORCEINLINE Piper::PhonemeId* CopyIds(Piper::PhonemeId* Dest, TConstArrayView<Piper::PhonemeId> Ids)
+    {
+        for (const Piper::PhonemeId Id : Ids)
+        {
+            *Dest++ = Id;
+        }
+        return Dest;
+    }
+
+    // Flags are resolved at compile time, so the inner loop has no branches except of vocabulary lookup
+    template<bool bPad, bool bBos, bool bEos>
+    void Tokenize(const FPhonemeTokenTable& Table, TConstArrayView<Piper::PhonemeUtf8> Phonemes, TArray<Piper::PhonemeId>& OutTokens, TMap<Piper::PhonemeUtf8, int32>& OutMissedPhonemes,
+        TConstArrayView<Piper::PhonemeId> PadIds, TConstArrayView<Piper::PhonemeId> BosIds, TConstArrayView<Piper::PhonemeId> EosIds)
+    {
+        // Upper bound of the output size
+        const int32 StartNum = OutTokens.Num();
+        int32 MaxNum = Phonemes.Num() * (Table.GetMaxIdsNum() + (bPad ? PadIds.Num() : 0));
+        if constexpr (bBos) MaxNum += BosIds.Num() + (bPad ? PadIds.Num() : 0);
+        if constexpr (bEos) MaxNum += EosIds.Num();
+        OutTokens.SetNumUninitialized(StartNum + MaxNum, EAllowShrinking::No);
+
+        Piper::PhonemeId* Dest = OutTokens.GetData() + StartNum;
+
+        // Beginning of sentence symbol (^) and pad after it (_)
+        if constexpr (bBos)
+        {
+            Dest = CopyIds(Dest, BosIds);
+            if constexpr (bPad) Dest = CopyIds(Dest, PadIds);
+        }
+
+        TConstArrayView<Piper::PhonemeId> MappedIds;
+        for (const Piper::PhonemeUtf8 Phoneme : Phonemes)
+        {
+            if (!Table.Find(Phoneme, MappedIds))
+            {
+                // Phoneme is missing from id map, count it only in padded mode
+                if constexpr (bPad) OutMissedPhonemes.FindOrAdd(Phoneme, 0)++;
+                continue;
+            }
+
+            Dest = CopyIds(Dest, MappedIds);
+            if constexpr (bPad) Dest = CopyIds(Dest, PadIds);
+        }
+
+        // End of sentence symbol ($)
+        if constexpr (bEos) Dest = CopyIds(Dest, EosIds);
+
+        OutTokens.SetNum((int32)(Dest - OutTokens.GetData()), EAllowShrinking::No);
+    }
+}
+
+bool UTTSModelData_Base::TokenizeWithTable(TConstArrayView<Piper::PhonemeUtf8> Phonemes, TArray<Piper::PhonemeId>& OutTokens, TMap<Piper::PhonemeUtf8, int32>& OutMissedPhonemes,
+    bool bFirst, bool bLast, bool bInterspersePad, bool bAddBos, bool bAddEos,
+    Piper::PhonemeUtf8 CharPad, Piper::PhonemeUtf8 CharBOS, Piper::PhonemeUtf8 CharEOS) const
+{
+    // Lock-free read: register reader before loading the pointer, so RebuildTokenTable won't delete the table under us
+    TokenTableReaders.fetch_add(1);
+    ON_SCOPE_EXIT
+    {
+        if (TokenTableReaders.fetch_sub(1) == 1 && bHasRetiredTokenTables.load())
+        {
+            // Rare path: the last reader of a replaced table
+            FScopeLock Lock(&TokenTableWriteLock);
+            ReclaimRetiredTokenTables();
+        }
+    };
+    const FPhonemeTokenTable* TablePtr = TokenTable.load();
+    if (!TablePtr || TablePtr->IsEmpty())
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Tokenize: vocabulary of %s is empty"), *GetName());
+        return false;
+    }
+    const FPhonemeTokenTable& Table = *TablePtr;
+
+    TConstArrayView<Piper::PhonemeId> PadIds, BosIds, EosIds;
+    const bool bPad = bInterspersePad && Table.Find(CharPad, PadIds);
+    const bool bBos = bFirst && bAddBos && Table.Find(CharBOS, BosIds);
+    const bool bEos = bLast && bAddEos && Table.Find(CharEOS, EosIds);
+
+    using FTokenizeFunc = void(*)(const FPhonemeTokenTable&, TConstArrayView<Piper::PhonemeUtf8>, TArray<Piper::PhonemeId>&, TMap<Piper::PhonemeUtf8, int32>&,
+        TConstArrayView<Piper::PhonemeId>, TConstArrayView<Piper::PhonemeId>, TConstArrayView<Piper::PhonemeId>);
+    static const FTokenizeFunc Variants[8] =
+    {
+        &TokenizerImpl::Tokenize<false, false, false>,
+        &TokenizerImpl::Tokenize<false, false, true>,
+        &TokenizerImpl::Tokenize<false, true, false>,
+        &TokenizerImpl::Tokenize<false, true, true>,
+        &TokenizerImpl::Tokenize<true, false, false>,
+        &TokenizerImpl::Tokenize<true, false, true>,
+        &TokenizerImpl::Tokenize<true, true, false>,
+        &TokenizerImpl::Tokenize<true, true, true>
+    };
+    const int32 VariantIndex = (bPad ? 4 : 0) | (bBos ? 2 : 0) | (bEos ? 1 : 0);
+    Variants[VariantIndex](Table, Phonemes, OutTokens, OutMissedPhonemes, PadIds, BosIds, EosIds);
+
+    return OutTokens.Num() > 0;
+}
+
+void UTTSModelData_Base::PostLoad()
+{
+    Super::PostLoad();
+    RebuildTokenTable();
+}
+
+#if WITH_EDITOR
+void UTTSModelData_Base::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+    Super::PostEditChangeProperty(PropertyChangedEvent);
+
+    if (PropertyChangedEvent.GetMemberPropertyName() == GET_MEMBER_NAME_CHECKED(UTTSModelData_Base, TokenToId))
+    {
+        RebuildTokenTable();
+    }
+}
+#endif
+
+void UTTSModelData_Base::FinishDestroy()
+{
+    {
+        FScopeLock Lock(&TokenTableWriteLock);
+        RetiredTokenTables.Empty();
+        bHasRetiredTokenTables = false;
+        delete TokenTable.exchange(nullptr);
+    }
+    Super::FinishDestroy();
+}
+
+void UTTSModelData_Base::RebuildTokenTable()
+{
+    // Build new table aside and then publish it, so concurrent Tokenize never sees partially built data
+    FPhonemeTokenTable* NewTable = new FPhonemeTokenTable();
+    NewTable->Build(TokenToId);
+
+    FScopeLock Lock(&TokenTableWriteLock);
+    if (const FPhonemeTokenTable* OldTable = TokenTable.exchange(NewTable))
+    {
+        // Readers which loaded the old pointer are still counted in TokenTableReaders
+        RetiredTokenTables.Emplace(OldTable);
+        bHasRetiredTokenTables = true;
+    }
+    ReclaimRetiredTokenTables();
+}
+
+void UTTSModelData_Base::ReclaimRetiredTokenTables() const
+{
+    // New readers can only get the current table, so with zero readers nobody holds a retired one
+    if (bHasRetiredTokenTables.load() && TokenTableReaders.load() == 0)
+    {
+        RetiredTokenTables.Empty();
+        bHasRetiredTokenTables = false;
+    }
+}
+
+bool UTTSModelData_Base::PhonemizeText(const FString& InText, FString& OutText, int32 SpeakerId, FPhonemePhrases& Phonemes, bool bCastCharactersAsWords)
+{
+    auto ModuleTts = FModuleManager::GetModulePtr<FLocalTTSModule>(TEXT("LocalTTS"));
+    if (!ModuleTts->IsLoaded()) return false;
+
+    ULocalTTSSubsystem* LocalTTS = GEngine->GetEngineSubsystem<ULocalTTSSubsystem>();
+    UPhonemizer* Phonemizer = LocalTTS->GetPhonemizer();
+
+    FString VoiceCode = GetEspeakCode(SpeakerId);
+    FString G2PLanguageCode;
+    int32 Result;
+    if (PhonemizationType == ETTSPhonemeType::PT_eSpeak)
+    {
+        Result = ModuleTts->func_espeak_SetVoiceByName(TCHAR_TO_ANSI(*VoiceCode));
+    }
+    else //if (PhonemizationType == ETTSPhonemeType::PT_NNM)
+    {
+        Result = Phonemizer->GetLanguageCodeFromEspeak(VoiceCode, PhonemizationType == ETTSPhonemeType::PT_Dictionary, G2PLanguageCode) ? 0 : 1;
+    }
+    if (Result != 0)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Failed to set phonemizer voice: \"%s\" (default is %s)"), *VoiceCode, *ESpeakVoiceCode);
+        return false;
+    }
+
+    // Modified by eSpeak
+    std::string textCopy(TCHAR_TO_UTF8(*InText));
+
+    // Sentences are added to the flat buffer and closed by EndPhrase
+    TArray<Piper::PhonemeUtf8>* SentencePhonemes = &Phonemes.Phonemes;
+    // eSpeak
+    const char* InputTextPointer = textCopy.c_str();
+    int Terminator = 0;
+    // non-eSpeak
+    TArray<FString> WordsPhonemizedWithTerminators;
+    // Normalized phonemes of the words found in dictionary
+    TArray<TArray<Piper::PhonemeUtf8>> DictionaryPhonemes;
+    const TArray<Piper::PhonemeUtf8>* WordPhonemes = nullptr;
+    TSet<FString> Terminators = { TEXT("."), TEXT(","), TEXT("?"), TEXT("!") };
+    int32 InputWordIndex = 0;
+    FString TerminatorChar;
+    if (PhonemizationType != ETTSPhonemeType::PT_eSpeak)
+    {
+        Phonemizer->SyncPhonemizeTextToCodepoints(InText.ToLower(), G2PLanguageCode, OutText, WordsPhonemizedWithTerminators, &DictionaryPhonemes, bCastCharactersAsWords);
+    }
+
+    while (InputTextPointer != NULL)
+    {
+        std::string clausePhonemes;
+        if (PhonemizationType == ETTSPhonemeType::PT_eSpeak)
+        {
+            // Modified espeak-ng API to get access to clause terminator
+            std::string clausePhonemesRaw(ModuleTts->func_espeak_TextToPhonemesWithTerminator((const void**)&InputTextPointer, espeakCHARS_AUTO, 0x02, &Terminator));
+            clausePhonemes = clausePhonemesRaw;
+#if PLATFORM_ANDROID
+            char chrTerminator[2] = { '0', '0' };
+            clausePhonemes.append(chrTerminator);
+#endif
+            OutText.Append(UTF8_TO_TCHAR(clausePhonemes.c_str()));
+        }
+        else //if (PhonemizationType == ETTSPhonemeType::PT_NNM)
+        {
+            FString NextWord = WordsPhonemizedWithTerminators[InputWordIndex].TrimEnd();
+            TerminatorChar = TEXT(" ");
+            for (const auto& t : Terminators)
+            {
+                if (NextWord.EndsWith(t))
+                {
+                    TerminatorChar = t; break;
+                }
+            }
+            if (NextWord.EndsWith(TerminatorChar))
+            {
+                NextWord.LeftChopInline(1);
+            }
+            if (DictionaryPhonemes.IsValidIndex(InputWordIndex) && !DictionaryPhonemes[InputWordIndex].IsEmpty())
+            {
+                // Dictionary phonemes don't need normalization
+                WordPhonemes = &DictionaryPhonemes[InputWordIndex];
+            }
+            else
+            {
+                std::string clausePhonemesRaw(TCHAR_TO_UTF8(*NextWord));
+                clausePhonemes = clausePhonemesRaw;
+                WordPhonemes = nullptr;
+            }
+
+            if (++InputWordIndex == WordsPhonemizedWithTerminators.Num())
+            {
+                InputTextPointer = NULL;
+            }
+        }
+
+        std::vector<Piper::PhonemeUtf8> MappedSentPhonemes;
+        if (WordPhonemes)
+        {
+            MappedSentPhonemes.assign(WordPhonemes->GetData(), WordPhonemes->GetData() + WordPhonemes->Num());
+        }
+        else
+        {
+            auto PhonemesNorm = una::norm::to_nfd_utf8(clausePhonemes);
+            auto PhonemesRange = una::ranges::utf8_view{ PhonemesNorm };
+            MappedSentPhonemes.insert(MappedSentPhonemes.end(), PhonemesRange.begin(), PhonemesRange.end());
+        }
+
+        auto phonemeIter = MappedSentPhonemes.begin();
+        auto phonemeEnd = MappedSentPhonemes.end();
+
+        // Filter out (lang) switch (flags).
+        // These surround words from languages other than the current voice.
+        bool inLanguageFlag = false;
+
+        while (phonemeIter != phonemeEnd)
+        {
+            if (inLanguageFlag)
+            {
+                if (*phonemeIter == U')')
+                {
+                    // End of (lang) switch
+                    inLanguageFlag = false;
+                }
+            }
+            else if (*phonemeIter == U'(')
+            {
+                // Start of (lang) switch
+                inLanguageFlag = true;
+            }
+            else
+            {
+                SentencePhonemes->Add(*phonemeIter);
+            }
+
+            phonemeIter++;
+        }
+
+        // Add appropriate punctuation depending on terminator type
+        if (PhonemizationType == ETTSPhonemeType::PT_eSpeak)
+        {
+            int punctuation = Terminator & 0x000FFFFF;
+            if (punctuation == CLAUSE_PERIOD)
+            {
+                SentencePhonemes->Add(P_Period);
+            }
+            else if (punctuation == CLAUSE_QUESTION)
+            {
+                SentencePhonemes->Add(P_Question);
+            }
+            else if (punctuation == CLAUSE_EXCLAMATION)
+            {
+                SentencePhonemes->Add(P_Exclamation);
+            }
+            else if (punctuation == CLAUSE_COMMA)
+            {
+                SentencePhonemes->Add(P_Comma);
+                SentencePhonemes->Add(P_Space);
+            }
+            else if (punctuation == CLAUSE_COLON)
+            {
+                SentencePhonemes->Add(P_Colon);
+                SentencePhonemes->Add(P_Space);
+            }
+            else if (punctuation == CLAUSE_SEMICOLON)
+            {
+                SentencePhonemes->Add(P_Semicolon);
+                SentencePhonemes->Add(P_Space);
+            }
+
+            if ((Terminator & CLAUSE_TYPE_SENTENCE) == CLAUSE_TYPE_SENTENCE)
+            {
+                // End of sentence
+                Phonemes.EndPhrase();
+            }
+        }
+        else // Dictionary, NNE
+        {
+            if (TerminatorChar == TEXT("."))
+            {
+                SentencePhonemes->Add(P_Period);
+            }
+            else if (TerminatorChar == TEXT("?"))
+            {
+                SentencePhonemes->Add(P_Question);
+            }
+            else if (TerminatorChar == TEXT("!"))
+            {
+                SentencePhonemes->Add(P_Exclamation);
+            }
+            else if (TerminatorChar == TEXT(","))
+            {
+                SentencePhonemes->Add(P_Comma);
+                SentencePhonemes->Add(P_Space);
+            }
+            else if (TerminatorChar == TEXT(" "))
+            {
+                SentencePhonemes->Add(P_Space);
+            }
+
+            if (TerminatorChar != TEXT(",") && TerminatorChar != TEXT(" "))
+            {
+                // End of sentence
+                Phonemes.EndPhrase();
+            }
+        }
+    } // while inputTextPointer != NULL
+
+    // Last sentence without terminator
+    Phonemes.EndPhrase();
+
+    return true;
+}
+
+FString UTTSModelData_Base::GetEspeakCode(int32 SpeakerId) const
+{
+    return ESpeakVoiceCode;
+}
+
+void UTTSModelData_Base::GetTrimmedRange(const float* Data, int32 Num, float Peak, int32& OutStart, int32& OutEnd) const
+{
+    OutStart = 0;
+    OutEnd = Num;
+    if (!bTrimSilence || Num <= 0)
+    {
+        return;
+    }
+
+    // Compare energy of 10 ms frames with threshold below peak of the phrase
+    if (Peak <= 0.f)
+    {
+        OutEnd = 0;
+        return;
+    }
+    const int32 FrameSize = FMath::Max(1, SampleRate / 100);
+    const float ThresholdSquared = FMath::Square(Peak * FMath::Pow(10.f, TrimThresholdDb / 20.f));
+    auto IsSilent = [Data, ThresholdSquared](int32 Start, int32 FrameNum)
+    {
+        return LocalTtsMath::SumOfSquares(Data + Start, FrameNum) < ThresholdSquared * (float)FrameNum;
+    };
+
+    int32 Start = 0;
+    while (Start < Num && IsSilent(Start, FMath::Min(FrameSize, Num - Start)))
+    {
+        Start += FrameSize;
+    }
+    if (Start >= Num)
+    {
+        OutEnd = 0;
+        return;
+    }
+
+    int32 End = Num;
+    while (End - FrameSize > Start && IsSilent(End - FrameSize, FrameSize))
+    {
+        End -= FrameSize;
+    }
+
+    const int32 PaddingSamples = FMath::Max(0, (int32)(TrimPaddingSeconds * (float)SampleRate));
+    OutStart = FMath::Max(0, Start - PaddingSamples);
+    OutEnd = FMath::Min(Num, End + PaddingSamples);
+}
+
+bool UTTSModelData_Base::Tokenize(TConstArrayView<Piper::PhonemeUtf8> Phonemes, TArray<Piper::PhonemeId>& OutTokens, TMap<Piper::PhonemeUtf8, int32>& OutMissedPhonemes, bool bFirst, bool bLast)
+{
+    return false;
+}
+
+bool UTTSModelData_Base::SetNNEInputParams(FNNEModelTTS& NNModel, const FTTSGenerateRequestContext& Context) const
+{
+    return false;
+}
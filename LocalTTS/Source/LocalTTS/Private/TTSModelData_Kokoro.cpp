@@ -1,406 +1,525 @@
-﻿// (c) Yuri N. K. 2025. All rights reserved.
-// ykasczc@gmail.com
-
-#include "TTSModelData_Kokoro.h"
-#include "NNE.h"
-#include "Misc/Paths.h"
-#include "Misc/FileHelper.h"
-//#include "HAL/FileManager.h"
-#include "Dom/JsonValue.h"
-#include "Dom/JsonObject.h"
-#include "Serialization/JsonReader.h"
-#include "Serialization/JsonSerializer.h"
-
-UTTSModelData_Kokoro::UTTSModelData_Kokoro()
-{
-#if ESPEAK_NG
-    PhonemizationType = ETTSPhonemeType::PT_eSpeak;
-#else
-    PhonemizationType = ETTSPhonemeType::PT_Dictionary;
-#endif
-    SampleRate = 24000;
-    SentenceSilenceSeconds = 0.f;
-    BaseSynthesisSpeedMultiplier = 3.f;
-}
-
-FString UTTSModelData_Kokoro::GetEspeakCode(int32 SpeakerId) const
-{
-    if (VoiceEspeakCodes.IsValidIndex(SpeakerId))
-    {
-        return VoiceEspeakCodes[SpeakerId];
-    }
-    else
-    {
-        return ESpeakVoiceCode;
-    }
-}
-
-bool UTTSModelData_Kokoro::PhonemizeText(const FString& InText, FString& OutText, int32 SpeakerId, TArray<TArray<Piper::PhonemeUtf8>>& Phonemes, bool bCastCharactersAsWords)
-{
-    const int32 MaxTokensInBatch = bInterspersePad ? 240 : 480;
-
-    bCastCharactersAsWords = bSplitChinese && GetEspeakCode(SpeakerId) == TEXT("cmn");
-    TArray<TArray<Piper::PhonemeUtf8>> TempBatches;
-    bool bResult = Super::PhonemizeText(InText, OutText, SpeakerId, TempBatches, bCastCharactersAsWords);
-
-    // Don't separate sentences, but keep tokens num below 510
-    if (bResult)
-    {
-        TArray<Piper::PhonemeUtf8> CombinedBatches;
-
-        for (const auto& Batch : TempBatches)
-        {
-            // Combine batches
-            if (CombinedBatches.Num() + Batch.Num() > MaxTokensInBatch)
-            {
-                if (CombinedBatches.Num() > 0)
-                {
-                    Phonemes.Add(CombinedBatches);
-                }
-                CombinedBatches = Batch;
-            }
-            else
-            {
-                CombinedBatches.Append(Batch);
-            }
-
-            // Ensure we're within tokens limit
-            while (CombinedBatches.Num() > MaxTokensInBatch)
-            {
-                Phonemes.AddDefaulted();
-                Phonemes.Last().SetNumUninitialized(MaxTokensInBatch);
-                FMemory::Memcpy(Phonemes.Last().GetData(), CombinedBatches.GetData(), MaxTokensInBatch * (int32)sizeof(Piper::PhonemeUtf8));
-
-                TArray<Piper::PhonemeUtf8> tmp;
-                tmp.SetNumUninitialized(CombinedBatches.Num() - MaxTokensInBatch);
-                FMemory::Memcpy(tmp.GetData(), &CombinedBatches[MaxTokensInBatch], tmp.Num() * (int32)sizeof(Piper::PhonemeUtf8));
-                CombinedBatches.SetNumUninitialized(tmp.Num());
-                CombinedBatches = tmp;
-            }
-        }
-
-        if (!CombinedBatches.IsEmpty())
-        {
-            Phonemes.Add(CombinedBatches);
-            UE_LOG(LogTemp, Log, TEXT("UTTSModelData_Kokoro::PhonemizeText: Added batch of size [%d] to Phonemes"), CombinedBatches.Num());
-        }
-    }
-
-    return bResult;
-}
-
-bool UTTSModelData_Kokoro::Tokenize(const TArray<Piper::PhonemeUtf8>& Phonemes, TArray<Piper::PhonemeId>& OutTokens, TMap<Piper::PhonemeUtf8, int32>& OutMissedPhonemes, bool bFirst, bool bLast)
-{
-    // Update PhonemeIdMap if needed
-    EnsurePhonemesMap();
-
-    // Beginning of sentence symbol (^)
-    if (bAddBos && bFirst && PhonemeIdMap.Contains(CharBOS))
-    {
-        const TArray<Piper::PhonemeId>& bosIds = PhonemeIdMap[CharBOS];
-        OutTokens.Append(bosIds);
-
-        if (bInterspersePad && PhonemeIdMap.Contains(CharPad))
-        {
-            // Pad after bos (_)
-            const TArray<Piper::PhonemeId>& padIds = PhonemeIdMap[CharPad];
-            OutTokens.Append(padIds);
-        }
-    }
-
-    if (bInterspersePad && PhonemeIdMap.Contains(CharPad))
-    {
-        // Add ids for each phoneme *with* padding
-        const TArray<Piper::PhonemeId>& padIds = PhonemeIdMap[CharPad];
-
-        for (auto const phoneme : Phonemes)
-        {
-            if (!PhonemeIdMap.Contains(phoneme))
-            {
-                // Phoneme is missing from id map
-                if (int32* MissedNum = OutMissedPhonemes.Find(phoneme))
-                {
-                    (*MissedNum)++;
-                }
-                else
-                {
-                    OutMissedPhonemes.Add(phoneme, 1);
-                }
-                continue;
-            }
-
-            // add mapped
-            const TArray<Piper::PhonemeId>& mappedIds = PhonemeIdMap[phoneme];
-            OutTokens.Append(mappedIds);
-            // add pad (_)
-            OutTokens.Append(padIds);
-        }
-    }
-    else
-    {
-        // Add ids for each phoneme *without* padding, don't count missed
-        for (auto const phoneme : Phonemes)
-        {
-            if (const TArray<Piper::PhonemeId>* mappedIds = PhonemeIdMap.Find(phoneme))
-            {
-                OutTokens.Append(*mappedIds);
-            }
-        }
-    }
-
-    // End of sentence symbol ($)
-    if (bAddEos && bLast)
-    {
-        if (const TArray<Piper::PhonemeId>* eosIds = PhonemeIdMap.Find(CharEOS))
-        {
-            OutTokens.Append(*eosIds);
-        }
-    }
-
-    return OutTokens.Num() > 0;
-}
-
-/*
-* shape (1, -1)   type Int64			phonemized tokens
-* shape (1, 256)  type Float			voice
-* shape (1)       type Float			speed 1.0
-*/
-bool UTTSModelData_Kokoro::SetNNEInputParams(FNNEModelTTS& NNModel, const FTTSGenerateRequestContext& Context) const
-{
-    // check parameters
-    if (!NNModel.CheckInParam(0, ENNETensorDataType::Int64)
-        || !NNModel.CheckInParam(1, ENNETensorDataType::Float)
-        || !NNModel.CheckInParam(2, ENNETensorDataType::Float))
-    {
-        UE_LOG(LogTemp, Warning, TEXT("Invalid input tensor parameters at ONNX TTS model"));
-        return false;
-    }
-    if (!Context.Tokens)
-    {
-        UE_LOG(LogTemp, Warning, TEXT("Invalid input tokens"));
-        return false;
-    }
-
-    int32 TokensNum = Context.Tokens->Num();
-
-    // inputs
-    // shape (1, -1)   type Int64			phonemized tokens
-    NNModel.PrepareInputInt64(0, *Context.Tokens, { 1, (uint32)TokensNum });
-
-    // voice
-    // shape (1, 256)  type Float			voice
-    TArray<float>& Voice = NNModel.GetInParamFloatUnsafe(1);
-    Voice.SetNumUninitialized(256);
-    
-    if (VoiceCache.IsValidIndex(Context.SpeakerId))
-    {
-        int32 BuffOffset = (TokensNum * 256) % VoiceCache[Context.SpeakerId].Data.Num();
-        FMemory::Memcpy(Voice.GetData(), &VoiceCache[Context.SpeakerId].Data[BuffOffset], (uint64)256 * (uint64)sizeof(float));
-    }
-    else
-    {
-        UE_LOG(LogTemp, Warning, TEXT("Invalid SpeakerId: %d"), Context.SpeakerId);
-        return false;
-    }
-    NNModel.InputBindings[1].SizeInBytes = (uint64)256 * (uint64)sizeof(float);
-    NNModel.InputBindings[1].Data = Voice.GetData();
-    NNModel.InputTensorShapes[1] = UE::NNE::FTensorShape::Make({ 1, 256 });
-
-    // speed
-    NNModel.PrepareInputFloat(2, { Speed }, { 1 });
-
-    return true;
-}
-
-void UTTSModelData_Kokoro::PostProcessNND(FSynthesisResult& SynthesisData) const
-{
-    // Normalize and convert to 16bit
-
-    const float MAX_WAV_VALUE = 32767.0f;
-
-    // Get max audio value for scaling
-    float MaxAudioValue = 0.01f;
-    for (const auto& sample : SynthesisData.PCMData32)
-    {
-        float AudioValue = abs(sample);
-        if (AudioValue > MaxAudioValue)
-        {
-            MaxAudioValue = AudioValue;
-        }
-    }
-
-    SynthesisData.PCMData16.SetNumUninitialized(SynthesisData.PCMData32.Num() * 2);
-    int16* pcm16 = (int16*)SynthesisData.PCMData16.GetData();
-
-    float AudioScale = (MAX_WAV_VALUE / FMath::Max(0.01f, MaxAudioValue));
-    for (int32 i = 0; i < SynthesisData.PCMData32.Num(); i++)
-    {
-        pcm16[i] = (int16)FMath::TruncToInt(SynthesisData.PCMData32[i] * AudioScale);
-    }
-}
-
-/*
-* Expected: tokenizer.json
-* from https://huggingface.co/onnx-community/Kokoro-82M-v1.0-ONNX
-*/
-void UTTSModelData_Kokoro::ImportFromFile(const FString& FileName)
-{
-    FString JsonData;
-    FFileHelper::LoadFileToString(JsonData, *FileName);
-
-    const TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(JsonData);
-    TSharedPtr<FJsonObject> JsonRootObject = MakeShareable(new FJsonObject);
-
-    if (!FJsonSerializer::Deserialize(Reader, JsonRootObject))
-    {
-        UE_LOG(LogTemp, Warning, TEXT("ImportFromFile: invalid json file %s"), *FileName);
-        return;
-    }
-
-    if (!JsonRootObject->HasTypedField<EJson::Object>(TEXT("normalizer")) ||
-        !JsonRootObject->HasTypedField<EJson::Object>(TEXT("post_processor")) ||
-        !JsonRootObject->HasTypedField<EJson::Object>(TEXT("model")))
-    {
-        UE_LOG(LogTemp, Warning, TEXT("ImportFromFile: invalid json file %s"), *FileName);
-        return;
-    }
-
-    TSharedPtr<FJsonObject> NormalizerRoot = JsonRootObject->GetObjectField(TEXT("normalizer"));
-    if (NormalizerRoot->HasTypedField<EJson::Object>(TEXT("pattern")))
-    {
-        TSharedPtr<FJsonObject> RegexPatternObj = NormalizerRoot->GetObjectField(TEXT("pattern"));
-        RegexPatternObj->TryGetStringField(TEXT("Regex"), TokenizePatternRegex);
-    }
-    FString NormType;
-    if (NormalizerRoot->TryGetStringField(TEXT("type"), NormType))
-    {
-        bTokenizePatternTypeReplace = NormType.Equals(TEXT("Replace"));
-    }
-
-    TokenToId.Empty();
-    TSharedPtr<FJsonObject> ModelRoot = JsonRootObject->GetObjectField(TEXT("model"));
-    if (!ModelRoot->HasTypedField<EJson::Object>(TEXT("vocab")))
-    {
-        UE_LOG(LogTemp, Warning, TEXT("ImportFromFile: invalid json file %s"), *FileName);
-        return;
-    }
-    TSharedPtr<FJsonObject> VocabRoot = ModelRoot->GetObjectField(TEXT("vocab"));
-    for (const auto& CharToToken : VocabRoot->Values)
-    {
-        FString VocabChar = CharToToken.Key;
-        if (CharToToken.Value->Type == EJson::Number)
-        {
-            int32 Token = CharToToken.Value->AsNumber();
-            TokenToId.Add(VocabChar, FTokensArrayWrapper({ Token }));
-        }
-    }
-
-    ESpeakVoiceCode.Empty();
-    LanguageCode.Empty();
-    LanguageFamily.Empty();
-    SampleRate = 24000;
-    Speed = 1.f;
-    SentenceSilenceSeconds = 0.f;
-}
-
-void UTTSModelData_Kokoro::ImportVoiceFromFile(const FString& FileName)
-{
-    if (!FPaths::FileExists(FileName))
-    {
-        return;
-    }
-    FString VoiceName = FPaths::GetBaseFilename(FileName);
-    FString VoiceCode = VoiceName.Left(2);
-    int32 VoiceId = Speakers.Num();
-
-    if (Speakers.Contains(VoiceName))
-    {
-        VoiceId = Speakers[VoiceName];
-    }
-    else
-    {
-        Speakers.Add(VoiceName, VoiceId);
-        VoiceEspeakCodes.Add(TEXT(""));
-        VoiceCache.AddDefaulted();
-    }
-
-    // Add new speaker
-    if (VoiceCode == TEXT("af") || VoiceCode == TEXT("am"))
-    {
-        VoiceCode = TEXT("en-us");
-    }
-    else if (VoiceCode == TEXT("bf") || VoiceCode == TEXT("bm"))
-    {
-        VoiceCode = TEXT("en-gb");
-    }
-    else if (VoiceCode == TEXT("jf") || VoiceCode == TEXT("jm"))
-    {
-        VoiceCode = TEXT("ja");
-    }
-    else if (VoiceCode == TEXT("zf") || VoiceCode == TEXT("zm"))
-    {
-        VoiceCode = TEXT("cmn");
-    }
-    else if (VoiceCode == TEXT("ef") || VoiceCode == TEXT("em"))
-    {
-        VoiceCode = TEXT("es");
-    }
-    else if (VoiceCode == TEXT("ff"))
-    {
-        VoiceCode = TEXT("fr-fr");
-    }
-    else if (VoiceCode == TEXT("hf") || VoiceCode == TEXT("hm"))
-    {
-        VoiceCode = TEXT("hi");
-    }
-    else if (VoiceCode == TEXT("if") || VoiceCode == TEXT("im"))
-    {
-        VoiceCode = TEXT("it");
-    }
-    else if (VoiceCode == TEXT("pf") || VoiceCode == TEXT("pm"))
-    {
-        VoiceCode = TEXT("pt-br");
-    }
-    // Add espeak code
-    VoiceEspeakCodes[VoiceId] = VoiceCode;
-
-    // Add cached voice data, actual shape is [-1, 1, 256]
-    TArray<uint8> RawBinaryData;
-    FFileHelper::LoadFileToArray(RawBinaryData, *FileName);
-    auto& TargetFloatArray = VoiceCache[VoiceId].Data;
-    TargetFloatArray.SetNumUninitialized(RawBinaryData.Num() / sizeof(float));
-
-    UE_LOG(LogTemp, Log, TEXT("From BIN file loaded %d bytes, casting them as %d floats"), RawBinaryData.Num(), TargetFloatArray.Num());
-
-    FMemory::Memcpy(TargetFloatArray.GetData(), RawBinaryData.GetData(), RawBinaryData.Num());
-}
-
-void UTTSModelData_Kokoro::DeleteSpeaker(int32 SpeakerID)
-{
-    FString key;
-    for (auto& sp : Speakers)
-    {
-        if (sp.Value == SpeakerID)
-        {
-            key = sp.Key;
-        }
-        else if (sp.Value > SpeakerID)
-        {
-            sp.Value--;
-        }
-    }
-
-    if (VoiceCache.IsValidIndex(SpeakerID))
-    {
-        Speakers.Remove(key);
-        VoiceCache.RemoveAt(SpeakerID);
-        VoiceEspeakCodes.RemoveAt(SpeakerID);
-    }
-}
-
-void UTTSModelData_Kokoro::DeleteAllSpeakers()
-{
-    Speakers.Empty();
-    VoiceCache.Empty();
-    VoiceEspeakCodes.Empty();
-}
+﻿// (c) Yuri N. K. 2025. All rights reserved.
+// ykasczc@gmail.com
+
+#include "TTSModelData_Kokoro.h"
+#include "NNE.h"
+#include "Misc/Paths.h"
+#include "Misc/FileHelper.h"
+//#include "HAL/FileManager.h"
+#include "Dom/JsonValue.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/CustomVersion.h"
+
+// Size of one row in voice style table
+static constexpr int32 VoiceStyleSize = 256;
+
+struct FKokoroModelDataVersion
+{
+    enum Type
+    {
+        BeforeCustomVersionWasAdded = 0,
+        // Voices are stored as bulk data instead of VoiceCache
+        VoiceBulkData,
+
+        VersionPlusOne,
+        LatestVersion = VersionPlusOne - 1
+    };
+
+    static const FGuid GUID;
+};
+
+const FGuid FKokoroModelDataVersion::GUID(0x3E8B51D4, 0x7C2A4F90, 0xB16D0E25, 0x94F7A3C8);
+FCustomVersionRegistration GRegisterKokoroModelDataVersion(FKokoroModelDataVersion::GUID, FKokoroModelDataVersion::LatestVersion, TEXT("LocalTTSKokoroModelData"));
+
+UTTSModelData_Kokoro::UTTSModelData_Kokoro()
+{
+#if ESPEAK_NG
+    PhonemizationType = ETTSPhonemeType::PT_eSpeak;
+#else
+    PhonemizationType = ETTSPhonemeType::PT_Dictionary;
+#endif
+    SampleRate = 24000;
+    SentenceSilenceSeconds = 0.f;
+    BaseSynthesisSpeedMultiplier = 3.f;
+}
+
+void UTTSModelData_Kokoro::Serialize(FArchive& Ar)
+{
+    Super::Serialize(Ar);
+    Ar.UsingCustomVersion(FKokoroModelDataVersion::GUID);
+
+    if (Ar.CustomVer(FKokoroModelDataVersion::GUID) >= FKokoroModelDataVersion::VoiceBulkData)
+    {
+        int32 VoicesNum = VoiceStyles.Num();
+        Ar << VoicesNum;
+        if (Ar.IsLoading())
+        {
+            for (auto& Voice : VoiceStyles)
+            {
+                UnloadVoiceStyle(*Voice);
+            }
+            VoiceStyles.Empty(VoicesNum);
+            for (int32 i = 0; i < VoicesNum; i++)
+            {
+                VoiceStyles.Add(MakeUnique<FVoiceStyle>());
+            }
+        }
+
+        // Voices are loaded on first use and can be memory mapped on platforms supporting it
+        for (int32 i = 0; i < VoiceStyles.Num(); i++)
+        {
+            VoiceStyles[i]->Data.SetBulkDataFlags(BULKDATA_Force_NOT_InlinePayload | BULKDATA_MemoryMappedPayload);
+            VoiceStyles[i]->Data.Serialize(Ar, this, INDEX_NONE, /* bAttemptFileMapping */ Ar.IsLoading());
+        }
+    }
+    else if (Ar.IsLoading() && VoiceCache.Num() > 0)
+    {
+        // Old asset: move voices to bulk data, they'll be saved in new format
+        VoiceStyles.Empty(VoiceCache.Num());
+        for (int32 i = 0; i < VoiceCache.Num(); i++)
+        {
+            VoiceStyles.Add(MakeUnique<FVoiceStyle>());
+            SetVoiceStyleData(i, VoiceCache[i].Data.GetData(), (int64)VoiceCache[i].Data.Num() * sizeof(float));
+        }
+        VoiceCache.Empty();
+    }
+}
+
+void UTTSModelData_Kokoro::BeginDestroy()
+{
+    Super::BeginDestroy();
+
+    for (auto& Voice : VoiceStyles)
+    {
+        UnloadVoiceStyle(*Voice);
+    }
+}
+
+FString UTTSModelData_Kokoro::GetEspeakCode(int32 SpeakerId) const
+{
+    if (VoiceEspeakCodes.IsValidIndex(SpeakerId))
+    {
+        return VoiceEspeakCodes[SpeakerId];
+    }
+    else
+    {
+        return ESpeakVoiceCode;
+    }
+}
+
+bool UTTSModelData_Kokoro::PhonemizeText(const FString& InText, FString& OutText, int32 SpeakerId, FPhonemePhrases& Phonemes, bool bCastCharactersAsWords)
+{
+    const int32 MaxTokensInBatch = bInterspersePad ? 240 : 480;
+
+    bCastCharactersAsWords = bSplitChinese && GetEspeakCode(SpeakerId) == TEXT("cmn");
+    FPhonemePhrases Sentences;
+    bool bResult = Super::PhonemizeText(InText, OutText, SpeakerId, Sentences, bCastCharactersAsWords);
+
+    // Don't separate sentences, but keep tokens num below 510
+    if (bResult)
+    {
+        // Batches are new split offsets in the same phonemes buffer
+        const int32 StartOffset = Phonemes.Phonemes.Num();
+        Phonemes.Phonemes.Append(MoveTemp(Sentences.Phonemes));
+
+        const Piper::PhonemeUtf8* Data = Phonemes.Phonemes.GetData() + StartOffset;
+        const int32 PhonemesNum = Phonemes.Phonemes.Num() - StartOffset;
+
+        // Latest boundaries in current batch (offsets after them)
+        int32 BatchStart = 0;
+        int32 LastClauseEnd = 0;
+        int32 LastWordEnd = 0;
+        int32 SentenceIndex = 0;
+
+        auto AddBatch = [&Phonemes, StartOffset](int32 BatchEnd)
+        {
+            Phonemes.PhraseEnds.Add(StartOffset + BatchEnd);
+            UE_LOG(LogTemp, Log, TEXT("UTTSModelData_Kokoro::PhonemizeText: Added batch of size [%d] to Phonemes"), Phonemes[Phonemes.Num() - 1].Num());
+        };
+
+        for (int32 i = 0; i < PhonemesNum; i++)
+        {
+            if (i - BatchStart == MaxTokensInBatch)
+            {
+                // Batch is full: split at the latest sentence or clause end if it isn't too close to the batch start, then at the latest word end
+                const int32 LastBoundary = FMath::Max(LastClauseEnd, LastWordEnd);
+                int32 SplitAt = i;
+                if (LastClauseEnd > BatchStart + MaxTokensInBatch / 2)
+                {
+                    SplitAt = LastClauseEnd;
+                }
+                else if (LastBoundary > BatchStart)
+                {
+                    SplitAt = LastBoundary;
+                }
+                AddBatch(SplitAt);
+                BatchStart = SplitAt;
+            }
+
+            const Piper::PhonemeUtf8 Phoneme = Data[i];
+            const bool bSentenceEnd = Sentences.PhraseEnds.IsValidIndex(SentenceIndex) && Sentences.PhraseEnds[SentenceIndex] == i + 1;
+            if (bSentenceEnd)
+            {
+                SentenceIndex++;
+            }
+
+            if (bSentenceEnd || Phoneme == P_Period || Phoneme == P_Comma || Phoneme == P_Question || Phoneme == P_Exclamation || Phoneme == P_Colon || Phoneme == P_Semicolon)
+            {
+                LastClauseEnd = i + 1;
+            }
+            else if (Phoneme == P_Space)
+            {
+                if (LastClauseEnd == i)
+                {
+                    // Keep space after punctuation in the same batch
+                    LastClauseEnd = i + 1;
+                }
+                LastWordEnd = i + 1;
+            }
+        }
+
+        if (PhonemesNum > BatchStart)
+        {
+            AddBatch(PhonemesNum);
+        }
+    }
+
+    return bResult;
+}
+
+bool UTTSModelData_Kokoro::Tokenize(TConstArrayView<Piper::PhonemeUtf8> Phonemes, TArray<Piper::PhonemeId>& OutTokens, TMap<Piper::PhonemeUtf8, int32>& OutMissedPhonemes, bool bFirst, bool bLast)
+{
+    return TokenizeWithTable(Phonemes, OutTokens, OutMissedPhonemes, bFirst, bLast, bInterspersePad, bAddBos, bAddEos, CharPad, CharBOS, CharEOS);
+}
+
+/*
+* shape (1, -1)   type Int64			phonemized tokens
+* shape (1, 256)  type Float			voice
+* shape (1)       type Float			speed 1.0
+*/
+bool UTTSModelData_Kokoro::SetNNEInputParams(FNNEModelTTS& NNModel, const FTTSGenerateRequestContext& Context) const
+{
+    // check parameters
+    if (!NNModel.CheckInParam(0, ENNETensorDataType::Int64)
+        || !NNModel.CheckInParam(1, ENNETensorDataType::Float)
+        || !NNModel.CheckInParam(2, ENNETensorDataType::Float))
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Invalid input tensor parameters at ONNX TTS model"));
+        return false;
+    }
+    if (!Context.Tokens)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Invalid input tokens"));
+        return false;
+    }
+
+    int32 TokensNum = Context.Tokens->Num();
+
+    // inputs
+    // shape (1, -1)   type Int64			phonemized tokens
+    NNModel.PrepareInputInt64(0, *Context.Tokens, { 1, (uint32)TokensNum });
+
+    // voice
+    // shape (1, 256)  type Float			voice
+    const FVoiceStyle* Voice = GetVoiceStyle(Context.SpeakerId);
+    if (!Voice)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Invalid SpeakerId: %d"), Context.SpeakerId);
+        return false;
+    }
+    // Copy style row for this tokens num (1 KB), so unloading the voice can't free memory used by running inference
+    {
+        FScopeLock VoiceLock(&Voice->LoadLock);
+        if (!Voice->Rows)
+        {
+            UE_LOG(LogTemp, Warning, TEXT("Voice style of SpeakerId %d was unloaded"), Context.SpeakerId);
+            return false;
+        }
+        const float* StyleRow = Voice->Rows + (int64)(TokensNum % Voice->RowsNum) * VoiceStyleSize;
+        NNModel.PrepareInputFloat(1, StyleRow, VoiceStyleSize, { 1, (uint32)VoiceStyleSize });
+    }
+
+    // speed
+    NNModel.PrepareInputFloat(2, { Speed }, { 1 });
+
+    return true;
+}
+
+void UTTSModelData_Kokoro::PostProcessNND(FSynthesisResult& SynthesisData) const
+{
+    // Normalize and convert to 16bit
+    SynthesisData.PCMData16.SetNumUninitialized(SynthesisData.PCMData32.Num() * 2);
+    LocalTtsMath::NormalizeToInt16(SynthesisData.PCMData32.GetData(), SynthesisData.PCMData32.Num(), GetNormalizationMinPeak(), (int16*)SynthesisData.PCMData16.GetData());
+}
+
+/*
+* Expected: tokenizer.json
+* from https://huggingface.co/onnx-community/Kokoro-82M-v1.0-ONNX
+*/
+void UTTSModelData_Kokoro::ImportFromFile(const FString& FileName)
+{
+    FString JsonData;
+    FFileHelper::LoadFileToString(JsonData, *FileName);
+
+    const TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(JsonData);
+    TSharedPtr<FJsonObject> JsonRootObject = MakeShareable(new FJsonObject);
+
+    if (!FJsonSerializer::Deserialize(Reader, JsonRootObject))
+    {
+        UE_LOG(LogTemp, Warning, TEXT("ImportFromFile: invalid json file %s"), *FileName);
+        return;
+    }
+
+    if (!JsonRootObject->HasTypedField<EJson::Object>(TEXT("normalizer")) ||
+        !JsonRootObject->HasTypedField<EJson::Object>(TEXT("post_processor")) ||
+        !JsonRootObject->HasTypedField<EJson::Object>(TEXT("model")))
+    {
+        UE_LOG(LogTemp, Warning, TEXT("ImportFromFile: invalid json file %s"), *FileName);
+        return;
+    }
+
+    TSharedPtr<FJsonObject> NormalizerRoot = JsonRootObject->GetObjectField(TEXT("normalizer"));
+    if (NormalizerRoot->HasTypedField<EJson::Object>(TEXT("pattern")))
+    {
+        TSharedPtr<FJsonObject> RegexPatternObj = NormalizerRoot->GetObjectField(TEXT("pattern"));
+        RegexPatternObj->TryGetStringField(TEXT("Regex"), TokenizePatternRegex);
+    }
+    FString NormType;
+    if (NormalizerRoot->TryGetStringField(TEXT("type"), NormType))
+    {
+        bTokenizePatternTypeReplace = NormType.Equals(TEXT("Replace"));
+    }
+
+    TokenToId.Empty();
+    TSharedPtr<FJsonObject> ModelRoot = JsonRootObject->GetObjectField(TEXT("model"));
+    if (!ModelRoot->HasTypedField<EJson::Object>(TEXT("vocab")))
+    {
+        UE_LOG(LogTemp, Warning, TEXT("ImportFromFile: invalid json file %s"), *FileName);
+        return;
+    }
+    TSharedPtr<FJsonObject> VocabRoot = ModelRoot->GetObjectField(TEXT("vocab"));
+    for (const auto& CharToToken : VocabRoot->Values)
+    {
+        FString VocabChar = CharToToken.Key;
+        if (CharToToken.Value->Type == EJson::Number)
+        {
+            int32 Token = CharToToken.Value->AsNumber();
+            TokenToId.Add(VocabChar, FTokensArrayWrapper({ Token }));
+        }
+    }
+    RebuildTokenTable();
+
+    ESpeakVoiceCode.Empty();
+    LanguageCode.Empty();
+    LanguageFamily.Empty();
+    SampleRate = 24000;
+    Speed = 1.f;
+    SentenceSilenceSeconds = 0.f;
+}
+
+void UTTSModelData_Kokoro::ImportVoiceFromFile(const FString& FileName)
+{
+    if (!FPaths::FileExists(FileName))
+    {
+        return;
+    }
+    FString VoiceName = FPaths::GetBaseFilename(FileName);
+    FString VoiceCode = VoiceName.Left(2);
+    int32 VoiceId = Speakers.Num();
+
+    if (Speakers.Contains(VoiceName))
+    {
+        VoiceId = Speakers[VoiceName];
+    }
+    else
+    {
+        Speakers.Add(VoiceName, VoiceId);
+        VoiceEspeakCodes.Add(TEXT(""));
+        VoiceStyles.Add(MakeUnique<FVoiceStyle>());
+    }
+
+    // Add new speaker
+    if (VoiceCode == TEXT("af") || VoiceCode == TEXT("am"))
+    {
+        VoiceCode = TEXT("en-us");
+    }
+    else if (VoiceCode == TEXT("bf") || VoiceCode == TEXT("bm"))
+    {
+        VoiceCode = TEXT("en-gb");
+    }
+    else if (VoiceCode == TEXT("jf") || VoiceCode == TEXT("jm"))
+    {
+        VoiceCode = TEXT("ja");
+    }
+    else if (VoiceCode == TEXT("zf") || VoiceCode == TEXT("zm"))
+    {
+        VoiceCode = TEXT("cmn");
+    }
+    else if (VoiceCode == TEXT("ef") || VoiceCode == TEXT("em"))
+    {
+        VoiceCode = TEXT("es");
+    }
+    else if (VoiceCode == TEXT("ff"))
+    {
+        VoiceCode = TEXT("fr-fr");
+    }
+    else if (VoiceCode == TEXT("hf") || VoiceCode == TEXT("hm"))
+    {
+        VoiceCode = TEXT("hi");
+    }
+    else if (VoiceCode == TEXT("if") || VoiceCode == TEXT("im"))
+    {
+        VoiceCode = TEXT("it");
+    }
+    else if (VoiceCode == TEXT("pf") || VoiceCode == TEXT("pm"))
+    {
+        VoiceCode = TEXT("pt-br");
+    }
+    // Add espeak code
+    VoiceEspeakCodes[VoiceId] = VoiceCode;
+
+    // Add voice data, actual shape is [-1, 1, 256]
+    TArray<uint8> RawBinaryData;
+    FFileHelper::LoadFileToArray(RawBinaryData, *FileName);
+    const int32 RowsNum = RawBinaryData.Num() / (VoiceStyleSize * sizeof(float));
+
+    UE_LOG(LogTemp, Log, TEXT("From BIN file loaded %d bytes, casting them as %d style rows"), RawBinaryData.Num(), RowsNum);
+
+    SetVoiceStyleData(VoiceId, RawBinaryData.GetData(), (int64)RowsNum * VoiceStyleSize * sizeof(float));
+}
+
+void UTTSModelData_Kokoro::DeleteSpeaker(int32 SpeakerID)
+{
+    FString key;
+    for (auto& sp : Speakers)
+    {
+        if (sp.Value == SpeakerID)
+        {
+            key = sp.Key;
+        }
+        else if (sp.Value > SpeakerID)
+        {
+            sp.Value--;
+        }
+    }
+
+    if (VoiceStyles.IsValidIndex(SpeakerID))
+    {
+        Speakers.Remove(key);
+        UnloadVoiceStyle(*VoiceStyles[SpeakerID]);
+        VoiceStyles.RemoveAt(SpeakerID);
+        VoiceEspeakCodes.RemoveAt(SpeakerID);
+    }
+}
+
+void UTTSModelData_Kokoro::DeleteAllSpeakers()
+{
+    Speakers.Empty();
+    for (auto& Voice : VoiceStyles)
+    {
+        UnloadVoiceStyle(*Voice);
+    }
+    VoiceStyles.Empty();
+    VoiceEspeakCodes.Empty();
+}
+
+const UTTSModelData_Kokoro::FVoiceStyle* UTTSModelData_Kokoro::GetVoiceStyle(int32 SpeakerId) const
+{
+    if (!VoiceStyles.IsValidIndex(SpeakerId))
+    {
+        return nullptr;
+    }
+
+    FVoiceStyle& Voice = *VoiceStyles[SpeakerId];
+    if (!Voice.bLoaded.load(std::memory_order_acquire) && !LoadVoiceStyle(Voice))
+    {
+        return nullptr;
+    }
+    return Voice.Rows ? &Voice : nullptr;
+}
+
+bool UTTSModelData_Kokoro::LoadVoiceStyle(FVoiceStyle& Voice) const
+{
+    FScopeLock Lock(&Voice.LoadLock);
+    if (Voice.bLoaded.load(std::memory_order_acquire))
+    {
+        return Voice.Rows != nullptr;
+    }
+
+    const int32 RowsNum = (int32)(Voice.Data.GetBulkDataSize() / (VoiceStyleSize * sizeof(float)));
+    const int64 DataSize = (int64)RowsNum * VoiceStyleSize * sizeof(float);
+    if (RowsNum > 0)
+    {
+        if (Voice.Data.IsDataMemoryMapped())
+        {
+            // Use mapped memory directly, it's unlocked when the voice is unloaded
+            Voice.Rows = (const float*)Voice.Data.LockReadOnly();
+            Voice.bDataLocked = true;
+        }
+        else if (Voice.Data.IsBulkDataLoaded())
+        {
+            // Editor or inline data
+            Voice.LoadedData.SetNumUninitialized(RowsNum * VoiceStyleSize);
+            FMemory::Memcpy(Voice.LoadedData.GetData(), Voice.Data.LockReadOnly(), DataSize);
+            Voice.Data.Unlock();
+            Voice.Rows = Voice.LoadedData.GetData();
+        }
+        else
+        {
+            // Read from disk
+            TUniquePtr<IBulkDataIORequest> Request(Voice.Data.CreateStreamingRequest(0, DataSize, AIOP_High, nullptr, nullptr));
+            if (Request.IsValid() && Request->WaitCompletion() && !Request->WasCancelled())
+            {
+                uint8* Results = Request->GetReadResults();
+                Voice.LoadedData.SetNumUninitialized(RowsNum * VoiceStyleSize);
+                FMemory::Memcpy(Voice.LoadedData.GetData(), Results, DataSize);
+                FMemory::Free(Results);
+                Voice.Rows = Voice.LoadedData.GetData();
+            }
+        }
+    }
+
+    if (Voice.Rows)
+    {
+        Voice.RowsNum = RowsNum;
+    }
+    else
+    {
+        UE_LOG(LogTemp, Warning, TEXT("%s: failed to load voice style data"), *GetName());
+    }
+    // Don't try to load invalid voice again
+    Voice.bLoaded.store(true, std::memory_order_release);
+    return Voice.Rows != nullptr;
+}
+
+void UTTSModelData_Kokoro::UnloadVoiceStyle(FVoiceStyle& Voice) const
+{
+    FScopeLock Lock(&Voice.LoadLock);
+    if (Voice.bDataLocked)
+    {
+        Voice.Data.Unlock();
+        Voice.bDataLocked = false;
+    }
+    Voice.Rows = nullptr;
+    Voice.RowsNum = 0;
+    Voice.LoadedData.Empty();
+    Voice.bLoaded.store(false, std::memory_order_release);
+}
+
+void UTTSModelData_Kokoro::SetVoiceStyleData(int32 SpeakerId, const void* Data, int64 Size)
+{
+    if (!VoiceStyles.IsValidIndex(SpeakerId))
+    {
+        return;
+    }
+
+    FVoiceStyle& Voice = *VoiceStyles[SpeakerId];
+    UnloadVoiceStyle(Voice);
+
+    Voice.Data.Lock(LOCK_READ_WRITE);
+    void* Dest = Voice.Data.Realloc(Size);
+    FMemory::Memcpy(Dest, Data, Size);
+    Voice.Data.Unlock();
+}
@@ -0,0 +1,128 @@
+// (c) Yuri N. K. 2025. All rights reserved.
+// ykasczc@gmail.com
+
+#include "TTSSoundWaveStreaming.h"
+#include "AudioDevice.h"
+#include "ActiveSound.h"
+
+#include UE_INLINE_GENERATED_CPP_BY_NAME(TTSSoundWaveStreaming)
+
+UTTSSoundWaveStreaming::UTTSSoundWaveStreaming(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	bFloatAudio = true;
+	SampleByteSize = sizeof(float);
+}
+
+void UTTSSoundWaveStreaming::InitializeStream(int32 InSampleRate, int32 CapacitySamples)
+{
+	SetSampleRate(InSampleRate);
+	NumChannels = 1;
+	bLooping = false;
+	Duration = INDEFINITELY_LOOPING_DURATION;
+
+	Rings.Reset();
+	FStreamRing* Ring = Rings.Add_GetRef(MakeUnique<FStreamRing>()).Get();
+	Ring->Buffer.SetCapacity((uint32)FMath::Max(CapacitySamples, NumSamplesToGeneratePerCallback));
+	ReadRing.store(Ring);
+	QueuedSamplesNum.store(0);
+	bStreamFinished.store(false);
+	PlayedSamplesNum.store(0);
+	UnderrunsNum.store(0);
+	UnderrunSamplesNum.store(0);
+}
+
+void UTTSSoundWaveStreaming::AppendAudio(const float* AudioData, int32 Num)
+{
+	if (Num <= 0 || IsStreamFinished())
+	{
+		return;
+	}
+	if (Rings.IsEmpty())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UTTSSoundWaveStreaming: stream isn't initialized"));
+		return;
+	}
+
+	// Delete rings which the audio thread has already left
+	const FStreamRing* CurrentReadRing = ReadRing.load(std::memory_order_acquire);
+	const int32 ReadRingIndex = Rings.IndexOfByPredicate([CurrentReadRing](const TUniquePtr<FStreamRing>& Ring) { return Ring.Get() == CurrentReadRing; });
+	if (ReadRingIndex > 0)
+	{
+		Rings.RemoveAt(0, ReadRingIndex, EAllowShrinking::No);
+	}
+
+	// Count samples before they're visible to the audio thread, so the counter never goes negative
+	QueuedSamplesNum.fetch_add(Num, std::memory_order_relaxed);
+
+	FStreamRing* WriteRing = Rings.Last().Get();
+	if (WriteRing->Buffer.Remainder() < (uint32)Num)
+	{
+		// Grow: old ring isn't written anymore, the audio thread moves to the new one when it's empty
+		FStreamRing* NewRing = Rings.Add_GetRef(MakeUnique<FStreamRing>()).Get();
+		NewRing->Buffer.SetCapacity(FMath::Max(WriteRing->Buffer.GetCapacity() * 2, (uint32)QueuedSamplesNum.load(std::memory_order_relaxed)));
+		WriteRing->Next.store(NewRing, std::memory_order_release);
+		WriteRing = NewRing;
+	}
+	WriteRing->Buffer.Push(AudioData, (uint32)Num);
+}
+
+void UTTSSoundWaveStreaming::FinishStream()
+{
+	bStreamFinished.store(true, std::memory_order_release);
+}
+
+void UTTSSoundWaveStreaming::Parse(FAudioDevice* AudioDevice, const UPTRINT NodeWaveInstanceHash, FActiveSound& ActiveSound, const FSoundParseParameters& ParseParams, TArray<FWaveInstance*>& WaveInstances)
+{
+	// No seeking in stream: playback time is only reported
+	ActiveSound.PlaybackTime = SampleRate > 0 ? (float)GetPlayedSamplesNum() / (float)SampleRate : 0.f;
+
+	if (IsStreamFinished() && GetQueuedSamplesNum() == 0)
+	{
+		AudioDevice->StopActiveSound(&ActiveSound);
+	}
+
+	// Skip UTTSSoundWaveRuntime::Parse, it works with the static buffer
+	USoundWaveProcedural::Parse(AudioDevice, NodeWaveInstanceHash, ActiveSound, ParseParams, WaveInstances);
+}
+
+int32 UTTSSoundWaveStreaming::GeneratePCMData(uint8* PCMData, const int32 SamplesNeeded)
+{
+	const int32 SamplesToPop = FMath::Min(SamplesNeeded, NumSamplesToGeneratePerCallback);
+	float* OutData = (float*)PCMData;
+	int32 SamplesPopped = 0;
+	FStreamRing* Ring = ReadRing.load(std::memory_order_relaxed);
+	while (Ring && SamplesPopped < SamplesToPop)
+	{
+		// Check for the next ring before reading, so the audio pushed to this ring before switching is already visible
+		FStreamRing* NextRing = Ring->Next.load(std::memory_order_acquire);
+		SamplesPopped += (int32)Ring->Buffer.Pop(OutData + SamplesPopped, (uint32)(SamplesToPop - SamplesPopped));
+		if (SamplesPopped < SamplesToPop && NextRing && Ring->Buffer.Num() == 0)
+		{
+			Ring = NextRing;
+			ReadRing.store(Ring, std::memory_order_release);
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	if (SamplesPopped > 0)
+	{
+		QueuedSamplesNum.fetch_sub(SamplesPopped, std::memory_order_relaxed);
+		PlayedSamplesNum.fetch_add(SamplesPopped, std::memory_order_relaxed);
+		return SamplesPopped * sizeof(float);
+	}
+
+	// Synthesis is slower than playback. Waiting for the first phrase isn't an underrun
+	if (!IsStreamFinished() && GetPlayedSamplesNum() > 0)
+	{
+		UnderrunsNum.fetch_add(1, std::memory_order_relaxed);
+		UnderrunSamplesNum.fetch_add(NumBufferUnderrunSamples, std::memory_order_relaxed);
+	}
+
+	const int32 BytesCopied = NumBufferUnderrunSamples * sizeof(float);
+	FMemory::Memzero(PCMData, BytesCopied);
+	return BytesCopied;
+}
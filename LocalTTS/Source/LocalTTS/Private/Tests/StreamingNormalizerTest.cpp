@@ -0,0 +1,84 @@
+// (c) Yuri N. K. 2025. All rights reserved.
+// ykasczc@gmail.com
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+#include "LocalTTSTypes.h"
+#include "StreamingNormalizer.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLocalTTSStreamingNormalizerTest, "LocalTTS.StreamingNormalizer.SentenceLevels",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FLocalTTSStreamingNormalizerTest::RunTest(const FString& Parameters)
+{
+	const int32 SampleRate = 22050;
+	const int32 PauseNum = (int32)((float)SampleRate * 0.3f);
+	const float MinPeak = 0.01f;
+	const double ToleranceDb = 0.5;
+
+	// Peak levels of sentences in test signals. Gain rises by 6 dB per ReleaseSeconds, so sentences after louder ones
+	// only reach the target if release is fast enough, other cases use the same settings as the subsystem
+	struct FTestCase
+	{
+		const TCHAR* Name;
+		TArray<float> Levels;
+		float ReleaseSeconds;
+	};
+	const TArray<FTestCase> TestCases =
+	{
+		{ TEXT("equal levels"), { 0.3f, 0.3f, 0.3f, 0.3f, 0.3f }, 4.f },
+		{ TEXT("mild variation"), { 0.3f, 0.25f, 0.35f, 0.28f, 0.32f }, 4.f },
+		{ TEXT("rising levels"), { 0.1f, 0.2f, 0.3f, 0.45f, 0.6f }, 4.f },
+		{ TEXT("wide variation"), { 0.1f, 0.6f, 0.2f, 0.45f, 0.3f }, 1.f },
+		{ TEXT("quiet"), { 0.02f, 0.02f, 0.02f }, 4.f },
+		{ TEXT("below min peak"), { 0.005f, 0.005f, 0.005f }, 4.f }
+	};
+
+	for (const FTestCase& TestCase : TestCases)
+	{
+		// Sentences of speech-like signal (carrier with syllable envelope) followed by pauses, as phrases are appended by subsystem
+		TArray<int32> SentenceSizes;
+		FStreamingNormalizer Normalizer(SampleRate, 0.05f, TestCase.ReleaseSeconds, MinPeak);
+		Audio::FAlignedFloatBuffer Sentence, Streamed;
+		int32 SamplesNum = 0;
+		for (int32 k = 0; k < TestCase.Levels.Num(); k++)
+		{
+			const int32 SentenceNum = (int32)((float)SampleRate * (1.f + 0.25f * (float)(k % 3)));
+			Sentence.SetNumZeroed(SentenceNum + PauseNum);
+			for (int32 i = 0; i < SentenceNum; i++)
+			{
+				Sentence[i] = TestCase.Levels[k] * FMath::Sin((float)i * 0.05f) * FMath::Abs(FMath::Sin((float)i * 0.0007f * (1.f + 0.3f * (float)k)));
+			}
+			SentenceSizes.Add(SentenceNum);
+			SamplesNum += Sentence.Num();
+			Normalizer.Process(Sentence.GetData(), Sentence.Num(), Streamed);
+		}
+		Normalizer.Flush(Streamed);
+
+		if (!TestEqual(FString::Printf(TEXT("%s: samples number"), TestCase.Name), Streamed.Num(), SamplesNum))
+		{
+			continue;
+		}
+
+		// Each sentence should be scaled to full range, or by 1 / MinPeak if it's too quiet
+		int32 Offset = 0;
+		for (int32 k = 0; k < SentenceSizes.Num(); k++)
+		{
+			const float Peak = LocalTtsMath::AbsMax(Streamed.GetData() + Offset, SentenceSizes[k]);
+			const float TargetPeak = FMath::Min(1.f, TestCase.Levels[k] / MinPeak);
+			const double DiffDb = 20.0 * FMath::LogX(10.0, FMath::Max((double)Peak, 1e-9) / (double)TargetPeak);
+
+			TestTrue(FString::Printf(TEXT("%s: sentence %d level %+.2f dB is within %.2f dB of target"), TestCase.Name, k, DiffDb, ToleranceDb),
+				FMath::Abs(DiffDb) <= ToleranceDb);
+			TestTrue(FString::Printf(TEXT("%s: sentence %d doesn't clip (peak %.4f)"), TestCase.Name, k, Peak), Peak <= 1.0001f);
+
+			Offset += SentenceSizes[k] + PauseNum;
+		}
+	}
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
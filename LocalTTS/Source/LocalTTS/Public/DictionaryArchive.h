@@ -1,69 +1,169 @@
-// (c) Yuri N. K. 2025. All rights reserved.
-// ykasczc@gmail.com
-
-#pragma once
-
-#include "CoreMinimal.h"
-#include "Serialization/BulkData.h"
-#include "Engine/DataAsset.h"
-#include "DictionaryArchive.generated.h"
-
-/**
- * Word-to-phonemes map serialized as ZIP archive
- */
-UCLASS(BlueprintType)
-class LOCALTTS_API UDictionaryArchive : public UDataAsset
-{
-	GENERATED_BODY()
-	
-public:
-	//~ Begin UObject Interface
-	virtual void Serialize(FArchive& Ar) override;
-	virtual void BeginDestroy() override;
-	//~ End UObject Interface
-	
-	// Binary archive to save in uasset
-	// Main data storage
-	FByteBulkData ArchivedData;
-
-	// Size of data (just for visual representation, because ArchivedData is hidden in blueprints)
-	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Data Info")
-	int64 Size = 0;
-
-	// Name of the imported file
-	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Data Info")
-	FString ImportFileName;
-
-	// Function to create the object from zip archive with CSV file
-	bool InitializeFromFile(const FString& FileName);
-
-	// Extract ZIP archive on disk in the specified directory
-	void Unzip();
-
-	// Fill G2PData from csv file data
-	void FillMap(const char* Data, int64 DataSize);
-
-	// Does the asset contain zip data?
-	bool HasBulkData() const;
-
-	// Was G2PData unzipped?
-	bool IsDictionaryReady() const;
-
-	// Find phonemes for the input word
-	const FString* Find(const FString& Word) const
-	{
-		return G2PData->Find(Word);
-	}
-
-private:
-
-	// Phonemization dictionary unzipped in runtime and shouldn't be serialized
-	TUniquePtr<TMap<FString, FString>> G2PData = nullptr;
-
-	// Archive header
-	void* ZipPtr = nullptr;
-	// Path to unzip
-	int32 ZipEntriesNum = 0;
-	int64 UnzippedSize = 0;
-	int64 FullArchiveSize = 0;
-};
+// (c) Yuri N. K. 2025. All rights reserved.
+// ykasczc@gmail.com
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Serialization/BulkData.h"
+#include "Engine/DataAsset.h"
+#include "PhonemeDictionaryTable.h"
+#include <atomic>
+#include "DictionaryArchive.generated.h"
+
+// Status of the dictionary table in runtime
+enum class EDictionaryState : uint8
+{
+	NotReady,
+	Building,
+	Ready,
+	Failed
+};
+
+/**
+ * Word-to-phonemes map serialized as ZIP archive (one or several csv files)
+ * Compiled dictionary is split to shards by hash of the word, each shard is loaded on first lookup
+ */
+UCLASS(BlueprintType)
+class LOCALTTS_API UDictionaryArchive : public UDataAsset
+{
+	GENERATED_BODY()
+	
+public:
+	//~ Begin UObject Interface
+	virtual void Serialize(FArchive& Ar) override;
+	virtual void BeginDestroy() override;
+	virtual bool IsReadyForFinishDestroy() override;
+#if WITH_EDITOR
+	virtual void PreSave(FObjectPreSaveContext SaveContext) override;
+#endif
+	//~ End UObject Interface
+	
+	// Binary archive to save in uasset
+	// Main data storage
+	FByteBulkData ArchivedData;
+
+	// Dictionary table shards built at import (FPhonemeDictionaryTable data), used in runtime without unzipping
+	FByteBulkData CompiledData;
+
+	// Offsets of the shards in CompiledData and its size at the end. Empty for single-table assets
+	UPROPERTY()
+	TArray<int64> CompiledShardOffsets;
+
+	// Size of data (just for visual representation, because ArchivedData is hidden in blueprints)
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Data Info")
+	int64 Size = 0;
+
+	// Size of the compiled dictionary table
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Data Info")
+	int64 CompiledSize = 0;
+
+	// Number of words in the compiled dictionary
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Data Info")
+	int32 WordsNum = 0;
+
+	// Name of the imported file
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Data Info")
+	FString ImportFileName;
+
+	// Function to create the object from zip archive with CSV file
+	bool InitializeFromFile(const FString& FileName);
+
+	// Prepare dictionary for lookups: initialize shards of compiled table or extract ZIP archive if there is no compiled table
+	void Unzip();
+
+	// Prepare dictionary for lookups in background thread. IsDictionaryReady returns true when it's finished
+	void PrepareAsync();
+
+	// Release loaded shards, the dictionary should be prepared again before lookups. Returns false if it's being prepared
+	bool ReleaseTable();
+
+	// Fill dictionary table from csv file data (parsed in parallel)
+	void FillMap(const char* Data, int64 DataSize);
+
+	// Does the asset contain zip data or compiled table?
+	bool HasBulkData() const;
+
+	// Does the asset contain compiled table?
+	bool HasCompiledTable() const;
+
+	// Was dictionary table unzipped? Thread-safe
+	bool IsDictionaryReady() const;
+
+	// Get dictionary table status. Thread-safe
+	EDictionaryState GetDictionaryState() const { return DictionaryState.load(std::memory_order_acquire); }
+
+	// Find phonemes for the input word (case-insensitive). Loads shard of the word if needed. Thread-safe
+	// Phonemes are NFD-normalized code points
+	bool Find(FStringView Word, TConstArrayView<UTF32CHAR>& OutPhonemes) const;
+
+	// Load shards of the words in parallel before lookups. Thread-safe
+	void PrefetchWords(TConstArrayView<FString> Words) const;
+	// Load all shards in parallel. Thread-safe
+	void LoadAllShards() const;
+
+	int32 GetShardsNum() const { return Shards.Num(); }
+	int32 GetLoadedShardsNum() const;
+	// Get table of the shard (loads it if needed)
+	const FPhonemeDictionaryTable* GetShardTable(int32 ShardIndex) const;
+	// Memory used by loaded shards
+	int64 GetResidentSize() const;
+
+private:
+
+	// Load compiled table or extract ZIP archive and update DictionaryState
+	void PrepareTable();
+	// Are shards created?
+	bool IsValidTable() const;
+	// Release unzipped data
+	void ReleaseData();
+	// Extract ZIP archive and build dictionary table
+	void UnzipArchive();
+	// Create dictionary shards from parsed csv data
+	void BuildTable(const FPhonemeDictionaryBuilder& Builder);
+	// Create (not loaded) shards for CompiledData
+	bool LoadCompiledTable();
+	// Save dictionary shards built by BuildTable to CompiledData. Game thread only, because the asset can be serialized there
+	void StoreCompiledTable(const TArray64<uint8>& Data, const TArray<int64>& ShardOffsets, int32 InWordsNum);
+	// Offsets of the shards in UnzippedData and its size at the end
+	TArray<int64> GetBuiltShardOffsets() const;
+	// Number of words in the shards built by BuildTable
+	int32 GetBuiltWordsNum() const;
+
+	struct FDictionaryShard
+	{
+		FPhonemeDictionaryTable Table;
+		// Location in CompiledData
+		int64 Offset = 0;
+		int64 Size = 0;
+		std::atomic<bool> bLoaded = false;
+		FCriticalSection LoadLock;
+	};
+
+	// Load shard table from CompiledData
+	bool LoadShard(FDictionaryShard& Shard) const;
+	FDictionaryShard* GetShard(uint32 Hash) const
+	{
+		return Shards[FPhonemeDictionaryTable::GetShardIndex(Hash, Shards.Num())].Get();
+	}
+
+	// CompiledData is locked while memory mapped table is used
+	bool bCompiledDataLocked = false;
+	const uint8* MappedData = nullptr;
+	// Reading loaded (not memory mapped) CompiledData from several threads
+	mutable FCriticalSection CompiledDataLock;
+
+	// Shards can be used only when it's Ready
+	std::atomic<EDictionaryState> DictionaryState = EDictionaryState::NotReady;
+
+	// Phonemization dictionary loaded in runtime and shouldn't be serialized
+	TArray<TUniquePtr<FDictionaryShard>> Shards;
+	// Shards data created in runtime from ZIP archive
+	TArray64<uint8> UnzippedData;
+
+	// Archive header
+	void* ZipPtr = nullptr;
+	// Path to unzip
+	int32 ZipEntriesNum = 0;
+	int64 UnzippedSize = 0;
+	int64 FullArchiveSize = 0;
+};
@@ -1,54 +1,73 @@
-// (c) Yuri N. K. 2025. All rights reserved.
-// ykasczc@gmail.com
-
-#pragma once
-
-#include "CoreMinimal.h"
-#include "Kismet/BlueprintFunctionLibrary.h"
-#include "LocalTTSTypes.h"
-#include "LocalTTSFunctionLibrary.generated.h"
-
-/**
- * Functions for LocalTTS subsystem
- */
-UCLASS()
-class LOCALTTS_API ULocalTTSFunctionLibrary : public UBlueprintFunctionLibrary
-{
-	GENERATED_BODY()
-
-public:
-	// Save 16-bit audio buffer to .wav file
-	UFUNCTION(BlueprintCallable, Category = "Local TTS")
-	static void SaveAudioDataToFile(const TArray<uint8>& RawPCMData, int32 NumChannels, int32 SampleRate, FString FileName);
-
-	// Save 32-bit audio buffer to .wav file
-	static void SaveAudioData32ToFile(const Audio::FAlignedFloatBuffer& RawPCMData, int32 NumChannels, int32 SampleRate, FString FileName);
-
-	// Get for the loaded model speaker ID corresponding to the speaker's name
-	UFUNCTION(BlueprintPure, meta = (DisplayName = "Get Speaker ID by Name"), Category = "Local TTS")
-	static int32 GetModelSpeakerByName(const FNNMInstanceId& ModelID, const FString& SpeakerName);
-
-	// Check if the model is loaded
-	UFUNCTION(BlueprintPure, meta = (DisplayName = "Is TTS Model Loaded"), Category = "Local TTS")
-	static bool IsTtsModelLoaded(const FNNMInstanceId& ModelID);
-
-	// Get TTSModelData asset related to the loaded model by tag
-	UFUNCTION(BlueprintPure, meta = (DisplayName = "Get TTS Model Data Asset"), Category = "Local TTS")
-	static class UTTSModelData_Base* GetTtsModelDataAsset(const FNNMInstanceId& ModelID);
-
-	// Release from memory already loaded NNE model
-	UFUNCTION(BlueprintCallable, meta = (DisplayName = "Release TTS Model"), Category = "Local TTS")
-	static bool ReleaseTtsModel(const FNNMInstanceId& ModelID);
-
-	// Helper function to cleanup csv datasets for g2p model training
-	UFUNCTION(BlueprintCallable, Category = "Local TTS")
-	static void Util_PhonemizeDictionaries();
-
-	// Helper function to cleanup csv datasets for g2p model training
-	UFUNCTION(BlueprintCallable, Category = "Local TTS")
-	static void Util_PhonemizeDictionariesToTrainG2P();
-
-	// Helper function to load NNE model with input/output data to FNNEModelTTS
-	static bool LoadNNM(FNNEModelTTS& ModelData, class UNNEModelData* ModelAsset, int32 OutputDataSize, FString Header);
-};
-
+// (c) Yuri N. K. 2025. All rights reserved.
+// ykasczc@gmail.com
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintFunctionLibrary.h"
+#include "LocalTTSTypes.h"
+#include "LocalTTSFunctionLibrary.generated.h"
+
+/**
+ * Functions for LocalTTS subsystem
+ */
+UCLASS()
+class LOCALTTS_API ULocalTTSFunctionLibrary : public UBlueprintFunctionLibrary
+{
+	GENERATED_BODY()
+
+public:
+	// Save 16-bit audio buffer to .wav file
+	UFUNCTION(BlueprintCallable, Category = "Local TTS")
+	static void SaveAudioDataToFile(const TArray<uint8>& RawPCMData, int32 NumChannels, int32 SampleRate, FString FileName);
+
+	// Save 32-bit audio buffer to .wav file
+	static void SaveAudioData32ToFile(const Audio::FAlignedFloatBuffer& RawPCMData, int32 NumChannels, int32 SampleRate, FString FileName);
+
+	// Get for the loaded model speaker ID corresponding to the speaker's name
+	UFUNCTION(BlueprintPure, meta = (DisplayName = "Get Speaker ID by Name"), Category = "Local TTS")
+	static int32 GetModelSpeakerByName(const FNNMInstanceId& ModelID, const FString& SpeakerName);
+
+	// Check if the model is loaded
+	UFUNCTION(BlueprintPure, meta = (DisplayName = "Is TTS Model Loaded"), Category = "Local TTS")
+	static bool IsTtsModelLoaded(const FNNMInstanceId& ModelID);
+
+	// Get TTSModelData asset related to the loaded model by tag
+	UFUNCTION(BlueprintPure, meta = (DisplayName = "Get TTS Model Data Asset"), Category = "Local TTS")
+	static class UTTSModelData_Base* GetTtsModelDataAsset(const FNNMInstanceId& ModelID);
+
+	// Release from memory already loaded NNE model
+	UFUNCTION(BlueprintCallable, meta = (DisplayName = "Release TTS Model"), Category = "Local TTS")
+	static bool ReleaseTtsModel(const FNNMInstanceId& ModelID);
+
+	// Helper function to cleanup csv datasets for g2p model training
+	UFUNCTION(BlueprintCallable, Category = "Local TTS")
+	static void Util_PhonemizeDictionaries();
+
+	// Helper function to cleanup csv datasets for g2p model training
+	UFUNCTION(BlueprintCallable, Category = "Local TTS")
+	static void Util_PhonemizeDictionariesToTrainG2P();
+
+	// Helper function to compare G2P decoding with and without past key values on out-of-dictionary words
+	UFUNCTION(BlueprintCallable, meta = (DisplayName = "Util Benchmark G2P Decoding"), Category = "Local TTS")
+	static void Util_BenchmarkG2PDecoding(const TArray<FString>& Words, const FString& EspeakLanguageCode, int32 Iterations = 10);
+
+	// Helper function to compare memory and lookup time of the phonemization dictionary table with TMap<FString, FString>
+	UFUNCTION(BlueprintCallable, meta = (DisplayName = "Util Benchmark Dictionary"), Category = "Local TTS")
+	static void Util_BenchmarkDictionary(class UDictionaryArchive* Dictionary, int32 LookupsNum = 100000);
+
+	// Helper function to compare vectorized peak normalization and 16 bit conversion of synthesized audio with scalar loops
+	UFUNCTION(BlueprintCallable, meta = (DisplayName = "Util Benchmark Audio Post Processing"), Category = "Local TTS")
+	static void Util_BenchmarkPostProcessing(int32 SamplesNum = 720000, int32 Iterations = 20);
+
+	// Helper function to load NNE model with input/output data to FNNEModelTTS
+	static bool LoadNNM(FNNEModelTTS& ModelData, class UNNEModelData* ModelAsset, int32 OutputDataSize, FString Header);
+
+	// Create one more instance of already loaded NNE model with its own input/output data
+	static bool CloneNNM(FNNEModelTTS& ModelData, const FNNEModelTTS& SourceModelData, int32 OutputDataSize, FString Header);
+
+protected:
+	// Create model instance for ModelData.Model and initialize input/output data
+	static bool CreateNNMInstance(FNNEModelTTS& ModelData, int32 OutputDataSize, FString Header);
+};
+
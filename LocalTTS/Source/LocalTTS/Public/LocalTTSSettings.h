@@ -1,49 +1,82 @@
-// (c) Yuri N. K. 2025. All rights reserved.
-// ykasczc@gmail.com
-
-#pragma once
-
-#include "CoreMinimal.h"
-#include "LocalTTSSettings.generated.h"
-
-/**
-* Global audio synthesis settings
-*/
-UCLASS(config = Engine, defaultconfig)
-class LOCALTTS_API UTtsSettings : public UObject
-{
-	GENERATED_BODY()
-
-public:
-	UTtsSettings();
-
-	// For any loaded model, should resample generated audio to TargetSampleRate?
-	UPROPERTY(GlobalConfig, EditAnywhere, Category = "Synthesis")
-	bool bResampleSynthesizedAudio = true;
-
-	// Any generated audio will be resampled to this value, if ResampleSynthesizedAudio is checked
-	UPROPERTY(GlobalConfig, EditAnywhere, meta=(EditCondition=bResampleSynthesizedAudio), Category = "Synthesis")
-	int32 TargetSampleRate = 44100;
-
-	// Save generated audio to [project dir]/Saved/CacheTTS
-	UPROPERTY(GlobalConfig, EditAnywhere, Category = "Synthesis")
-	bool bSaveCachedWav = false;
-
-	// Init espeak tokenizer when starting UE
-	UPROPERTY(GlobalConfig, EditAnywhere, Category = "Synthesis")
-	bool bAutoInitializeOnStartup = true;
-
-	// ONNX encoder of the G2P NNE model
-	UPROPERTY(GlobalConfig, EditAnywhere, Category = "Synthesis")
-	TSoftObjectPtr<class UNNEModelData> PhonemizerEncoder;
-
-	// ONNX decoder of the G2P NNE model
-	UPROPERTY(GlobalConfig, EditAnywhere, Category = "Synthesis")
-	TSoftObjectPtr<class UNNEModelData> PhonemizerDecoder;
-
-	// Phonemizer asset
-	UPROPERTY(GlobalConfig, EditAnywhere, Category = "Synthesis")
-	TSoftObjectPtr<class UPhonemizer> PhonemizerInfo;
-
-	static const UTtsSettings* Get();
+// (c) Yuri N. K. 2025. All rights reserved.
+// ykasczc@gmail.com
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "LocalTTSSettings.generated.h"
+
+/**
+* Global audio synthesis settings
+*/
+UCLASS(config = Engine, defaultconfig)
+class LOCALTTS_API UTtsSettings : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	UTtsSettings();
+
+	// For any loaded model, should resample generated audio to TargetSampleRate?
+	UPROPERTY(GlobalConfig, EditAnywhere, Category = "Synthesis")
+	bool bResampleSynthesizedAudio = true;
+
+	// Any generated audio will be resampled to this value, if ResampleSynthesizedAudio is checked
+	UPROPERTY(GlobalConfig, EditAnywhere, meta=(EditCondition=bResampleSynthesizedAudio), Category = "Synthesis")
+	int32 TargetSampleRate = 44100;
+
+	// Play generated audio at the model's sample rate (audio mixer converts it in playback) and resample to TargetSampleRate only for saved WAV files
+	UPROPERTY(GlobalConfig, EditAnywhere, meta=(EditCondition=bResampleSynthesizedAudio), Category = "Synthesis")
+	bool bNativeRatePlayback = false;
+
+	// Normalize volume of each sentence as it's synthesized (look-ahead limiter) instead of scanning peak of the whole audio
+	UPROPERTY(GlobalConfig, EditAnywhere, Category = "Synthesis")
+	bool bStreamingNormalization = false;
+
+	// Pass synthesized float audio to the sound wave as is: the buffer is moved without conversion to 16 bit.
+	// 16 bit data is only created when requested (saved WAV files, GetRawPCMData)
+	UPROPERTY(GlobalConfig, EditAnywhere, Category = "Synthesis")
+	bool bFloatPlayback = false;
+
+	// Pass sound wave (UTTSSoundWaveStreaming) to the callback as soon as synthesis starts and append sentences while it's playing
+	UPROPERTY(GlobalConfig, EditAnywhere, Category = "Synthesis")
+	bool bStreamingPlayback = false;
+
+	// Number of model instances used to synthesize batches of one long text in parallel (Kokoro models). Each instance needs its own runtime memory
+	UPROPERTY(GlobalConfig, EditAnywhere, meta=(ClampMin = 1, ClampMax = 8), Category = "Synthesis")
+	int32 ParallelBatchInstances = 1;
+
+	// Save generated audio to [project dir]/Saved/CacheTTS
+	UPROPERTY(GlobalConfig, EditAnywhere, Category = "Synthesis")
+	bool bSaveCachedWav = false;
+
+	// Init espeak tokenizer when starting UE
+	UPROPERTY(GlobalConfig, EditAnywhere, Category = "Synthesis")
+	bool bAutoInitializeOnStartup = true;
+
+	// ONNX encoder of the G2P NNE model
+	UPROPERTY(GlobalConfig, EditAnywhere, Category = "Synthesis")
+	TSoftObjectPtr<class UNNEModelData> PhonemizerEncoder;
+
+	// ONNX decoder of the G2P NNE model
+	UPROPERTY(GlobalConfig, EditAnywhere, Category = "Synthesis")
+	TSoftObjectPtr<class UNNEModelData> PhonemizerDecoder;
+
+	// Optional ONNX decoder of the G2P NNE model exported with past key values (decodes one token per step)
+	UPROPERTY(GlobalConfig, EditAnywhere, Category = "Synthesis")
+	TSoftObjectPtr<class UNNEModelData> PhonemizerDecoderWithPast;
+
+	// Phonemizer asset
+	UPROPERTY(GlobalConfig, EditAnywhere, Category = "Synthesis")
+	TSoftObjectPtr<class UPhonemizer> PhonemizerInfo;
+
+	// Project lexicons with phonemes of game-specific words, they are checked before dictionaries
+	UPROPERTY(GlobalConfig, EditAnywhere, Category = "Synthesis")
+	TArray<TSoftObjectPtr<class UPhonemeLexicon>> Lexicons;
+
+	// Append words phonemized by G2P model to [project dir]/Saved/LocalTTS/G2P_[language].csv and reuse them next time
+	UPROPERTY(GlobalConfig, EditAnywhere, Category = "Synthesis")
+	bool bSaveG2PWords = false;
+
+	static const UTtsSettings* Get();
 };
\ No newline at end of file
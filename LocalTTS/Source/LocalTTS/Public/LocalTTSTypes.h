@@ -1,200 +1,275 @@
-// (c) Yuri N. K. 2025. All rights reserved.
-// ykasczc@gmail.com
-
-#pragma once
-
-#include "CoreMinimal.h"
-#include "NNERuntimeCPU.h"
-#include "DSP/AlignedBuffer.h"
-#include "LocalTTSTypes.generated.h"
-
-class UNNEModelData;
-class UTTSModelData_Base;
-
-// Helpers for android support
-namespace PlatformFileUtils
-{
-	// Fix invalid delimiters in the path
-	void NormalizePath(FString& Path);
-
-	// Return absolute actual path on storage device from the Unreal path
-	// For Windows they're equal 
-	FString GetPlatformPath(FString Path);
-
-	// Check if directory exists on physical disk
-	bool DirectoryExists(const FString& Dir);
-}
-
-namespace Piper
-{
-	typedef char32_t PhonemeUtf8;
-	typedef int64_t PhonemeId;
-}
-
-/**
-* Phonemization approach (not in use)
-*/
-UENUM(BlueprintType)
-enum class ETTSPhonemeType : uint8
-{
-	PT_eSpeak				UMETA(DisplayName = "eSpeak"),
-	PT_Dictionary			UMETA(DisplayName = "Dictionary + G2P NNM"),
-	PT_NNM					UMETA(DisplayName = "G2P NNM")
-};
-
-// Container for NNM instance key in ULocalTTSSubsystem
-USTRUCT(BlueprintType, meta=(DisplayName = "TTS Model Instance ID"))
-struct FNNMInstanceId
-{
-	GENERATED_BODY()
-
-	// Key in ULocalTTSSubsystem::VoiceModels
-	UPROPERTY()
-	int32 Id = INDEX_NONE;
-
-	FNNMInstanceId() {}
-	FNNMInstanceId(int32 Index) : Id(Index) {}
-	FNNMInstanceId& operator=(int32 Value)
-	{
-		Id = Value; return *this;
-	}
-	bool operator==(int32 Value) const
-	{
-		return Id == Value;
-	}
-};
-
-// NNM input index to data buffer
-USTRUCT()
-struct FNNEModelInputBinding
-{
-	GENERATED_BODY()
-
-	// Data format in NNM input
-	ENNETensorDataType Format = ENNETensorDataType::None;
-	// Corresponding array index
-	int32 ArrayIndex = INDEX_NONE;
-};
-
-/**
-* Generic TTS ONNX model with input and output settings
-*/
-USTRUCT()
-struct FNNEModelTTS
-{
-	GENERATED_BODY()
-
-protected:
-	FGuid Guid;
-
-public:
-	TObjectPtr<UTTSModelData_Base> VoiceDesc = nullptr;
-	FString ModelAssetName;
-
-	// NNE Setup
-
-	// NNE Model
-	TSharedPtr<UE::NNE::IModelInstanceCPU> ModelInstance;
-	// Inputs
-	TArray<UE::NNE::FTensorBindingCPU> InputBindings;
-	// Outputs (just one, just float)
-	TArray<UE::NNE::FTensorBindingCPU> OutputBindings;
-
-	// Tensor buffers
-
-	// Universal input mapping
-	TArray<FNNEModelInputBinding> InputMap;
-	TArray<TArray<float>> InputDataFloat;
-	TArray<TArray<int64>> InputDataInt64;
-	// Outputs
-	TArray<float> OutputData;
-	// Shapes applied before RunSync
-	TArray<UE::NNE::FTensorShape> InputTensorShapes;
-
-	// Model is loaded
-	bool bLoaded = false;
-
-	// Using GUID for operator==
-	FNNEModelTTS() : Guid(FGuid::NewGuid()) {}
-
-	bool operator==(const FNNEModelTTS& Other) const { return Guid == Other.Guid; }
-	FString GetGUID() const { return Guid.ToString(); }
-
-	// Get reference to input tensor by Index
-	TArray<int64>& GetInParamIntUnsafe(const int32 Index);
-	// Get reference to input tensor by Index
-	TArray<float>& GetInParamFloatUnsafe(const int32 Index);
-	// Get if input exists
-	bool CheckInParam(const int32 Index, ENNETensorDataType Type) const;
-	// Reserve memory for RunSync output
-	void PrepareOutputBuffer(int32 Size);
-
-	// Set input parameters
-	bool PrepareInputFloat(int32 Index, const TArray<float>& Data, const TArrayView<const uint32>& Shape);
-	bool PrepareInputInt64(int32 Index, const TArray<int64>& Data, const TArrayView<const uint32>& Shape);
-	// Run and get output tensor
-	bool RunNNE(TArray<float>& OutData, TArray<uint32>& OutDataShape, bool bReturnData = true);
-};
-
-/**
-* Non-static text-to-speech generation settings
-*/
-USTRUCT(Blueprintable)
-struct FTTSGenerateSettings
-{
-	GENERATED_BODY()
-
-	// Numeric ID of speaker in the model. Use -1 for models without speakers map.
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "TTS Generate Settings")
-	int32 SpeakerId = INDEX_NONE;
-};
-
-/**
-* Model parameters; internal; used to fill NNM inputs
-*/
-USTRUCT()
-struct FTTSGenerateRequestContext
-{
-	GENERATED_BODY()
-
-	// ID of speaker in the model
-	UPROPERTY()
-	int32 SpeakerId = INDEX_NONE;
-
-	// Pointer to tokens
-	const TArray<Piper::PhonemeId>* Tokens = nullptr;
-};
-
-/**
-* All data generated by NNM
-*/
-USTRUCT()
-struct FSynthesisResult
-{
-	GENERATED_BODY()
-
-	// Voice
-	FNNMInstanceId ModelTag;
-
-	// Phonemized input data
-	TArray<TArray<Piper::PhonemeUtf8>> PhonemePhrases;
-
-	// Generated audio duration
-	double AudioSeconds = 0.0;
-
-	// Final post-processed sample rate of PCMData32 and PCMData16
-	int32 SampleRate = 0;
-
-	// Primary audio buffer (32-bit)
-	Audio::FAlignedFloatBuffer PCMData32;
-	// Buffer converted to 16-bit format
-	TArray<uint8> PCMData16;
-
-	void Reset(const FNNMInstanceId& NewVoice)
-	{
-		ModelTag = NewVoice;
-		AudioSeconds = 0.f;
-		PCMData16.Empty();
-		PhonemePhrases.Empty();
-	}
-};
+// (c) Yuri N. K. 2025. All rights reserved.
+// ykasczc@gmail.com
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "NNERuntimeCPU.h"
+#include "DSP/AlignedBuffer.h"
+#include "LocalTTSTypes.generated.h"
+
+class UNNEModelData;
+class UTTSModelData_Base;
+
+// Helpers for android support
+namespace PlatformFileUtils
+{
+	// Fix invalid delimiters in the path
+	void NormalizePath(FString& Path);
+
+	// Return absolute actual path on storage device from the Unreal path
+	// For Windows they're equal 
+	FString GetPlatformPath(FString Path);
+
+	// Check if directory exists on physical disk
+	bool DirectoryExists(const FString& Dir);
+}
+
+// Vectorized math helpers
+namespace LocalTtsMath
+{
+	// Index of the first max value in array
+	LOCALTTS_API int32 ArgMax(const float* Data, int32 Num);
+
+	// Max absolute value in array
+	LOCALTTS_API float AbsMax(const float* Data, int32 Num);
+
+	// Copy array to Out and return its max absolute value in the same pass
+	LOCALTTS_API float CopyAbsMax(const float* Data, int32 Num, float* Out);
+
+	// Sum of squared values in array
+	LOCALTTS_API float SumOfSquares(const float* Data, int32 Num);
+
+	// Out[i] = trunc(Data[i] * Scale) clamped to int16 range
+	LOCALTTS_API void FloatToInt16(const float* Data, int32 Num, float Scale, int16* Out);
+
+	// Scale audio to the full int16 range by its peak (not less than MinPeak) in two passes
+	LOCALTTS_API void NormalizeToInt16(const float* Data, int32 Num, float MinPeak, int16* Out);
+
+	// Scale float audio to [-1, 1] by its peak (not less than MinPeak)
+	LOCALTTS_API void NormalizeInPlace(float* Data, int32 Num, float MinPeak);
+}
+
+namespace Piper
+{
+	typedef char32_t PhonemeUtf8;
+	typedef int64_t PhonemeId;
+}
+
+/**
+* Phonemized text: one flat buffer of phonemes split into phrases (sentences or model batches)
+*/
+struct FPhonemePhrases
+{
+	// All phonemes of the text
+	TArray<Piper::PhonemeUtf8> Phonemes;
+	// End offset of each phrase in Phonemes
+	TArray<int32> PhraseEnds;
+
+	int32 Num() const { return PhraseEnds.Num(); }
+	bool IsEmpty() const { return PhraseEnds.IsEmpty(); }
+	bool IsValidIndex(int32 Index) const { return PhraseEnds.IsValidIndex(Index); }
+
+	// Phrase phonemes as a view into Phonemes
+	TConstArrayView<Piper::PhonemeUtf8> operator[](int32 Index) const
+	{
+		const int32 Start = Index > 0 ? PhraseEnds[Index - 1] : 0;
+		return TConstArrayView<Piper::PhonemeUtf8>(Phonemes.GetData() + Start, PhraseEnds[Index] - Start);
+	}
+
+	// Number of phonemes added after the last closed phrase
+	int32 GetOpenPhraseNum() const { return Phonemes.Num() - (PhraseEnds.IsEmpty() ? 0 : PhraseEnds.Last()); }
+
+	// Close current phrase, empty phrases are ignored
+	void EndPhrase()
+	{
+		if (GetOpenPhraseNum() > 0)
+		{
+			PhraseEnds.Add(Phonemes.Num());
+		}
+	}
+
+	void Empty()
+	{
+		Phonemes.Empty();
+		PhraseEnds.Empty();
+	}
+};
+
+/**
+* Phonemization approach (not in use)
+*/
+UENUM(BlueprintType)
+enum class ETTSPhonemeType : uint8
+{
+	PT_eSpeak				UMETA(DisplayName = "eSpeak"),
+	PT_Dictionary			UMETA(DisplayName = "Dictionary + G2P NNM"),
+	PT_NNM					UMETA(DisplayName = "G2P NNM")
+};
+
+// Container for NNM instance key in ULocalTTSSubsystem
+USTRUCT(BlueprintType, meta=(DisplayName = "TTS Model Instance ID"))
+struct FNNMInstanceId
+{
+	GENERATED_BODY()
+
+	// Key in ULocalTTSSubsystem::VoiceModels
+	UPROPERTY()
+	int32 Id = INDEX_NONE;
+
+	FNNMInstanceId() {}
+	FNNMInstanceId(int32 Index) : Id(Index) {}
+	FNNMInstanceId& operator=(int32 Value)
+	{
+		Id = Value; return *this;
+	}
+	bool operator==(int32 Value) const
+	{
+		return Id == Value;
+	}
+};
+
+// NNM input index to data buffer
+USTRUCT()
+struct FNNEModelInputBinding
+{
+	GENERATED_BODY()
+
+	// Data format in NNM input
+	ENNETensorDataType Format = ENNETensorDataType::None;
+	// Corresponding array index
+	int32 ArrayIndex = INDEX_NONE;
+};
+
+/**
+* Generic TTS ONNX model with input and output settings
+*/
+USTRUCT()
+struct FNNEModelTTS
+{
+	GENERATED_BODY()
+
+protected:
+	FGuid Guid;
+
+public:
+	TObjectPtr<UTTSModelData_Base> VoiceDesc = nullptr;
+	FString ModelAssetName;
+
+	// NNE Setup
+
+	// NNE Model (shared by all instances created from the same asset)
+	TSharedPtr<UE::NNE::IModelCPU> Model;
+	// NNE Model Instance
+	TSharedPtr<UE::NNE::IModelInstanceCPU> ModelInstance;
+	// Inputs
+	TArray<UE::NNE::FTensorBindingCPU> InputBindings;
+	// Outputs (just one, just float)
+	TArray<UE::NNE::FTensorBindingCPU> OutputBindings;
+
+	// Tensor buffers
+
+	// Universal input mapping
+	TArray<FNNEModelInputBinding> InputMap;
+	TArray<TArray<float>> InputDataFloat;
+	TArray<TArray<int64>> InputDataInt64;
+	// Outputs
+	TArray<float> OutputData;
+	// Outputs with index > 0 (only for models with several output tensors), ExtraOutputData[0] is output #1
+	TArray<TArray<float>> ExtraOutputData;
+	// Shapes applied before RunSync
+	TArray<UE::NNE::FTensorShape> InputTensorShapes;
+
+	// Model is loaded
+	bool bLoaded = false;
+
+	// Using GUID for operator==
+	FNNEModelTTS() : Guid(FGuid::NewGuid()) {}
+
+	bool operator==(const FNNEModelTTS& Other) const { return Guid == Other.Guid; }
+	FString GetGUID() const { return Guid.ToString(); }
+
+	// Get reference to input tensor by Index
+	TArray<int64>& GetInParamIntUnsafe(const int32 Index);
+	// Get reference to input tensor by Index
+	TArray<float>& GetInParamFloatUnsafe(const int32 Index);
+	// Get if input exists
+	bool CheckInParam(const int32 Index, ENNETensorDataType Type) const;
+	// Reserve memory for RunSync output
+	void PrepareOutputBuffer(int32 Size);
+	// Reserve memory for additional RunSync output (OutputIndex > 0)
+	void PrepareExtraOutputBuffer(int32 OutputIndex, int32 Size);
+
+	// Set input parameters
+	bool PrepareInputFloat(int32 Index, const TArray<float>& Data, const TArrayView<const uint32>& Shape);
+	bool PrepareInputFloat(int32 Index, const float* Data, int32 Num, const TArrayView<const uint32>& Shape);
+	bool PrepareInputInt64(int32 Index, const TArray<int64>& Data, const TArrayView<const uint32>& Shape);
+	// Bind external memory owned by the caller as input parameter without copying. Data should stay valid while the binding is used
+	bool BindInputFloat(int32 Index, float* Data, int64 Num, const TArrayView<const uint32>& Shape);
+	bool BindInputInt64(int32 Index, int64* Data, int64 Num, const TArrayView<const uint32>& Shape);
+	// Run and get output tensor
+	bool RunNNE(TArray<float>& OutData, TArray<uint32>& OutDataShape, bool bReturnData = true);
+};
+
+/**
+* Non-static text-to-speech generation settings
+*/
+USTRUCT(Blueprintable)
+struct FTTSGenerateSettings
+{
+	GENERATED_BODY()
+
+	// Numeric ID of speaker in the model. Use -1 for models without speakers map.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "TTS Generate Settings")
+	int32 SpeakerId = INDEX_NONE;
+};
+
+/**
+* Model parameters; internal; used to fill NNM inputs
+*/
+USTRUCT()
+struct FTTSGenerateRequestContext
+{
+	GENERATED_BODY()
+
+	// ID of speaker in the model
+	UPROPERTY()
+	int32 SpeakerId = INDEX_NONE;
+
+	// Pointer to tokens
+	const TArray<Piper::PhonemeId>* Tokens = nullptr;
+};
+
+/**
+* All data generated by NNM
+*/
+USTRUCT()
+struct FSynthesisResult
+{
+	GENERATED_BODY()
+
+	// Voice
+	FNNMInstanceId ModelTag;
+
+	// Phonemized input data
+	FPhonemePhrases PhonemePhrases;
+
+	// Generated audio duration
+	double AudioSeconds = 0.0;
+
+	// Final post-processed sample rate of PCMData32 and PCMData16
+	int32 SampleRate = 0;
+
+	// Primary audio buffer (32-bit)
+	Audio::FAlignedFloatBuffer PCMData32;
+	// Buffer converted to 16-bit format
+	TArray<uint8> PCMData16;
+
+	void Reset(const FNNMInstanceId& NewVoice)
+	{
+		ModelTag = NewVoice;
+		AudioSeconds = 0.f;
+		PCMData16.Empty();
+		PhonemePhrases.Empty();
+	}
+};
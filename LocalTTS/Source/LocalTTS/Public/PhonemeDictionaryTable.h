@@ -0,0 +1,138 @@
+// (c) Yuri N. K. 2025. All rights reserved.
+// ykasczc@gmail.com
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Read-only word-to-phonemes hash table stored in a single memory block:
+ * [header][slots: uint32 entry index + 1][entries: hash, offset, lengths][pool: value, key, value, key...]
+ * Keys are lowercased UTF-8, so lookups are case-insensitive and don't allocate memory
+ * Values are NFD-normalized UTF-32 code points (aligned to 4 bytes), ready to be tokenized
+ */
+class LOCALTTS_API FPhonemeDictionaryTable
+{
+public:
+	FPhonemeDictionaryTable() = default;
+	~FPhonemeDictionaryTable() { Reset(); }
+	FPhonemeDictionaryTable(const FPhonemeDictionaryTable&) = delete;
+	FPhonemeDictionaryTable& operator=(const FPhonemeDictionaryTable&) = delete;
+
+	// Max length of the key in UTF-8 bytes
+	static constexpr int32 MaxKeyBytes = 128;
+
+	struct FHeader
+	{
+		uint32 Magic;
+		uint32 Version;
+		uint32 EntriesNum;
+		// Power of two
+		uint32 SlotsNum;
+		uint64 PoolSize;
+	};
+
+	struct FEntry
+	{
+		uint32 Hash;
+		// Offset of the value in pool (aligned to 4 bytes), key follows the value
+		uint32 Offset;
+		// Key length in bytes
+		uint16 KeyLen;
+		// Value length in code points
+		uint16 ValueLen;
+
+		// Offset of the key in pool
+		uint32 GetKeyOffset() const { return Offset + (uint32)(ValueLen * sizeof(UTF32CHAR)); }
+		// Size of value and key in pool
+		uint32 GetSize() const { return Align((uint32)(ValueLen * sizeof(UTF32CHAR)) + KeyLen, sizeof(UTF32CHAR)); }
+	};
+
+	static constexpr uint32 Magic = 0x54445450; // "PTDT"
+	static constexpr uint32 Version = 2;
+
+	// Use already built table data (from FPhonemeDictionaryBuilder)
+	bool Initialize(TArray64<uint8>&& InData);
+	// Use table data allocated with FMemory::Malloc (like bulk data copy), the table takes ownership
+	bool InitializeFromRawMemory(void* InData, int64 InSize);
+	// Use external table data (like locked memory mapped bulk data), which should stay valid while the table is used
+	bool InitializeView(const uint8* InData, int64 InSize);
+	void Reset();
+
+	// Find phonemes for the word (case-insensitive)
+	bool Find(FStringView Word, TConstArrayView<UTF32CHAR>& OutPhonemes) const;
+	// Find phonemes for the word lowercased with FoldWord. Hash is HashKey(Key, KeyLen)
+	bool FindFolded(const UTF8CHAR* Key, int32 KeyLen, uint32 Hash, TConstArrayView<UTF32CHAR>& OutPhonemes) const;
+
+	bool IsValid() const { return Header != nullptr; }
+	int32 Num() const { return Header ? (int32)Header->EntriesNum : 0; }
+	// Get key and value by entry index in [0, Num())
+	void GetEntry(int32 Index, FUtf8StringView& OutWord, TConstArrayView<UTF32CHAR>& OutPhonemes) const;
+	// Memory allocated by the table (zero for external data)
+	int64 GetAllocatedSize() const { return RawMemory ? DataSize : Data.GetAllocatedSize(); }
+	// Raw table data to save
+	const uint8* GetRawData() const { return reinterpret_cast<const uint8*>(Header); }
+	int64 GetRawSize() const { return Header ? DataSize : 0; }
+
+	// Lowercase word and convert to UTF-8. Returns number of bytes or INDEX_NONE if the word is too long
+	static int32 FoldWord(FStringView Word, UTF8CHAR (&OutKey)[MaxKeyBytes]);
+	static int32 FoldWord(FUtf8StringView Word, UTF8CHAR (&OutKey)[MaxKeyBytes]);
+	// FNV-1a
+	static uint32 HashKey(const UTF8CHAR* Key, int32 Len);
+	// Convert phonemes to string
+	static FString PhonemesToString(TConstArrayView<UTF32CHAR> Phonemes);
+	// Shard of the key in sharded dictionary. High bits of the hash are used, because low bits select slot in the table
+	static int32 GetShardIndex(uint32 Hash, int32 ShardsNum)
+	{
+		return ShardsNum > 1 ? (int32)(Hash >> (32 - FMath::FloorLog2((uint32)ShardsNum))) : 0;
+	}
+
+private:
+	// Validate table data and set pointers
+	bool SetData(const uint8* InData, int64 InSize);
+
+	// Owned table data (one of them) or nothing if external data is used
+	TArray64<uint8> Data;
+	void* RawMemory = nullptr;
+	int64 DataSize = 0;
+
+	// Pointers to Data
+	const FHeader* Header = nullptr;
+	const uint32* Slots = nullptr;
+	const FEntry* Entries = nullptr;
+	const uint8* Pool = nullptr;
+};
+
+/**
+ * Collects words and phonemes to build FPhonemeDictionaryTable
+ */
+class LOCALTTS_API FPhonemeDictionaryBuilder
+{
+public:
+	// Add word (will be lowercased) and phonemes (will be NFD-normalized). Later duplicates replace earlier ones
+	bool Add(FUtf8StringView Word, FUtf8StringView Phonemes);
+	bool Add(FStringView Word, FStringView Phonemes);
+	// Move entries from other builder to the end of this one
+	void Append(FPhonemeDictionaryBuilder&& Other);
+	void Reserve(int32 EntriesNum, int64 PoolSize);
+
+	int32 Num() const { return Entries.Num(); }
+
+	// Create table data
+	bool Build(TArray64<uint8>& OutData) const;
+	// Create ShardsNum (power of two) tables in parallel and write them one after another (aligned to 8 bytes)
+	// OutShardOffsets gets ShardsNum + 1 offsets in OutData
+	bool BuildShards(int32 ShardsNum, TArray64<uint8>& OutData, TArray<int64>& OutShardOffsets) const;
+	// Number of shards to keep size of each shard about TargetShardSize
+	int32 GetRecommendedShardsNum() const;
+
+	static constexpr int64 TargetShardSize = 256 * 1024;
+	static constexpr int32 MaxShardsNum = 256;
+
+private:
+	// Create table data from some of the entries
+	bool BuildSubset(TConstArrayView<int32> EntryIndices, TArray64<uint8>& OutData) const;
+
+	TArray<FPhonemeDictionaryTable::FEntry> Entries;
+	TArray64<uint8> Pool;
+};
@@ -0,0 +1,50 @@
+// (c) Yuri N. K. 2025. All rights reserved.
+// ykasczc@gmail.com
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "PhonemeDictionaryTable.h"
+#include "HAL/CriticalSection.h"
+#include "PhonemeLexicon.generated.h"
+
+/**
+ * Project-specific words (names, jargon) with phonemes. Phonemizer checks lexicons before dictionaries and G2P model
+ */
+UCLASS(BlueprintType)
+class LOCALTTS_API UPhonemeLexicon : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	//~ Begin UObject Interface
+	virtual void PostLoad() override;
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+	//~ End UObject Interface
+
+	// G2P language code ("eng-us", "rus"). Keep empty to use the lexicon for all languages
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Lexicon")
+	FName LanguageCode;
+
+	// Word and its phonemes in IPA (like espeak-ng output)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Lexicon")
+	TMap<FString, FString> Words;
+
+	// Build lookup table from Words. Call it after changing Words in runtime
+	UFUNCTION(BlueprintCallable, Category = "Lexicon")
+	void RebuildTable();
+
+	// Can the lexicon be used for G2P language code?
+	bool IsUsedForLanguage(FName InLanguageCode) const { return LanguageCode.IsNone() || LanguageCode == InLanguageCode; }
+
+	// Get current lookup table. Thread-safe, the table stays valid while it's referenced
+	TSharedPtr<const FPhonemeDictionaryTable> GetTable() const;
+
+private:
+	// Replaced when lexicon is changed
+	TSharedPtr<const FPhonemeDictionaryTable> Table;
+	mutable FCriticalSection TableLock;
+};
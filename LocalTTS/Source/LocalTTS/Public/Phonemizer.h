@@ -1,78 +1,238 @@
-// (c) Yuri N. K. 2025. All rights reserved.
-// ykasczc@gmail.com
-
-#pragma once
-
-#include "CoreMinimal.h"
-#include "Engine/DataAsset.h"
-#include "LocalTTSTypes.h"
-#include "DictionaryArchive.h"
-#include "Phonemizer.generated.h"
-
-/**
- * Asset to phonemize text input using dictionaries and NNE G2P model
- * The model was fine-tuned for all voices supported by Piper.
- * Dataset built using open IPA dictionaries https://github.com/open-dict-data/ipa-dict
- * re-phonemized with espeak-ng https://github.com/espeak-ng/espeak-ng/
- * G2P model architecture: https://github.com/lingjzhu/CharsiuG2P/
- * 13 epoches, loss: 0.0107.
- */
-UCLASS(BlueprintType)
-class LOCALTTS_API UPhonemizer : public UDataAsset
-{
-	GENERATED_BODY()
-
-public:
-	virtual void BeginDestroy() override;
-
-	// Phonemization dictionaries (still better the model, and of course faster)
-	// To add a new dictionary use LoadDictionaryFromArchive
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "TTS Phonemizer")
-	TMap<FName, TSoftObjectPtr<class UDictionaryArchive>> Dictionaries;
-
-	// Load NNE models and prepare to use phonemizer
-	UFUNCTION(BlueprintCallable, Category = "Phonemizer")
-	void SyncLoadModel(TSoftObjectPtr<UNNEModelData> EncoderPtr, TSoftObjectPtr<UNNEModelData> DecoderPtr);
-
-	// Phonemize text. Automatically uses dictionary for known words, if th dictionary was loaded and unzipped for the active language
-	UFUNCTION(BlueprintCallable, Category = "Phonemizer")
-	void SyncPhonemizeText(const FString& Text, FString& PhonemizedText, TArray<FString>& OutWords, bool bCharactersAsWords);
-
-	// Load dictionary asset by espeak language code ("en-us", "ru")
-	UFUNCTION(BlueprintCallable, Category = "Phonemizer")
-	void PrepareDictionary(const FString& EspeakLanguageCode);
-
-	// Set current language. Language code like: "eng-us" or "rus"
-	UFUNCTION(BlueprintCallable, Category = "Phonemizer")
-	void SetLanguageCodeFormatRaw(const FString& InLanguageCode);
-
-	// Set current language. Language code like: "en-us", "ru"...
-	UFUNCTION(BlueprintCallable, Category = "Phonemizer")
-	bool SetLanguageCodeFormatEspeak(const FString& InLanguageCode, bool bUseDicrionary);
-
-	// Add new phonemization dictionary
-	UFUNCTION(BlueprintCallable, Category = "Phonemizer")
-	void LoadDictionaryFromArchive(const FString& FileName, const FString& InLanguageCode);
-
-	// Get active language code ("eng-us" or "rus")
-	UFUNCTION(BlueprintPure, Category = "Phonemizer")
-	FString GetLanguage() const;
-
-protected:
-	// G2P model: encoder
-	FNNEModelTTS Encoder;
-	// G2P model: decoder
-	FNNEModelTTS Decoder;
-
-	// Active language code
-	FString LanguageCode;
-
-	// Logits to tokens, not used anymore
-	void ArgMax(const float* In, int32 Shape0, int32 Shape1, TArray<int64>& Out) const;
-
-	TMap<FString, FString> EspeakToActual = {
-		{TEXT("ar"), TEXT("ara")}, {TEXT("ca"), TEXT("cat")}, {TEXT("cs"), TEXT("cze")}, {TEXT("cy"), TEXT("wel-nw")}, {TEXT("da"), TEXT("dan")}, {TEXT("de"), TEXT("ger")}, {TEXT("el"), TEXT("gre")}, {TEXT("en-gb-x-rp"), TEXT("eng-uk")}, {TEXT("en-us"), TEXT("eng-us")}, {TEXT("es"), TEXT("spa")}, {TEXT("es-419"), TEXT("spa-me")}, {TEXT("fa"), TEXT("fas")}, {TEXT("fi"), TEXT("fin")}, {TEXT("fr"), TEXT("fra")}, {TEXT("fr-fr"), TEXT("fra")}, {TEXT("hu"), TEXT("hun")}, {TEXT("is"), TEXT("ice")}, {TEXT("it"), TEXT("ita")}, {TEXT("ka"), TEXT("geo")}, {TEXT("kk"), TEXT("kaz")}, {TEXT("lb"), TEXT("ltz")}, {TEXT("nl"), TEXT("dut")}, {TEXT("nb"), TEXT("nob")}, {TEXT("pl"), TEXT("pol")}, {TEXT("pt-br"), TEXT("por-bz")}, {TEXT("pt"), TEXT("por-po")}, {TEXT("ro"), TEXT("ron")}, {TEXT("ru"), TEXT("rus")}, {TEXT("sk"), TEXT("slo")}, {TEXT("sl"), TEXT("slv")}, {TEXT("sr"), TEXT("srp")}, {TEXT("sv"), TEXT("swe")}, {TEXT("sw"), TEXT("swa")}, {TEXT("tr"), TEXT("tur")}, {TEXT("uk"), TEXT("ukr")}, {TEXT("vi"), TEXT("vie-n")}, {TEXT("cmn"), TEXT("zho-s")}, {TEXT("zh"), TEXT("zho-s")}, {TEXT("j"), TEXT("jpn")}, {TEXT("ja"), TEXT("jpn")}, {TEXT("hi"), TEXT("hin")}
-	};
-
-	FLoadSoftObjectPathAsyncDelegate OnDictionaryLoaded;
-};
+// (c) Yuri N. K. 2025. All rights reserved.
+// ykasczc@gmail.com
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "LocalTTSTypes.h"
+#include "DictionaryArchive.h"
+#include "HAL/CriticalSection.h"
+#include "HAL/Event.h"
+#include <atomic>
+#include <string>
+#include "Phonemizer.generated.h"
+
+// G2P model instances used by one phonemization call
+struct FG2PSession
+{
+	// G2P model: encoder
+	FNNEModelTTS Encoder;
+	// G2P model: decoder
+	FNNEModelTTS Decoder;
+	// G2P model: decoder with past key values (optional)
+	FNNEModelTTS DecoderWithPast;
+};
+
+/**
+ * Asset to phonemize text input using dictionaries and NNE G2P model
+ * The model was fine-tuned for all voices supported by Piper.
+ * Dataset built using open IPA dictionaries https://github.com/open-dict-data/ipa-dict
+ * re-phonemized with espeak-ng https://github.com/espeak-ng/espeak-ng/
+ * G2P model architecture: https://github.com/lingjzhu/CharsiuG2P/
+ * 13 epoches, loss: 0.0107.
+ */
+UCLASS(BlueprintType)
+class LOCALTTS_API UPhonemizer : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	virtual void BeginDestroy() override;
+
+	// Phonemization dictionaries (still better the model, and of course faster)
+	// To add a new dictionary use LoadDictionaryFromArchive
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "TTS Phonemizer")
+	TMap<FName, TSoftObjectPtr<class UDictionaryArchive>> Dictionaries;
+
+	// Use incremental decoding with the G2P decoder exported with past key values (if it's loaded)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "TTS Phonemizer")
+	bool bUseCachedDecoder = true;
+
+	// Number of G2P model instances to phonemize texts in parallel (for different voices or languages). Each instance needs its own runtime memory
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "TTS Phonemizer", meta = (ClampMin = 1, ClampMax = 16))
+	int32 MaxConcurrentSessions = 1;
+
+	// Release dictionary of the language without loaded voices if it wasn't used for this time (seconds). Zero to keep dictionaries loaded
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "TTS Phonemizer", meta = (ClampMin = 0))
+	float DictionaryUnloadDelay = 120.f;
+
+	// Release dictionaries of the languages without loaded voices if all dictionaries use more memory (MB). Zero for no limit
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "TTS Phonemizer", meta = (ClampMin = 0))
+	int32 DictionaryMemoryBudgetMB = 0;
+
+	// Load NNE models and prepare to use phonemizer
+	UFUNCTION(BlueprintCallable, Category = "Phonemizer")
+	void SyncLoadModel(TSoftObjectPtr<UNNEModelData> EncoderPtr, TSoftObjectPtr<UNNEModelData> DecoderPtr);
+
+	// Load optional G2P decoder with past key values inputs/outputs to decode one token per step
+	UFUNCTION(BlueprintCallable, Category = "Phonemizer")
+	bool SyncLoadCachedDecoder(TSoftObjectPtr<UNNEModelData> DecoderWithPastPtr);
+
+	// Create G2P model instances from already loaded assets. Doesn't load anything, so can be called from any thread
+	bool InitializeModels(UNNEModelData* EncoderModelAsset, UNNEModelData* DecoderModelAsset);
+
+	// Create G2P decoder with past key values from already loaded asset. Can be called from any thread
+	bool InitializeCachedDecoder(UNNEModelData* DecoderModelAsset);
+
+	// Is the decoder with past key values loaded and usable?
+	UFUNCTION(BlueprintPure, Category = "Phonemizer")
+	bool HasCachedDecoder() const;
+
+	// Phonemize text in current language (see SetLanguageCodeFormatRaw). Automatically uses dictionary for known words, if th dictionary was loaded and unzipped for the language
+	UFUNCTION(BlueprintCallable, Category = "Phonemizer")
+	void SyncPhonemizeText(const FString& Text, FString& PhonemizedText, TArray<FString>& OutWords, bool bCharactersAsWords);
+
+	// Same as SyncPhonemizeText, but in the specified language ("eng-us" or "rus") instead of current one.
+	// Also returns NFD-normalized phonemes of the words found in dictionary (empty for other words) if OutDictionaryPhonemes isn't null.
+	// Thread-safe: several texts can be phonemized in parallel
+	void SyncPhonemizeTextToCodepoints(const FString& Text, const FString& InLanguageCode, FString& PhonemizedText, TArray<FString>& OutWords, TArray<TArray<Piper::PhonemeUtf8>>* OutDictionaryPhonemes, bool bCharactersAsWords);
+
+	// Load dictionary asset by espeak language code ("en-us", "ru") and prepare it in background thread
+	UFUNCTION(BlueprintCallable, Category = "Phonemizer")
+	void PrepareDictionary(const FString& EspeakLanguageCode);
+
+	// Set current language used by SyncPhonemizeText and PhonemizeWordsG2P without language. Language code like: "eng-us" or "rus"
+	UFUNCTION(BlueprintCallable, Category = "Phonemizer")
+	void SetLanguageCodeFormatRaw(const FString& InLanguageCode);
+
+	// Set current language. Language code like: "en-us", "ru"...
+	UFUNCTION(BlueprintCallable, Category = "Phonemizer")
+	bool SetLanguageCodeFormatEspeak(const FString& InLanguageCode, bool bUseDicrionary);
+
+	// Convert language code like "en-us" to G2P language code like "eng-us" and request dictionary if needed (doesn't wait for it). Doesn't change current language
+	UFUNCTION(BlueprintCallable, Category = "Phonemizer")
+	bool GetLanguageCodeFromEspeak(const FString& EspeakLanguageCode, bool bUseDictionary, FString& OutLanguageCode);
+
+	// Register voice using dictionary of the language (espeak code like "en-us") and prepare the dictionary
+	UFUNCTION(BlueprintCallable, Category = "Phonemizer")
+	void AddDictionaryUser(const FString& EspeakLanguageCode, int32 VoiceId);
+
+	// Voice doesn't use dictionary anymore, the dictionary can be released by UpdateDictionaries
+	UFUNCTION(BlueprintCallable, Category = "Phonemizer")
+	void RemoveDictionaryUser(const FString& EspeakLanguageCode, int32 VoiceId);
+
+	// Release unused dictionaries according to DictionaryUnloadDelay and DictionaryMemoryBudgetMB. Called by subsystem on game thread
+	void UpdateDictionaries();
+
+	// Get memory used by loaded dictionaries (bytes) by G2P language code
+	UFUNCTION(BlueprintCallable, Category = "Phonemizer")
+	TMap<FName, int64> GetDictionariesResidentSize() const;
+
+	// Use lexicon with game-specific words, lexicons are checked before dictionaries
+	UFUNCTION(BlueprintCallable, Category = "Phonemizer")
+	void AddLexicon(class UPhonemeLexicon* Lexicon);
+
+	UFUNCTION(BlueprintCallable, Category = "Phonemizer")
+	void RemoveLexicon(class UPhonemeLexicon* Lexicon);
+
+	// Add new phonemization dictionary
+	UFUNCTION(BlueprintCallable, Category = "Phonemizer")
+	void LoadDictionaryFromArchive(const FString& FileName, const FString& InLanguageCode);
+
+	// Get active language code ("eng-us" or "rus")
+	UFUNCTION(BlueprintPure, Category = "Phonemizer")
+	FString GetLanguage() const;
+
+	// Run G2P model for the words (without dictionary). Language code like: "eng-us" or "rus"
+	bool PhonemizeWordsG2P(const TArray<FString>& Words, const FString& InLanguageCode, TArray<FString>& OutPhonemes, bool bAllowCachedDecoder);
+	// Same in current language
+	bool PhonemizeWordsG2P(const TArray<FString>& Words, TArray<FString>& OutPhonemes, bool bAllowCachedDecoder);
+
+protected:
+	// G2P model instances, each phonemization call gets exclusive access to one of them
+	TArray<TUniquePtr<FG2PSession>> Sessions;
+	TArray<FG2PSession*> FreeSessions;
+	mutable FCriticalSection SessionsLock;
+	// Auto-reset: a session was released or sessions were rebuilt
+	FEvent* SessionReleasedEvent = nullptr;
+	// Manual-reset: set while all sessions are free
+	FEvent* SessionsIdleEvent = nullptr;
+	// Manual-reset: set while sessions aren't being rebuilt
+	FEvent* RebuildFinishedEvent = nullptr;
+	// Models are being replaced, new sessions can't be acquired (guarded by SessionsLock)
+	bool bSessionsRebuilding = false;
+	// Requesting dictionaries from synthesis threads
+	mutable FCriticalSection DictionaryLock;
+	// Dictionaries passed to PrepareDictionary
+	TSet<FName> RequestedDictionaries;
+	// Loaded dictionary assets (prepared or being prepared)
+	UPROPERTY(Transient)
+	TMap<FName, TObjectPtr<UDictionaryArchive>> LoadedDictionaries;
+
+	struct FDictionaryUsage
+	{
+		// Loaded voices using the dictionary
+		TSet<int32> Voices;
+		double LastUsedTime = 0.0;
+	};
+	// Usage of the dictionaries by G2P language code
+	TMap<FName, FDictionaryUsage> DictionaryUsage;
+	// Read lock while dictionary is used by SyncPhonemizeText, write lock to release dictionary
+	FRWLock DictionaryResidencyLock;
+
+	// Active lexicons (guarded by DictionaryLock)
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<class UPhonemeLexicon>> Lexicons;
+
+	// Words phonemized by G2P model and saved to file (see UTtsSettings::bSaveG2PWords)
+	struct FG2PWordsCache
+	{
+		FPhonemeDictionaryBuilder Builder;
+		TSharedPtr<const FPhonemeDictionaryTable> Table;
+		// Words added to Builder after Table was built, the table is rebuilt in batches
+		int32 PendingWordsNum = 0;
+		double LastBuildTime = 0.0;
+
+		void BuildTable();
+	};
+	TMap<FName, FG2PWordsCache> G2PWordsCaches;
+	FCriticalSection G2PWordsLock;
+
+	// Get table of saved G2P words for the language, loads the file on first call. Thread-safe
+	TSharedPtr<const FPhonemeDictionaryTable> GetG2PWordsTable(FName InLanguageCode);
+	// Add words to the file and (later, in batches) to the table. Thread-safe
+	void SaveG2PWords(FName InLanguageCode, const TArray<FString>& Words, const TArray<FString>& Phonemes);
+	static FString GetG2PWordsFilePath(FName InLanguageCode);
+
+	void OnDictionaryAssetLoaded(const FSoftObjectPath& AssetPath, UObject* LoadedAsset, FName DictKey);
+	// Get loaded dictionary and update its usage time. Thread-safe
+	UDictionaryArchive* FindResidentDictionary(FName DictKey);
+	// Release dictionary data, it will be prepared again when requested. DictionaryResidencyLock should be locked for write
+	void UnloadDictionary(FName DictKey);
+
+	// Heads (X) and head size (Y) of each past key/value input of DecoderWithPast
+	TArray<FIntPoint> DecoderPastShapes;
+	// DecoderWithPast failed at runtime, full-sequence decoder is used instead
+	std::atomic<bool> bCachedDecoderFailed = false;
+
+	// Wait for free G2P session. Returns nullptr if G2P model isn't loaded
+	FG2PSession* AcquireSession();
+	// Block new sessions, wait until all sessions are released and lock SessionsLock to replace models
+	void LockSessionsForRebuild();
+	void UnlockSessionsAfterRebuild();
+	void ReleaseSession(FG2PSession* Session);
+
+	// Language tag used as the G2P model prefix ("<eng-us>:")
+	static FString GetLanguageTag(const FString& InLanguageCode);
+
+	// Encode and decode words of similar length. Bucket is indices in WordsUtf8, OutTokens are generated tokens in the same order
+	bool PhonemizeBucketG2P(FG2PSession& Session, const TArray<std::string>& WordsUtf8, const TArray<int32>& Bucket, bool bAllowCachedDecoder, TArray<TArray<int64>>& OutTokens);
+
+	// Greedy decoding: feed whole generated sequence on each step
+	// AttentionMask and EncoderOutputs are bound to the decoder without copying, finished words are removed from them in place
+	bool DecodeFullSequence(FG2PSession& Session, int32 BatchNum, int32 SeqLen, TArray<int64>& AttentionMask, float* EncoderOutputs, TArray<uint32> EncoderOutputsShape, TArray<TArray<int64>>& OutTokens);
+
+	// Greedy decoding: feed only the latest token on each step and reuse self-attention cache
+	bool DecodeIncremental(FG2PSession& Session, int32 BatchNum, int32 SeqLen, TArray<int64>& AttentionMask, float* EncoderOutputs, TArray<uint32> EncoderOutputsShape, TArray<TArray<int64>>& OutTokens);
+
+	// ArgMax of the last-position logits for each row
+	void SelectNextTokens(const float* Logits, int32 RowStride, int32 VocabSize, int32 RowsNum, TArray<int64>& OutNextTokens) const;
+
+	// Active language code (for blueprint API)
+	FString LanguageCode;
+
+	TMap<FString, FString> EspeakToActual = {
+		{TEXT("ar"), TEXT("ara")}, {TEXT("ca"), TEXT("cat")}, {TEXT("cs"), TEXT("cze")}, {TEXT("cy"), TEXT("wel-nw")}, {TEXT("da"), TEXT("dan")}, {TEXT("de"), TEXT("ger")}, {TEXT("el"), TEXT("gre")}, {TEXT("en-gb-x-rp"), TEXT("eng-uk")}, {TEXT("en-us"), TEXT("eng-us")}, {TEXT("es"), TEXT("spa")}, {TEXT("es-419"), TEXT("spa-me")}, {TEXT("fa"), TEXT("fas")}, {TEXT("fi"), TEXT("fin")}, {TEXT("fr"), TEXT("fra")}, {TEXT("fr-fr"), TEXT("fra")}, {TEXT("hu"), TEXT("hun")}, {TEXT("is"), TEXT("ice")}, {TEXT("it"), TEXT("ita")}, {TEXT("ka"), TEXT("geo")}, {TEXT("kk"), TEXT("kaz")}, {TEXT("lb"), TEXT("ltz")}, {TEXT("nl"), TEXT("dut")}, {TEXT("nb"), TEXT("nob")}, {TEXT("pl"), TEXT("pol")}, {TEXT("pt-br"), TEXT("por-bz")}, {TEXT("pt"), TEXT("por-po")}, {TEXT("ro"), TEXT("ron")}, {TEXT("ru"), TEXT("rus")}, {TEXT("sk"), TEXT("slo")}, {TEXT("sl"), TEXT("slv")}, {TEXT("sr"), TEXT("srp")}, {TEXT("sv"), TEXT("swe")}, {TEXT("sw"), TEXT("swa")}, {TEXT("tr"), TEXT("tur")}, {TEXT("uk"), TEXT("ukr")}, {TEXT("vi"), TEXT("vie-n")}, {TEXT("cmn"), TEXT("zho-s")}, {TEXT("zh"), TEXT("zho-s")}, {TEXT("j"), TEXT("jpn")}, {TEXT("ja"), TEXT("jpn")}, {TEXT("hi"), TEXT("hin")}
+	};
+};
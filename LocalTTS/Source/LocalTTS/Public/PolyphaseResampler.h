@@ -0,0 +1,64 @@
+// (c) Yuri N. K. 2025. All rights reserved.
+// ykasczc@gmail.com
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DSP/AlignedBuffer.h"
+
+/**
+ * Windowed-sinc FIR filter split into phases for rational resampling InRate -> OutRate (Up / Down)
+ * Immutable after creation, so it's shared by all resamplers with the same rates
+ */
+struct LOCALTTS_API FPolyphaseFilterBank
+{
+	// Max number of phases (OutRate / gcd), larger banks aren't created
+	static constexpr int32 MaxPhasesNum = 4096;
+
+	int32 InRate = 0;
+	int32 OutRate = 0;
+	int32 Up = 1;
+	int32 Down = 1;
+	// Filter length of each phase, multiple of 4
+	int32 TapsNum = 0;
+	// Up x TapsNum, taps of each phase are stored in input order (Taps[i] weights i-th sample of the window), so dot product with input is contiguous
+	Audio::FAlignedFloatBuffer Coefficients;
+
+	const float* GetPhase(int32 Phase) const { return Coefficients.GetData() + (int64)Phase * TapsNum; }
+
+	// Returns nullptr if rates are invalid or ratio is too complex
+	static TSharedPtr<const FPolyphaseFilterBank> Create(int32 InRate, int32 OutRate, int32 TapsNum = 32);
+};
+
+/**
+ * Streaming polyphase resampler. Input can be pushed in chunks (e.g. sentences), output is appended
+ */
+class LOCALTTS_API FPolyphaseResampler
+{
+public:
+	FPolyphaseResampler(TSharedPtr<const FPolyphaseFilterBank> InFilterBank);
+
+	// Resample next chunk and append output to OutData
+	void Process(const float* Data, int32 Num, Audio::FAlignedFloatBuffer& OutData);
+	// Same as Process for Num zero samples
+	void ProcessSilence(int32 Num, Audio::FAlignedFloatBuffer& OutData);
+	// Append the rest of output delayed by filter
+	void Flush(Audio::FAlignedFloatBuffer& OutData);
+	// Prepare to process new stream
+	void Reset();
+
+	// Number of output samples for Num input samples
+	int64 GetOutputNum(int64 Num) const { return (Num * FilterBank->Up + FilterBank->Down - 1) / FilterBank->Down; }
+
+private:
+	void ProduceOutput(int64 InputEnd, int64 OutputEnd, Audio::FAlignedFloatBuffer& OutData);
+
+	TSharedPtr<const FPolyphaseFilterBank> FilterBank;
+	// Input samples starting from absolute index HistoryStart (negative indices are zeros)
+	TArray<float> History;
+	int64 HistoryStart = 0;
+	// Total number of pushed input samples
+	int64 InputNum = 0;
+	// Absolute index of the next output sample
+	int64 OutputIndex = 0;
+};
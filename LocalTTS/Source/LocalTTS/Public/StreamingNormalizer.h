@@ -0,0 +1,51 @@
+// (c) Yuri N. K. 2025. All rights reserved.
+// ykasczc@gmail.com
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DSP/AlignedBuffer.h"
+
+/**
+ * Streaming peak normalizer (look-ahead limiter) to replace whole-buffer peak normalization.
+ * Gain is computed per block of BlockSize samples from block peaks in the look-ahead window:
+ * it goes down linearly ahead of louder blocks and rises back slowly (by 6 dB per ReleaseSeconds).
+ * Output is scaled to TargetPeak = 1 and delayed by GetLatency() samples until Flush
+ */
+class LOCALTTS_API FStreamingNormalizer
+{
+public:
+	static constexpr int32 BlockSize = 64;
+
+	FStreamingNormalizer(int32 SampleRate, float LookAheadSeconds = 0.05f, float ReleaseSeconds = 4.f, float InMinPeak = 0.01f);
+
+	// Normalize next chunk and append ready output to OutData
+	void Process(const float* Data, int32 Num, Audio::FAlignedFloatBuffer& OutData);
+	// Append the rest of output
+	void Flush(Audio::FAlignedFloatBuffer& OutData);
+	// Prepare to process new stream
+	void Reset();
+
+	// Max number of samples kept until more input or Flush
+	int32 GetLatency() const { return (LookAheadBlocks + 2) * BlockSize; }
+
+private:
+	// Peak of block in Pending (block -1 is the last one sent to output, blocks after the end are silent)
+	float GetPeak(int32 Block) const;
+	// Max gain which doesn't clip block and previous one
+	float GetRequiredGain(int32 Block) const;
+	// Write BlocksNum blocks from Pending to OutData and remove them
+	void ProduceOutput(int32 BlocksNum, Audio::FAlignedFloatBuffer& OutData);
+
+	int32 LookAheadBlocks = 1;
+	float ReleaseStep = 1.f;
+	float MinPeak = 0.01f;
+
+	// Input samples not sent to output yet, starting from block boundary
+	TArray<float> Pending;
+	// Peaks of complete blocks in Pending
+	TArray<float> BlockPeaks;
+	float LastPeak = 0.f;
+	// Gain at the start of the first pending block (negative before first output)
+	float Gain = -1.f;
+};
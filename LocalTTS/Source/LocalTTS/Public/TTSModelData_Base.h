@@ -1,115 +1,218 @@
-// (c) Yuri N. K. 2025. All rights reserved.
-// ykasczc@gmail.com
-
-#pragma once
-
-#include "CoreMinimal.h"
-#include "Engine/DataAsset.h"
-#include "LocalTTSTypes.h"
-#include "TTSModelData_Base.generated.h"
-
-// Nested array of IDs to token-to-IDs map
-USTRUCT(BlueprintType)
-struct FTokensArrayWrapper
-{
-	GENERATED_BODY()
-
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Tokens Array")
-	TArray<int32> Tokens;
-
-	FTokensArrayWrapper() {}
-	FTokensArrayWrapper(const TArray<int32>& InTokens)
-	{
-		Tokens = InTokens;
-	}
-};
-
-/**
- * Practically virtual asset to describe ONNX model settings and provide tokenization.
- * Should create child class for each type of TTS
- */
-UCLASS()
-class LOCALTTS_API UTTSModelData_Base : public UDataAsset
-{
-	GENERATED_BODY()
-
-public:
-	UTTSModelData_Base();
-
-	// Speakers (voices) supported by this model, if it supports more than one, with corresponding IDs (speaker tokens)
-	UPROPERTY(VisibleAnywhere, BlueprintReadWrite, Category = "Model")
-	TMap<FString, int32> Speakers;
-
-	// Language code used in eSpeak phonemizer
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta=(DisplayName="eSpeak Language Code"), Category = "Model")
-	FString ESpeakVoiceCode;
-
-	// General language code
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Model")
-	FString LanguageCode;
-
-	// General language family
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Model")
-	FString LanguageFamily;
-
-	// Sample rate used by the model this asset describes
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Model")
-	int32 SampleRate = 22050;
-
-	// Num channels (it's always mono)
-	UPROPERTY(VisibleAnywhere, BlueprintReadWrite, Category = "Model")
-	int32 Channels = 1;
-
-	// Extra silence to add between sentences
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Model")
-	float SentenceSilenceSeconds = 0.f;
-
-	// Speaking speed
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Model")
-	float Speed = 1.f;
-
-	// It's internal, used to predict output audio buffer size by phonemes number
-	UPROPERTY(VisibleAnywhere, BlueprintReadWrite, Category = "Model")
-	float BaseSynthesisSpeedMultiplier = 1.f;
-
-	// Neural net vocabulary
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Tokenizer")
-	TMap<FString, FTokensArrayWrapper> TokenToId;
-
-	// eSpeak phonemization is supported only in non-commercial version (due to GPL-3.0 limitations), and NN/dicrionaries is supported only in the Fab version
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Tokenizer")
-	ETTSPhonemeType PhonemizationType;
-
-	// Universal function to generate phonemes splitted by sentences
-	virtual bool PhonemizeText(const FString& InText, FString& OutText, int32 SpeakerId, TArray<TArray<Piper::PhonemeUtf8>>& Phonemes, bool bCastCharactersAsWords = false);
-
-	// Get phonemization code (usually eSpeakVoiceCode, but can be overriden for multilangual models)
-	virtual FString GetEspeakCode(int32 SpeakerId) const;
-
-	// Convert array of phonemes to tokens
-	virtual bool Tokenize(const TArray<Piper::PhonemeUtf8>& Phonemes, TArray<Piper::PhonemeId>& OutTokens, TMap<Piper::PhonemeUtf8, int32>& OutMissedPhonemes, bool bFirst, bool bLast);
-
-	// Called before RunSync to initialize model's input parameters
-	virtual bool SetNNEInputParams(FNNEModelTTS& NNModel, const FTTSGenerateRequestContext& Context) const;
-
-	// Called after RunSync for audio normalization, if needed
-	virtual void PostProcessNND(FSynthesisResult& SynthesisData) const {};
-
-	// Import setting of this asset from file
-	virtual void ImportFromFile(const FString& FileName) {};
-
-	// Fill PhonemeIdMap from TokenToId
-	void EnsurePhonemesMap();
-
-protected:
-	Piper::PhonemeUtf8 P_Period = U'.';      // CLAUSE_PERIOD
-	Piper::PhonemeUtf8 P_Comma = U',';       // CLAUSE_COMMA
-	Piper::PhonemeUtf8 P_Question = U'?';    // CLAUSE_QUESTION
-	Piper::PhonemeUtf8 P_Exclamation = U'!'; // CLAUSE_EXCLAMATION
-	Piper::PhonemeUtf8 P_Colon = U':';       // CLAUSE_COLON
-	Piper::PhonemeUtf8 P_Semicolon = U';';   // CLAUSE_SEMICOLON
-	Piper::PhonemeUtf8 P_Space = U' ';
-
-	// Toknization map converted from Unreal to NN-readable format
-	TMap<Piper::PhonemeUtf8, TArray<Piper::PhonemeId>> PhonemeIdMap;
-};
+// (c) Yuri N. K. 2025. All rights reserved.
+// ykasczc@gmail.com
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "LocalTTSTypes.h"
+#include <atomic>
+#include "TTSModelData_Base.generated.h"
+
+// Nested array of IDs to token-to-IDs map
+USTRUCT(BlueprintType)
+struct FTokensArrayWrapper
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Tokens Array")
+	TArray<int32> Tokens;
+
+	FTokensArrayWrapper() {}
+	FTokensArrayWrapper(const TArray<int32>& InTokens)
+	{
+		Tokens = InTokens;
+	}
+};
+
+/**
+ * Vocabulary compiled to flat arrays: phoneme code point -> span of token ids
+ */
+struct LOCALTTS_API FPhonemeTokenTable
+{
+	// Code points below this value (Latin, IPA, diacritics, Greek, Cyrillic, punctuation, arrows) are indexed directly
+	static constexpr uint32 DenseRange = 0x3000;
+
+	// Fixed-size span in Ids
+	struct FSpan
+	{
+		int32 Offset = 0;
+		int32 Num = 0;
+	};
+
+	// Build from asset vocabulary, keys are normalized to NFD
+	void Build(const TMap<FString, FTokensArrayWrapper>& TokenToId);
+	void Reset();
+
+	bool IsEmpty() const { return Spans.IsEmpty(); }
+	int32 Num() const { return Spans.Num(); }
+	// Max number of ids per phoneme, used to pre-size output
+	int32 GetMaxIdsNum() const { return MaxIdsNum; }
+
+	FORCEINLINE bool Find(Piper::PhonemeUtf8 Phoneme, TConstArrayView<Piper::PhonemeId>& OutIds) const
+	{
+		int32 SpanIndex = INDEX_NONE;
+		if ((uint32)Phoneme < DenseRange)
+		{
+			SpanIndex = (int32)Dense[(int32)Phoneme] - 1;
+		}
+		else if (const int32* FoundIndex = Fallback.Find(Phoneme))
+		{
+			SpanIndex = *FoundIndex;
+		}
+		if (SpanIndex < 0)
+		{
+			return false;
+		}
+		const FSpan& Span = Spans[SpanIndex];
+		OutIds = TConstArrayView<Piper::PhonemeId>(Ids.GetData() + Span.Offset, Span.Num);
+		return true;
+	}
+
+private:
+	// Span index + 1 for each code point in dense range, 0 if phoneme isn't in vocabulary
+	TArray<uint16> Dense;
+	// Span index for code points above DenseRange
+	TMap<Piper::PhonemeUtf8, int32> Fallback;
+	TArray<FSpan> Spans;
+	TArray<Piper::PhonemeId> Ids;
+	int32 MaxIdsNum = 0;
+};
+
+/**
+ * Practically virtual asset to describe ONNX model settings and provide tokenization.
+ * Should create child class for each type of TTS
+ */
+UCLASS()
+class LOCALTTS_API UTTSModelData_Base : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	UTTSModelData_Base();
+
+	// UObject interface
+	virtual void PostLoad() override;
+	virtual void FinishDestroy() override;
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+	// End UObject interface
+
+	// Speakers (voices) supported by this model, if it supports more than one, with corresponding IDs (speaker tokens)
+	UPROPERTY(VisibleAnywhere, BlueprintReadWrite, Category = "Model")
+	TMap<FString, int32> Speakers;
+
+	// Language code used in eSpeak phonemizer
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta=(DisplayName="eSpeak Language Code"), Category = "Model")
+	FString ESpeakVoiceCode;
+
+	// General language code
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Model")
+	FString LanguageCode;
+
+	// General language family
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Model")
+	FString LanguageFamily;
+
+	// Sample rate used by the model this asset describes
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Model")
+	int32 SampleRate = 22050;
+
+	// Num channels (it's always mono)
+	UPROPERTY(VisibleAnywhere, BlueprintReadWrite, Category = "Model")
+	int32 Channels = 1;
+
+	// Extra silence to add between sentences
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Model")
+	float SentenceSilenceSeconds = 0.f;
+
+	// Speaking speed
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Model")
+	float Speed = 1.f;
+
+	// Cut near-silent audio at the start and end of each synthesized phrase (before SentenceSilenceSeconds is added)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Silence Trimming")
+	bool bTrimSilence = false;
+
+	// RMS level of 10 ms frame (dB relative to peak of the phrase) below which the frame is silent
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (EditCondition = bTrimSilence, ClampMax = 0), Category = "Silence Trimming")
+	float TrimThresholdDb = -50.f;
+
+	// Silence to keep before the first and after the last non-silent frame
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (EditCondition = bTrimSilence, ClampMin = 0), Category = "Silence Trimming")
+	float TrimPaddingSeconds = 0.05f;
+
+	// It's internal, used to predict output audio buffer size by phonemes number
+	UPROPERTY(VisibleAnywhere, BlueprintReadWrite, Category = "Model")
+	float BaseSynthesisSpeedMultiplier = 1.f;
+
+	// Neural net vocabulary
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Tokenizer")
+	TMap<FString, FTokensArrayWrapper> TokenToId;
+
+	// eSpeak phonemization is supported only in non-commercial version (due to GPL-3.0 limitations), and NN/dicrionaries is supported only in the Fab version
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Tokenizer")
+	ETTSPhonemeType PhonemizationType;
+
+	// Universal function to generate phonemes splitted by sentences
+	virtual bool PhonemizeText(const FString& InText, FString& OutText, int32 SpeakerId, FPhonemePhrases& Phonemes, bool bCastCharactersAsWords = false);
+
+	// Get phonemization code (usually eSpeakVoiceCode, but can be overriden for multilangual models)
+	virtual FString GetEspeakCode(int32 SpeakerId) const;
+
+	// Convert array of phonemes to tokens
+	virtual bool Tokenize(TConstArrayView<Piper::PhonemeUtf8> Phonemes, TArray<Piper::PhonemeId>& OutTokens, TMap<Piper::PhonemeUtf8, int32>& OutMissedPhonemes, bool bFirst, bool bLast);
+
+	// Called before RunSync to initialize model's input parameters
+	virtual bool SetNNEInputParams(FNNEModelTTS& NNModel, const FTTSGenerateRequestContext& Context) const;
+
+	// Get range of phrase audio to keep after trimming of leading and trailing silence (OutStart == OutEnd if all audio is silent).
+	// Threshold is relative to Peak of the phrase, because raw model output isn't normalized yet. Only silent frames at the edges are read
+	void GetTrimmedRange(const float* Data, int32 Num, float Peak, int32& OutStart, int32& OutEnd) const;
+
+	// Can phrases of one request be synthesized in parallel by several model instances?
+	virtual bool SupportsParallelBatches() const { return false; }
+
+	// Called after RunSync for audio normalization, if needed
+	virtual void PostProcessNND(FSynthesisResult& SynthesisData) const {};
+
+	// Min peak used to normalize output by peak volume (0 if output isn't normalized)
+	virtual float GetNormalizationMinPeak() const { return 0.f; }
+
+	// Import setting of this asset from file
+	virtual void ImportFromFile(const FString& FileName) {};
+
+	// Compile TokenToId and publish it for Tokenize. Call it after changing TokenToId in runtime
+	UFUNCTION(BlueprintCallable, Category = "Tokenizer")
+	void RebuildTokenTable();
+
+
+protected:
+	Piper::PhonemeUtf8 P_Period = U'.';      // CLAUSE_PERIOD
+	Piper::PhonemeUtf8 P_Comma = U',';       // CLAUSE_COMMA
+	Piper::PhonemeUtf8 P_Question = U'?';    // CLAUSE_QUESTION
+	Piper::PhonemeUtf8 P_Exclamation = U'!'; // CLAUSE_EXCLAMATION
+	Piper::PhonemeUtf8 P_Colon = U':';       // CLAUSE_COLON
+	Piper::PhonemeUtf8 P_Semicolon = U';';   // CLAUSE_SEMICOLON
+	Piper::PhonemeUtf8 P_Space = U' ';
+
+	// Shared tokenizer loop for Piper-like vocabularies
+	bool TokenizeWithTable(TConstArrayView<Piper::PhonemeUtf8> Phonemes, TArray<Piper::PhonemeId>& OutTokens, TMap<Piper::PhonemeUtf8, int32>& OutMissedPhonemes,
+		bool bFirst, bool bLast, bool bInterspersePad, bool bAddBos, bool bAddEos,
+		Piper::PhonemeUtf8 CharPad, Piper::PhonemeUtf8 CharBOS, Piper::PhonemeUtf8 CharEOS) const;
+
+private:
+	// Toknization map converted from Unreal to NN-readable format. Published tables are never modified
+	std::atomic<const FPhonemeTokenTable*> TokenTable = nullptr;
+	// Number of Tokenize calls currently reading TokenTable
+	mutable std::atomic<int32> TokenTableReaders = 0;
+	// Replaced tables waiting until no Tokenize call can read them
+	mutable TArray<TUniquePtr<const FPhonemeTokenTable>> RetiredTokenTables;
+	mutable std::atomic<bool> bHasRetiredTokenTables = false;
+	// Only used by RebuildTokenTable and reclamation, never by Tokenize
+	mutable FCriticalSection TokenTableWriteLock;
+
+	// Delete retired tables if there are no readers. Caller must hold TokenTableWriteLock
+	void ReclaimRetiredTokenTables() const;
+};
@@ -1,71 +1,86 @@
-// (c) Yuri N. K. 2025. All rights reserved.
-// ykasczc@gmail.com
-
-#pragma once
-
-#include "CoreMinimal.h"
-#include "AudioMixerTypes.h"
-#include "UObject/ObjectMacros.h"
-#include "Sound/SoundWaveProcedural.h"
-#include "Runtime/Launch/Resources/Version.h"
-#include "TTSSoundWaveRuntime.generated.h"
-
-/**
- * SoundWave asset created in runtime with access to PCM data from blueprint
- */
-UCLASS()
-class LOCALTTS_API UTTSSoundWaveRuntime : public USoundWaveProcedural
-{
-	GENERATED_BODY()
-
-protected:
-
-	// The actual audio buffer that can be consumed. QueuedAudio is fed to this buffer. Accessed only audio thread.
-	TArray<uint8> StaticAudioBuffer;
-
-public:
-	UTTSSoundWaveRuntime(const FObjectInitializer& ObjectInitializer);
-
-	// Get audio sample rate for current platform
-	UFUNCTION(BlueprintPure, Category = "Sound Wave")
-	int32 GetPlatformSampleRate() const;
-
-	// Get channesl number
-	UFUNCTION(BlueprintPure, Category = "Sound Wave")
-	int32 GetChannelsNum() const;
-
-	// Get raw 16-bit audio buffer
-	UFUNCTION(BlueprintPure, meta=(DisplayName = "Get PCM Data"), Category = "Sound Wave")
-	void GetRawPCMData(TArray<uint8>& Buffer) const;
-
-	//~ Begin USoundBase Interface.
-	virtual void Parse(class FAudioDevice* AudioDevice, const UPTRINT NodeWaveInstanceHash, FActiveSound& ActiveSound, const FSoundParseParameters& ParseParams, TArray<FWaveInstance*>& WaveInstances) override;
-	//~ End USoundBase Interface.
-
-	//~ Begin USoundWave Interface.
-	virtual int32 GeneratePCMData(uint8* PCMData, const int32 SamplesNeeded) override;
-	virtual bool HasCompressedData(FName Format, ITargetPlatform* TargetPlatform) const override;
-	virtual void BeginGetCompressedData(FName Format, const FPlatformAudioCookOverrides* CompressionOverrides, const ITargetPlatform* InTargetPlatform) override;
-	virtual FByteBulkData* GetCompressedData(FName Format, const FPlatformAudioCookOverrides* CompressionOverrides, const ITargetPlatform* InTargetPlatform) override;
-	virtual void InitAudioResource(FByteBulkData& CompressedData) override;
-	virtual bool InitAudioResource(FName Format) override;
-	virtual int32 GetResourceSizeForFormat(FName Format) override;
-	virtual Audio::EAudioMixerStreamDataFormat::Type GetGeneratedPCMDataFormat() const override { return Audio::EAudioMixerStreamDataFormat::Int16; }
-	//~ End USoundWave Interface.
-
-	/** Add data to the FIFO that feeds the audio device. */
-	void InitializeAudio(const uint8* AudioData, const int32 BufferSize);
-
-	/** Query bytes queued for playback */
-	int32 GetAudioBufferSize();
-
-private:
-
-	mutable TSharedPtr<FCriticalSection> DataMutex;
-
-	bool SetPlaybackTime(float PlaybackTime);
-	float GetPlaybackTime() const;
-	bool IsPlaybackFinished() const;
-
-	uint32 PlayedNumOfFrames = 0;
-};
+// (c) Yuri N. K. 2025. All rights reserved.
+// ykasczc@gmail.com
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AudioMixerTypes.h"
+#include "DSP/AlignedBuffer.h"
+#include "UObject/ObjectMacros.h"
+#include "Sound/SoundWaveProcedural.h"
+#include "Runtime/Launch/Resources/Version.h"
+#include "TTSSoundWaveRuntime.generated.h"
+
+/**
+ * SoundWave asset created in runtime with access to PCM data from blueprint
+ */
+UCLASS()
+class LOCALTTS_API UTTSSoundWaveRuntime : public USoundWaveProcedural
+{
+	GENERATED_BODY()
+
+protected:
+
+	// The actual audio buffer that can be consumed. QueuedAudio is fed to this buffer. Accessed only audio thread.
+	TArray<uint8> StaticAudioBuffer;
+
+	// Float audio used instead of StaticAudioBuffer if the wave is initialized by InitializeAudioFloat
+	Audio::FAlignedFloatBuffer FloatAudioBuffer;
+	bool bFloatAudio = false;
+
+public:
+	UTTSSoundWaveRuntime(const FObjectInitializer& ObjectInitializer);
+
+	// Get audio sample rate for current platform
+	UFUNCTION(BlueprintPure, Category = "Sound Wave")
+	int32 GetPlatformSampleRate() const;
+
+	// Get channesl number
+	UFUNCTION(BlueprintPure, Category = "Sound Wave")
+	int32 GetChannelsNum() const;
+
+	// Get raw 16-bit audio buffer (converted from float audio if needed)
+	UFUNCTION(BlueprintPure, meta=(DisplayName = "Get PCM Data"), Category = "Sound Wave")
+	void GetRawPCMData(TArray<uint8>& Buffer) const;
+
+	// Get float audio buffer (empty if the wave is initialized with 16-bit data)
+	const Audio::FAlignedFloatBuffer& GetFloatPCMData() const { return FloatAudioBuffer; }
+
+	//~ Begin USoundBase Interface.
+	virtual void Parse(class FAudioDevice* AudioDevice, const UPTRINT NodeWaveInstanceHash, FActiveSound& ActiveSound, const FSoundParseParameters& ParseParams, TArray<FWaveInstance*>& WaveInstances) override;
+	//~ End USoundBase Interface.
+
+	//~ Begin USoundWave Interface.
+	virtual int32 GeneratePCMData(uint8* PCMData, const int32 SamplesNeeded) override;
+	virtual bool HasCompressedData(FName Format, ITargetPlatform* TargetPlatform) const override;
+	virtual void BeginGetCompressedData(FName Format, const FPlatformAudioCookOverrides* CompressionOverrides, const ITargetPlatform* InTargetPlatform) override;
+	virtual FByteBulkData* GetCompressedData(FName Format, const FPlatformAudioCookOverrides* CompressionOverrides, const ITargetPlatform* InTargetPlatform) override;
+	virtual void InitAudioResource(FByteBulkData& CompressedData) override;
+	virtual bool InitAudioResource(FName Format) override;
+	virtual int32 GetResourceSizeForFormat(FName Format) override;
+	virtual Audio::EAudioMixerStreamDataFormat::Type GetGeneratedPCMDataFormat() const override { return bFloatAudio ? Audio::EAudioMixerStreamDataFormat::Float : Audio::EAudioMixerStreamDataFormat::Int16; }
+	//~ End USoundWave Interface.
+
+	/** Add data to the FIFO that feeds the audio device. */
+	void InitializeAudio(const uint8* AudioData, const int32 BufferSize);
+
+	/** Take ownership of float audio (in [-1, 1] range) and play it without conversion to 16-bit */
+	void InitializeAudioFloat(Audio::FAlignedFloatBuffer&& AudioData);
+
+	/** Query bytes queued for playback */
+	int32 GetAudioBufferSize();
+
+private:
+
+	mutable TSharedPtr<FCriticalSection> DataMutex;
+
+	bool SetPlaybackTime(float PlaybackTime);
+	float GetPlaybackTime() const;
+	bool IsPlaybackFinished() const;
+
+	// Current audio buffer in format of GetGeneratedPCMDataFormat
+	const uint8* GetAudioData() const { return bFloatAudio ? (const uint8*)FloatAudioBuffer.GetData() : StaticAudioBuffer.GetData(); }
+	int32 GetAudioDataSize() const { return bFloatAudio ? FloatAudioBuffer.Num() * sizeof(float) : StaticAudioBuffer.Num(); }
+
+	uint32 PlayedNumOfFrames = 0;
+};
@@ -0,0 +1,83 @@
+// (c) Yuri N. K. 2025. All rights reserved.
+// ykasczc@gmail.com
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TTSSoundWaveRuntime.h"
+#include "DSP/Dsp.h"
+#include <atomic>
+#include "TTSSoundWaveStreaming.generated.h"
+
+/**
+ * Sound wave which can be played while audio is still being synthesized.
+ * Float audio is appended by one producer thread (AppendAudio) and drained by the audio render thread
+ * through a lock-free single-producer/single-consumer ring buffer. If the ring is full, the producer
+ * chains a larger one and the audio thread switches to it after the old ring is empty, so synthesis
+ * never waits for playback, no audio is dropped and the audio thread doesn't allocate memory
+ */
+UCLASS()
+class LOCALTTS_API UTTSSoundWaveStreaming : public UTTSSoundWaveRuntime
+{
+	GENERATED_BODY()
+
+public:
+	UTTSSoundWaveStreaming(const FObjectInitializer& ObjectInitializer);
+
+	// Number of times the audio thread had no data to play after playback started and before the stream was finished
+	UFUNCTION(BlueprintPure, Category = "Sound Wave")
+	int32 GetUnderrunsNum() const { return UnderrunsNum.load(std::memory_order_relaxed); }
+
+	// Total number of silent samples played because of underruns
+	UFUNCTION(BlueprintPure, Category = "Sound Wave")
+	int64 GetUnderrunSamplesNum() const { return UnderrunSamplesNum.load(std::memory_order_relaxed); }
+
+	// Number of samples appended but not played yet
+	UFUNCTION(BlueprintPure, Category = "Sound Wave")
+	int32 GetQueuedSamplesNum() const { return (int32)QueuedSamplesNum.load(std::memory_order_relaxed); }
+
+	// Was all audio of the stream appended?
+	UFUNCTION(BlueprintPure, Category = "Sound Wave")
+	bool IsStreamFinished() const { return bStreamFinished.load(std::memory_order_acquire); }
+
+	//~ Begin USoundBase Interface.
+	virtual void Parse(class FAudioDevice* AudioDevice, const UPTRINT NodeWaveInstanceHash, FActiveSound& ActiveSound, const FSoundParseParameters& ParseParams, TArray<FWaveInstance*>& WaveInstances) override;
+	//~ End USoundBase Interface.
+
+	//~ Begin USoundWave Interface.
+	virtual int32 GeneratePCMData(uint8* PCMData, const int32 SamplesNeeded) override;
+	virtual Audio::EAudioMixerStreamDataFormat::Type GetGeneratedPCMDataFormat() const override { return Audio::EAudioMixerStreamDataFormat::Float; }
+	//~ End USoundWave Interface.
+
+	/** Set sample rate and initial ring buffer size. Call it before the wave is played or audio is appended */
+	void InitializeStream(int32 InSampleRate, int32 CapacitySamples);
+
+	/** Append copy of float audio (producer thread only) */
+	void AppendAudio(const float* AudioData, int32 Num);
+
+	/** Mark end of the stream: playback stops after the queued audio (producer thread only) */
+	void FinishStream();
+
+	/** Number of samples played so far */
+	int64 GetPlayedSamplesNum() const { return PlayedSamplesNum.load(std::memory_order_relaxed); }
+
+private:
+	struct FStreamRing
+	{
+		Audio::TCircularAudioBuffer<float> Buffer;
+		// Larger ring which gets the audio after this one, set by the producer after its last push to this ring
+		std::atomic<FStreamRing*> Next = nullptr;
+	};
+
+	// Owned by the producer: the ring being read and the rings after it (earlier rings are deleted by AppendAudio)
+	TArray<TUniquePtr<FStreamRing>> Rings;
+	// Ring being read, switched by the audio thread
+	std::atomic<FStreamRing*> ReadRing = nullptr;
+	std::atomic<int64> QueuedSamplesNum = 0;
+
+	std::atomic<bool> bStreamFinished = false;
+	// Written by the audio thread only
+	std::atomic<int64> PlayedSamplesNum = 0;
+	std::atomic<int32> UnderrunsNum = 0;
+	std::atomic<int64> UnderrunSamplesNum = 0;
+};
@@ -1,17 +1,17 @@
-// (c) Yuri N. K. 2025. All rights reserved.
-// ykasczc@gmail.com
-
-#pragma once
- 
-#include "Modules/ModuleManager.h"
-
-class FLocalTTSEditor : public IModuleInterface
-{
-public:
-	virtual void StartupModule() override;
-	virtual void ShutdownModule() override;
-
-
-private:
-
+// (c) Yuri N. K. 2025. All rights reserved.
+// ykasczc@gmail.com
+
+#pragma once
+ 
+#include "Modules/ModuleManager.h"
+
+class FLocalTTSEditor : public IModuleInterface
+{
+public:
+	virtual void StartupModule() override;
+	virtual void ShutdownModule() override;
+
+
+private:
+
 };
\ No newline at end of file